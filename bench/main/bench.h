@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "ArduinoJson.h"
+#include "platform.h"
+
+// Microbenchmark runner shared by the ESP32 benchmark firmware (bench/) and
+// the host build (host/bench). Each case is run in batches of a calibrated
+// number of iterations, wall time and CPU cycles are taken per batch and
+// reported per operation.
+
+// keeps the compiler from optimizing away a result
+template <typename T> static inline void bench_keep(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+typedef struct
+{
+    const char *name;
+    uint32_t iterations; // per batch
+    uint32_t batches;
+    double nsMin;
+    double nsMedian;
+    double nsMax;
+    double cyclesMedian;
+} bench_result_t;
+
+class Bench {
+  public:
+    typedef struct
+    {
+        uint32_t batchUs = 20000; // target duration of one batch
+        uint32_t batches = 15;
+        const char *filter = nullptr; // only run cases containing this string
+    } Config;
+
+  protected:
+    Config m_config;
+    std::vector<bench_result_t> m_results;
+
+    void addResult(const char *name, uint32_t iterations, std::vector<int64_t> &us, std::vector<uint32_t> &cycles);
+
+  public:
+    Bench(const Config &config) : m_config(config)
+    {
+    }
+
+    bool selected(const char *name) const
+    {
+        return !m_config.filter || strstr(name, m_config.filter);
+    }
+
+    template <typename F> void run(const char *name, F &&op)
+    {
+        if (!selected(name)) {
+            return;
+        }
+
+        // warm up and double the iterations until a batch takes long enough
+        uint32_t iterations = 1;
+        while (iterations < (1u << 24)) {
+            int64_t start = platform_time_us();
+            for (uint32_t i = 0; i < iterations; i++) {
+                op();
+            }
+            if (platform_time_us() - start >= m_config.batchUs) {
+                break;
+            }
+            iterations *= 2;
+        }
+
+        std::vector<int64_t> us(m_config.batches);
+        std::vector<uint32_t> cycles(m_config.batches);
+        for (uint32_t b = 0; b < m_config.batches; b++) {
+            int64_t start = platform_time_us();
+            uint32_t startCycles = platform_cycle_count();
+            for (uint32_t i = 0; i < iterations; i++) {
+                op();
+            }
+            cycles[b] = platform_cycle_count() - startCycles;
+            us[b] = platform_time_us() - start;
+        }
+        addResult(name, iterations, us, cycles);
+    }
+
+    const std::vector<bench_result_t> &getResults() const
+    {
+        return m_results;
+    }
+
+    // {"platform": .., "version": .., "cycle_counter": .., "results": [..]}
+    void toJson(JsonDocument &doc, const char *platform, const char *version, const char *cycleCounter) const;
+};
+
+// runs all cases of the suite
+void bench_run_suite(Bench &bench);
@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <string>
+
+#include "ArduinoJson.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "sdkconfig.h"
+
+#include "bench.h"
+#include "eventlog.h"
+
+static const char *TAG = "microbench";
+
+// Runs the suite once after boot. The results are printed between
+// BENCH_JSON_BEGIN and BENCH_JSON_END, cycles are counted with CCOUNT.
+extern "C" void app_main(void)
+{
+    // the hot paths log at info level
+    esp_log_level_set("*", ESP_LOG_WARN);
+    EVENT_LOG.init(CONFIG_EVENTLOG_RECORDS);
+
+    ESP_LOGW(TAG, "running microbenchmarks at %d MHz", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+
+    Bench::Config config;
+    Bench bench(config);
+    bench_run_suite(bench);
+
+    JsonDocument doc;
+    bench.toJson(doc, CONFIG_IDF_TARGET, esp_app_get_description()->version, "ccount");
+    doc["cpu_mhz"] = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+
+    std::string json;
+    serializeJson(doc, json);
+    printf("BENCH_JSON_BEGIN\n%s\nBENCH_JSON_END\n", json.c_str());
+    fflush(stdout);
+}
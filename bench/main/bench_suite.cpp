@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "crc.h"
+#include "history.h"
+#include "mining.h"
+#include "stratum_api.h"
+
+void Bench::addResult(const char *name, uint32_t iterations, std::vector<int64_t> &us, std::vector<uint32_t> &cycles)
+{
+    std::sort(us.begin(), us.end());
+    std::sort(cycles.begin(), cycles.end());
+
+    bench_result_t result;
+    result.name = name;
+    result.iterations = iterations;
+    result.batches = us.size();
+    result.nsMin = (double) us.front() * 1000.0 / iterations;
+    result.nsMedian = (double) us[us.size() / 2] * 1000.0 / iterations;
+    result.nsMax = (double) us.back() * 1000.0 / iterations;
+    result.cyclesMedian = (double) cycles[cycles.size() / 2] / iterations;
+    m_results.push_back(result);
+
+    printf("%-40s %12.1f ns/op %12.1f cycles/op (%u x %u)\n", name, result.nsMedian, result.cyclesMedian,
+           (unsigned) result.batches, (unsigned) iterations);
+    fflush(stdout);
+}
+
+void Bench::toJson(JsonDocument &doc, const char *platform, const char *version, const char *cycleCounter) const
+{
+    doc["platform"] = platform;
+    doc["version"] = version;
+    doc["cycle_counter"] = cycleCounter;
+    doc["batch_us"] = m_config.batchUs;
+
+    JsonArray results = doc["results"].to<JsonArray>();
+    for (const bench_result_t &r : m_results) {
+        JsonObject obj = results.add<JsonObject>();
+        obj["name"] = r.name;
+        obj["iterations"] = r.iterations;
+        obj["batches"] = r.batches;
+        obj["ns_min"] = r.nsMin;
+        obj["ns_median"] = r.nsMedian;
+        obj["ns_max"] = r.nsMax;
+        obj["cycles_median"] = r.cyclesMedian;
+    }
+}
+
+// deterministic hex test data
+static void fill_hex(char *out, size_t bytes, uint32_t seed)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < bytes * 2; i++) {
+        seed = seed * 1103515245u + 12345u;
+        out[i] = digits[(seed >> 16) & 0xf];
+    }
+    out[bytes * 2] = 0;
+}
+
+static void fill_bin(uint8_t *out, size_t bytes, uint32_t seed)
+{
+    for (size_t i = 0; i < bytes; i++) {
+        seed = seed * 1103515245u + 12345u;
+        out[i] = (uint8_t) (seed >> 16);
+    }
+}
+
+// typical pool sizes: 64 byte coinbase1, 4+4 byte extranonces, 120 byte coinbase2
+static const size_t COINBASE_BYTES = 64 + 8 + 120;
+
+static void bench_crc(Bench &bench)
+{
+    uint8_t cmd[4] = {0x51, 0x09, 0x00, 0x14};
+    bench.run("crc5/4B", [&]() { bench_keep(crc5(cmd, sizeof(cmd))); });
+
+    uint8_t frame[9];
+    fill_bin(frame, sizeof(frame), 1);
+    bench.run("crc5/9B", [&]() { bench_keep(crc5(frame, sizeof(frame))); });
+
+    // job packet of the BM1366/68/70
+    uint8_t job[84];
+    fill_bin(job, sizeof(job), 2);
+    bench.run("crc16_false/84B", [&]() { bench_keep(crc16_false(job, sizeof(job))); });
+}
+
+static void bench_mining(Bench &bench)
+{
+    static char coinbase[COINBASE_BYTES * 2 + 1];
+    fill_hex(coinbase, COINBASE_BYTES, 3);
+
+    static uint8_t branches[MAX_MERKLE_BRANCHES][32];
+    fill_bin(&branches[0][0], sizeof(branches), 4);
+
+    char merkleRoot[65];
+    bench.run("merkle_root/0_branches", [&]() {
+        calculate_merkle_root_hash(coinbase, branches, 0, merkleRoot);
+        bench_keep(merkleRoot);
+    });
+    bench.run("merkle_root/6_branches", [&]() {
+        calculate_merkle_root_hash(coinbase, branches, 6, merkleRoot);
+        bench_keep(merkleRoot);
+    });
+    bench.run("merkle_root/12_branches", [&]() {
+        calculate_merkle_root_hash(coinbase, branches, 12, merkleRoot);
+        bench_keep(merkleRoot);
+    });
+
+    mining_notify notify = {};
+    fill_bin(notify._prev_block_hash, sizeof(notify._prev_block_hash), 5);
+    notify.version = 0x20000000;
+    notify.target = 0x17034219;
+    notify.ntime = 0x66000000;
+    notify.difficulty = 1024;
+
+    bm_job job = {};
+    bench.run("construct_bm_job", [&]() {
+        construct_bm_job(&notify, merkleRoot, 0x1fffe000, &job);
+        bench_keep(job);
+    });
+
+    uint32_t nonce = 0;
+    bench.run("test_nonce_value", [&]() { bench_keep(test_nonce_value(&job, nonce++, job.version)); });
+}
+
+static void bench_stratum(Bench &bench)
+{
+    // mining.notify with 12 merkle branches, about 1.4 kB like on the big pools
+    static char notifyLine[2048];
+    char prevHash[65], coinbase1[129], coinbase2[241], branch[65];
+    fill_hex(prevHash, 32, 6);
+    fill_hex(coinbase1, 64, 7);
+    fill_hex(coinbase2, 120, 8);
+
+    int len = snprintf(notifyLine, sizeof(notifyLine), "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"6a3f1\",\"%s\",\"%s\",\"%s\",[",
+                       prevHash, coinbase1, coinbase2);
+    for (int i = 0; i < 12; i++) {
+        fill_hex(branch, 32, 100 + i);
+        len += snprintf(notifyLine + len, sizeof(notifyLine) - len, "%s\"%s\"", i ? "," : "", branch);
+    }
+    snprintf(notifyLine + len, sizeof(notifyLine) - len, "],\"20000000\",\"17034219\",\"66000000\",true]}");
+
+    bench.run("stratum_parse/mining.notify_12_branches", [&]() {
+        StratumApiV1Message message = {};
+        StratumApi::parse(&message, notifyLine);
+        if (message.mining_notification) {
+            StratumApi::freeMiningNotify(message.mining_notification);
+            free(message.mining_notification);
+        }
+    });
+
+    static const char *difficultyLine = "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[8192]}";
+    bench.run("stratum_parse/mining.set_difficulty", [&]() {
+        StratumApiV1Message message = {};
+        StratumApi::parse(&message, difficultyLine);
+        bench_keep(message.new_difficulty);
+    });
+
+    static const char *resultLine = "{\"id\":42,\"result\":true,\"error\":null}";
+    bench.run("stratum_parse/result", [&]() {
+        StratumApiV1Message message = {};
+        StratumApi::parse(&message, resultLine);
+        bench_keep(message.response_success);
+    });
+}
+
+// static so the PSRAM buffers stay referenced, History never frees them
+static History s_history;
+
+static void bench_history(Bench &bench)
+{
+    if (!s_history.init(4)) {
+        printf("history: allocation failed, skipped\n");
+        return;
+    }
+
+    // one share per second of history
+    uint64_t timestamp = 1000000;
+    for (int i = 0; i < 1000; i++) {
+        s_history.pushShare(1024, timestamp, i & 3);
+        timestamp += 1000;
+    }
+
+    HistoryAvg idle(&s_history, 3600llu * 1000llu);
+    idle.update();
+    bench.run("history_avg_update/no_new_samples", [&]() {
+        idle.update();
+        bench_keep(idle);
+    });
+
+    // an average that starts from scratch catches up with all 1000 samples
+    bench.run("history_avg_update/catch_up_1000", [&]() {
+        HistoryAvg avg(&s_history, 3600llu * 1000llu);
+        avg.update();
+        bench_keep(avg);
+    });
+
+    // updates the 1m, 10m, 1h and 1d averages
+    int asic = 0;
+    bench.run("history_push_share", [&]() {
+        s_history.pushShare(1024, timestamp, asic);
+        timestamp += 1000;
+        asic = (asic + 1) & 3;
+    });
+
+    // one chart sample every 5 s, closes a 1h bucket every 12 samples
+    uint64_t chartTimestamp = 0;
+    bench.run("history_push_chart_sample", [&]() {
+        s_history.pushChartSample(chartTimestamp, 60.0f, 80.0f);
+        chartTimestamp += 5000;
+    });
+}
+
+void bench_run_suite(Bench &bench)
+{
+    bench_crc(bench);
+    bench_mining(bench);
+    bench_stratum(bench);
+    bench_history(bench);
+}
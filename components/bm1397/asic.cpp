@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <string.h>
 #include <math.h>
 #include <endian.h>
@@ -33,6 +34,18 @@ typedef struct __attribute__((__packed__))
 
 const static char* TAG = "asic";
 
+// the crc5 covers the 64 data bits and the upper 3 bits of the last byte,
+// the remainder over the whole frame is 0 if it is intact
+static bool responseCrcValid(const uint8_t *response)
+{
+    return crc5((uint8_t *) response + 2, 9) == 0;
+}
+
+static int fastUartBaud(uint8_t divider)
+{
+    return FAST_UART_CLOCK / (8 * (divider + 1));
+}
+
 Asic::Asic() {
     m_current_frequency = 56.25;
 }
@@ -223,6 +236,84 @@ int Asic::count_asics() {
     return chip_counter;
 }
 
+void Asic::setFastUartDivider(uint8_t divider)
+{
+    send6(CMD_WRITE_ALL, 0x00, FAST_UART_CONFIGURATION, 0x11, 0x30, divider, 0x00);
+}
+
+// reads the chip id of all chips a couple of times, the link is good if
+// every chip answered every time with the right id and crc
+bool Asic::probeLink(int chipCount)
+{
+    uint8_t buf[11];
+    for (int round = 0; round < FAST_UART_PROBE_ROUNDS; round++) {
+        send2(CMD_READ_ALL, 0x00, 0x00);
+        for (int chip = 0; chip < chipCount; chip++) {
+            if (SERIAL_rx(buf, sizeof(buf), 100) != sizeof(buf)) {
+                return false;
+            }
+            if (!responseCrcValid(buf)) {
+                m_crcErrors++;
+                return false;
+            }
+            if (memcmp(getChipId(), buf, 6)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int Asic::negotiateBaud(int chipCount, int maxBaud)
+{
+    int baud = setMaxBaud();
+    // no idea why a delay is needed here starting with esp-idf 5.4 🙈
+    vTaskDelay(pdMS_TO_TICKS(500));
+    SERIAL_set_baud(baud);
+    SERIAL_clear_buffer();
+
+    if (!probeLink(chipCount)) {
+        ESP_LOGE(TAG, "link not reliable at %d baud, not trying faster rates", baud);
+        return baud;
+    }
+
+    uint8_t divider = FAST_UART_LEGACY_DIVIDER;
+    while (divider > 0 && fastUartBaud(divider - 1) <= maxBaud) {
+        int next = fastUartBaud(divider - 1);
+
+        setFastUartDivider(divider - 1);
+        SERIAL_wait_tx_done();
+        SERIAL_set_baud(next);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        SERIAL_clear_buffer();
+
+        if (probeLink(chipCount)) {
+            ESP_LOGI(TAG, "link reliable at %d baud", next);
+            divider--;
+            baud = next;
+            continue;
+        }
+
+        ESP_LOGW(TAG, "link not reliable at %d baud, staying at %d baud", next, baud);
+
+        // some of the writes may get lost on the bad link
+        for (int i = 0; i < 3; i++) {
+            setFastUartDivider(divider);
+        }
+        SERIAL_wait_tx_done();
+        SERIAL_set_baud(baud);
+        vTaskDelay(pdMS_TO_TICKS(10));
+        SERIAL_clear_buffer();
+
+        if (!probeLink(chipCount)) {
+            ESP_LOGE(TAG, "chain lost after going back to %d baud", baud);
+            return 0;
+        }
+        break;
+    }
+    return baud;
+}
+
 void Asic::setJobDifficultyMask(int difficulty)
 {
     // Default mask of 256 diff
@@ -251,6 +342,16 @@ void Asic::setJobDifficultyMask(int difficulty)
     send((CMD_WRITE_ALL), job_difficulty_mask, 6, ASIC_SERIALTX_DEBUG);
 }
 
+void Asic::setVersionMask(uint32_t mask)
+{
+    uint16_t versions = (mask & ASIC_VERSION_ROLLING_BITS) >> 13;
+
+    ESP_LOGI(TAG, "Setting ASIC version mask to %08" PRIx32, mask & ASIC_VERSION_ROLLING_BITS);
+
+    // bit 31 enables the rolling, the lower 16 bits are the mask
+    send6(CMD_WRITE_ALL, 0x00, VERSION_ROLLING, 0x90, 0x00, versions >> 8, versions & 0xff);
+}
+
 // can ramp up and down in 6.25MHz steps
 bool Asic::setAsicFrequency(float target_freq) {
     return doFrequencyTransition(target_freq);
@@ -308,6 +409,12 @@ bool Asic::processWork(task_result *result)
         return false;
     }
 
+    // only counted, nonces are validated anyway and a damaged register
+    // response is replaced by the next one
+    if (!responseCrcValid((uint8_t *) &asic_result)) {
+        m_crcErrors++;
+    }
+
     // if this matches we can assume it's not a nonce but a response from a read request
     if (/*(asic_result.midstate_num == 0) &&*/ !(asic_result.nonce & 0x7f) && !(asic_result.version)) {
         result->data = __bswap32(asic_result.nonce);
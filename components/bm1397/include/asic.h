@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+
 #include "mining.h"
 
 #define CRC5_MASK 0x1F
@@ -41,6 +43,15 @@
 #define FAST_UART_CONFIGURATION 0x28
 #define TICKET_MASK 0x14
 #define MISC_CONTROL 0x18
+#define VERSION_ROLLING 0xA4
+
+// block header version bits the chips can roll, 16 bits from bit 13
+#define ASIC_VERSION_ROLLING_BITS 0x1fffe000
+
+// fast UART of the BM1366/68/70: baud = 25 MHz / (8 * (divider + 1))
+#define FAST_UART_CLOCK 25000000
+#define FAST_UART_LEGACY_DIVIDER 2 // what setMaxBaud writes
+#define FAST_UART_PROBE_ROUNDS 16
 
 #define ESP_LOGIE(b, tag, fmt, ...)                                                                                                \
     do {                                                                                                                           \
@@ -76,6 +87,7 @@ class Asic {
 protected:
     float m_current_frequency;
     float m_actual_current_frequency;
+    std::atomic<uint32_t> m_crcErrors{0};
 
     void send(uint8_t header, uint8_t *data, uint8_t data_len, bool debug);
     void send2(uint8_t header, uint8_t b0, uint8_t b1);
@@ -88,6 +100,8 @@ protected:
     void sendChainInactive(void);
     uint16_t reverseUint16(uint16_t num);
     bool receiveWork(asic_result_t *result);
+    bool probeLink(int chipCount);
+    void setFastUartDivider(uint8_t divider);
 
     // asic model specific
     virtual const uint8_t* getChipId() = 0;
@@ -100,6 +114,10 @@ public:
     uint8_t sendWork(uint32_t job_id, bm_job *next_bm_job);
     bool processWork(task_result *result);
     void setJobDifficultyMask(int difficulty);
+
+    // limits the version rolling of the chips to the bits of the pool mask,
+    // a mask of 0 disables it
+    void setVersionMask(uint32_t mask);
     bool setAsicFrequency(float frequency);
     virtual void requestChipTemp() = 0;
     virtual uint16_t getSmallCoreCount() = 0;
@@ -108,4 +126,14 @@ public:
     // asic models specific
     virtual uint8_t init(uint64_t frequency, uint16_t asic_count, uint32_t difficulty) = 0;
     virtual int setMaxBaud(void) = 0;
+
+    // switches the chain to the fastest baud up to maxBaud that passes the
+    // register read-back probes, returns the baud or 0 if the chain is lost
+    int negotiateBaud(int chipCount, int maxBaud);
+
+    // responses with a wrong crc5 since boot
+    uint32_t getCrcErrors()
+    {
+        return m_crcErrors.load(std::memory_order_relaxed);
+    }
 };
@@ -6,10 +6,20 @@
 
 #define CHUNK_SIZE 1024
 
+typedef struct
+{
+    int baud;
+    uint32_t txBytes; // wraps around
+    uint32_t rxBytes; // wraps around
+} serial_stats_t;
+
 int SERIAL_send(uint8_t *, int, bool);
 void SERIAL_init(void);
 int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
 void SERIAL_clear_buffer(void);
 void SERIAL_set_baud(int baud);
+// waits until everything that was sent left the UART
+void SERIAL_wait_tx_done(void);
+void SERIAL_get_stats(serial_stats_t *stats);
 
 #endif /* SERIAL_H_ */
\ No newline at end of file
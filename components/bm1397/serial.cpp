@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <atomic>
 
 #include "driver/uart.h"
 
@@ -18,10 +19,17 @@
 #define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
 
+// 2 KB would fill up in less than 7 ms at 3 Mbaud
+#define RX_BUF_SIZE (BUF_SIZE * 8)
+
 static const char *TAG = "serial";
 
 static pthread_mutex_t tx_mute = PTHREAD_MUTEX_INITIALIZER;
 
+static std::atomic<int> s_baud{115200};
+static std::atomic<uint32_t> s_txBytes{0};
+static std::atomic<uint32_t> s_rxBytes{0};
+
 void SERIAL_init(void)
 {
     ESP_LOGI(TAG, "Initializing serial");
@@ -45,13 +53,26 @@ void SERIAL_init(void)
     // Install UART driver (we don't need an event queue here)
     // tx buffer 0 so the tx time doesn't overlap with the job wait time
     //  by returning before the job is written
-    uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    uart_driver_install(UART_NUM_1, RX_BUF_SIZE, BUF_SIZE * 2, 0, NULL, 0);
 }
 
 void SERIAL_set_baud(int baud)
 {
     ESP_LOGI(TAG, "Changing UART baud to %i", baud);
     uart_set_baudrate(UART_NUM_1, baud);
+    s_baud = baud;
+}
+
+void SERIAL_wait_tx_done(void)
+{
+    uart_wait_tx_done(UART_NUM_1, pdMS_TO_TICKS(100));
+}
+
+void SERIAL_get_stats(serial_stats_t *stats)
+{
+    stats->baud = s_baud;
+    stats->txBytes = s_txBytes.load(std::memory_order_relaxed);
+    stats->rxBytes = s_rxBytes.load(std::memory_order_relaxed);
 }
 
 int SERIAL_send(uint8_t *data, int len, bool debug)
@@ -65,6 +86,10 @@ int SERIAL_send(uint8_t *data, int len, bool debug)
     int written = uart_write_bytes(UART_NUM_1, (const char *) data, len);
     pthread_mutex_unlock(&tx_mute);
 
+    if (written > 0) {
+        s_txBytes.fetch_add(written, std::memory_order_relaxed);
+    }
+
     return written;
 }
 
@@ -75,6 +100,9 @@ int SERIAL_send(uint8_t *data, int len, bool debug)
 int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
     int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, pdMS_TO_TICKS(timeout_ms));
+    if (bytes_read > 0) {
+        s_rxBytes.fetch_add(bytes_read, std::memory_order_relaxed);
+    }
 
 #if BM1368_SERIALRX_DEBUG
     size_t buff_len = 0;
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <pthread.h>
+#include <stdint.h>
+
+#include "esp_http_client.h"
+
+#include "influx_ring.h"
 
 typedef struct
 {
@@ -29,6 +34,22 @@ typedef struct
     float last_ping_rtt; 
 } Stats;
 
+// statistics of the batch writer itself
+typedef struct
+{
+    uint64_t points_written;
+    uint64_t points_dropped;
+    uint64_t bytes_raw;
+    uint64_t bytes_wire;
+    uint32_t flushes;
+    uint32_t flush_errors;
+    uint32_t last_flush_ms;
+    uint32_t max_flush_ms;
+    uint32_t buffered_points;
+    uint32_t buffered_bytes;
+    float points_per_sec;
+} WriterStats;
+
 class Influx {
   protected:
     char *m_host;
@@ -41,7 +62,21 @@ class Influx {
     char m_auth_header[128];
     char *m_big_buffer;
 
+    // batching
+    InfluxRing m_ring;
+    char *m_gzip_buffer;
+    char *m_line_buffer;
+    void *m_compressor;
+    esp_http_client_handle_t m_write_client;
+    WriterStats m_writer_stats;
+    int64_t m_rate_timestamp;
+    uint64_t m_rate_points;
+
     bool get_org_id(char *out_org_id, size_t max_len);
+    void enqueueLine(int len);
+    int gzip(const char *src, int len);
+    bool post(const char *data, int len, bool gzipped, int *status_code);
+    void closeWriteClient();
 
   public:
     // make this beautiful later
@@ -51,7 +86,18 @@ class Influx {
     Influx();
 
     bool init(const char *host, int port, const char *token, const char *bucket, const char *org, const char *prefix);
-    void write();
+
+    // add points to the batch, timestamps are unix time in ms (0 = server time)
+    void enqueueStats(int64_t timestamp_ms);
+    void enqueueShare(int64_t timestamp_ms, int asic_nr, double diff, uint32_t asic_diff, uint32_t pool_diff);
+    void enqueueChipTemp(int64_t timestamp_ms, int asic_nr, float temp);
+
+    // send one batch, returns false if sending failed and should be retried later
+    bool flush();
+    size_t pending();
+
+    void getWriterStats(WriterStats *stats);
+
     bool load_last_values();
     bool bucket_exists();
     bool create_bucket();
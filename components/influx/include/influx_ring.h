@@ -0,0 +1,53 @@
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte ring buffer for line-protocol points.
+//
+// Every point is a single '\n' terminated line. Lines are only removed
+// once the server accepted them (consume), so points that can't be sent
+// stay buffered and are backfilled with their original timestamps.
+// When the ring is full the oldest lines are dropped.
+//
+// Positions are absolute byte offsets that never wrap, so a reader can
+// detect if the lines it peeked were overwritten in the meantime.
+class InfluxRing {
+  protected:
+    char *m_buffer = nullptr;
+    size_t m_size = 0;
+
+    uint64_t m_head = 0; // absolute offset of the oldest byte
+    uint64_t m_tail = 0; // absolute offset of the next free byte
+    uint32_t m_lines = 0;
+
+    uint64_t m_dropped = 0;
+
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    void dropOldestLine();
+
+  public:
+    InfluxRing();
+
+    bool init(size_t size);
+
+    // append one line (without trailing newline), drops the oldest lines if needed
+    bool push(const char *line, size_t len);
+
+    // copy as many complete lines as fit into dst, returns the number of bytes
+    // copied and sets start to the absolute offset of the first copied byte
+    size_t peek(char *dst, size_t maxLen, uint64_t *start, uint32_t *lines);
+
+    // remove lines that were returned by peek
+    void consume(uint64_t start, size_t len, uint32_t lines);
+
+    size_t used();
+    uint32_t lines();
+    uint64_t dropped();
+    size_t capacity()
+    {
+        return m_size;
+    }
+};
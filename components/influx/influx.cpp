@@ -1,7 +1,10 @@
 #include "ArduinoJson.h"
 #include "psram_allocator.h"
+#include <esp_heap_caps.h>
 #include <esp_http_client.h>
 #include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
@@ -10,6 +13,8 @@
 #include <sys/time.h>
 #include <time.h>
 
+#include "rom/miniz.h"
+
 #include "influx.h"
 
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
@@ -23,9 +28,14 @@ static const char *TAG = "InfluxDB";
 #endif
 
 #define m_big_buffer_SIZE 32768
+#define INFLUX_LINE_SIZE 1024
 
 Influx::Influx() {
-    // nop
+    m_big_buffer = NULL;
+    m_gzip_buffer = NULL;
+    m_line_buffer = NULL;
+    m_compressor = NULL;
+    m_write_client = NULL;
 }
 
 bool Influx::ping()
@@ -381,75 +391,284 @@ bool Influx::load_last_values()
     return false;
 }
 
-void Influx::write()
+static int formatTimestamp(char *dst, size_t len, int64_t timestamp_ms)
 {
-    char url[256];
+    if (timestamp_ms <= 0) {
+        // no valid time yet, let the server assign it
+        dst[0] = 0;
+        return 0;
+    }
+    return snprintf(dst, len, " %lld", (long long) timestamp_ms);
+}
+
+void Influx::enqueueStats(int64_t timestamp_ms)
+{
+    char ts[24];
+    formatTimestamp(ts, sizeof(ts), timestamp_ms);
 
-    snprintf(m_big_buffer, m_big_buffer_SIZE,
+    int len = snprintf(m_line_buffer, INFLUX_LINE_SIZE,
              "%s temperature=%f,temperature2=%f,"
              "hashing_speed=%f,invalid_shares=%d,valid_shares=%d,uptime=%d,"
              "best_difficulty=%f,total_best_difficulty=%f,pool_errors=%d,"
              "accepted=%d,not_accepted=%d,total_uptime=%d,blocks_found=%d,"
              "pwr_vin=%f,pwr_iin=%f,pwr_pin=%f,pwr_vout=%f,pwr_iout=%f,pwr_pout=%f,"
-             "total_blocks_found=%d,duplicate_hashes=%d,last_ping_rtt=%.2f",
+             "total_blocks_found=%d,duplicate_hashes=%d,last_ping_rtt=%.2f%s",
              m_prefix, m_stats.temp, m_stats.temp2, m_stats.hashing_speed, m_stats.invalid_shares,
              m_stats.valid_shares, m_stats.uptime, m_stats.best_difficulty, m_stats.total_best_difficulty,
              m_stats.pool_errors, m_stats.accepted, m_stats.not_accepted, m_stats.total_uptime,
              m_stats.blocks_found, m_stats.pwr_vin, m_stats.pwr_iin, m_stats.pwr_pin,
              m_stats.pwr_vout, m_stats.pwr_iout, m_stats.pwr_pout, m_stats.total_blocks_found,
-             m_stats.duplicate_hashes, m_stats.last_ping_rtt);
+             m_stats.duplicate_hashes, m_stats.last_ping_rtt, ts);
 
-    snprintf(url, sizeof(url), "%s:%d/api/v2/write?bucket=%s&org=%s&precision=s", m_host, m_port, m_bucket,
-             m_org);
+    enqueueLine(len);
+}
 
-    ESP_LOGI(TAG, "URL: %s", url);
-    ESP_LOGI(TAG, "POST: %s", m_big_buffer);
+void Influx::enqueueShare(int64_t timestamp_ms, int asic_nr, double diff, uint32_t asic_diff, uint32_t pool_diff)
+{
+    char ts[24];
+    formatTimestamp(ts, sizeof(ts), timestamp_ms);
 
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_POST,
-    };
+    int len = snprintf(m_line_buffer, INFLUX_LINE_SIZE, "%s_shares,asic=%d diff=%f,asic_diff=%lui,pool_diff=%lui%s",
+                       m_prefix, asic_nr, diff, (unsigned long) asic_diff, (unsigned long) pool_diff, ts);
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    enqueueLine(len);
+}
 
-    esp_http_client_set_header(client, "Authorization", m_auth_header);
-    esp_http_client_set_header(client, "Content-Type", "text/plain");
-    esp_http_client_set_post_field(client, m_big_buffer, strlen(m_big_buffer));
+void Influx::enqueueChipTemp(int64_t timestamp_ms, int asic_nr, float temp)
+{
+    char ts[24];
+    formatTimestamp(ts, sizeof(ts), timestamp_ms);
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        int content_length = esp_http_client_get_content_length(client);
+    int len = snprintf(m_line_buffer, INFLUX_LINE_SIZE, "%s_chips,asic=%d temp=%f%s", m_prefix, asic_nr, temp, ts);
 
-        ESP_LOGI(TAG, "HTTP POST Status = %d, content_length = %d", status_code, content_length);
+    enqueueLine(len);
+}
 
-        if (status_code == 400) {
-            int len = esp_http_client_read(client, m_big_buffer, m_big_buffer_SIZE - 1);
-            if (len > 0) {
-                m_big_buffer[len] = 0; // Null-terminate the response
-                ESP_LOGE(TAG, "HTTP POST Error 400 Response: %s", m_big_buffer);
-            } else {
-                ESP_LOGE(TAG, "HTTP POST Error 400: No response body");
-            }
+void Influx::enqueueLine(int len)
+{
+    if (len <= 0 || len >= INFLUX_LINE_SIZE) {
+        ESP_LOGE(TAG, "point too long, dropped");
+        return;
+    }
+    if (!m_ring.push(m_line_buffer, len)) {
+        ESP_LOGE(TAG, "error buffering point");
+    }
+}
+
+// gzip the batch into m_gzip_buffer, returns the compressed length or -1
+int Influx::gzip(const char *src, int len)
+{
+#ifdef CONFIG_INFLUX_GZIP
+    if (!m_compressor) {
+        // the compressor state is big (~300kB), only allocate it once
+        m_compressor = ALLOC(sizeof(tdefl_compressor));
+        if (!m_compressor) {
+            ESP_LOGW(TAG, "error allocating compressor, sending uncompressed");
+            return -1;
+        }
+    }
+
+    // gzip header: magic, deflate, no flags, no mtime, no extra flags, OS unix
+    static const uint8_t header[10] = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+    memcpy(m_gzip_buffer, header, sizeof(header));
+
+    // greedy parsing with few probes is plenty for line protocol and a lot faster
+    tdefl_compressor *comp = (tdefl_compressor *) m_compressor;
+    if (tdefl_init(comp, NULL, NULL, 16 | TDEFL_GREEDY_PARSING_FLAG) != TDEFL_STATUS_OKAY) {
+        return -1;
+    }
+
+    size_t in_len = len;
+    size_t out_len = m_big_buffer_SIZE - sizeof(header) - 8;
+    tdefl_status status = tdefl_compress(comp, src, &in_len, &m_gzip_buffer[sizeof(header)], &out_len, TDEFL_FINISH);
+    if (status != TDEFL_STATUS_DONE || in_len != (size_t) len) {
+        // didn't fit, not worth it
+        return -1;
+    }
+
+    // trailer: crc32 and uncompressed size, both little endian
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *) src, len);
+    uint8_t *trailer = (uint8_t *) &m_gzip_buffer[sizeof(header) + out_len];
+    for (int i = 0; i < 4; i++) {
+        trailer[i] = (crc >> (i * 8)) & 0xff;
+        trailer[4 + i] = ((uint32_t) len >> (i * 8)) & 0xff;
+    }
+    return sizeof(header) + out_len + 8;
+#else
+    return -1;
+#endif
+}
+
+void Influx::closeWriteClient()
+{
+    if (m_write_client) {
+        esp_http_client_cleanup(m_write_client);
+        m_write_client = NULL;
+    }
+}
+
+bool Influx::post(const char *data, int len, bool gzipped, int *status_code)
+{
+    // the client is kept open between batches so the connection is reused (keep-alive)
+    if (!m_write_client) {
+        char url[256];
+        snprintf(url, sizeof(url), "%s:%d/api/v2/write?bucket=%s&org=%s&precision=ms", m_host, m_port, m_bucket, m_org);
+        ESP_LOGI(TAG, "URL: %s", url);
+
+        esp_http_client_config_t config = {
+            .url = url,
+            .method = HTTP_METHOD_POST,
+            .timeout_ms = 10000,
+            .keep_alive_enable = true,
+        };
+        m_write_client = esp_http_client_init(&config);
+        if (!m_write_client) {
+            ESP_LOGE(TAG, "error creating http client");
+            return false;
         }
+        esp_http_client_set_header(m_write_client, "Authorization", m_auth_header);
+        esp_http_client_set_header(m_write_client, "Content-Type", "text/plain; charset=utf-8");
+    }
+
+    if (gzipped) {
+        esp_http_client_set_header(m_write_client, "Content-Encoding", "gzip");
     } else {
+        esp_http_client_delete_header(m_write_client, "Content-Encoding");
+    }
+    esp_http_client_set_post_field(m_write_client, data, len);
+
+    esp_err_t err = esp_http_client_perform(m_write_client);
+    if (err != ESP_OK) {
         ESP_LOGE(TAG, "HTTP POST request failed: %s", esp_err_to_name(err));
+        // start with a fresh connection next time
+        closeWriteClient();
+        return false;
     }
 
-    esp_http_client_cleanup(client);
+    *status_code = esp_http_client_get_status_code(m_write_client);
+    return true;
+}
+
+bool Influx::flush()
+{
+    uint64_t start;
+    uint32_t lines;
+
+    // take as many complete lines as fit into one request
+    int len = m_ring.peek(m_big_buffer, m_big_buffer_SIZE, &start, &lines);
+    if (!len) {
+        return true;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+
+    const char *body = m_big_buffer;
+    int body_len = len;
+    bool gzipped = false;
+
+    int gz_len = gzip(m_big_buffer, len);
+    if (gz_len > 0 && gz_len < len) {
+        body = m_gzip_buffer;
+        body_len = gz_len;
+        gzipped = true;
+    }
+
+    int status_code = 0;
+    bool sent = post(body, body_len, gzipped, &status_code);
+
+    uint32_t latency_ms = (uint32_t) ((esp_timer_get_time() - t0) / 1000);
+
+    pthread_mutex_lock(&m_lock);
+    m_writer_stats.last_flush_ms = latency_ms;
+    if (latency_ms > m_writer_stats.max_flush_ms) {
+        m_writer_stats.max_flush_ms = latency_ms;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (!sent) {
+        pthread_mutex_lock(&m_lock);
+        m_writer_stats.flush_errors++;
+        pthread_mutex_unlock(&m_lock);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "HTTP POST Status = %d, %lu points, %d bytes (%d on the wire), %lu ms", status_code, (unsigned long) lines,
+             len, body_len, (unsigned long) latency_ms);
+
+    // 5xx and 429 are worth retrying, keep the points
+    if (status_code >= 500 || status_code == 429) {
+        pthread_mutex_lock(&m_lock);
+        m_writer_stats.flush_errors++;
+        pthread_mutex_unlock(&m_lock);
+        return false;
+    }
+
+    // other errors mean the server rejected the data, retrying won't help
+    if (status_code < 200 || status_code >= 300) {
+        ESP_LOGE(TAG, "batch rejected by server (status %d), dropping %lu points", status_code, (unsigned long) lines);
+    }
+
+    m_ring.consume(start, len, lines);
+
+    pthread_mutex_lock(&m_lock);
+    m_writer_stats.flushes++;
+    if (status_code >= 200 && status_code < 300) {
+        m_writer_stats.points_written += lines;
+        m_writer_stats.bytes_raw += len;
+        m_writer_stats.bytes_wire += body_len;
+    } else {
+        m_writer_stats.flush_errors++;
+    }
+
+    // points per second averaged over at least 10s
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed = now - m_rate_timestamp;
+    if (elapsed >= 10000000) {
+        m_writer_stats.points_per_sec = (float) (m_writer_stats.points_written - m_rate_points) * 1000000.0f / (float) elapsed;
+        m_rate_points = m_writer_stats.points_written;
+        m_rate_timestamp = now;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    return true;
+}
+
+size_t Influx::pending()
+{
+    return m_ring.used();
+}
+
+void Influx::getWriterStats(WriterStats *stats)
+{
+    pthread_mutex_lock(&m_lock);
+    *stats = m_writer_stats;
+    pthread_mutex_unlock(&m_lock);
+
+    stats->points_dropped = m_ring.dropped();
+    stats->buffered_points = m_ring.lines();
+    stats->buffered_bytes = m_ring.used();
 }
 
 bool Influx::init(const char *host, int port, const char *token, const char *bucket, const char *org, const char *prefix)
 {
     m_big_buffer = (char*) ALLOC(m_big_buffer_SIZE);
+    m_gzip_buffer = (char*) ALLOC(m_big_buffer_SIZE);
+    m_line_buffer = (char*) ALLOC(INFLUX_LINE_SIZE);
 
-    if (!m_big_buffer) {
+    if (!m_big_buffer || !m_gzip_buffer || !m_line_buffer) {
         ESP_LOGE(TAG, "error allocating influx message buffer");
         return false;
     }
 
+    if (!m_ring.init(CONFIG_INFLUX_RING_KB * 1024)) {
+        return false;
+    }
+
     // zero stats
     memset(&m_stats, 0, sizeof(m_stats));
+    memset(&m_writer_stats, 0, sizeof(m_writer_stats));
+    m_rate_timestamp = esp_timer_get_time();
+    m_rate_points = 0;
 
     m_port = port;
     m_host = strdup(host);
@@ -0,0 +1,141 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "influx_ring.h"
+
+static const char *TAG = "influx_ring";
+
+#ifdef CONFIG_SPIRAM
+#define ALLOC(s) heap_caps_malloc(s, MALLOC_CAP_SPIRAM)
+#else
+#define ALLOC(s) malloc(s)
+#endif
+
+InfluxRing::InfluxRing()
+{
+    // NOP
+}
+
+bool InfluxRing::init(size_t size)
+{
+    m_buffer = (char *) ALLOC(size);
+    if (!m_buffer) {
+        ESP_LOGE(TAG, "error allocating point buffer (%u bytes)", (unsigned) size);
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+void InfluxRing::dropOldestLine()
+{
+    // advance head behind the next newline
+    while (m_head < m_tail) {
+        char c = m_buffer[m_head % m_size];
+        m_head++;
+        if (c == '\n') {
+            break;
+        }
+    }
+    m_lines--;
+    m_dropped++;
+}
+
+bool InfluxRing::push(const char *line, size_t len)
+{
+    // a line must always fit, otherwise it could never be sent
+    if (!m_buffer || !len || len + 1 > m_size / 4) {
+        return false;
+    }
+
+    pthread_mutex_lock(&m_lock);
+
+    while (m_tail + len + 1 - m_head > m_size) {
+        dropOldestLine();
+    }
+
+    size_t pos = m_tail % m_size;
+    size_t first = (len < m_size - pos) ? len : m_size - pos;
+    memcpy(&m_buffer[pos], line, first);
+    memcpy(m_buffer, &line[first], len - first);
+    m_tail += len;
+    m_buffer[m_tail % m_size] = '\n';
+    m_tail++;
+    m_lines++;
+
+    pthread_mutex_unlock(&m_lock);
+    return true;
+}
+
+size_t InfluxRing::peek(char *dst, size_t maxLen, uint64_t *start, uint32_t *lines)
+{
+    pthread_mutex_lock(&m_lock);
+
+    *start = m_head;
+    *lines = 0;
+
+    size_t copied = 0;
+    size_t lineStart = 0;
+    for (uint64_t i = m_head; i < m_tail && copied < maxLen; i++) {
+        char c = m_buffer[i % m_size];
+        dst[copied++] = c;
+        if (c == '\n') {
+            lineStart = copied;
+            (*lines)++;
+        }
+    }
+
+    pthread_mutex_unlock(&m_lock);
+
+    // only complete lines
+    return lineStart;
+}
+
+void InfluxRing::consume(uint64_t start, size_t len, uint32_t lines)
+{
+    pthread_mutex_lock(&m_lock);
+
+    uint64_t end = start + len;
+    if (m_head == start) {
+        m_head = end;
+        m_lines -= lines;
+    } else if (m_head < end) {
+        // some of the peeked lines were dropped while sending,
+        // count the remaining ones up to the end of the batch
+        while (m_head < end) {
+            if (m_buffer[m_head % m_size] == '\n') {
+                m_lines--;
+            }
+            m_head++;
+        }
+    }
+    // else: everything peeked was already overwritten
+
+    pthread_mutex_unlock(&m_lock);
+}
+
+size_t InfluxRing::used()
+{
+    pthread_mutex_lock(&m_lock);
+    size_t u = (size_t) (m_tail - m_head);
+    pthread_mutex_unlock(&m_lock);
+    return u;
+}
+
+uint32_t InfluxRing::lines()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t l = m_lines;
+    pthread_mutex_unlock(&m_lock);
+    return l;
+}
+
+uint64_t InfluxRing::dropped()
+{
+    pthread_mutex_lock(&m_lock);
+    uint64_t d = m_dropped;
+    pthread_mutex_unlock(&m_lock);
+    return d;
+}
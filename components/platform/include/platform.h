@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Thin platform layer for the mining core (ASIC drivers, stratum, job and
+// result tasks, history) so the same sources build for the ESP32 and natively
+// on Linux. There are two backends:
+//
+//   platform_esp.cpp    esp_timer, heap_caps (PSRAM) and FreeRTOS timers
+//   platform_posix.cpp  CLOCK_MONOTONIC, libc heap and a thread per timer
+//
+// Logging, serial and sockets already have narrow interfaces and are not
+// wrapped again: ESP_LOGx (host/compat/include/esp_log.h on POSIX), SERIAL_*
+// from serial.h (UART or the host emulator) and BSD sockets (lwIP or libc).
+
+// monotonic time since boot
+int64_t platform_time_us(void);
+
+static inline uint64_t platform_time_ms(void)
+{
+    return (uint64_t) platform_time_us() / 1000ULL;
+}
+
+// free running CPU cycle counter (CCOUNT on the ESP32-S3, TSC / CNTVCT on
+// Linux, 0 where there is none). Only differences are meaningful, it wraps.
+uint32_t platform_cycle_count(void);
+
+// large buffers that are not accessed from ISRs or by DMA, they go to PSRAM
+// when there is some. Can be released with free() as well.
+void *platform_malloc(size_t size);
+void *platform_realloc(void *ptr, size_t size);
+void platform_free(void *ptr);
+
+// periodic software timers, the callback runs in the timer task (ESP) or the
+// timer's own thread (POSIX) and must not block
+typedef struct platform_timer *platform_timer_t;
+typedef void (*platform_timer_cb_t)(void *arg);
+
+platform_timer_t platform_timer_create(const char *name, uint32_t period_ms, platform_timer_cb_t callback, void *arg);
+bool platform_timer_start(platform_timer_t timer);
+bool platform_timer_stop(platform_timer_t timer);
+// changes the period and (re)starts the timer
+bool platform_timer_set_period(platform_timer_t timer, uint32_t period_ms);
+bool platform_timer_is_active(platform_timer_t timer);
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include "sdkconfig.h"
+
+#include "platform.h"
+
+struct platform_timer
+{
+    TimerHandle_t handle;
+    platform_timer_cb_t callback;
+    void *arg;
+};
+
+int64_t platform_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+uint32_t platform_cycle_count(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+
+void *platform_malloc(size_t size)
+{
+#ifdef CONFIG_SPIRAM
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+#else
+    return malloc(size);
+#endif
+}
+
+void *platform_realloc(void *ptr, size_t size)
+{
+#ifdef CONFIG_SPIRAM
+    return heap_caps_realloc(ptr, size, MALLOC_CAP_SPIRAM);
+#else
+    return realloc(ptr, size);
+#endif
+}
+
+void platform_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
+
+static void timer_callback(TimerHandle_t handle)
+{
+    platform_timer_t timer = (platform_timer_t) pvTimerGetTimerID(handle);
+    timer->callback(timer->arg);
+}
+
+platform_timer_t platform_timer_create(const char *name, uint32_t period_ms, platform_timer_cb_t callback, void *arg)
+{
+    platform_timer_t timer = (platform_timer_t) malloc(sizeof(struct platform_timer));
+    if (!timer) {
+        return NULL;
+    }
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->handle = xTimerCreate(name, pdMS_TO_TICKS(period_ms), pdTRUE, timer, timer_callback);
+    if (!timer->handle) {
+        free(timer);
+        return NULL;
+    }
+    return timer;
+}
+
+bool platform_timer_start(platform_timer_t timer)
+{
+    return xTimerStart(timer->handle, 0) == pdPASS;
+}
+
+bool platform_timer_stop(platform_timer_t timer)
+{
+    return xTimerStop(timer->handle, 0) == pdPASS;
+}
+
+bool platform_timer_set_period(platform_timer_t timer, uint32_t period_ms)
+{
+    return xTimerChangePeriod(timer->handle, pdMS_TO_TICKS(period_ms), 0) == pdPASS;
+}
+
+bool platform_timer_is_active(platform_timer_t timer)
+{
+    return xTimerIsTimerActive(timer->handle) != pdFALSE;
+}
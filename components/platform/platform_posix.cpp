@@ -0,0 +1,136 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "platform.h"
+
+// POSIX backend of the platform layer for the native build. Every timer gets
+// its own thread, unlike the single FreeRTOS timer task callbacks of different
+// timers may run in parallel.
+
+struct platform_timer
+{
+    char name[16];
+    std::chrono::milliseconds period;
+    platform_timer_cb_t callback;
+    void *arg;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    bool active = false;
+    std::chrono::steady_clock::time_point expiry;
+};
+
+int64_t platform_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t platform_cycle_count(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t) __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t cycles;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+    return (uint32_t) cycles;
+#else
+    return 0;
+#endif
+}
+
+void *platform_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void *platform_realloc(void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void platform_free(void *ptr)
+{
+    free(ptr);
+}
+
+static void timer_thread(platform_timer_t timer)
+{
+    pthread_setname_np(pthread_self(), timer->name);
+
+    std::unique_lock<std::mutex> lock(timer->lock);
+    while (1) {
+        if (!timer->active) {
+            timer->changed.wait(lock);
+            continue;
+        }
+        if (timer->changed.wait_until(lock, timer->expiry) != std::cv_status::timeout) {
+            // started, stopped or period changed, re-evaluate
+            continue;
+        }
+        if (!timer->active || std::chrono::steady_clock::now() < timer->expiry) {
+            continue;
+        }
+        timer->expiry += timer->period;
+
+        lock.unlock();
+        timer->callback(timer->arg);
+        lock.lock();
+    }
+}
+
+platform_timer_t platform_timer_create(const char *name, uint32_t period_ms, platform_timer_cb_t callback, void *arg)
+{
+    platform_timer_t timer = new platform_timer();
+    strncpy(timer->name, name, sizeof(timer->name) - 1);
+    timer->period = std::chrono::milliseconds(period_ms);
+    timer->callback = callback;
+    timer->arg = arg;
+
+    // timers live as long as the process, like they do in the firmware
+    std::thread(timer_thread, timer).detach();
+    return timer;
+}
+
+bool platform_timer_start(platform_timer_t timer)
+{
+    std::lock_guard<std::mutex> lock(timer->lock);
+    timer->active = true;
+    timer->expiry = std::chrono::steady_clock::now() + timer->period;
+    timer->changed.notify_one();
+    return true;
+}
+
+bool platform_timer_stop(platform_timer_t timer)
+{
+    std::lock_guard<std::mutex> lock(timer->lock);
+    timer->active = false;
+    timer->changed.notify_one();
+    return true;
+}
+
+bool platform_timer_set_period(platform_timer_t timer, uint32_t period_ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(timer->lock);
+        timer->period = std::chrono::milliseconds(period_ms);
+    }
+    return platform_timer_start(timer);
+}
+
+bool platform_timer_is_active(platform_timer_t timer)
+{
+    std::lock_guard<std::mutex> lock(timer->lock);
+    return timer->active;
+}
@@ -119,6 +119,12 @@ class StratumApi {
     // Resets the message ID counter.
     void resetUid();
 
+    // Returns the ID of the last message sent.
+    int getLastUid() const
+    {
+        return m_send_uid - 1;
+    }
+
     // clear the message buffer
     void clearBuffer();
 
@@ -14,7 +14,9 @@
 #include "esp_log.h"
 #include "esp_ota_ops.h"
 #include "lwip/sockets.h"
+#include "platform.h"
 #include <errno.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -22,12 +24,6 @@
 // The logging tag for ESP logging.
 static const char *TAG = "stratum_api";
 
-#ifdef CONFIG_SPIRAM
-#define ALLOC(s) heap_caps_malloc(s, MALLOC_CAP_SPIRAM)
-#else
-#define ALLOC(s) malloc(s)
-#endif
-
 void safe_free(char *&ptr)
 {
     if (ptr) {         // Check if pointer is not null
@@ -38,8 +34,8 @@ void safe_free(char *&ptr)
 
 StratumApi::StratumApi() : m_len(0), m_send_uid(1)
 {
-    m_buffer = (char *) ALLOC(BIG_BUFFER_SIZE);
-    m_requestBuffer = (char *) ALLOC(BUFFER_SIZE);
+    m_buffer = (char *) platform_malloc(BIG_BUFFER_SIZE);
+    m_requestBuffer = (char *) platform_malloc(BUFFER_SIZE);
     clearBuffer();
 }
 
@@ -150,7 +146,7 @@ char *StratumApi::receiveJsonRpcLine(int sockfd)
     int line_length = newline_ptr - m_buffer;
 
     // Allocate memory for the resulting line.
-    char *line = (char *) ALLOC(line_length + 1);
+    char *line = (char *) platform_malloc(line_length + 1);
 
     if (!line) {
         ESP_LOGE(TAG, "Failed to allocate memory for line.");
@@ -190,7 +186,7 @@ bool StratumApi::parseMethods(JsonDocument &doc, const char *method_str, Stratum
     switch (message->method) {
     case MINING_NOTIFY: {
         ESP_LOGI(TAG, "mining notify");
-        mining_notify *new_work = (mining_notify *) ALLOC(sizeof(mining_notify));
+        mining_notify *new_work = (mining_notify *) platform_malloc(sizeof(mining_notify));
 
         JsonArray params = doc["params"].as<JsonArray>();
 
@@ -294,7 +290,7 @@ bool StratumApi::parseSetupResponses(JsonDocument &doc, StratumApiV1Message *mes
             return false;
         }
         message->version_mask = strtoul(mask, NULL, 16);
-        ESP_LOGI(TAG, "Set version mask: %08lx", message->version_mask);
+        ESP_LOGI(TAG, "Set version mask: %08" PRIx32, message->version_mask);
         break;
     }
     case STRATUM_ID_AUTHORIZE: {
@@ -395,7 +391,7 @@ bool StratumApi::subscribe(int socket, const char *device, const char *asic)
 //--------------------------------------------------------------------
 bool StratumApi::suggestDifficulty(int socket, uint32_t difficulty)
 {
-    snprintf(m_requestBuffer, BUFFER_SIZE, "{\"id\": %d, \"method\": \"mining.suggest_difficulty\", \"params\": [%ld]}\n",
+    snprintf(m_requestBuffer, BUFFER_SIZE, "{\"id\": %d, \"method\": \"mining.suggest_difficulty\", \"params\": [%" PRIu32 "]}\n",
              m_send_uid++, difficulty);
 
     return send(socket, m_requestBuffer);
@@ -419,7 +415,8 @@ bool StratumApi::submitShare(int socket, const char *username, const char *jobid
                              uint32_t nonce, uint32_t version)
 {
     snprintf(m_requestBuffer, BUFFER_SIZE,
-             "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%08lx\", \"%08lx\", \"%08lx\"]}\n",
+             "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%08" PRIx32 "\", \"%08" PRIx32
+             "\", \"%08" PRIx32 "\"]}\n",
              m_send_uid++, username, jobid, extranonce_2, ntime, nonce, version);
 
     return send(socket, m_requestBuffer);
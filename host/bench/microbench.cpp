@@ -0,0 +1,104 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/utsname.h>
+
+#include "ArduinoJson.h"
+#include "esp_log.h"
+
+#include "bench.h"
+#include "eventlog.h"
+
+// Host runner of the microbenchmark suite in bench/main, the ESP32 runner is
+// the benchmark firmware in bench/.
+//
+//   ./microbench --json results.json
+//   ./microbench --filter merkle --batches 30
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [--filter STR] [--batches N] [--batch-us US] [--json FILE|-]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    Bench::Config config;
+    const char *jsonFile = nullptr;
+
+    static const struct option options[] = {
+        {"filter", required_argument, nullptr, 'f'},
+        {"batches", required_argument, nullptr, 'b'},
+        {"batch-us", required_argument, nullptr, 'u'},
+        {"json", required_argument, nullptr, 'j'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:b:u:j:", options, nullptr)) != -1) {
+        switch (opt) {
+        case 'f':
+            config.filter = optarg;
+            break;
+        case 'b':
+            config.batches = atoi(optarg);
+            break;
+        case 'u':
+            config.batchUs = atoi(optarg);
+            break;
+        case 'j':
+            jsonFile = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.batches < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // the hot paths log at info level
+    if (!getenv("ESP_HOST_LOG_LEVEL")) {
+        esp_log_level_set("*", ESP_LOG_WARN);
+    }
+    EVENT_LOG.init(CONFIG_EVENTLOG_RECORDS);
+
+    Bench bench(config);
+    bench_run_suite(bench);
+
+    if (!jsonFile) {
+        return 0;
+    }
+
+    struct utsname name;
+    uname(&name);
+    std::string platform = std::string("linux-") + name.machine;
+
+#if defined(__x86_64__) || defined(__i386__)
+    const char *cycleCounter = "tsc";
+#elif defined(__aarch64__)
+    const char *cycleCounter = "cntvct";
+#else
+    const char *cycleCounter = "none";
+#endif
+
+    JsonDocument doc;
+    bench.toJson(doc, platform.c_str(), "host", cycleCounter);
+
+    std::string json;
+    serializeJsonPretty(doc, json);
+    json += "\n";
+
+    FILE *out = std::string(jsonFile) == "-" ? stdout : fopen(jsonFile, "w");
+    if (!out) {
+        perror(jsonFile);
+        return 1;
+    }
+    fputs(json.c_str(), out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Force-included into every translation unit of the host build
+// (-include host_compat.h), covers the newlib specifics the firmware
+// sources rely on.
+
+#include <byteswap.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifndef __bswap16
+#define __bswap16(x) bswap_16(x)
+#endif
+#ifndef __bswap32
+#define __bswap32(x) bswap_32(x)
+#endif
+#ifndef __bswap64
+#define __bswap64(x) bswap_64(x)
+#endif
+
+// newlib has strlcpy, glibc only since 2.38
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+#include <string.h>
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t n = (len >= size) ? size - 1 : len;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+
+// Minimal esp_log for the host build, prints to stderr.
+// The level can be set with ESP_HOST_LOG_LEVEL=0..5 (default 3, info).
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+typedef int (*vprintf_like_t)(const char *, va_list);
+
+// one level for all tags, shared by all translation units
+inline int esp_host_log_level_value = -1;
+
+static inline int esp_host_log_level(void)
+{
+    if (esp_host_log_level_value < 0) {
+        const char *env = getenv("ESP_HOST_LOG_LEVEL");
+        esp_host_log_level_value = env ? atoi(env) : ESP_LOG_INFO;
+    }
+    return esp_host_log_level_value;
+}
+
+// the host has no per-tag levels, any tag sets the global one
+static inline void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void) tag;
+    esp_host_log_level_value = level;
+}
+
+static inline void esp_host_log(esp_log_level_t level, const char *letter, const char *tag, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+static inline void esp_host_log(esp_log_level_t level, const char *letter, const char *tag, const char *fmt, ...)
+{
+    if ((int) level > esp_host_log_level()) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s (%s) ", letter, tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static inline void esp_log_buffer_hex_internal(const char *tag, const void *buffer, uint16_t len, esp_log_level_t level)
+{
+    if ((int) level > esp_host_log_level()) {
+        return;
+    }
+    const uint8_t *p = (const uint8_t *) buffer;
+    fprintf(stderr, "  (%s) ", tag);
+    for (int i = 0; i < len; i++) {
+        fprintf(stderr, "%02x ", p[i]);
+    }
+    fputc('\n', stderr);
+}
+
+static inline vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    (void) func;
+    return vprintf;
+}
+
+#define ESP_LOGE(tag, fmt, ...) esp_host_log(ESP_LOG_ERROR, "E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) esp_host_log(ESP_LOG_WARN, "W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) esp_host_log(ESP_LOG_INFO, "I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) esp_host_log(ESP_LOG_DEBUG, "D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) esp_host_log(ESP_LOG_VERBOSE, "V", tag, fmt, ##__VA_ARGS__)
+
+#define ESP_LOG_BUFFER_HEX_LEVEL(tag, buffer, len, level) esp_log_buffer_hex_internal(tag, buffer, len, level)
+#define ESP_LOG_BUFFER_HEX(tag, buffer, len) esp_log_buffer_hex_internal(tag, buffer, len, ESP_LOG_INFO)
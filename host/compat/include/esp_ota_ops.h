@@ -0,0 +1,13 @@
+#pragma once
+
+typedef struct
+{
+    char version[32];
+    char project_name[32];
+} esp_app_desc_t;
+
+static inline const esp_app_desc_t *esp_ota_get_app_description(void)
+{
+    static const esp_app_desc_t desc = {"host", "esp-miner"};
+    return &desc;
+}
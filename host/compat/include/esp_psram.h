@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// no PSRAM on the host, large buffers come from the libc heap
+
+static inline bool esp_psram_is_initialized(void)
+{
+    return false;
+}
+
+static inline size_t esp_psram_get_size(void)
+{
+    return 0;
+}
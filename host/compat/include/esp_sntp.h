@@ -0,0 +1,3 @@
+#pragma once
+
+// the host clock is already synchronized
@@ -0,0 +1,46 @@
+#pragma once
+
+// FreeRTOS subset for the host build, one tick is one millisecond
+
+#include <atomic>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_TASK_NAME_LEN 16
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+#define pdTICKS_TO_MS(ticks) ((uint32_t) (ticks))
+
+#define pdFALSE ((BaseType_t) 0)
+#define pdTRUE ((BaseType_t) 1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+// critical sections are spinlocks, like on the dual core ESP32-S3
+typedef struct
+{
+    std::atomic<int> locked{0};
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+static inline void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    while (mux->locked.exchange(1, std::memory_order_acquire)) {
+    }
+}
+
+static inline void vPortExitCritical(portMUX_TYPE *mux)
+{
+    mux->locked.store(0, std::memory_order_release);
+}
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_SAFE(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_SAFE(mux) vPortExitCritical(mux)
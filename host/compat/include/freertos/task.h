@@ -0,0 +1,81 @@
+#pragma once
+
+#include <pthread.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+// tasks are detached threads named like the task (visible in top -H and
+// /proc), priorities, stack sizes and cores are ignored
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define tskNO_AFFINITY ((BaseType_t) 0x7FFFFFFF)
+
+static inline void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {(time_t) (ticks / 1000), (long) (ticks % 1000) * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+static inline TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static inline BaseType_t xTaskCreate(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                     UBaseType_t priority, TaskHandle_t *handle)
+{
+    (void) stackDepth;
+    (void) priority;
+    char threadName[16] = {};
+    strncpy(threadName, name, sizeof(threadName) - 1);
+    std::thread([task, parameters, threadName]() {
+        pthread_setname_np(pthread_self(), threadName);
+        task(parameters);
+    }).detach();
+    if (handle) {
+        *handle = NULL;
+    }
+    return pdPASS;
+}
+
+static inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                                 UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    (void) core;
+    return xTaskCreate(task, name, stackDepth, parameters, priority, handle);
+}
+
+static inline void vTaskDelete(TaskHandle_t task)
+{
+    if (!task) {
+        pthread_exit(NULL);
+    }
+}
+
+// task handles aren't tracked, so notifications can't be delivered: a take
+// waits for its timeout and a give does nothing
+static inline TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    static thread_local char self;
+    return &self;
+}
+
+static inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void) task;
+    return pdPASS;
+}
+
+static inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    (void) clearOnExit;
+    vTaskDelay(ticks);
+    return 0;
+}
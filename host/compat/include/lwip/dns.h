@@ -0,0 +1,4 @@
+#pragma once
+
+// on ESP-IDF this pulls in the lwIP socket API (close, TCP_KEEPIDLE, ...)
+#include "lwip/sockets.h"
@@ -0,0 +1,4 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
@@ -0,0 +1,11 @@
+#pragma once
+
+// lwIP implements the BSD socket API, on the host it is the real one
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
@@ -0,0 +1,3 @@
+#pragma once
+
+// no Kconfig on the host, the firmware sources fall back to their defaults
@@ -0,0 +1,505 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+#include "ArduinoJson.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+
+#include "create_jobs_task.h"
+#include "eventlog.h"
+#include "global_state.h"
+#include "metrics.h"
+#include "tasks/asic_result_task.h"
+
+#include "bm13xx_chain.h"
+#include "mock_pool.h"
+#include "serial_emulator.h"
+
+// End-to-end benchmark of the mining pipeline on Linux.
+//
+// The firmware's own StratumManager/StratumTask, create_jobs_task and
+// ASIC_result_task run unmodified against the mock pool (over TCP) and the
+// emulated chain (through the real ASIC drivers). Only System and Board are
+// host replacements (see include/).
+//
+// Measured:
+//   - accepted shares per second and the pool side acceptance latency
+//   - notify-to-work latency: from the pool sending a notify to the first
+//     job frame built from it arriving at the chain (followed by ntime)
+//   - CPU time of the firmware tasks per accepted share and per nonce
+//
+// The emulator caps nonce difficulties (see bm13xx_chain.h), so the pool
+// difficulty is fractional by default and the firmware submits every nonce.
+
+static const char *TAG = "e2e_bench";
+
+typedef struct
+{
+    int durationSec = 30;
+    int warmupTimeoutSec = 15;
+
+    Bm13xxModel model = Bm13xxModel::BM1368;
+    int chips = 4;
+    double hashrateGhs = 500.0;
+    int zeroBits = 12;
+    float frequency = 490.0f;
+
+    int jobIntervalMs = 500;
+    uint32_t asicDifficulty = 32;
+
+    bool json = false;
+    bool metrics = false;
+    bool check = false;
+} bench_options_t;
+
+static std::mutex s_jobsLock;
+static std::map<uint32_t, int64_t> s_firstJobTime;
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --duration S          measurement time (30)\n"
+            "  --model 1366|1368|1370, --chips N (4), --hashrate GH/s per chip (500), --zero-bits N (12)\n"
+            "  --job-interval MS     ASIC job interval (500)\n"
+            "  --asic-diff D         ASIC ticket difficulty (32)\n"
+            "  --notify-ms MS        pool notify interval (2000)\n"
+            "  --branches N          merkle branches (12)\n"
+            "  --version-mask HEX    version rolling mask of the pool (1fffe000)\n"
+            "  --difficulty D[,D..]  pool difficulties (0.000001)\n"
+            "  --difficulty-every N  next difficulty every N notifies (0)\n"
+            "  --clean-every N       clean jobs every N notifies (10)\n"
+            "  --reconnect S         client.reconnect every S seconds (0)\n"
+            "  --slow P --slow-ms MS delay a submit response with probability P (0, 2000)\n"
+            "  --malformed P         malformed line before a notify with probability P (0)\n"
+            "  --json                print the result as json\n"
+            "  --metrics             also print the firmware metrics\n"
+            "  --check               exit with 1 if no share was accepted or a share was invalid\n",
+            name);
+}
+
+static bool parse_difficulties(const char *str, std::vector<double> &out)
+{
+    out.clear();
+    char *copy = strdup(str);
+    char *save;
+    for (char *tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(nullptr, ",", &save)) {
+        out.push_back(atof(tok));
+    }
+    free(copy);
+    return !out.empty();
+}
+
+// CPU time of the firmware tasks in seconds, that are all threads except
+// main, the emulator and the pool
+static double firmware_cpu_seconds()
+{
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        return 0.0;
+    }
+
+    double total = 0.0;
+    pid_t mainTid = getpid();
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        int tid = atoi(entry->d_name);
+        if (tid <= 0 || tid == mainTid) {
+            continue;
+        }
+
+        char path[64];
+        char comm[32] = {};
+        snprintf(path, sizeof(path), "/proc/self/task/%d/comm", tid);
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        if (!fgets(comm, sizeof(comm), f)) {
+            comm[0] = 0;
+        }
+        fclose(f);
+        if (!strncmp(comm, "bm13xx", 6) || !strncmp(comm, "pool-", 5)) {
+            continue;
+        }
+
+        // nanoseconds on the cpu
+        snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", tid);
+        f = fopen(path, "r");
+        unsigned long long ns = 0;
+        if (f) {
+            if (fscanf(f, "%llu", &ns) == 1) {
+                total += (double) ns / 1e9;
+            }
+            fclose(f);
+        }
+    }
+    closedir(dir);
+    return total;
+}
+
+static Asic *create_asic(Bm13xxModel model)
+{
+    switch (model) {
+    case Bm13xxModel::BM1366:
+        return new BM1366();
+    case Bm13xxModel::BM1370:
+        return new BM1370();
+    default:
+        return new BM1368();
+    }
+}
+
+static const char *model_name(Bm13xxModel model)
+{
+    switch (model) {
+    case Bm13xxModel::BM1366:
+        return "BM1366";
+    case Bm13xxModel::BM1370:
+        return "BM1370";
+    default:
+        return "BM1368";
+    }
+}
+
+static bool print_metrics(void *ctx, const char *data, size_t len)
+{
+    (void) ctx;
+    return fwrite(data, 1, len, stdout) == len;
+}
+
+int main(int argc, char **argv)
+{
+    // the tasks log every notify and share, keep it quiet unless asked
+    setenv("ESP_HOST_LOG_LEVEL", "2", 0);
+
+    bench_options_t options;
+    MockPoolConfig poolConfig;
+    poolConfig.port = 0;
+    poolConfig.notifyIntervalMs = 2000;
+    poolConfig.difficulties = {0.000001};
+
+    enum
+    {
+        OPT_DURATION = 256,
+        OPT_MODEL,
+        OPT_CHIPS,
+        OPT_HASHRATE,
+        OPT_ZERO_BITS,
+        OPT_JOB_INTERVAL,
+        OPT_ASIC_DIFF,
+        OPT_NOTIFY_MS,
+        OPT_BRANCHES,
+        OPT_VERSION_MASK,
+        OPT_DIFFICULTY,
+        OPT_DIFFICULTY_EVERY,
+        OPT_CLEAN_EVERY,
+        OPT_RECONNECT,
+        OPT_SLOW,
+        OPT_SLOW_MS,
+        OPT_MALFORMED,
+        OPT_JSON,
+        OPT_METRICS,
+        OPT_CHECK,
+    };
+
+    static const struct option longOptions[] = {
+        {"duration", required_argument, nullptr, OPT_DURATION},
+        {"model", required_argument, nullptr, OPT_MODEL},
+        {"chips", required_argument, nullptr, OPT_CHIPS},
+        {"hashrate", required_argument, nullptr, OPT_HASHRATE},
+        {"zero-bits", required_argument, nullptr, OPT_ZERO_BITS},
+        {"job-interval", required_argument, nullptr, OPT_JOB_INTERVAL},
+        {"asic-diff", required_argument, nullptr, OPT_ASIC_DIFF},
+        {"notify-ms", required_argument, nullptr, OPT_NOTIFY_MS},
+        {"branches", required_argument, nullptr, OPT_BRANCHES},
+        {"version-mask", required_argument, nullptr, OPT_VERSION_MASK},
+        {"difficulty", required_argument, nullptr, OPT_DIFFICULTY},
+        {"difficulty-every", required_argument, nullptr, OPT_DIFFICULTY_EVERY},
+        {"clean-every", required_argument, nullptr, OPT_CLEAN_EVERY},
+        {"reconnect", required_argument, nullptr, OPT_RECONNECT},
+        {"slow", required_argument, nullptr, OPT_SLOW},
+        {"slow-ms", required_argument, nullptr, OPT_SLOW_MS},
+        {"malformed", required_argument, nullptr, OPT_MALFORMED},
+        {"json", no_argument, nullptr, OPT_JSON},
+        {"metrics", no_argument, nullptr, OPT_METRICS},
+        {"check", no_argument, nullptr, OPT_CHECK},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_DURATION:
+            options.durationSec = atoi(optarg);
+            break;
+        case OPT_MODEL:
+            options.model = !strcmp(optarg, "1366")   ? Bm13xxModel::BM1366
+                            : !strcmp(optarg, "1370") ? Bm13xxModel::BM1370
+                                                      : Bm13xxModel::BM1368;
+            break;
+        case OPT_CHIPS:
+            options.chips = atoi(optarg);
+            break;
+        case OPT_HASHRATE:
+            options.hashrateGhs = atof(optarg);
+            break;
+        case OPT_ZERO_BITS:
+            options.zeroBits = atoi(optarg);
+            break;
+        case OPT_JOB_INTERVAL:
+            options.jobIntervalMs = atoi(optarg);
+            break;
+        case OPT_ASIC_DIFF:
+            options.asicDifficulty = (uint32_t) atoi(optarg);
+            break;
+        case OPT_NOTIFY_MS:
+            poolConfig.notifyIntervalMs = atoi(optarg);
+            break;
+        case OPT_BRANCHES:
+            poolConfig.numBranches = atoi(optarg);
+            break;
+        case OPT_VERSION_MASK:
+            poolConfig.versionMask = (uint32_t) strtoul(optarg, nullptr, 16);
+            break;
+        case OPT_DIFFICULTY:
+            if (!parse_difficulties(optarg, poolConfig.difficulties)) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case OPT_DIFFICULTY_EVERY:
+            poolConfig.difficultyEvery = atoi(optarg);
+            break;
+        case OPT_CLEAN_EVERY:
+            poolConfig.cleanJobsEvery = atoi(optarg);
+            break;
+        case OPT_RECONNECT:
+            poolConfig.reconnectEverySec = atoi(optarg);
+            break;
+        case OPT_SLOW:
+            poolConfig.slowResponseProbability = atof(optarg);
+            break;
+        case OPT_SLOW_MS:
+            poolConfig.slowResponseMs = atoi(optarg);
+            break;
+        case OPT_MALFORMED:
+            poolConfig.malformedProbability = atof(optarg);
+            break;
+        case OPT_JSON:
+            options.json = true;
+            break;
+        case OPT_METRICS:
+            options.metrics = true;
+            break;
+        case OPT_CHECK:
+            options.check = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    MockPool pool(poolConfig);
+    if (!pool.start()) {
+        return 1;
+    }
+
+    Bm13xxConfig chainConfig;
+    chainConfig.model = options.model;
+    chainConfig.numChips = options.chips;
+    chainConfig.hashrateGhs = options.hashrateGhs;
+    chainConfig.cpuZeroBits = options.zeroBits;
+
+    Bm13xxChain chain(chainConfig);
+    chain.setJobObserver([](uint32_t ntime) {
+        std::lock_guard<std::mutex> lock(s_jobsLock);
+        s_firstJobTime.emplace(ntime, esp_timer_get_time());
+    });
+    chain.start();
+    SERIAL_attach_emulator(&chain);
+
+    // what the board does in initAsics
+    std::unique_ptr<Asic> asic(create_asic(options.model));
+    int chips = asic->init(options.frequency, options.chips, options.asicDifficulty);
+    if (chips != options.chips) {
+        ESP_LOGE(TAG, "%d of %d chips detected", chips, options.chips);
+        return 1;
+    }
+
+    Board board(asic.get(), model_name(options.model));
+    board.setAsicJobIntervalMs(options.jobIntervalMs);
+    board.setAsicFrequency((int) options.frequency, options.chips);
+    board.setAsicDifficulty(options.asicDifficulty, options.asicDifficulty);
+    SYSTEM_MODULE.setBoard(&board);
+
+    History history;
+    if (!history.init(options.chips)) {
+        ESP_LOGE(TAG, "failed to allocate the history");
+        return 1;
+    }
+    SYSTEM_MODULE.setHistory(&history);
+
+    StratumConfig *primary = SYSTEM_MODULE.getStratumConfig(0);
+    primary->primary = true;
+    primary->host = "127.0.0.1";
+    primary->port = pool.getPort();
+    primary->user = "bench.worker";
+    primary->password = "x";
+
+    StratumConfig *secondary = SYSTEM_MODULE.getStratumConfig(1);
+    secondary->primary = false;
+    secondary->host = "";
+    secondary->user = "";
+    secondary->password = "";
+
+    EVENT_LOG.init(CONFIG_EVENTLOG_RECORDS);
+
+    // like app_main
+    xTaskCreate(STRATUM_MANAGER.taskWrapper, "stratum manager", 8192, (void *) &STRATUM_MANAGER, 5, NULL);
+    xTaskCreate(create_jobs_task, "stratum miner", 8192, NULL, 10, NULL);
+    xTaskCreate(ASIC_result_task, "asic result", 8192, NULL, 15, NULL);
+
+    // wait for the first accepted share
+    int64_t warmupEnd = esp_timer_get_time() + (int64_t) options.warmupTimeoutSec * 1000000;
+    while (!pool.getStats().accepted && esp_timer_get_time() < warmupEnd) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+    if (!pool.getStats().accepted) {
+        ESP_LOGE(TAG, "no share accepted within %d s", options.warmupTimeoutSec);
+        fflush(stdout);
+        _exit(1);
+    }
+
+    MockPoolStats pool0 = pool.getStats();
+    Bm13xxStats chain0 = chain.getStats();
+    double cpu0 = firmware_cpu_seconds();
+    int64_t start = esp_timer_get_time();
+
+    vTaskDelay(pdMS_TO_TICKS(options.durationSec * 1000));
+
+    double elapsed = (double) (esp_timer_get_time() - start) / 1e6;
+    MockPoolStats pool1 = pool.getStats();
+    Bm13xxStats chain1 = chain.getStats();
+    uint64_t nonces = chain1.nonces - chain0.nonces;
+    double cpu = firmware_cpu_seconds() - cpu0;
+
+    uint64_t accepted = pool1.accepted - pool0.accepted;
+    uint64_t submits = pool1.submits - pool0.submits;
+    LatencySummary acceptLatency = pool.getAcceptLatencyUs();
+
+    std::vector<double> notifyToWork;
+    {
+        std::lock_guard<std::mutex> lock(s_jobsLock);
+        for (const auto &job : s_firstJobTime) {
+            int64_t sent;
+            if (pool.getNotifyTime(job.first, &sent)) {
+                notifyToWork.push_back((double) (job.second - sent));
+            }
+        }
+    }
+    LatencySummary notifyLatency = summarize_latency(notifyToWork);
+
+    double sharesPerSec = (double) accepted / elapsed;
+    double cpuPerShareUs = accepted ? cpu * 1e6 / (double) accepted : 0.0;
+    double cpuPerNonceUs = nonces ? cpu * 1e6 / (double) nonces : 0.0;
+
+    if (options.json) {
+        JsonDocument doc;
+        doc["model"] = model_name(options.model);
+        doc["chips"] = options.chips;
+        doc["duration_s"] = elapsed;
+
+        JsonObject p = doc["pool"].to<JsonObject>();
+        p["notifies"] = pool1.notifies - pool0.notifies;
+        p["submits"] = submits;
+        p["accepted"] = accepted;
+        p["rejected_stale"] = pool1.rejectedStale - pool0.rejectedStale;
+        p["rejected_duplicate"] = pool1.rejectedDuplicate - pool0.rejectedDuplicate;
+        p["rejected_low_difficulty"] = pool1.rejectedLowDifficulty - pool0.rejectedLowDifficulty;
+        p["rejected_invalid"] = pool1.rejectedInvalid - pool0.rejectedInvalid;
+        p["connections"] = pool1.connections;
+        p["reconnects"] = pool1.reconnects - pool0.reconnects;
+        p["malformed"] = pool1.malformed - pool0.malformed;
+        p["slow_responses"] = pool1.slowResponses - pool0.slowResponses;
+        p["shares_per_s"] = sharesPerSec;
+        p["accept_latency_p50_ms"] = acceptLatency.p50 / 1000.0;
+        p["accept_latency_p99_ms"] = acceptLatency.p99 / 1000.0;
+        p["accept_latency_max_ms"] = acceptLatency.max / 1000.0;
+
+        JsonObject m = doc["miner"].to<JsonObject>();
+        m["nonces"] = nonces;
+        m["notify_to_work_count"] = notifyLatency.count;
+        m["notify_to_work_p50_ms"] = notifyLatency.p50 / 1000.0;
+        m["notify_to_work_p99_ms"] = notifyLatency.p99 / 1000.0;
+        m["notify_to_work_max_ms"] = notifyLatency.max / 1000.0;
+        m["cpu_ms"] = cpu * 1000.0;
+        m["cpu_per_share_us"] = cpuPerShareUs;
+        m["cpu_per_nonce_us"] = cpuPerNonceUs;
+
+        JsonObject e = doc["emulator"].to<JsonObject>();
+        e["jobs"] = chain1.jobs - chain0.jobs;
+        e["nonces"] = chain1.nonces - chain0.nonces;
+        e["hashes"] = chain1.hashes - chain0.hashes;
+        e["crc_errors"] = chain1.crcErrors;
+
+        std::string json;
+        serializeJsonPretty(doc, json);
+        printf("%s\n", json.c_str());
+    } else {
+        printf("%s x%d, %.0f GH/s per chip, %.1f s\n", model_name(options.model), options.chips, options.hashrateGhs, elapsed);
+        printf("pool:     %llu notifies, %llu submits, %llu accepted, rejected %llu stale / %llu duplicate / %llu low diff / "
+               "%llu invalid\n",
+               (unsigned long long) (pool1.notifies - pool0.notifies), (unsigned long long) submits,
+               (unsigned long long) accepted, (unsigned long long) (pool1.rejectedStale - pool0.rejectedStale),
+               (unsigned long long) (pool1.rejectedDuplicate - pool0.rejectedDuplicate),
+               (unsigned long long) (pool1.rejectedLowDifficulty - pool0.rejectedLowDifficulty),
+               (unsigned long long) (pool1.rejectedInvalid - pool0.rejectedInvalid));
+        printf("faults:   %llu connections, %llu reconnects, %llu malformed lines, %llu slow responses\n",
+               (unsigned long long) pool1.connections, (unsigned long long) (pool1.reconnects - pool0.reconnects),
+               (unsigned long long) (pool1.malformed - pool0.malformed),
+               (unsigned long long) (pool1.slowResponses - pool0.slowResponses));
+        printf("shares:   %.2f accepted/s, acceptance latency p50 %.2f / p90 %.2f / p99 %.2f / max %.2f ms\n", sharesPerSec,
+               acceptLatency.p50 / 1000.0, acceptLatency.p90 / 1000.0, acceptLatency.p99 / 1000.0, acceptLatency.max / 1000.0);
+        printf("work:     notify-to-work p50 %.2f / p90 %.2f / p99 %.2f / max %.2f ms (%zu notifies)\n", notifyLatency.p50 / 1000.0,
+               notifyLatency.p90 / 1000.0, notifyLatency.p99 / 1000.0, notifyLatency.max / 1000.0, notifyLatency.count);
+        printf("cpu:      %.1f ms in firmware tasks, %.1f us per share, %.1f us per nonce (%llu nonces)\n", cpu * 1000.0,
+               cpuPerShareUs, cpuPerNonceUs, (unsigned long long) nonces);
+        printf("emulator: %llu jobs, %llu nonces, %llu hashes, %llu crc errors\n", (unsigned long long) (chain1.jobs - chain0.jobs),
+               (unsigned long long) (chain1.nonces - chain0.nonces), (unsigned long long) (chain1.hashes - chain0.hashes),
+               (unsigned long long) chain1.crcErrors);
+    }
+
+    if (options.metrics) {
+        char buf[2048];
+        Metrics::exportAll(buf, sizeof(buf), print_metrics, nullptr);
+    }
+
+    int rc = 0;
+    if (options.check) {
+        if (!accepted || pool1.rejectedInvalid || pool1.rejectedDuplicate || chain1.crcErrors) {
+            printf("FAILED\n");
+            rc = 1;
+        } else {
+            printf("OK\n");
+        }
+    }
+
+    // the firmware tasks never return
+    fflush(stdout);
+    _exit(rc);
+}
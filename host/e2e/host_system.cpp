@@ -0,0 +1,33 @@
+#include <stdio.h>
+
+#include "global_state.h"
+#include "tasks/influx_task.h"
+
+// Singletons of main.cpp the mining tasks link against
+
+System SYSTEM_MODULE;
+StratumManager STRATUM_MANAGER;
+AsicJobs asicJobs;
+
+// only used for log lines, the firmware version has SI suffixes
+void System::suffixString(uint64_t val, char *buf, size_t bufSize, int sigDigits)
+{
+    (void) sigDigits;
+    snprintf(buf, bufSize, "%llu", (unsigned long long) val);
+}
+
+// no influx on the host
+
+void influx_task_push_share(int asic_nr, double diff, uint32_t asic_diff, uint32_t pool_diff)
+{
+    (void) asic_nr;
+    (void) diff;
+    (void) asic_diff;
+    (void) pool_diff;
+}
+
+void influx_task_push_chip_temp(int asic_nr, float temp)
+{
+    (void) asic_nr;
+    (void) temp;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "asic.h"
+
+// Host replacement of main/boards/board.h, a board with an emulated chain
+// and the settings the mining tasks read.
+
+class Board {
+  protected:
+    const char *m_miningAgent = "NerdQAxe++";
+    const char *m_asicModel;
+    int m_asicJobIntervalMs = 1200;
+    int m_asicFrequency = 525;
+    int m_asicCount = 1;
+    uint32_t m_asicMinDifficulty = 256;
+    uint32_t m_asicMaxDifficulty = 4096;
+    Asic *m_asics = nullptr;
+
+  public:
+    Board(Asic *asics, const char *asicModel)
+    {
+        m_asics = asics;
+        m_asicModel = asicModel;
+    }
+
+    void setAsicJobIntervalMs(int ms)
+    {
+        m_asicJobIntervalMs = ms;
+    }
+
+    void setAsicFrequency(int frequency, int asicCount)
+    {
+        m_asicFrequency = frequency;
+        m_asicCount = asicCount;
+    }
+
+    void setAsicDifficulty(uint32_t minDifficulty, uint32_t maxDifficulty)
+    {
+        m_asicMinDifficulty = minDifficulty;
+        m_asicMaxDifficulty = maxDifficulty;
+    }
+
+    const char *getMiningAgent()
+    {
+        return m_miningAgent;
+    }
+
+    const char *getAsicModel()
+    {
+        return m_asicModel;
+    }
+
+    int getAsicJobIntervalMs()
+    {
+        return m_asicJobIntervalMs;
+    }
+
+    int getAsicFrequency()
+    {
+        return m_asicFrequency;
+    }
+
+    int getAsicCount()
+    {
+        return m_asicCount;
+    }
+
+    uint32_t getAsicMaxDifficulty()
+    {
+        return m_asicMaxDifficulty;
+    }
+
+    uint32_t getAsicMinDifficulty()
+    {
+        return m_asicMinDifficulty;
+    }
+
+    void setChipTemp(int nr, float temp)
+    {
+        (void) nr;
+        (void) temp;
+    }
+
+    Asic *getAsics()
+    {
+        return m_asics;
+    }
+};
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host replacement of components/connect, the network is always up
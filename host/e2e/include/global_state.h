@@ -0,0 +1,22 @@
+#pragma once
+
+// Host replacement of main/global_state.h for the end-to-end benchmark.
+// Only the singletons the stratum, job and result tasks use exist here.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stratum_api.h"
+
+#include "asic.h"
+#include "tasks/asic_jobs.h"
+#include "tasks/stratum_task.h"
+
+#include "boards/board.h"
+#include "system.h"
+
+extern System SYSTEM_MODULE;
+extern StratumManager STRATUM_MANAGER;
+
+extern AsicJobs asicJobs;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host replacement of components/influx, only the types the task header uses
+
+typedef struct
+{
+    uint64_t points_written;
+    uint64_t points_dropped;
+    uint64_t bytes_raw;
+    uint64_t bytes_wire;
+    uint32_t flushes;
+    uint32_t flush_errors;
+    uint32_t last_flush_ms;
+    uint32_t max_flush_ms;
+    uint32_t buffered_points;
+    uint32_t buffered_bytes;
+    float points_per_sec;
+} WriterStats;
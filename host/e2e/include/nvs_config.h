@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host replacement of main/nvs_config.h with the firmware defaults
+
+namespace Config {
+
+inline uint32_t getStratumDifficulty()
+{
+    return 1000;
+}
+
+inline bool isStratumKeepaliveEnabled()
+{
+    return true;
+}
+
+} // namespace Config
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "boards/board.h"
+#include "history.h"
+#include "platform.h"
+#include "tasks/stratum_task.h"
+
+// Host replacement of main/system.h. Keeps the counters the tasks report
+// to, so the benchmark can read them.
+
+class System {
+  protected:
+    Board *m_board = nullptr;
+    History *m_history = nullptr;
+    StratumConfig m_stratumConfig[2] = {};
+
+    std::atomic<uint64_t> m_sharesAccepted{0};
+    std::atomic<uint64_t> m_sharesRejected{0};
+    std::atomic<uint64_t> m_foundNonces{0};
+    std::atomic<uint64_t> m_notifies{0};
+    std::atomic<int> m_poolErrors{0};
+    std::atomic<uint32_t> m_poolDifficulty{0};
+    double m_bestSessionDiff = 0.0;
+
+  public:
+    void notifyAcceptedShare()
+    {
+        m_sharesAccepted++;
+    }
+    void notifyRejectedShare()
+    {
+        m_sharesRejected++;
+    }
+    void notifyFoundNonce(double poolDiff, int asicNr)
+    {
+        m_foundNonces++;
+        if (m_history) {
+            m_history->pushShare(poolDiff, platform_time_ms(), asicNr);
+        }
+    }
+    void checkForBestDiff(double foundDiff, uint32_t nbits)
+    {
+        (void) nbits;
+        if (foundDiff > m_bestSessionDiff) {
+            m_bestSessionDiff = foundDiff;
+        }
+    }
+    void notifyMiningStarted()
+    {
+    }
+    void notifyNewNtime(uint32_t ntime)
+    {
+        (void) ntime;
+        m_notifies++;
+    }
+
+    static void suffixString(uint64_t val, char *buf, size_t bufSize, int sigDigits);
+
+    uint64_t getSharesAccepted() const
+    {
+        return m_sharesAccepted;
+    }
+    uint64_t getSharesRejected() const
+    {
+        return m_sharesRejected;
+    }
+    uint64_t getFoundNonces() const
+    {
+        return m_foundNonces;
+    }
+    uint64_t getNotifies() const
+    {
+        return m_notifies;
+    }
+    uint64_t getBestSessionNonceDiff() const
+    {
+        return (uint64_t) m_bestSessionDiff;
+    }
+
+    StratumConfig *getStratumConfig(uint8_t index)
+    {
+        return &m_stratumConfig[index];
+    }
+
+    void setPoolDifficulty(uint32_t difficulty)
+    {
+        m_poolDifficulty = difficulty;
+    }
+    uint32_t getPoolDifficulty() const
+    {
+        return m_poolDifficulty;
+    }
+    void incPoolErrors()
+    {
+        ++m_poolErrors;
+    }
+    int getPoolErrors() const
+    {
+        return m_poolErrors;
+    }
+
+    // the host benchmark has no scheduler
+    bool isMiningPaused() const
+    {
+        return false;
+    }
+
+    void setBoard(Board *board)
+    {
+        m_board = board;
+    }
+    Board *getBoard()
+    {
+        return m_board;
+    }
+
+    void setHistory(History *history)
+    {
+        m_history = history;
+    }
+    History *getHistory()
+    {
+        return m_history;
+    }
+};
@@ -0,0 +1,585 @@
+#include <chrono>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#include "bm13xx_chain.h"
+
+#include "crc.h"
+
+static const char *TAG = "bm13xx_emu";
+
+// register addresses, see components/bm1397/include/asic.h
+#define REG_CHIP_ID 0x00
+#define REG_PLL0 0x08
+#define REG_TICKET_MASK 0x14
+#define REG_FAST_UART 0x28
+#define REG_VERSION_MASK 0xA4
+#define REG_TEMPERATURE 0xB4
+
+#define HEADER_JOB 0x20
+#define HEADER_GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define JOB_DATA_LEN 82
+#define RESPONSE_LEN 11
+
+// inverse of the conversion in ASIC_result_task
+#define TEMP_TO_RAW(t) ((uint32_t) (((t) + 299.5144f) / 0.171342f))
+
+static const uint8_t chip_id_1366[2] = {0x13, 0x66};
+static const uint8_t chip_id_1368[2] = {0x13, 0x68};
+static const uint8_t chip_id_1370[2] = {0x13, 0x70};
+
+// the crc5 covers the 64 data bits and the upper 3 bits of the last byte,
+// so that the remainder over the whole response is 0
+static void set_response_crc(uint8_t *response)
+{
+    for (uint8_t crc = 0; crc <= 0x1f; crc++) {
+        response[10] = (response[10] & 0xe0) | crc;
+        if (crc5(&response[2], 9) == 0) {
+            return;
+        }
+    }
+}
+
+static uint8_t reverse_bits(uint8_t b)
+{
+    b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+    b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+    b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+    return b;
+}
+
+// the job packet carries the hashes with reversed word order, see construct_bm_job
+static void reverse_words(const uint8_t *src, uint8_t *dst)
+{
+    for (int i = 0; i < 8; i++) {
+        memcpy(&dst[i * 4], &src[(7 - i) * 4], 4);
+    }
+}
+
+static int leading_zero_bits(const uint8_t hash[32])
+{
+    // the hash is a little endian 256 bit number
+    int bits = 0;
+    for (int i = 31; i >= 0; i--) {
+        if (hash[i]) {
+            return bits + __builtin_clz((uint32_t) hash[i]) - 24;
+        }
+        bits += 8;
+    }
+    return bits;
+}
+
+Bm13xxChain::Bm13xxChain(const Bm13xxConfig &config) : m_config(config), m_rng(config.seed)
+{
+    m_chips.resize(config.numChips);
+    for (chip_t &chip : m_chips) {
+        memset(&chip, 0, sizeof(chip));
+        chip.temp = config.ambientTemp;
+    }
+    m_start = 0.0;
+    m_start = now();
+}
+
+Bm13xxChain::~Bm13xxChain()
+{
+    stop();
+}
+
+double Bm13xxChain::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count() - m_start;
+}
+
+const uint8_t *Bm13xxChain::chipId()
+{
+    switch (m_config.model) {
+    case Bm13xxModel::BM1366:
+        return chip_id_1366;
+    case Bm13xxModel::BM1370:
+        return chip_id_1370;
+    default:
+        return chip_id_1368;
+    }
+}
+
+uint16_t Bm13xxChain::smallCoreCount()
+{
+    switch (m_config.model) {
+    case Bm13xxModel::BM1366:
+        return 894;
+    case Bm13xxModel::BM1370:
+        return 2040;
+    default:
+        return 1276;
+    }
+}
+
+// position of the chip number in the nonce, see nonceToAsicNr
+int Bm13xxChain::asicNrShift()
+{
+    return (m_config.model == Bm13xxModel::BM1370) ? 11 : 10;
+}
+
+void Bm13xxChain::start()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    if (m_running) {
+        return;
+    }
+    m_running = true;
+    m_thread = std::thread(&Bm13xxChain::hashLoop, this);
+}
+
+void Bm13xxChain::stop()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_work.notify_all();
+    m_thread.join();
+}
+
+void Bm13xxChain::write(const uint8_t *data, size_t len)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        // resync on the preamble
+        if (m_frame.size() == 0 && b != 0x55) {
+            continue;
+        }
+        if (m_frame.size() == 1 && b != 0xAA) {
+            m_frame.clear();
+            if (b == 0x55) {
+                m_frame.push_back(b);
+            }
+            continue;
+        }
+        m_frame.push_back(b);
+
+        // the length field counts header, length, data and crc
+        if (m_frame.size() >= 4 && m_frame.size() == (size_t) m_frame[3] + 2) {
+            handleFrame(m_frame.data(), m_frame.size());
+            m_frame.clear();
+        } else if (m_frame.size() >= 4 && m_frame[3] < 5) {
+            // can't be a valid frame
+            m_stats.crcErrors++;
+            m_frame.clear();
+        }
+    }
+}
+
+size_t Bm13xxChain::read(uint8_t *data, size_t len, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_txReady.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return m_tx.size() >= len; });
+
+    size_t n = std::min(len, m_tx.size());
+    for (size_t i = 0; i < n; i++) {
+        data[i] = m_tx.front();
+        m_tx.pop_front();
+    }
+    return n;
+}
+
+void Bm13xxChain::clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_tx.clear();
+}
+
+Bm13xxStats Bm13xxChain::getStats()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_stats;
+}
+
+float Bm13xxChain::getFrequency(int chip)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return frequency(m_chips[chip]);
+}
+
+void Bm13xxChain::setJobObserver(std::function<void(uint32_t ntime)> observer)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_jobObserver = observer;
+}
+
+uint32_t Bm13xxChain::getTicketDifficulty(int chip)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return ticketDifficulty(m_chips[chip]);
+}
+
+void Bm13xxChain::setHostBaud(int baud)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_hostBaud = baud;
+}
+
+int Bm13xxChain::getChipBaud()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_chipBaud;
+}
+
+// true if the next frame is lost or damaged on the link
+bool Bm13xxChain::linkDamages()
+{
+    // UARTs tolerate a few percent of baud mismatch
+    if (m_hostBaud && fabs((double) m_hostBaud - m_chipBaud) > m_chipBaud * 0.05) {
+        return true;
+    }
+    if (m_config.maxBaud && m_chipBaud > m_config.maxBaud) {
+        return (++m_linkFrames % 4) == 0;
+    }
+    return false;
+}
+
+void Bm13xxChain::handleFrame(const uint8_t *frame, size_t len)
+{
+    if (linkDamages()) {
+        m_stats.linkErrors++;
+        return;
+    }
+
+    uint8_t header = frame[2];
+    bool job = header & HEADER_JOB;
+    size_t dataLen = len - (job ? 6 : 5);
+
+    if (job) {
+        uint16_t crc = crc16_false((uint8_t *) frame + 2, dataLen + 2);
+        if (frame[len - 2] != (crc >> 8) || frame[len - 1] != (crc & 0xff)) {
+            ESP_LOGW(TAG, "job crc error");
+            m_stats.crcErrors++;
+            return;
+        }
+    } else if (crc5((uint8_t *) frame + 2, dataLen + 2) != frame[len - 1]) {
+        ESP_LOGW(TAG, "command crc error");
+        m_stats.crcErrors++;
+        return;
+    }
+
+    m_stats.framesRx++;
+
+    if (job) {
+        handleJob(frame + 4, dataLen);
+    } else {
+        handleCommand(header, frame + 4, dataLen);
+    }
+}
+
+void Bm13xxChain::handleCommand(uint8_t header, const uint8_t *data, size_t len)
+{
+    bool all = header & HEADER_GROUP_ALL;
+
+    switch (header & 0x0f) {
+    case CMD_INACTIVE:
+        // chips forget their address and take the next one that is sent
+        for (chip_t &chip : m_chips) {
+            chip.addressed = false;
+        }
+        break;
+
+    case CMD_SETADDRESS:
+        for (chip_t &chip : m_chips) {
+            if (!chip.addressed) {
+                chip.addressed = true;
+                chip.address = data[0];
+                break;
+            }
+        }
+        break;
+
+    case CMD_WRITE: {
+        if (len < 6) {
+            break;
+        }
+        uint32_t value = ((uint32_t) data[2] << 24) | ((uint32_t) data[3] << 16) | ((uint32_t) data[4] << 8) | data[5];
+        for (chip_t &chip : m_chips) {
+            if (all || chip.address == data[0]) {
+                writeRegister(chip, data[1], value);
+            }
+        }
+        m_stats.regWrites++;
+        break;
+    }
+
+    case CMD_READ:
+        if (len < 2) {
+            break;
+        }
+        // every chip answers in chain order
+        for (chip_t &chip : m_chips) {
+            if (!all && chip.address != data[0]) {
+                continue;
+            }
+            uint32_t value = chip.regs[data[1]];
+            if (data[1] == REG_CHIP_ID) {
+                value = ((uint32_t) chipId()[0] << 24) | ((uint32_t) chipId()[1] << 16);
+            } else if (data[1] == REG_TEMPERATURE) {
+                value = 0x80000000 | TEMP_TO_RAW(chip.temp);
+            }
+            sendRegister(chip, data[1], value);
+        }
+        m_stats.regReads++;
+        break;
+    }
+}
+
+void Bm13xxChain::writeRegister(chip_t &chip, uint8_t reg, uint32_t value)
+{
+    chip.regs[reg] = value;
+
+    if (reg == REG_FAST_UART) {
+        // all chips take the broadcast, the chain switches at once
+        m_chipBaud = 25000000 / (8 * (((value >> 8) & 0xff) + 1));
+    }
+
+    if (reg == REG_PLL0) {
+        // chips get warmer with the frequency
+        int index = &chip - m_chips.data();
+        chip.temp = m_config.ambientTemp + frequency(chip) * 0.04f + index * 0.5f;
+    }
+}
+
+void Bm13xxChain::handleJob(const uint8_t *data, size_t len)
+{
+    if (len != JOB_DATA_LEN) {
+        ESP_LOGW(TAG, "unexpected job length %d", (int) len);
+        return;
+    }
+
+    chip_job_t job;
+    job.jobId = data[0];
+    memcpy(&job.nbits, &data[6], 4);
+    memcpy(&job.ntime, &data[10], 4);
+    reverse_words(&data[14], job.merkleRoot);
+    reverse_words(&data[46], job.prevBlockHash);
+    memcpy(&job.version, &data[78], 4);
+
+    // all chips work on the job, each one on its own part of the nonce space
+    double t = now();
+    for (chip_t &chip : m_chips) {
+        bool first = !chip.hasJob;
+        chip.job = job;
+        chip.hasJob = true;
+        chip.nonceCounter = 0;
+        chip.versionCounter = 0;
+        if (first || chip.nextNonceTime < t - 1.0) {
+            chip.nextNonceTime = t;
+            scheduleNonce(chip);
+        }
+    }
+
+    m_stats.jobs++;
+    m_work.notify_all();
+
+    if (m_jobObserver) {
+        m_jobObserver(job.ntime);
+    }
+}
+
+void Bm13xxChain::sendResponse(const uint8_t *response)
+{
+    if (linkDamages()) {
+        m_stats.linkErrors++;
+        // a flipped bit, the host sees a crc error
+        uint8_t damaged[RESPONSE_LEN];
+        memcpy(damaged, response, RESPONSE_LEN);
+        damaged[4] ^= 0x10;
+        m_tx.insert(m_tx.end(), damaged, damaged + RESPONSE_LEN);
+        m_txReady.notify_all();
+        return;
+    }
+    m_tx.insert(m_tx.end(), response, response + RESPONSE_LEN);
+    m_txReady.notify_all();
+}
+
+void Bm13xxChain::sendRegister(const chip_t &chip, uint8_t reg, uint32_t value)
+{
+    uint8_t response[RESPONSE_LEN] = {0xAA, 0x55};
+    response[2] = value >> 24;
+    response[3] = value >> 16;
+    response[4] = value >> 8;
+    response[5] = value;
+    response[6] = chip.address;
+    response[7] = reg;
+    response[8] = 0;
+    response[9] = 0;
+    set_response_crc(response);
+    sendResponse(response);
+}
+
+uint32_t Bm13xxChain::ticketDifficulty(const chip_t &chip)
+{
+    // inverse of Asic::setJobDifficultyMask
+    uint32_t value = chip.regs[REG_TICKET_MASK];
+    uint32_t mask = 0;
+    for (int i = 0; i < 4; i++) {
+        mask |= (uint32_t) reverse_bits((value >> (8 * i)) & 0xff) << (8 * i);
+    }
+    return mask + 1;
+}
+
+float Bm13xxChain::frequency(const chip_t &chip)
+{
+    // inverse of Asic::sendHashFrequency
+    uint32_t value = chip.regs[REG_PLL0];
+    int fbDiv = (value >> 16) & 0xff;
+    int refDiv = (value >> 8) & 0xff;
+    int postDiv1 = ((value >> 4) & 0x0f) + 1;
+    int postDiv2 = (value & 0x0f) + 1;
+    if (!fbDiv || !refDiv) {
+        // reset default
+        return 56.25f;
+    }
+    return 25.0f * fbDiv / (refDiv * postDiv1 * postDiv2);
+}
+
+double Bm13xxChain::hashrate(const chip_t &chip)
+{
+    if (m_config.hashrateGhs > 0.0) {
+        return m_config.hashrateGhs;
+    }
+    return frequency(chip) * smallCoreCount() / 1000.0;
+}
+
+void Bm13xxChain::scheduleNonce(chip_t &chip)
+{
+    // nonces above the ticket mask arrive as a poisson process
+    double mean = 4294967296.0 * ticketDifficulty(chip) / (hashrate(chip) * 1e9);
+    std::uniform_real_distribution<double> uniform(1e-12, 1.0);
+    chip.nextNonceTime += -log(uniform(m_rng)) * mean;
+}
+
+void Bm13xxChain::findNonce(int index, chip_t &chip)
+{
+    const chip_job_t &job = chip.job;
+    int shift = asicNrShift();
+    uint32_t lowMask = (1u << shift) - 1;
+
+    uint32_t versionMask = (chip.regs[REG_VERSION_MASK] & 0x80000000) ? (chip.regs[REG_VERSION_MASK] & 0xffff) : 0;
+    int zeroBits = m_config.cpuZeroBits;
+
+    uint8_t header[80];
+    memcpy(&header[4], job.prevBlockHash, 32);
+    memcpy(&header[36], job.merkleRoot, 32);
+    memcpy(&header[68], &job.ntime, 4);
+    memcpy(&header[72], &job.nbits, 4);
+
+    uint64_t limit = 1ull << (zeroBits + 6);
+    uint64_t tries;
+    for (tries = 0; tries < limit; tries++) {
+        uint32_t counter = chip.nonceCounter++;
+        uint32_t nonce = ((counter >> shift) << 16) | ((uint32_t) index << shift) | (counter & lowMask);
+
+        // nonce space of this version exhausted, roll the version
+        if (chip.nonceCounter == 0 || (chip.nonceCounter >> shift) > 0xffff) {
+            chip.nonceCounter = 0;
+            chip.versionCounter++;
+        }
+
+        uint16_t rolled = chip.versionCounter & versionMask;
+
+        // the firmware would take this for a register response
+        if (!(nonce & 0x7f) && !rolled) {
+            continue;
+        }
+
+        uint32_t version = job.version | ((uint32_t) rolled << 13);
+        memcpy(&header[0], &version, 4);
+        memcpy(&header[76], &nonce, 4);
+
+        uint8_t hash[32];
+        mbedtls_sha256(header, sizeof(header), hash, 0);
+        mbedtls_sha256(hash, 32, hash, 0);
+
+        if (leading_zero_bits(hash) < zeroBits) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stats.hashes += tries + 1;
+        m_stats.nonces++;
+
+        std::uniform_int_distribution<int> core(0, 15);
+        uint8_t smallCore = core(m_rng);
+
+        uint8_t response[RESPONSE_LEN] = {0xAA, 0x55};
+        memcpy(&response[2], &nonce, 4);
+        response[6] = 0;
+        // inverse of asicToJobId
+        response[7] = (m_config.model == Bm13xxModel::BM1366) ? (job.jobId | (smallCore & 0x07))
+                                                              : (((job.jobId << 1) & 0xf0) | smallCore);
+        response[8] = rolled >> 8;
+        response[9] = rolled & 0xff;
+        response[10] = 0x80;
+        set_response_crc(response);
+        sendResponse(response);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_stats.hashes += tries;
+    ESP_LOGW(TAG, "chip %d: no nonce found within %llu hashes", index, (unsigned long long) limit);
+}
+
+void Bm13xxChain::hashLoop()
+{
+    pthread_setname_np(pthread_self(), "bm13xx-chain");
+
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while (m_running) {
+        // chip with the earliest due nonce
+        int next = -1;
+        for (int i = 0; i < (int) m_chips.size(); i++) {
+            if (m_chips[i].hasJob && (next < 0 || m_chips[i].nextNonceTime < m_chips[next].nextNonceTime)) {
+                next = i;
+            }
+        }
+
+        if (next < 0) {
+            m_work.wait(lock);
+            continue;
+        }
+
+        double wait = m_chips[next].nextNonceTime - now();
+        if (wait > 0) {
+            m_work.wait_for(lock, std::chrono::duration<double>(wait));
+            continue;
+        }
+
+        // search without the lock, the firmware keeps sending meanwhile
+        chip_t chip = m_chips[next];
+        lock.unlock();
+        findNonce(next, chip);
+        lock.lock();
+
+        // keep the search position unless a new job arrived
+        chip_t &current = m_chips[next];
+        if (current.job.jobId == chip.job.jobId && !memcmp(current.job.merkleRoot, chip.job.merkleRoot, 32)) {
+            current.nonceCounter = chip.nonceCounter;
+            current.versionCounter = chip.versionCounter;
+        }
+        scheduleNonce(current);
+    }
+}
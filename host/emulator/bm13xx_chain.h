@@ -0,0 +1,176 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Host-side emulator of a chain of BM1366/BM1368/BM1370 chips.
+//
+// Consumes the byte stream the firmware sends with SERIAL_send and
+// produces the 11 byte frames SERIAL_rx expects:
+//
+//   - command frames (55 AA, crc5) for chip enumeration, addressing,
+//     register writes (ticket mask, PLL, version mask, ...) and reads
+//   - job frames (55 AA, crc16) which are hashed with the real
+//     double SHA-256 header construction
+//   - register responses (chip id, temperature 0xB4) and nonce frames
+//     in the format Asic::processWork decodes
+//   - the fast UART register: frames are only understood if the host
+//     baud (SERIAL_set_baud) matches the chips' baud, and above `maxBaud`
+//     every 4th frame in each direction is damaged
+//
+// Nonces are paced by a simulated per-chip hashrate and the ticket mask.
+// A PC can't search for real ticket mask difficulties, so every returned
+// nonce is a real solution of at least `cpuZeroBits` leading zero bits.
+// The firmware computes the same (low) difficulty from it.
+
+enum class Bm13xxModel
+{
+    BM1366,
+    BM1368,
+    BM1370,
+};
+
+typedef struct
+{
+    Bm13xxModel model = Bm13xxModel::BM1368;
+    int numChips = 1;
+
+    // simulated hashrate per chip, 0 derives it from PLL frequency and core count
+    double hashrateGhs = 0.0;
+
+    // difficulty of the returned nonces is capped at this many leading zero bits
+    int cpuZeroBits = 16;
+
+    float ambientTemp = 40.0f;
+
+    // fastest baud the link carries without errors, 0 for no limit
+    int maxBaud = 0;
+    uint32_t seed = 1;
+} Bm13xxConfig;
+
+typedef struct
+{
+    uint64_t framesRx;
+    uint64_t crcErrors;
+    uint64_t jobs;
+    uint64_t regReads;
+    uint64_t regWrites;
+    uint64_t nonces;
+    uint64_t hashes;
+    uint64_t linkErrors; // frames lost or damaged by the baud
+} Bm13xxStats;
+
+class Bm13xxChain {
+  protected:
+    typedef struct
+    {
+        uint8_t jobId;
+        uint32_t version;
+        uint32_t nbits;
+        uint32_t ntime;
+        uint8_t prevBlockHash[32]; // header byte order
+        uint8_t merkleRoot[32];    // header byte order
+    } chip_job_t;
+
+    typedef struct
+    {
+        bool addressed;
+        uint8_t address;
+        uint32_t regs[256];
+        float temp;
+
+        bool hasJob;
+        chip_job_t job;
+        uint32_t nonceCounter;
+        uint16_t versionCounter;
+        double nextNonceTime; // seconds since start
+    } chip_t;
+
+    Bm13xxConfig m_config;
+    std::vector<chip_t> m_chips;
+
+    // command parser
+    std::vector<uint8_t> m_frame;
+
+    // frames to the host
+    std::deque<uint8_t> m_tx;
+
+    std::mutex m_lock;
+    std::condition_variable m_txReady;
+    std::condition_variable m_work;
+    std::thread m_thread;
+    bool m_running = false;
+
+    std::mt19937_64 m_rng;
+    Bm13xxStats m_stats = {};
+    double m_start;
+
+    std::function<void(uint32_t ntime)> m_jobObserver;
+
+    int m_hostBaud = 0; // 0 if the host baud isn't modelled (pty)
+    int m_chipBaud = 115200;
+    uint32_t m_linkFrames = 0;
+
+    double now();
+    const uint8_t *chipId();
+    uint16_t smallCoreCount();
+    int asicNrShift();
+
+    bool linkDamages();
+    void handleFrame(const uint8_t *frame, size_t len);
+    void handleCommand(uint8_t header, const uint8_t *data, size_t len);
+    void handleJob(const uint8_t *data, size_t len);
+    void writeRegister(chip_t &chip, uint8_t reg, uint32_t value);
+    void sendResponse(const uint8_t *response);
+    void sendRegister(const chip_t &chip, uint8_t reg, uint32_t value);
+
+    uint32_t ticketDifficulty(const chip_t &chip);
+    float frequency(const chip_t &chip);
+    double hashrate(const chip_t &chip);
+    void scheduleNonce(chip_t &chip);
+    void findNonce(int index, chip_t &chip);
+
+    void hashLoop();
+
+  public:
+    Bm13xxChain(const Bm13xxConfig &config);
+    ~Bm13xxChain();
+
+    void start();
+    void stop();
+
+    // bytes sent by the firmware (SERIAL_send)
+    void write(const uint8_t *data, size_t len);
+
+    // bytes for the firmware (SERIAL_rx), waits until len bytes are there or
+    // the timeout expired, returns the number of bytes copied
+    size_t read(uint8_t *data, size_t len, int timeoutMs);
+
+    // drops pending frames (SERIAL_clear_buffer)
+    void clear();
+
+    // baud of the host side UART (SERIAL_set_baud), the link only checks it
+    // once it was set
+    void setHostBaud(int baud);
+    int getChipBaud();
+
+    Bm13xxStats getStats();
+
+    // called with the ntime of every job frame, from the thread that sends
+    // it and with the chain locked, so it must not call back into the chain
+    void setJobObserver(std::function<void(uint32_t ntime)> observer);
+
+    float getFrequency(int chip);
+    uint32_t getTicketDifficulty(int chip);
+    int getNumChips()
+    {
+        return (int) m_chips.size();
+    }
+};
@@ -0,0 +1,146 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+
+#include "bm13xx_chain.h"
+
+// Exposes an emulated chain on a pseudo terminal, so anything that talks
+// to a serial port (e.g. firmware on a dev board through a USB UART, or a
+// host build using a tty) can be connected to it.
+//
+//   ./bm13xx_emu --model 1368 --chips 4 --hashrate 500
+//   -> /dev/pts/5
+
+static volatile bool s_running = true;
+
+static void on_signal(int)
+{
+    s_running = false;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--model 1366|1368|1370] [--chips N] [--hashrate GH/s per chip] [--zero-bits N] [--link path]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    Bm13xxConfig config;
+    const char *link = nullptr;
+
+    static const struct option options[] = {
+        {"model", required_argument, nullptr, 'm'},    {"chips", required_argument, nullptr, 'c'},
+        {"hashrate", required_argument, nullptr, 'h'}, {"zero-bits", required_argument, nullptr, 'z'},
+        {"link", required_argument, nullptr, 'l'},     {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:c:h:z:l:", options, nullptr)) != -1) {
+        switch (opt) {
+        case 'm':
+            if (!strcmp(optarg, "1366")) {
+                config.model = Bm13xxModel::BM1366;
+            } else if (!strcmp(optarg, "1370")) {
+                config.model = Bm13xxModel::BM1370;
+            } else {
+                config.model = Bm13xxModel::BM1368;
+            }
+            break;
+        case 'c':
+            config.numChips = atoi(optarg);
+            break;
+        case 'h':
+            config.hashrateGhs = atof(optarg);
+            break;
+        case 'z':
+            config.cpuZeroBits = atoi(optarg);
+            break;
+        case 'l':
+            link = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    // raw bytes, no line discipline
+    struct termios tio;
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+
+    const char *slave = ptsname(master);
+    if (link) {
+        unlink(link);
+        if (symlink(slave, link)) {
+            perror("symlink");
+            return 1;
+        }
+    }
+    printf("%s\n", link ? link : slave);
+    fflush(stdout);
+
+    // no SA_RESTART, the blocking read has to return on a signal
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    Bm13xxChain chain(config);
+    chain.start();
+
+    // chain -> tty
+    std::thread tx([&] {
+        uint8_t frame[11];
+        while (s_running) {
+            if (chain.read(frame, sizeof(frame), 100) == sizeof(frame)) {
+                if (::write(master, frame, sizeof(frame)) < 0 && errno != EIO) {
+                    perror("write");
+                }
+            }
+        }
+    });
+
+    // tty -> chain
+    uint8_t buf[256];
+    while (s_running) {
+        ssize_t n = ::read(master, buf, sizeof(buf));
+        if (n > 0) {
+            chain.write(buf, n);
+        } else if (n < 0 && errno != EINTR) {
+            // EIO until the other side opens the tty
+            usleep(100 * 1000);
+        }
+    }
+
+    tx.join();
+    chain.stop();
+
+    Bm13xxStats stats = chain.getStats();
+    fprintf(stderr, "frames %llu, crc errors %llu, jobs %llu, nonces %llu, hashes %llu\n", (unsigned long long) stats.framesRx,
+            (unsigned long long) stats.crcErrors, (unsigned long long) stats.jobs, (unsigned long long) stats.nonces,
+            (unsigned long long) stats.hashes);
+
+    if (link) {
+        unlink(link);
+    }
+    close(master);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <math.h>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bm1366.h"
+#include "bm1368.h"
+#include "bm1370.h"
+#include "mining.h"
+#include "utils.h"
+
+#include "bm13xx_chain.h"
+#include "serial_emulator.h"
+
+// Drives the real BM13xx drivers against the emulated chain: enumeration,
+// addressing, ticket mask, PLL, baud negotiation, temperature reads, jobs
+// and nonces. Every
+// nonce is validated with test_nonce_value, so a mismatch anywhere between
+// construct_bm_job, the job packet and the result decoding fails the test.
+
+#define NUM_CHIPS 4
+#define NUM_NONCES 16
+#define ZERO_BITS 14
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            s_failures++;                                                                                                          \
+        }                                                                                                                          \
+    } while (0)
+
+static bm_job *build_job(uint32_t extranonce_2)
+{
+    static const char *coinbase_1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff20020862062f503253482f04b8864e5008";
+    static const char *coinbase_2 = "072f736c7573682f000000000100f2052a010000001976a914d23fcdf86f7e756a64a7a9688ef9903327048ed988ac00000000";
+
+    mining_notify notify;
+    memset(&notify, 0, sizeof(notify));
+    hex2bin("0000000000000000000287c1b4b3a9a6a5b0e4d6a91c3f0e2b6e4f1d2c3b4a59", notify._prev_block_hash, 32);
+    notify.version = 0x20000000;
+    notify.version_mask = 0x1fffe000;
+    notify.target = 0x1705ae3a;
+    notify.ntime = 0x6650a1b2;
+    notify.difficulty = 1024;
+
+    char extranonce_2_str[9];
+    snprintf(extranonce_2_str, sizeof(extranonce_2_str), "%08x", extranonce_2);
+
+    char coinbase_tx[512];
+    snprintf(coinbase_tx, sizeof(coinbase_tx), "%s%s%s%s", coinbase_1, "e8a1b2c3", extranonce_2_str, coinbase_2);
+
+    char merkle_root[65];
+    calculate_merkle_root_hash(coinbase_tx, notify._merkle_branches, 0, merkle_root);
+
+    bm_job *job = (bm_job *) calloc(1, sizeof(bm_job));
+    construct_bm_job(&notify, merkle_root, notify.version_mask, job);
+    job->jobid = strdup("selftest");
+    job->extranonce2 = strdup(extranonce_2_str);
+    job->asic_diff = 1;
+    return job;
+}
+
+// linkBaud is the fastest baud the emulated link carries, expectedBaud the
+// rate the negotiation has to settle on
+static void run(const char *name, Bm13xxModel model, Asic *asic, int linkBaud, int expectedBaud)
+{
+    Bm13xxConfig config;
+    config.model = model;
+    config.numChips = NUM_CHIPS;
+    config.hashrateGhs = 400.0;
+    config.cpuZeroBits = ZERO_BITS;
+    config.maxBaud = linkBaud;
+
+    Bm13xxChain chain(config);
+    chain.start();
+    SERIAL_attach_emulator(&chain);
+
+    auto start = std::chrono::steady_clock::now();
+
+    // enumeration, addressing, PLL and ticket mask
+    int chips = asic->init(100, NUM_CHIPS, 256);
+    CHECK(chips == NUM_CHIPS, "%s: %d chips detected", name, chips);
+    CHECK(fabs(chain.getFrequency(NUM_CHIPS - 1) - 100.0f) < 1.0f, "%s: frequency %.2f", name,
+          chain.getFrequency(NUM_CHIPS - 1));
+    CHECK(chain.getTicketDifficulty(0) == 256, "%s: ticket difficulty %u", name, chain.getTicketDifficulty(0));
+
+    // fastest rate the link carries, the host and the chips have to agree
+    int baud = asic->negotiateBaud(chips, 3125000);
+    CHECK(baud == expectedBaud, "%s: negotiated %d baud, expected %d", name, baud, expectedBaud);
+    CHECK(abs(chain.getChipBaud() - baud) < baud / 20, "%s: chips at %d baud, host at %d", name, chain.getChipBaud(), baud);
+    uint32_t crcErrors = asic->getCrcErrors();
+
+    // low ticket mask so the nonces come quickly
+    asic->setJobDifficultyMask(1);
+    CHECK(chain.getTicketDifficulty(0) == 1, "%s: ticket difficulty %u", name, chain.getTicketDifficulty(0));
+
+    // temperature read, only the BM1368 driver requests it
+    int temps = 0;
+    if (model == Bm13xxModel::BM1368) {
+        asic->requestChipTemp();
+        task_result result;
+        while (temps < NUM_CHIPS && asic->processWork(&result)) {
+            if (result.is_reg_resp && result.reg == 0xb4 && (result.data & 0x80000000)) {
+                float temp = (float) (result.data & 0x0000ffff) * 0.171342f - 299.5144f;
+                CHECK(temp > 30.0f && temp < 100.0f, "%s: chip temp %.1f", name, temp);
+                temps++;
+            }
+        }
+        CHECK(temps == NUM_CHIPS, "%s: %d temperature responses", name, temps);
+    }
+
+    // jobs by the ASIC job id, like asicJobs
+    bm_job *jobs[128] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        bm_job *job = build_job(i);
+        uint8_t asicJobId = asic->sendWork(i, job);
+        if (jobs[asicJobId]) {
+            free_bm_job(jobs[asicJobId]);
+        }
+        jobs[asicJobId] = job;
+    }
+
+    double minDiff = 65535.0 * pow(2.0, ZERO_BITS - 48);
+    int nonces = 0;
+    int perChip[NUM_CHIPS] = {};
+    while (nonces < NUM_NONCES) {
+        task_result result;
+        if (!asic->processWork(&result)) {
+            CHECK(false, "%s: no nonce received", name);
+            break;
+        }
+        if (result.is_reg_resp) {
+            continue;
+        }
+
+        bm_job *job = jobs[result.job_id];
+        CHECK(job, "%s: unknown job id %02x", name, result.job_id);
+        if (!job) {
+            continue;
+        }
+
+        double diff = test_nonce_value(job, result.nonce, result.rolled_version | job->version);
+        CHECK(diff >= minDiff, "%s: nonce %08x diff %g below %g", name, result.nonce, diff, minDiff);
+        CHECK(result.asic_nr < NUM_CHIPS, "%s: asic nr %d", name, result.asic_nr);
+        if (result.asic_nr < NUM_CHIPS) {
+            perChip[result.asic_nr]++;
+        }
+        nonces++;
+    }
+
+    CHECK(asic->getCrcErrors() == crcErrors, "%s: %u crc errors after the negotiation", name,
+          (unsigned) (asic->getCrcErrors() - crcErrors));
+
+    chain.stop();
+    SERIAL_attach_emulator(nullptr);
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    Bm13xxStats stats = chain.getStats();
+    printf("%s: %d chips, %d baud, %d temps, %d nonces (%d/%d/%d/%d), %llu frames, %llu crc errors, %llu link errors, %llu hashes, "
+           "%.2fs\n",
+           name, chips, baud, temps, nonces, perChip[0], perChip[1], perChip[2], perChip[3], (unsigned long long) stats.framesRx,
+           (unsigned long long) stats.crcErrors, (unsigned long long) stats.linkErrors, (unsigned long long) stats.hashes, elapsed);
+    CHECK(stats.crcErrors == 0, "%s: %llu crc errors", name, (unsigned long long) stats.crcErrors);
+
+    for (bm_job *job : jobs) {
+        if (job) {
+            free_bm_job(job);
+        }
+    }
+}
+
+int main()
+{
+    std::unique_ptr<Asic> bm1366(new BM1366());
+    std::unique_ptr<Asic> bm1368(new BM1368());
+    std::unique_ptr<Asic> bm1370(new BM1370());
+
+    // clean link, link that fails at 3.125M and one that only carries the legacy 1M
+    run("BM1366", Bm13xxModel::BM1366, bm1366.get(), 0, 3125000);
+    run("BM1368", Bm13xxModel::BM1368, bm1368.get(), 2000000, 1562500);
+    run("BM1370", Bm13xxModel::BM1370, bm1370.get(), 1100000, 1000000);
+
+    printf("%s\n", s_failures ? "FAILED" : "OK");
+    return s_failures ? 1 : 0;
+}
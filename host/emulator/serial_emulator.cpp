@@ -0,0 +1,80 @@
+#include <atomic>
+
+#include "esp_log.h"
+
+#include "serial.h"
+#include "serial_emulator.h"
+
+static const char *TAG = "serial";
+
+static Bm13xxChain *s_chain = nullptr;
+
+static std::atomic<int> s_baud{115200};
+static std::atomic<uint32_t> s_txBytes{0};
+static std::atomic<uint32_t> s_rxBytes{0};
+
+void SERIAL_attach_emulator(Bm13xxChain *chain)
+{
+    s_chain = chain;
+    // a new chain starts at the reset baud like the UART after SERIAL_init
+    s_baud = 115200;
+    if (s_chain) {
+        s_chain->setHostBaud(s_baud);
+    }
+}
+
+void SERIAL_init(void)
+{
+    ESP_LOGI(TAG, "Initializing serial (emulated chain)");
+}
+
+void SERIAL_set_baud(int baud)
+{
+    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+    s_baud = baud;
+    if (s_chain) {
+        s_chain->setHostBaud(baud);
+    }
+}
+
+void SERIAL_wait_tx_done(void)
+{
+    // the chain consumes the bytes in SERIAL_send
+}
+
+void SERIAL_get_stats(serial_stats_t *stats)
+{
+    stats->baud = s_baud;
+    stats->txBytes = s_txBytes.load(std::memory_order_relaxed);
+    stats->rxBytes = s_rxBytes.load(std::memory_order_relaxed);
+}
+
+int SERIAL_send(uint8_t *data, int len, bool debug)
+{
+    if (debug) {
+        ESP_LOG_BUFFER_HEX_LEVEL("serial_tx", data, len, ESP_LOG_INFO);
+    }
+    if (!s_chain) {
+        return -1;
+    }
+    s_chain->write(data, len);
+    s_txBytes.fetch_add(len, std::memory_order_relaxed);
+    return len;
+}
+
+int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+{
+    if (!s_chain) {
+        return -1;
+    }
+    int16_t bytes = (int16_t) s_chain->read(buf, size, timeout_ms);
+    s_rxBytes.fetch_add(bytes, std::memory_order_relaxed);
+    return bytes;
+}
+
+void SERIAL_clear_buffer(void)
+{
+    if (s_chain) {
+        s_chain->clear();
+    }
+}
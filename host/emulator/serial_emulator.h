@@ -0,0 +1,7 @@
+#pragma once
+
+#include "bm13xx_chain.h"
+
+// Routes the SERIAL_* functions of components/bm1397/include/serial.h
+// to an emulated chain instead of the UART
+void SERIAL_attach_emulator(Bm13xxChain *chain);
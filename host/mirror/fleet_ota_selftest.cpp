@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "fleet_ota_manifest.h"
+#include "fleet_ota_task.h"
+#include "host_device.h"
+#include "ota_writer.h"
+
+#include "mock_mirror.h"
+
+// Checks the fleet OTA pull against the mock mirror: the manifest parser and
+// update plan (main/fleet_ota_manifest.cpp), FleetOta of the firmware
+// (main/tasks/fleet_ota_task.cpp) pulling into the flash of host_device.cpp
+// with cut downloads, misaligned ranges and deltas, the takeover of a stale
+// upload session and the rollout and stagger spread over a fleet of MACs.
+
+#define DEVICE_MODEL "NerdQAxe++"
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            s_failures++;                                                                                                          \
+        }                                                                                                                          \
+    } while (0)
+
+static std::vector<uint8_t> make_image(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = seed >> 16;
+    }
+    return data;
+}
+
+static std::string sha256_hex(const std::vector<uint8_t> &data)
+{
+    return MockMirror::sha256Hex(data);
+}
+
+// FleetOta of the firmware with the protected steps opened up
+class TestFleetOta : public FleetOta {
+  public:
+    using FleetOta::check;
+    using FleetOta::init;
+};
+
+static void test_manifest()
+{
+    const char *json = "{\"version\":\"v1.0.31\",\"rolloutPercent\":25,\"staggerMinutes\":30,"
+                       "\"firmware\":{\"NerdQAxe++\":{\"url\":\"nerdqaxeplus/esp-miner.bin\",\"size\":1000,"
+                       "\"sha256\":\"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\"},"
+                       "\"NerdOCTAXE-γ\":{\"url\":\"http://other/fw.bin\",\"size\":2000,"
+                       "\"sha256\":\"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb\"}},"
+                       "\"www\":{\"url\":\"/www.bin\",\"size\":3000,"
+                       "\"sha256\":\"cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc\"}}";
+
+    fleet_ota_manifest_t m;
+    CHECK(fleet_ota_parse_manifest(json, strlen(json), "http://mirror.lan/ota/", DEVICE_MODEL, "", &m), "manifest rejected");
+    CHECK(!strcmp(m.version, "v1.0.31"), "version %s", m.version);
+    CHECK(m.rolloutPercent == 25 && m.staggerMinutes == 30, "rollout %d stagger %d", m.rolloutPercent, m.staggerMinutes);
+    CHECK(m.firmware.present && m.firmware.size == 1000, "firmware %d %u", m.firmware.present, m.firmware.size);
+    CHECK(!strcmp(m.firmware.url, "http://mirror.lan/ota/nerdqaxeplus/esp-miner.bin"), "firmware url %s", m.firmware.url);
+    CHECK(!strcmp(m.www.url, "http://mirror.lan/ota/www.bin"), "www url %s", m.www.url);
+
+    CHECK(fleet_ota_parse_manifest(json, strlen(json), "http://mirror.lan", "NerdOCTAXE-γ", "", &m), "manifest rejected");
+    CHECK(!strcmp(m.firmware.url, "http://other/fw.bin"), "absolute url %s", m.firmware.url);
+
+    // no image for the model: only www
+    CHECK(fleet_ota_parse_manifest(json, strlen(json), "http://mirror.lan", "NerdQAxe+", "", &m), "manifest rejected");
+    CHECK(!m.firmware.present && m.www.present, "firmware %d www %d", m.firmware.present, m.www.present);
+
+    const char *broken = "{\"version\":\"v1\",\"www\":{\"url\":\"www.bin\",\"size\":3000,\"sha256\":\"abc\"}}";
+    CHECK(!fleet_ota_parse_manifest(broken, strlen(broken), "http://mirror.lan", DEVICE_MODEL, "", &m), "short sha256 accepted");
+    const char *noVersion = "{\"rolloutPercent\":100}";
+    CHECK(!fleet_ota_parse_manifest(noVersion, strlen(noVersion), "http://mirror.lan", DEVICE_MODEL, "", &m), "no version accepted");
+    CHECK(!fleet_ota_parse_manifest("{", 1, "http://mirror.lan", DEVICE_MODEL, "", &m), "truncated json accepted");
+}
+
+static void test_plan()
+{
+    fleet_ota_manifest_t m;
+    memset(&m, 0, sizeof(m));
+    strcpy(m.version, "v1.0.31");
+    m.firmware.present = true;
+    strcpy(m.firmware.sha256, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+    m.www.present = true;
+    strcpy(m.www.sha256, "cccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccccc");
+    const char *other = "dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd";
+
+    CHECK(fleet_ota_plan(&m, "v1.0.30", "", "") == (FLEET_OTA_FIRMWARE | FLEET_OTA_WWW), "new version");
+    CHECK(fleet_ota_plan(&m, "v1.0.31", "", "") == 0, "same version, www of the release");
+    CHECK(fleet_ota_plan(&m, "v1.0.31", "", m.www.sha256) == 0, "same version, same www");
+    CHECK(fleet_ota_plan(&m, "v1.0.31", "", other) == FLEET_OTA_WWW, "same version, new www");
+    CHECK(fleet_ota_plan(&m, "v1.0.30", "", m.www.sha256) == FLEET_OTA_FIRMWARE, "new version, same www");
+
+    // a pulled image is compared by its hash, whatever version it reports
+    CHECK(fleet_ota_plan(&m, "v1.0.31-dirty", m.firmware.sha256, m.www.sha256) == 0, "pulled image, other version");
+    CHECK(fleet_ota_plan(&m, "v1.0.31", other, m.www.sha256) == FLEET_OTA_FIRMWARE, "pulled image, same version, new sha");
+
+    m.firmware.present = false;
+    CHECK(fleet_ota_plan(&m, "v1.0.30", "", m.www.sha256) == 0, "no firmware for the model");
+
+    size_t start = 0;
+    CHECK(fleet_ota_parse_content_range("bytes 1000-1999/2000", &start) && start == 1000, "content range %zu", start);
+    CHECK(!fleet_ota_parse_content_range("bytes */2000", &start), "unsatisfied range accepted");
+    CHECK(!fleet_ota_parse_content_range("items 1-2/3", &start), "other unit accepted");
+}
+
+static void test_delta_manifest()
+{
+    std::vector<uint8_t> base = make_image(1000, 3);
+    std::vector<uint8_t> image = make_image(1200, 4);
+
+    MockMirrorConfig config;
+    config.firmware = image;
+    config.delta = host_delta_make(base, image);
+    config.deltaFrom = sha256_hex(base);
+    MockMirror mirror(config);
+    std::string json = mirror.getManifest();
+
+    fleet_ota_manifest_t m;
+    CHECK(fleet_ota_parse_manifest(json.c_str(), json.size(), "http://mirror.lan", DEVICE_MODEL, "", &m) && !m.delta.present,
+          "delta without a known running image");
+    CHECK(fleet_ota_parse_manifest(json.c_str(), json.size(), "http://mirror.lan", DEVICE_MODEL, sha256_hex(image).c_str(), &m) &&
+              !m.delta.present,
+          "delta from another image");
+    CHECK(fleet_ota_parse_manifest(json.c_str(), json.size(), "http://mirror.lan", DEVICE_MODEL, sha256_hex(base).c_str(), &m) &&
+              m.delta.present && m.delta.size == config.delta.size(),
+          "delta from the running image");
+    CHECK(!strcmp(m.delta.url, "http://mirror.lan/firmware.delta"), "delta url %s", m.delta.url);
+}
+
+// starts the mirror and points the device at it
+static bool start_mirror(MockMirror &mirror, const char *name)
+{
+    if (!mirror.start()) {
+        CHECK(false, "%s: mirror doesn't start", name);
+        return false;
+    }
+    char mirrorUrl[64];
+    snprintf(mirrorUrl, sizeof(mirrorUrl), "http://127.0.0.1:%d/", mirror.getPort());
+    host_device_set_config("ota_mirror", mirrorUrl);
+    return true;
+}
+
+static void test_pull(bool ranges)
+{
+    const char *name = ranges ? "ranges" : "no ranges";
+
+    MockMirrorConfig config;
+    config.port = 0;
+    config.version = "v1.0.99";
+    config.firmware = make_image(1500 * 1000, 1);
+    config.www = make_image(700 * 1000, 2);
+    config.dropAfter = 300 * 1000;
+    config.drops = ranges ? 3 : 1;
+    config.ranges = ranges;
+
+    host_device_reset(make_image(1400 * 1000, 5), "v1.0.98");
+    MockMirror mirror(config);
+    if (!start_mirror(mirror, name)) {
+        return;
+    }
+
+    TestFleetOta fleet;
+    fleet.init();
+    fleet.check(true);
+
+    CHECK(host_device_boot_image() == config.firmware, "%s: firmware differs", name);
+    CHECK(host_device_www(config.www.size()) == config.www, "%s: www differs", name);
+    CHECK(host_device_restarts() == 1, "%s: %d restarts", name, host_device_restarts());
+    CHECK(host_device_get_config("ota_fw_sha") == sha256_hex(config.firmware), "%s: pulled firmware not recorded", name);
+
+    MockMirrorStats stats = mirror.getStats();
+    CHECK(stats.drops == (uint64_t) config.drops, "%s: %llu drops", name, (unsigned long long) stats.drops);
+    if (ranges) {
+        // every cut response is continued, nothing is sent twice
+        CHECK(stats.rangeRequests == stats.drops, "%s: %llu range requests", name, (unsigned long long) stats.rangeRequests);
+        CHECK(stats.bytesSent == config.firmware.size() + config.www.size(), "%s: %llu bytes sent", name,
+              (unsigned long long) stats.bytesSent);
+    }
+    printf("%s: %llu requests, %llu range requests, %llu bytes sent, %llu drops\n", name, (unsigned long long) stats.requests,
+           (unsigned long long) stats.rangeRequests, (unsigned long long) stats.bytesSent, (unsigned long long) stats.drops);
+
+    // the new image reports a version other than the manifest's, it must not
+    // be pulled again after the reboot
+    host_device_reboot("v1.0.99-dirty");
+    TestFleetOta rebooted;
+    rebooted.init();
+    rebooted.check(true);
+
+    MockMirrorStats after = mirror.getStats();
+    CHECK(after.requests == stats.requests + 1, "%s: %llu requests after the reboot", name,
+          (unsigned long long) (after.requests - stats.requests));
+    CHECK(host_device_restarts() == 1, "%s: pulled again after the reboot", name);
+    mirror.stop();
+}
+
+static void test_range_skew()
+{
+    MockMirrorConfig config;
+    config.port = 0;
+    config.version = "v1.0.99";
+    config.firmware = make_image(900 * 1000, 6);
+    config.dropAfter = 300 * 1000;
+    config.drops = 1;
+    config.rangeSkew = 4096;
+
+    host_device_reset(make_image(800 * 1000, 7), "v1.0.98");
+    MockMirror mirror(config);
+    if (!start_mirror(mirror, "skew")) {
+        return;
+    }
+
+    TestFleetOta fleet;
+    fleet.init();
+    fleet.check(true);
+
+    // the misaligned 206 isn't written, the download starts over
+    MockMirrorStats stats = mirror.getStats();
+    CHECK(host_device_boot_image() == config.firmware, "skew: firmware differs");
+    CHECK(stats.rangeRequests == 1, "skew: %llu range requests", (unsigned long long) stats.rangeRequests);
+    mirror.stop();
+}
+
+static void test_delta(bool matchingBase)
+{
+    const char *name = matchingBase ? "delta" : "delta fallback";
+
+    std::vector<uint8_t> base = make_image(1200 * 1000, 8);
+    std::vector<uint8_t> other = make_image(1200 * 1000, 9);
+
+    MockMirrorConfig config;
+    config.port = 0;
+    config.version = "v1.0.99";
+    config.firmware = make_image(1300 * 1000, 10);
+    // a patch that was made from another image doesn't result in the firmware
+    config.delta = host_delta_make(matchingBase ? base : other, config.firmware);
+    config.deltaFrom = sha256_hex(base);
+
+    // the running image was pulled before
+    host_device_reset(base, "v1.0.98");
+    host_device_set_config("ota_fw_sha", sha256_hex(base).c_str());
+    host_device_set_config("ota_fw_part", sha256_hex(base).c_str());
+
+    MockMirror mirror(config);
+    if (!start_mirror(mirror, name)) {
+        return;
+    }
+
+    TestFleetOta fleet;
+    fleet.init();
+    fleet.check(true);
+
+    MockMirrorStats stats = mirror.getStats();
+    CHECK(host_device_boot_image() == config.firmware, "%s: firmware differs", name);
+    CHECK(stats.deltas == 1, "%s: %llu deltas", name, (unsigned long long) stats.deltas);
+    uint64_t expected = config.delta.size() + (matchingBase ? 0 : config.firmware.size());
+    CHECK(stats.bytesSent == expected, "%s: %llu bytes sent, expected %llu", name, (unsigned long long) stats.bytesSent,
+          (unsigned long long) expected);
+    printf("%s: %llu bytes sent for a %zu byte image\n", name, (unsigned long long) stats.bytesSent, config.firmware.size());
+    mirror.stop();
+}
+
+// a browser upload that went away must not keep the flash from the next one
+static void test_stale_session()
+{
+    host_device_reset(make_image(200 * 1000, 9), "v1.0.98");
+    std::vector<uint8_t> image = make_image(100 * 1000, 10);
+
+    OtaWriter browser;
+    OtaWriter puller;
+    CHECK(browser.begin(OtaTarget::FIRMWARE, image.size(), nullptr) == ESP_OK, "stale: first session refused");
+    CHECK(browser.write(image.data(), 4096) == ESP_OK, "stale: first write failed");
+    CHECK(puller.begin(OtaTarget::FIRMWARE, image.size(), nullptr) == ESP_ERR_INVALID_STATE, "stale: live session taken over");
+
+    usleep(OTA_SESSION_TIMEOUT_US + 50000);
+    CHECK(puller.begin(OtaTarget::FIRMWARE, image.size(), sha256_hex(image).c_str()) == ESP_OK, "stale: session not taken over");
+    CHECK(!browser.isActive() && browser.write(image.data(), 4096) == ESP_ERR_INVALID_STATE, "stale: old session still writes");
+    CHECK(puller.write(image.data(), image.size()) == ESP_OK && puller.finish() == ESP_OK, "stale: new session failed");
+    CHECK(host_device_boot_image() == image, "stale: firmware differs");
+}
+
+static void test_fleet()
+{
+    const int devices = 10000;
+    const int staggerMinutes = 60;
+
+    int inRollout = 0;
+    int buckets[4] = {};
+    for (int i = 0; i < devices; i++) {
+        // MACs of one production batch only differ in the last bytes
+        uint8_t mac[6] = {0x48, 0x27, 0xe2, 0x10, (uint8_t) (i >> 8), (uint8_t) i};
+        uint32_t slot = fleet_ota_device_slot(mac);
+
+        inRollout += fleet_ota_in_rollout(slot, 20);
+        CHECK(fleet_ota_in_rollout(slot, 100) && !fleet_ota_in_rollout(slot, 0), "slot %u", slot);
+
+        int delay = fleet_ota_stagger_delay_s(slot, staggerMinutes);
+        CHECK(delay >= 0 && delay < staggerMinutes * 60, "delay %d", delay);
+        buckets[delay * 4 / (staggerMinutes * 60)]++;
+    }
+
+    CHECK(inRollout > devices * 18 / 100 && inRollout < devices * 22 / 100, "%d of %d in a 20%% rollout", inRollout, devices);
+    for (int i = 0; i < 4; i++) {
+        CHECK(buckets[i] > devices * 22 / 100 && buckets[i] < devices * 28 / 100, "stagger quarter %d has %d devices", i,
+              buckets[i]);
+    }
+    printf("fleet: %d of %d in a 20%% rollout, stagger quarters %d/%d/%d/%d\n", inRollout, devices, buckets[0], buckets[1],
+           buckets[2], buckets[3]);
+}
+
+int main()
+{
+    test_manifest();
+    test_plan();
+    test_delta_manifest();
+    test_pull(true);
+    test_pull(false);
+    test_range_skew();
+    test_delta(true);
+    test_delta(false);
+    test_stale_session();
+    test_fleet();
+
+    if (s_failures) {
+        printf("%d failures\n", s_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,408 @@
+#include <map>
+#include <mutex>
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_delta_ota.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "global_state.h"
+#include "host_device.h"
+#include "mbedtls/sha256.h"
+#include "nvs_config.h"
+#include "spi_flash_mmap.h"
+
+// The device side of the fleet OTA selftest, see host_device.h
+
+#define APP_PARTITION_SIZE (2 * 1024 * 1024)
+#define WWW_PARTITION_SIZE (1024 * 1024)
+
+typedef struct
+{
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+    size_t imageSize; // app partitions
+} host_partition_t;
+
+typedef struct
+{
+    bool active;
+    int partition;
+    size_t offset;
+    size_t erasedUntil;
+} host_ota_t;
+
+static std::mutex s_lock;
+static host_partition_t s_partitions[3];
+static int s_running = 0;
+static int s_boot = 0;
+static host_ota_t s_ota;
+static esp_app_desc_t s_appDesc;
+static int s_restarts = 0;
+static std::map<std::string, std::string> s_config;
+
+System SYSTEM_MODULE;
+PowerManagementTask POWER_MANAGEMENT_MODULE;
+
+static void initPartition(host_partition_t *partition, esp_partition_type_t type, esp_partition_subtype_t subtype,
+                          uint32_t address, uint32_t size, const char *label)
+{
+    partition->info.type = type;
+    partition->info.subtype = subtype;
+    partition->info.address = address;
+    partition->info.size = size;
+    strlcpy(partition->info.label, label, sizeof(partition->info.label));
+    partition->data.assign(size, 0xff);
+    partition->imageSize = 0;
+}
+
+static host_partition_t *find(const esp_partition_t *partition)
+{
+    for (auto &p : s_partitions) {
+        if (&p.info == partition) {
+            return &p;
+        }
+    }
+    return nullptr;
+}
+
+void host_device_reset(const std::vector<uint8_t> &image, const char *version)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    initPartition(&s_partitions[0], ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, APP_PARTITION_SIZE, "ota_0");
+    initPartition(&s_partitions[1], ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x10000 + APP_PARTITION_SIZE,
+                  APP_PARTITION_SIZE, "ota_1");
+    initPartition(&s_partitions[2], ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x10000 + 2 * APP_PARTITION_SIZE,
+                  WWW_PARTITION_SIZE, "www");
+    memcpy(s_partitions[0].data.data(), image.data(), image.size());
+    s_partitions[0].imageSize = image.size();
+    s_running = s_boot = 0;
+    s_ota = {};
+    s_restarts = 0;
+    s_config.clear();
+    strlcpy(s_appDesc.version, version, sizeof(s_appDesc.version));
+    strlcpy(s_appDesc.project_name, "esp-miner", sizeof(s_appDesc.project_name));
+}
+
+std::vector<uint8_t> host_device_boot_image()
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    const host_partition_t *p = &s_partitions[s_boot];
+    return std::vector<uint8_t>(p->data.begin(), p->data.begin() + p->imageSize);
+}
+
+std::vector<uint8_t> host_device_www(size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    return std::vector<uint8_t>(s_partitions[2].data.begin(), s_partitions[2].data.begin() + size);
+}
+
+void host_device_reboot(const char *version)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_running = s_boot;
+    strlcpy(s_appDesc.version, version, sizeof(s_appDesc.version));
+}
+
+int host_device_restarts()
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    return s_restarts;
+}
+
+void host_device_set_config(const char *key, const char *value)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_config[key] = value;
+}
+
+std::string host_device_get_config(const char *key)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    auto it = s_config.find(key);
+    return it == s_config.end() ? "" : it->second;
+}
+
+// partition
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    for (auto &p : s_partitions) {
+        if (p.info.type == type && (subtype == ESP_PARTITION_SUBTYPE_ANY || p.info.subtype == subtype) &&
+            (!label || !strcmp(p.info.label, label))) {
+            return &p.info;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    if (!p || src_offset + size > p->data.size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, p->data.data() + src_offset, size);
+    return ESP_OK;
+}
+
+// NOR flash: bits only go from 1 to 0 without an erase
+static esp_err_t writeLocked(host_partition_t *p, size_t offset, const void *src, size_t size)
+{
+    if (offset + size > p->data.size()) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *data = (const uint8_t *) src;
+    for (size_t i = 0; i < size; i++) {
+        if ((p->data[offset + i] & data[i]) != data[i]) {
+            return ESP_FAIL;
+        }
+        p->data[offset + i] = data[i];
+    }
+    return ESP_OK;
+}
+
+static esp_err_t eraseLocked(host_partition_t *p, size_t offset, size_t size)
+{
+    if (offset % SPI_FLASH_SEC_SIZE || size % SPI_FLASH_SEC_SIZE || offset + size > p->data.size()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(p->data.data() + offset, 0xff, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    return p ? writeLocked(p, dst_offset, src, size) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    return p ? eraseLocked(p, offset, size) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t *partition, uint8_t *sha_256)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    if (!p) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t size = (p->info.type == ESP_PARTITION_TYPE_APP) ? p->imageSize : p->data.size();
+    if (!size) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    mbedtls_sha256(p->data.data(), size, sha_256, 0);
+    return ESP_OK;
+}
+
+// app update
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    return &s_partitions[s_running].info;
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    return &s_partitions[s_boot].info;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    (void) start_from;
+    std::lock_guard<std::mutex> lock(s_lock);
+    return &s_partitions[s_running ^ 1].info;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    if (!p || p == &s_partitions[s_running] || p->info.type != ESP_PARTITION_TYPE_APP) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (image_size != OTA_WITH_SEQUENTIAL_WRITES) {
+        eraseLocked(p, 0, p->data.size());
+    }
+    p->imageSize = 0;
+    s_ota.active = true;
+    s_ota.partition = (int) (p - s_partitions);
+    s_ota.offset = 0;
+    s_ota.erasedUntil = (image_size == OTA_WITH_SEQUENTIAL_WRITES) ? 0 : p->data.size();
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    if (handle != 1 || !s_ota.active) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_partition_t *p = &s_partitions[s_ota.partition];
+    while (s_ota.erasedUntil < s_ota.offset + size && s_ota.erasedUntil < p->data.size()) {
+        eraseLocked(p, s_ota.erasedUntil, SPI_FLASH_SEC_SIZE);
+        s_ota.erasedUntil += SPI_FLASH_SEC_SIZE;
+    }
+    esp_err_t err = writeLocked(p, s_ota.offset, data, size);
+    if (err == ESP_OK) {
+        s_ota.offset += size;
+    }
+    return err;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    if (handle != 1 || !s_ota.active || !s_ota.offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_partitions[s_ota.partition].imageSize = s_ota.offset;
+    s_ota.active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    if (handle != 1 || !s_ota.active) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_ota.active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    host_partition_t *p = find(partition);
+    if (!p || !p->imageSize) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_boot = (int) (p - s_partitions);
+    return ESP_OK;
+}
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    return &s_appDesc;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    (void) type;
+    static const uint8_t hostMac[6] = {0x48, 0x27, 0xe2, 0x10, 0x00, 0x01};
+    memcpy(mac, hostMac, sizeof(hostMac));
+    return ESP_OK;
+}
+
+// delta, the patch is the image XORed with the base as it is in the
+// partition (erased flash behind the image)
+
+typedef struct
+{
+    esp_delta_ota_cfg_t cfg;
+    size_t offset;
+} host_delta_t;
+
+std::vector<uint8_t> host_delta_make(const std::vector<uint8_t> &base, const std::vector<uint8_t> &image)
+{
+    std::vector<uint8_t> patch(image.size());
+    for (size_t i = 0; i < image.size(); i++) {
+        patch[i] = image[i] ^ (i < base.size() ? base[i] : 0xff);
+    }
+    return patch;
+}
+
+esp_delta_ota_handle_t esp_delta_ota_init(esp_delta_ota_cfg_t *cfg)
+{
+    if (!cfg || !cfg->read_cb || !cfg->write_cb) {
+        return nullptr;
+    }
+    host_delta_t *delta = new host_delta_t();
+    delta->cfg = *cfg;
+    return delta;
+}
+
+esp_err_t esp_delta_ota_feed_patch(esp_delta_ota_handle_t handle, const uint8_t *buf, int size)
+{
+    host_delta_t *delta = (host_delta_t *) handle;
+    std::vector<uint8_t> out(size);
+    esp_err_t err = delta->cfg.read_cb(out.data(), size, (int) delta->offset);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < size; i++) {
+        out[i] ^= buf[i];
+    }
+    err = delta->cfg.write_cb(out.data(), size, delta->cfg.user_data);
+    if (err == ESP_OK) {
+        delta->offset += size;
+    }
+    return err;
+}
+
+esp_err_t esp_delta_ota_finalize(esp_delta_ota_handle_t handle)
+{
+    return handle ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_delta_ota_deinit(esp_delta_ota_handle_t handle)
+{
+    delete (host_delta_t *) handle;
+    return ESP_OK;
+}
+
+// board and power management
+
+const char *Board::getDeviceModel()
+{
+    return "NerdQAxe++";
+}
+
+void PowerManagementTask::restart()
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_restarts++;
+}
+
+// settings
+
+namespace Config {
+
+void beginBatch()
+{
+}
+
+void commitBatch()
+{
+}
+
+StringRef::StringRef(const char *key, const char *default_value)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    auto it = s_config.find(key);
+    m_value = (it == s_config.end()) ? default_value : it->second;
+}
+
+char *nvs_config_get_string(const char *key, const char *default_value)
+{
+    StringRef value(key, default_value);
+    return strdup(value.c_str());
+}
+
+void nvs_config_set_string(const char *key, const char *value)
+{
+    std::lock_guard<std::mutex> lock(s_lock);
+    s_config[key] = value;
+}
+
+} // namespace Config
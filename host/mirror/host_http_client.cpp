@@ -0,0 +1,198 @@
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "esp_http_client.h"
+
+// HTTP/1.1 client over a blocking socket, one request per connection like
+// the firmware's pull uses it
+
+struct esp_http_client
+{
+    std::string host;
+    int port = 80;
+    std::string path;
+    int timeoutMs = 10000;
+    http_event_handle_cb handler = nullptr;
+    void *userData = nullptr;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    int fd = -1;
+    int status = 0;
+    int64_t contentLength = -1;
+    int64_t received = 0;
+    std::string pending; // body that came with the headers
+};
+
+static bool parseUrl(const char *url, esp_http_client *client)
+{
+    const char *p = url;
+    if (!strncmp(p, "http://", 7)) {
+        p += 7;
+    } else if (strstr(p, "://")) {
+        return false;
+    }
+    const char *slash = strchr(p, '/');
+    std::string hostPort = slash ? std::string(p, slash - p) : std::string(p);
+    client->path = slash ? slash : "/";
+
+    size_t colon = hostPort.find(':');
+    if (colon != std::string::npos) {
+        client->port = atoi(hostPort.c_str() + colon + 1);
+        hostPort.resize(colon);
+    }
+    client->host = hostPort;
+    return !client->host.empty() && client->port > 0;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client *client = new esp_http_client();
+    if (!config->url || !parseUrl(config->url, client)) {
+        delete client;
+        return nullptr;
+    }
+    if (config->timeout_ms) {
+        client->timeoutMs = config->timeout_ms;
+    }
+    client->handler = config->event_handler;
+    client->userData = config->user_data;
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    client->headers.emplace_back(key, value);
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    (void) write_len;
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", client->port);
+    if (getaddrinfo(client->host.c_str(), port, &hints, &res) || !res) {
+        return ESP_FAIL;
+    }
+
+    client->fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval tv = {client->timeoutMs / 1000, (client->timeoutMs % 1000) * 1000};
+    setsockopt(client->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    bool connected = client->fd >= 0 && !connect(client->fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (!connected) {
+        return ESP_FAIL;
+    }
+
+    std::string request = "GET " + client->path + " HTTP/1.1\r\nHost: " + client->host + "\r\n";
+    for (auto &header : client->headers) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "Connection: close\r\n\r\n";
+    if (send(client->fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t) request.size()) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    std::string head;
+    char buf[1024];
+    size_t end;
+    while ((end = head.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(client->fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+            return -1;
+        }
+        head.append(buf, n);
+    }
+    client->pending = head.substr(end + 4);
+    head.resize(end + 2);
+
+    size_t lineEnd = head.find("\r\n");
+    if (sscanf(head.c_str(), "HTTP/1.%*d %d", &client->status) != 1) {
+        return -1;
+    }
+    for (size_t pos = lineEnd + 2; pos < head.size(); pos = lineEnd + 2) {
+        lineEnd = head.find("\r\n", pos);
+        std::string line = head.substr(pos, lineEnd - pos);
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, colon);
+        std::string value = line.substr(line.find_first_not_of(' ', colon + 1));
+        if (!strcasecmp(key.c_str(), "Content-Length")) {
+            client->contentLength = atoll(value.c_str());
+        }
+        if (client->handler) {
+            esp_http_client_event_t evt = {};
+            evt.event_id = HTTP_EVENT_ON_HEADER;
+            evt.client = client;
+            evt.user_data = client->userData;
+            evt.header_key = &key[0];
+            evt.header_value = &value[0];
+            client->handler(&evt);
+        }
+    }
+    return client->contentLength < 0 ? 0 : client->contentLength;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (client->contentLength >= 0 && client->received + len > client->contentLength) {
+        len = (int) (client->contentLength - client->received);
+    }
+    if (len <= 0) {
+        return 0;
+    }
+
+    int n;
+    if (!client->pending.empty()) {
+        n = std::min<int>(len, (int) client->pending.size());
+        memcpy(buffer, client->pending.data(), n);
+        client->pending.erase(0, n);
+    } else {
+        n = (int) recv(client->fd, buffer, len, 0);
+        if (n < 0) {
+            return -1;
+        }
+    }
+    client->received += n;
+    return n;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    delete client;
+    return ESP_OK;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Host replacement of the app description, the version is set by the test
+// (host_device.h)
+
+typedef struct
+{
+    char version[32];
+    char project_name[32];
+} esp_app_desc_t;
+
+const esp_app_desc_t *esp_app_get_description(void);
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// Host stand-in for esp_delta_ota. detools isn't built for the host, the
+// patch is the new image XORed with the base, which is enough to run the
+// firmware's delta path: the base is read through read_cb and the result
+// goes out through write_cb as it is decoded. host_delta_make builds one.
+
+typedef esp_err_t (*src_read_cb_t)(uint8_t *buf_p, size_t size, int src_offset);
+typedef esp_err_t (*merged_stream_write_cb_t)(const uint8_t *buf_p, size_t size, void *user_data);
+
+typedef struct
+{
+    void *user_data;
+    src_read_cb_t read_cb;
+    merged_stream_write_cb_t write_cb;
+} esp_delta_ota_cfg_t;
+
+typedef void *esp_delta_ota_handle_t;
+
+esp_delta_ota_handle_t esp_delta_ota_init(esp_delta_ota_cfg_t *cfg);
+esp_err_t esp_delta_ota_feed_patch(esp_delta_ota_handle_t handle, const uint8_t *buf, int size);
+esp_err_t esp_delta_ota_finalize(esp_delta_ota_handle_t handle);
+esp_err_t esp_delta_ota_deinit(esp_delta_ota_handle_t handle);
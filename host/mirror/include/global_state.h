@@ -0,0 +1,29 @@
+#pragma once
+
+// Host replacement of main/global_state.h for the fleet OTA pull, only the
+// board model and the restart after a firmware update
+
+class Board {
+  public:
+    const char *getDeviceModel();
+};
+
+class System {
+  protected:
+    Board m_board;
+
+  public:
+    Board *getBoard()
+    {
+        return &m_board;
+    }
+};
+
+class PowerManagementTask {
+  public:
+    // counted, see host_device.h
+    void restart();
+};
+
+extern System SYSTEM_MODULE;
+extern PowerManagementTask POWER_MANAGEMENT_MODULE;
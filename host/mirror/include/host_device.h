@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Controls of the device the fleet OTA selftest runs FleetOta against:
+// flash with ota_0, ota_1 and www, the app version and the settings.
+
+// fresh flash, the device runs image from ota_0
+void host_device_reset(const std::vector<uint8_t> &image, const char *version);
+
+// what was activated, the running image until an update was finished
+std::vector<uint8_t> host_device_boot_image();
+std::vector<uint8_t> host_device_www(size_t size);
+
+// the next boot: the activated image runs with the version
+void host_device_reboot(const char *version);
+
+int host_device_restarts();
+
+void host_device_set_config(const char *key, const char *value);
+std::string host_device_get_config(const char *key);
+
+// patch for the host esp_delta_ota
+std::vector<uint8_t> host_delta_make(const std::vector<uint8_t> &base, const std::vector<uint8_t> &image);
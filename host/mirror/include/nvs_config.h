@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Host replacement of main/nvs_config.h with the settings of the fleet OTA
+// pull, kept in memory (host_device.cpp)
+
+namespace Config {
+
+void beginBatch();
+void commitBatch();
+
+class StringRef {
+  protected:
+    std::string m_value;
+
+  public:
+    StringRef(const char *key, const char *default_value);
+
+    const char *c_str() const
+    {
+        return m_value.c_str();
+    }
+};
+
+char *nvs_config_get_string(const char *key, const char *default_value);
+void nvs_config_set_string(const char *key, const char *value);
+
+inline char *getOtaMirrorURL()
+{
+    return nvs_config_get_string("ota_mirror", "");
+}
+inline uint16_t getOtaPullInterval()
+{
+    return 60;
+}
+inline void setOtaWwwSha(const char *value)
+{
+    nvs_config_set_string("ota_www_sha", value);
+}
+inline void setOtaFwSha(const char *value)
+{
+    nvs_config_set_string("ota_fw_sha", value);
+}
+inline void setOtaFwPartSha(const char *value)
+{
+    nvs_config_set_string("ota_fw_part", value);
+}
+inline StringRef refOtaWwwSha()
+{
+    return StringRef("ota_www_sha", "");
+}
+inline StringRef refOtaFwSha()
+{
+    return StringRef("ota_fw_sha", "");
+}
+inline StringRef refOtaFwPartSha()
+{
+    return StringRef("ota_fw_part", "");
+}
+
+} // namespace Config
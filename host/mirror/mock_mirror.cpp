@@ -0,0 +1,271 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "mbedtls/sha256.h"
+
+#include "mock_mirror.h"
+
+static const char *TAG = "mock_mirror";
+
+#define MAX_REQUEST 4096
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+static void send_status(int fd, const char *status)
+{
+    char head[128];
+    int len = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    send_all(fd, head, len);
+}
+
+MockMirror::MockMirror(const MockMirrorConfig &config) : m_config(config)
+{
+    m_dropsLeft = config.dropAfter ? config.drops : 0;
+}
+
+MockMirror::~MockMirror()
+{
+    stop();
+}
+
+std::string MockMirror::sha256Hex(const std::vector<uint8_t> &data)
+{
+    uint8_t hash[32];
+    mbedtls_sha256(data.data(), data.size(), hash, 0);
+
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", hash[i]);
+    }
+    return hex;
+}
+
+std::string MockMirror::getManifest()
+{
+    char buf[256];
+    std::string json = "{";
+    snprintf(buf, sizeof(buf), "\"version\":\"%s\",\"rolloutPercent\":%d,\"staggerMinutes\":%d", m_config.version.c_str(),
+             m_config.rolloutPercent, m_config.staggerMinutes);
+    json += buf;
+    if (!m_config.firmware.empty()) {
+        snprintf(buf, sizeof(buf), ",\"firmware\":{\"%s\":{\"url\":\"firmware.bin\",\"size\":%zu,\"sha256\":\"%s\"",
+                 m_config.deviceModel.c_str(), m_config.firmware.size(), sha256Hex(m_config.firmware).c_str());
+        json += buf;
+        if (!m_config.delta.empty()) {
+            snprintf(buf, sizeof(buf), ",\"deltas\":[{\"from\":\"%s\",\"url\":\"firmware.delta\",\"size\":%zu}]",
+                     m_config.deltaFrom.c_str(), m_config.delta.size());
+            json += buf;
+        }
+        json += "}}";
+    }
+    if (!m_config.www.empty()) {
+        snprintf(buf, sizeof(buf), ",\"www\":{\"url\":\"/www.bin\",\"size\":%zu,\"sha256\":\"%s\"}", m_config.www.size(),
+                 sha256Hex(m_config.www).c_str());
+        json += buf;
+    }
+    json += "}";
+    return json;
+}
+
+MockMirrorStats MockMirror::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
+
+bool MockMirror::start()
+{
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenFd < 0) {
+        ESP_LOGE(TAG, "socket: %s", strerror(errno));
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.bindAddress, &addr.sin_addr) != 1) {
+        ESP_LOGE(TAG, "invalid bind address %s", m_config.bindAddress);
+        return false;
+    }
+
+    if (bind(m_listenFd, (struct sockaddr *) &addr, sizeof(addr)) || listen(m_listenFd, 16)) {
+        ESP_LOGE(TAG, "bind %s:%d: %s", m_config.bindAddress, m_config.port, strerror(errno));
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(m_listenFd, (struct sockaddr *) &addr, &len);
+    m_port = ntohs(addr.sin_port);
+
+    m_running = true;
+    m_acceptThread = std::thread(&MockMirror::acceptLoop, this);
+
+    ESP_LOGI(TAG, "listening on %s:%d", m_config.bindAddress, m_port);
+    return true;
+}
+
+void MockMirror::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    shutdown(m_listenFd, SHUT_RDWR);
+    close(m_listenFd);
+    m_acceptThread.join();
+}
+
+// one request per connection, the devices download one image at a time
+void MockMirror::acceptLoop()
+{
+    pthread_setname_np(pthread_self(), "mirror-accept");
+
+    while (m_running) {
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        serve(fd);
+        close(fd);
+    }
+}
+
+void MockMirror::sendImage(int fd, const std::vector<uint8_t> &image, size_t start)
+{
+    char head[256];
+    int len;
+    if (start && m_config.rangeSkew) {
+        start = start > m_config.rangeSkew ? start - m_config.rangeSkew : 0;
+    }
+    if (start) {
+        len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 206 Partial Content\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\n"
+                       "Content-Range: bytes %zu-%zu/%zu\r\nConnection: close\r\n\r\n",
+                       image.size() - start, start, image.size() - 1, image.size());
+    } else {
+        len = snprintf(head, sizeof(head),
+                       "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\n"
+                       "Accept-Ranges: %s\r\nConnection: close\r\n\r\n",
+                       image.size(), m_config.ranges ? "bytes" : "none");
+    }
+    if (!send_all(fd, head, len)) {
+        return;
+    }
+
+    size_t end = image.size();
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_dropsLeft && end - start > m_config.dropAfter) {
+            m_dropsLeft--;
+            m_stats.drops++;
+            end = start + m_config.dropAfter;
+        }
+    }
+
+    if (send_all(fd, image.data() + start, end - start)) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.bytesSent += end - start;
+    }
+}
+
+void MockMirror::serve(int fd)
+{
+    char request[MAX_REQUEST];
+    size_t len = 0;
+    while (len < sizeof(request) - 1) {
+        ssize_t n = recv(fd, request + len, sizeof(request) - 1 - len, 0);
+        if (n <= 0) {
+            return;
+        }
+        len += (size_t) n;
+        request[len] = 0;
+        if (strstr(request, "\r\n\r\n")) {
+            break;
+        }
+    }
+
+    char method[8], path[256];
+    if (sscanf(request, "%7s %255s", method, path) != 2 || strcmp(method, "GET")) {
+        send_status(fd, "400 Bad Request");
+        return;
+    }
+
+    size_t start = 0;
+    const char *range = strcasestr(request, "\r\nRange: bytes=");
+    if (range && m_config.ranges) {
+        start = strtoul(range + strlen("\r\nRange: bytes="), nullptr, 10);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.requests++;
+        if (start) {
+            m_stats.rangeRequests++;
+        }
+    }
+
+    const std::vector<uint8_t> *image = nullptr;
+    if (!strcmp(path, "/manifest.json")) {
+        std::string manifest = getManifest();
+        char head[128];
+        int headLen = snprintf(head, sizeof(head),
+                               "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                               "Connection: close\r\n\r\n",
+                               manifest.size());
+        if (send_all(fd, head, headLen)) {
+            send_all(fd, manifest.data(), manifest.size());
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.manifests++;
+        return;
+    } else if (!strcmp(path, "/firmware.bin") && !m_config.firmware.empty()) {
+        image = &m_config.firmware;
+    } else if (!strcmp(path, "/www.bin") && !m_config.www.empty()) {
+        image = &m_config.www;
+    } else if (!strcmp(path, "/firmware.delta") && !m_config.delta.empty()) {
+        image = &m_config.delta;
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.deltas++;
+    }
+
+    if (!image) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.notFound++;
+        send_status(fd, "404 Not Found");
+        return;
+    }
+    if (start >= image->size()) {
+        send_status(fd, "416 Range Not Satisfiable");
+        return;
+    }
+    sendImage(fd, *image, start);
+}
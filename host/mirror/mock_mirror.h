@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local update mirror for the fleet OTA pull (main/tasks/fleet_ota_task).
+//
+// Serves /manifest.json, built from the configured version and images with
+// their size and SHA-256, and the images at /firmware.bin and /www.bin with
+// Range support (206 Partial Content). A firmware delta is served at
+// /firmware.delta. A device is pointed at it with the
+// otaMirrorURL setting, e.g. http://192.168.1.10:8080/.
+//
+// Faults that can be injected:
+//   - the first N image responses are cut after a number of bytes, the
+//     client has to continue with a Range request
+//   - Range requests are ignored (200 with the whole image)
+//   - 206 responses start before the requested offset
+
+typedef struct
+{
+    const char *bindAddress = "127.0.0.1";
+    int port = 8080; // 0 binds to any free port, see getPort
+
+    std::string version = "v0.0.0";
+    std::string deviceModel = "NerdQAxe++";
+    int rolloutPercent = 100;
+    int staggerMinutes = 0;
+
+    // empty images are left out of the manifest
+    std::vector<uint8_t> firmware;
+    std::vector<uint8_t> www;
+
+    // patch to the firmware from the image with the deltaFrom sha256
+    std::vector<uint8_t> delta;
+    std::string deltaFrom;
+
+    size_t dropAfter = 0; // bytes, 0 = off
+    int drops = 1;        // responses that are cut
+    bool ranges = true;
+    size_t rangeSkew = 0; // bytes a 206 response starts early
+} MockMirrorConfig;
+
+typedef struct
+{
+    uint64_t requests;
+    uint64_t manifests;
+    uint64_t rangeRequests;
+    uint64_t deltas;
+    uint64_t bytesSent;
+    uint64_t drops;
+    uint64_t notFound;
+} MockMirrorStats;
+
+class MockMirror {
+  protected:
+    MockMirrorConfig m_config;
+    int m_listenFd = -1;
+    int m_port = 0;
+
+    std::atomic<bool> m_running{false};
+    std::thread m_acceptThread;
+
+    std::mutex m_lock;
+    MockMirrorStats m_stats = {};
+    int m_dropsLeft = 0;
+
+    void acceptLoop();
+    void serve(int fd);
+    void sendImage(int fd, const std::vector<uint8_t> &image, size_t start);
+
+  public:
+    MockMirror(const MockMirrorConfig &config);
+    ~MockMirror();
+
+    bool start();
+    void stop();
+
+    int getPort()
+    {
+        return m_port;
+    }
+
+    std::string getManifest();
+    MockMirrorStats getStats();
+
+    static std::string sha256Hex(const std::vector<uint8_t> &data);
+};
@@ -0,0 +1,158 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mock_mirror.h"
+
+// Standalone update mirror for the fleet OTA pull:
+//
+//   ./mock_mirror --bind 0.0.0.0 --port 8080 --version v1.0.99 --firmware esp-miner.bin --www www.bin
+//
+// and set otaMirrorURL of the miners to http://<host>:8080/.
+
+static volatile bool s_running = true;
+
+static void on_signal(int)
+{
+    s_running = false;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--bind ADDR] [--port N] [--version V] [--model M] [--firmware FILE] [--www FILE]\n"
+            "          [--delta FILE --delta-from SHA256] [--rollout PCT] [--stagger MIN] [--drop-after BYTES]\n"
+            "          [--drops N] [--no-ranges] [--range-skew BYTES]\n",
+            name);
+}
+
+static bool read_file(const char *path, std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static void print_stats(MockMirror &mirror)
+{
+    MockMirrorStats stats = mirror.getStats();
+    printf("%llu requests, %llu manifests, %llu range requests, %llu deltas, %llu bytes sent, %llu drops, %llu not found\n",
+           (unsigned long long) stats.requests, (unsigned long long) stats.manifests, (unsigned long long) stats.rangeRequests,
+           (unsigned long long) stats.deltas, (unsigned long long) stats.bytesSent, (unsigned long long) stats.drops,
+           (unsigned long long) stats.notFound);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    MockMirrorConfig config;
+
+    static const struct option options[] = {
+        {"bind", required_argument, nullptr, 'b'},
+        {"port", required_argument, nullptr, 'p'},
+        {"version", required_argument, nullptr, 'v'},
+        {"model", required_argument, nullptr, 'm'},
+        {"firmware", required_argument, nullptr, 'f'},
+        {"www", required_argument, nullptr, 'w'},
+        {"delta", required_argument, nullptr, 'D'},
+        {"delta-from", required_argument, nullptr, 'F'},
+        {"rollout", required_argument, nullptr, 'r'},
+        {"stagger", required_argument, nullptr, 's'},
+        {"drop-after", required_argument, nullptr, 'd'},
+        {"drops", required_argument, nullptr, 'n'},
+        {"no-ranges", no_argument, nullptr, 'R'},
+        {"range-skew", required_argument, nullptr, 'k'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:p:v:m:f:w:D:F:r:s:d:n:Rk:", options, nullptr)) != -1) {
+        switch (opt) {
+        case 'b':
+            config.bindAddress = optarg;
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'v':
+            config.version = optarg;
+            break;
+        case 'm':
+            config.deviceModel = optarg;
+            break;
+        case 'f':
+            if (!read_file(optarg, config.firmware)) {
+                return 1;
+            }
+            break;
+        case 'w':
+            if (!read_file(optarg, config.www)) {
+                return 1;
+            }
+            break;
+        case 'D':
+            if (!read_file(optarg, config.delta)) {
+                return 1;
+            }
+            break;
+        case 'F':
+            config.deltaFrom = optarg;
+            break;
+        case 'r':
+            config.rolloutPercent = atoi(optarg);
+            break;
+        case 's':
+            config.staggerMinutes = atoi(optarg);
+            break;
+        case 'd':
+            config.dropAfter = strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            config.drops = atoi(optarg);
+            break;
+        case 'R':
+            config.ranges = false;
+            break;
+        case 'k':
+            config.rangeSkew = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    MockMirror mirror(config);
+    if (!mirror.start()) {
+        return 1;
+    }
+    printf("http://%s:%d/\n%s\n", config.bindAddress, mirror.getPort(), mirror.getManifest().c_str());
+    fflush(stdout);
+
+    int ticks = 0;
+    while (s_running) {
+        usleep(100 * 1000);
+        if (++ticks % 100 == 0) {
+            print_stats(mirror);
+        }
+    }
+
+    mirror.stop();
+    print_stats(mirror);
+    return 0;
+}
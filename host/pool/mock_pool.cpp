@@ -0,0 +1,674 @@
+#include <arpa/inet.h>
+#include <array>
+#include <deque>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <random>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ArduinoJson.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/sha256.h"
+
+#include "mock_pool.h"
+
+static const char *TAG = "mock_pool";
+
+#define MAX_JOBS 16
+#define MAX_LINE 16384
+#define RECONNECT_GRACE_US 500000
+
+// 0x00000000FFFF0000000000000000000000000000000000000000000000000000
+static const double truediffone = 26959535291011309493156476344723991336010898738574164086137773096960.0;
+
+// nbits of a 2024 block, only used to fill the header
+static const uint32_t NBITS = 0x17034219;
+static const uint32_t VERSION = 0x20000000;
+
+// stratum error codes
+#define ERR_OTHER 20
+#define ERR_JOB_NOT_FOUND 21
+#define ERR_DUPLICATE 22
+#define ERR_LOW_DIFFICULTY 23
+
+typedef struct
+{
+    std::string id;
+    uint8_t prevBlockHash[32]; // header byte order
+    std::string coinbase1;
+    std::string coinbase2;
+    std::vector<std::array<uint8_t, 32>> branches;
+    uint32_t version;
+    uint32_t ntime;
+    double difficulty;
+} pool_job_t;
+
+static void double_sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    uint8_t first[32];
+    mbedtls_sha256(data, len, first, 0);
+    mbedtls_sha256(first, 32, out, 0);
+}
+
+static std::string to_hex(const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(len * 2);
+    for (size_t i = 0; i < len; i++) {
+        hex += digits[data[i] >> 4];
+        hex += digits[data[i] & 0x0f];
+    }
+    return hex;
+}
+
+static bool from_hex(const std::string &hex, std::vector<uint8_t> &out)
+{
+    if (hex.size() & 1) {
+        return false;
+    }
+    out.resize(hex.size() / 2);
+    for (size_t i = 0; i < out.size(); i++) {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], 0};
+        char *end;
+        out[i] = (uint8_t) strtoul(byte, &end, 16);
+        if (*end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_hex32(const char *str, uint32_t *value)
+{
+    if (!str || !*str || strlen(str) > 8) {
+        return false;
+    }
+    char *end;
+    *value = (uint32_t) strtoul(str, &end, 16);
+    return !*end;
+}
+
+// little endian 256 bit number to double
+static double le256_to_double(const uint8_t hash[32])
+{
+    double value = 0.0;
+    for (int i = 31; i >= 0; i--) {
+        value = value * 256.0 + hash[i];
+    }
+    return value;
+}
+
+class MockPool::Client {
+  protected:
+    MockPool *m_pool;
+    int m_fd;
+    std::mt19937 m_rng;
+
+    std::string m_rx;
+    std::string m_extranonce1;
+    bool m_subscribed = false;
+    bool m_authorized = false;
+
+    std::deque<pool_job_t> m_jobs;
+    std::set<std::string> m_submitted;
+    uint8_t m_prevBlockHash[32];
+    size_t m_difficultyIndex = 0;
+    int m_notifies = 0;
+
+    int64_t m_nextNotify = 0;
+    int64_t m_reconnectAt = 0;
+    int64_t m_closeAt = 0;
+
+    typedef struct
+    {
+        int64_t due;
+        int64_t received;
+        std::string line;
+    } response_t;
+    std::deque<response_t> m_responses;
+
+    bool sendLine(const std::string &line);
+    void respond(int64_t id, int64_t received, bool delayable, const std::string &result, const std::string &error);
+    void handleLine(const std::string &line, int64_t received);
+    void handleSubmit(JsonDocument &doc, int64_t id, int64_t received);
+    void sendNotify();
+    void sendMalformed();
+    double difficulty()
+    {
+        return m_pool->m_config.difficulties[m_difficultyIndex];
+    }
+
+  public:
+    Client(MockPool *pool, int fd, uint32_t seed);
+    void run();
+};
+
+MockPool::Client::Client(MockPool *pool, int fd, uint32_t seed) : m_pool(pool), m_fd(fd), m_rng(seed)
+{
+    char enonce1[9];
+    snprintf(enonce1, sizeof(enonce1), "%08x", pool->m_extranonce1.fetch_add(1) + 0x1000);
+    m_extranonce1 = enonce1;
+
+    for (uint8_t &b : m_prevBlockHash) {
+        b = (uint8_t) m_rng();
+    }
+}
+
+bool MockPool::Client::sendLine(const std::string &line)
+{
+    std::string data = line + "\n";
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(m_fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+void MockPool::Client::respond(int64_t id, int64_t received, bool delayable, const std::string &result, const std::string &error)
+{
+    std::string line = "{\"id\":" + std::to_string(id) + ",\"result\":" + result + ",\"error\":" + error + "}";
+
+    int64_t due = received;
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (delayable && m_pool->m_config.slowResponseProbability > 0.0 &&
+        chance(m_rng) < m_pool->m_config.slowResponseProbability) {
+        due += (int64_t) m_pool->m_config.slowResponseMs * 1000;
+        std::lock_guard<std::mutex> lock(m_pool->m_lock);
+        m_pool->m_stats.slowResponses++;
+    }
+
+    // responses leave in due order, a delayed one can be overtaken
+    auto it = m_responses.begin();
+    while (it != m_responses.end() && it->due <= due) {
+        ++it;
+    }
+    m_responses.insert(it, {due, delayable ? received : 0, line});
+}
+
+void MockPool::Client::sendNotify()
+{
+    const MockPoolConfig &config = m_pool->m_config;
+
+    std::string setDifficulty;
+    if (config.difficultyEvery > 0 && m_notifies > 0 && (m_notifies % config.difficultyEvery) == 0) {
+        m_difficultyIndex = (m_difficultyIndex + 1) % config.difficulties.size();
+        char line[128];
+        snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.10g]}", difficulty());
+        setDifficulty = line;
+    }
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (config.malformedProbability > 0.0 && chance(m_rng) < config.malformedProbability) {
+        sendMalformed();
+    }
+
+    bool clean = m_jobs.empty() || (config.cleanJobsEvery > 0 && (m_notifies % config.cleanJobsEvery) == 0);
+    if (clean && !m_jobs.empty()) {
+        // new block
+        for (uint8_t &b : m_prevBlockHash) {
+            b = (uint8_t) m_rng();
+        }
+        m_jobs.clear();
+        m_submitted.clear();
+    }
+
+    uint32_t counter = m_pool->m_jobCounter.fetch_add(1);
+
+    pool_job_t job;
+    char id[16];
+    snprintf(id, sizeof(id), "%x", counter);
+    job.id = id;
+    memcpy(job.prevBlockHash, m_prevBlockHash, 32);
+    job.version = VERSION;
+    // unique per notify, the benchmark follows jobs by their ntime
+    job.ntime = 0x66000000 + counter;
+    job.difficulty = difficulty();
+
+    // coinbase: tx version, one input spending nothing, scriptsig with height
+    // and a tag, the extranonces go at the end of the scriptsig
+    uint8_t tag[8];
+    for (uint8_t &b : tag) {
+        b = (uint8_t) m_rng();
+    }
+    job.coinbase1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff2003a0bb0d08" +
+                    to_hex(tag, sizeof(tag));
+    job.coinbase2 = "ffffffff0100f2052a010000001976a914d23fcdf86f7e756a64a7a9688ef9903327048ed988ac00000000";
+
+    for (int i = 0; i < config.numBranches; i++) {
+        std::array<uint8_t, 32> branch;
+        for (uint8_t &b : branch) {
+            b = (uint8_t) m_rng();
+        }
+        job.branches.push_back(branch);
+    }
+
+    // stratum sends the previous block hash with swapped 32 bit words
+    uint8_t prevStratum[32];
+    for (int i = 0; i < 32; i++) {
+        prevStratum[i] = job.prevBlockHash[(i & ~3) + 3 - (i & 3)];
+    }
+
+    std::string branches;
+    for (size_t i = 0; i < job.branches.size(); i++) {
+        branches += (i ? ",\"" : "\"") + to_hex(job.branches[i].data(), 32) + "\"";
+    }
+
+    char numbers[64];
+    snprintf(numbers, sizeof(numbers), "\"%08x\",\"%08x\",\"%08x\"", job.version, NBITS, job.ntime);
+
+    std::string notify = "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"" + job.id + "\",\"" + to_hex(prevStratum, 32) +
+                         "\",\"" + job.coinbase1 + "\",\"" + job.coinbase2 + "\",[" + branches + "]," + numbers + "," +
+                         (clean ? "true" : "false") + "]}";
+
+    m_jobs.push_back(job);
+    if (m_jobs.size() > MAX_JOBS) {
+        m_jobs.pop_front();
+    }
+    m_notifies++;
+
+    if (!setDifficulty.empty()) {
+        sendLine(setDifficulty);
+    }
+    int64_t now = esp_timer_get_time();
+    sendLine(notify);
+
+    std::lock_guard<std::mutex> lock(m_pool->m_lock);
+    m_pool->m_stats.notifies++;
+    if (!setDifficulty.empty()) {
+        m_pool->m_stats.difficultyChanges++;
+    }
+    m_pool->m_notifyTimes.emplace(job.ntime, now);
+}
+
+void MockPool::Client::sendMalformed()
+{
+    static const char *lines[] = {
+        "this is not json",
+        "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"1\",\"00000000",
+        "\x01\x02\x03\xff\xfe",
+    };
+    sendLine(lines[m_rng() % (sizeof(lines) / sizeof(lines[0]))]);
+
+    std::lock_guard<std::mutex> lock(m_pool->m_lock);
+    m_pool->m_stats.malformed++;
+}
+
+void MockPool::Client::handleSubmit(JsonDocument &doc, int64_t id, int64_t received)
+{
+    JsonArray params = doc["params"].as<JsonArray>();
+
+    const char *jobId = params[1].as<const char *>();
+    const char *extranonce2 = params[2].as<const char *>();
+    uint32_t ntime = 0, nonce = 0, versionBits = 0;
+
+    auto reject = [&](int code, const char *reason, uint64_t MockPoolStats::*counter) {
+        ESP_LOGD(TAG, "share rejected: %s", reason);
+        respond(id, received, true, "null", "[" + std::to_string(code) + ",\"" + reason + "\",null]");
+        std::lock_guard<std::mutex> lock(m_pool->m_lock);
+        m_pool->m_stats.submits++;
+        (m_pool->m_stats.*counter)++;
+    };
+
+    if (params.size() < 5 || !jobId || !extranonce2 || !parse_hex32(params[3].as<const char *>(), &ntime) ||
+        !parse_hex32(params[4].as<const char *>(), &nonce)) {
+        return reject(ERR_OTHER, "Malformed submit", &MockPoolStats::rejectedInvalid);
+    }
+    if (params.size() > 5 && !parse_hex32(params[5].as<const char *>(), &versionBits)) {
+        return reject(ERR_OTHER, "Malformed version", &MockPoolStats::rejectedInvalid);
+    }
+
+    const pool_job_t *job = nullptr;
+    for (const pool_job_t &j : m_jobs) {
+        if (j.id == jobId) {
+            job = &j;
+        }
+    }
+    if (!job) {
+        return reject(ERR_JOB_NOT_FOUND, "Job not found", &MockPoolStats::rejectedStale);
+    }
+    if (strlen(extranonce2) != (size_t) m_pool->m_config.extranonce2Len * 2) {
+        return reject(ERR_OTHER, "Invalid extranonce2 size", &MockPoolStats::rejectedInvalid);
+    }
+    if (ntime < job->ntime || ntime > job->ntime + 7200) {
+        return reject(ERR_OTHER, "Ntime out of range", &MockPoolStats::rejectedInvalid);
+    }
+    if (versionBits & ~m_pool->m_config.versionMask) {
+        return reject(ERR_OTHER, "Invalid version bits", &MockPoolStats::rejectedInvalid);
+    }
+
+    char key[128];
+    snprintf(key, sizeof(key), "%s/%s/%08x/%08x/%08x", jobId, extranonce2, ntime, nonce, versionBits);
+    if (!m_submitted.insert(key).second) {
+        return reject(ERR_DUPLICATE, "Duplicate share", &MockPoolStats::rejectedDuplicate);
+    }
+
+    // rebuild the header
+    std::vector<uint8_t> coinbase;
+    if (!from_hex(job->coinbase1 + m_extranonce1 + extranonce2 + job->coinbase2, coinbase)) {
+        return reject(ERR_OTHER, "Invalid extranonce2", &MockPoolStats::rejectedInvalid);
+    }
+
+    uint8_t merkle[64];
+    double_sha256(coinbase.data(), coinbase.size(), merkle);
+    for (const auto &branch : job->branches) {
+        memcpy(merkle + 32, branch.data(), 32);
+        double_sha256(merkle, 64, merkle);
+    }
+
+    uint32_t version = (job->version & ~m_pool->m_config.versionMask) | versionBits;
+    uint8_t header[80];
+    memcpy(header, &version, 4);
+    memcpy(header + 4, job->prevBlockHash, 32);
+    memcpy(header + 36, merkle, 32);
+    memcpy(header + 68, &ntime, 4);
+    memcpy(header + 72, &NBITS, 4);
+    memcpy(header + 76, &nonce, 4);
+
+    uint8_t hash[32];
+    double_sha256(header, sizeof(header), hash);
+    double shareDifficulty = truediffone / le256_to_double(hash);
+
+    if (shareDifficulty < job->difficulty) {
+        return reject(ERR_LOW_DIFFICULTY, "Low difficulty share", &MockPoolStats::rejectedLowDifficulty);
+    }
+
+    respond(id, received, true, "true", "null");
+
+    std::lock_guard<std::mutex> lock(m_pool->m_lock);
+    m_pool->m_stats.submits++;
+    m_pool->m_stats.accepted++;
+    m_pool->m_stats.bestDifficulty = std::max(m_pool->m_stats.bestDifficulty, shareDifficulty);
+}
+
+void MockPool::Client::handleLine(const std::string &line, int64_t received)
+{
+    JsonDocument doc;
+    if (deserializeJson(doc, line)) {
+        ESP_LOGW(TAG, "invalid line from miner: %s", line.c_str());
+        return;
+    }
+
+    int64_t id = doc["id"].as<int64_t>();
+    const char *method = doc["method"].as<const char *>();
+    if (!method) {
+        return;
+    }
+
+    const MockPoolConfig &config = m_pool->m_config;
+
+    if (!strcmp(method, "mining.subscribe")) {
+        m_subscribed = true;
+        respond(id, received, false,
+                "[[[\"mining.set_difficulty\",\"1\"],[\"mining.notify\",\"1\"]],\"" + m_extranonce1 + "\"," +
+                    std::to_string(config.extranonce2Len) + "]",
+                "null");
+    } else if (!strcmp(method, "mining.configure")) {
+        char result[96];
+        snprintf(result, sizeof(result), "{\"version-rolling\":true,\"version-rolling.mask\":\"%08x\"}", config.versionMask);
+        respond(id, received, false, result, "null");
+    } else if (!strcmp(method, "mining.authorize")) {
+        respond(id, received, false, m_subscribed ? "true" : "false", "null");
+        if (m_subscribed && !m_authorized) {
+            m_authorized = true;
+            char line[128];
+            snprintf(line, sizeof(line), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.10g]}", difficulty());
+            m_responses.push_back({received, 0, line});
+            // first notify right after the authorize response
+            m_nextNotify = received;
+        }
+    } else if (!strcmp(method, "mining.suggest_difficulty")) {
+        // the difficulty schedule of the pool wins
+        respond(id, received, false, "true", "null");
+    } else if (!strcmp(method, "mining.submit")) {
+        handleSubmit(doc, id, received);
+    } else {
+        respond(id, received, false, "null", "[20,\"Unsupported method\",null]");
+    }
+}
+
+void MockPool::Client::run()
+{
+    const MockPoolConfig &config = m_pool->m_config;
+
+    if (config.reconnectEverySec > 0) {
+        m_reconnectAt = esp_timer_get_time() + (int64_t) config.reconnectEverySec * 1000000;
+    }
+
+    char buf[4096];
+    while (m_pool->m_running) {
+        int64_t now = esp_timer_get_time();
+
+        // sleep until the next thing to do
+        int64_t wakeup = now + 100000;
+        if (m_authorized && m_nextNotify) {
+            wakeup = std::min(wakeup, m_nextNotify);
+        }
+        if (!m_responses.empty()) {
+            wakeup = std::min(wakeup, m_responses.front().due);
+        }
+        if (m_reconnectAt) {
+            wakeup = std::min(wakeup, m_reconnectAt);
+        }
+        if (m_closeAt) {
+            wakeup = std::min(wakeup, m_closeAt);
+        }
+
+        struct pollfd pfd = {m_fd, POLLIN, 0};
+        int timeoutMs = (int) std::max<int64_t>(0, (wakeup - now + 999) / 1000);
+        if (poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR) {
+            break;
+        }
+
+        if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = ::recv(m_fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                break;
+            }
+            m_rx.append(buf, n);
+            int64_t received = esp_timer_get_time();
+            size_t pos;
+            while ((pos = m_rx.find('\n')) != std::string::npos) {
+                std::string line = m_rx.substr(0, pos);
+                m_rx.erase(0, pos + 1);
+                if (!line.empty() && !m_closeAt) {
+                    handleLine(line, received);
+                }
+            }
+            if (m_rx.size() > MAX_LINE) {
+                ESP_LOGW(TAG, "line too long, dropping connection");
+                break;
+            }
+        }
+
+        now = esp_timer_get_time();
+
+        while (!m_responses.empty() && m_responses.front().due <= now) {
+            response_t response = m_responses.front();
+            m_responses.pop_front();
+            if (!sendLine(response.line)) {
+                break;
+            }
+            if (response.received) {
+                std::lock_guard<std::mutex> lock(m_pool->m_lock);
+                m_pool->m_acceptLatencyUs.push_back((double) (esp_timer_get_time() - response.received));
+            }
+        }
+
+        if (m_authorized && m_nextNotify && now >= m_nextNotify && !m_closeAt) {
+            sendNotify();
+            m_nextNotify += (int64_t) config.notifyIntervalMs * 1000;
+            if (m_nextNotify < now) {
+                m_nextNotify = now + (int64_t) config.notifyIntervalMs * 1000;
+            }
+        }
+
+        if (m_reconnectAt && now >= m_reconnectAt && !m_closeAt) {
+            sendLine("{\"id\":null,\"method\":\"client.reconnect\",\"params\":[]}");
+            m_closeAt = now + RECONNECT_GRACE_US;
+            std::lock_guard<std::mutex> lock(m_pool->m_lock);
+            m_pool->m_stats.reconnects++;
+        }
+
+        if (m_closeAt && now >= m_closeAt) {
+            ESP_LOGI(TAG, "closing connection after client.reconnect");
+            break;
+        }
+    }
+}
+
+MockPool::MockPool(const MockPoolConfig &config) : m_config(config)
+{
+    if (m_config.difficulties.empty()) {
+        m_config.difficulties.push_back(1.0);
+    }
+}
+
+MockPool::~MockPool()
+{
+    stop();
+}
+
+bool MockPool::start()
+{
+    m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (m_listenFd < 0) {
+        ESP_LOGE(TAG, "socket: %s", strerror(errno));
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.bindAddress, &addr.sin_addr) != 1) {
+        ESP_LOGE(TAG, "invalid bind address %s", m_config.bindAddress);
+        return false;
+    }
+
+    if (bind(m_listenFd, (struct sockaddr *) &addr, sizeof(addr)) || listen(m_listenFd, 16)) {
+        ESP_LOGE(TAG, "bind %s:%d: %s", m_config.bindAddress, m_config.port, strerror(errno));
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+
+    socklen_t len = sizeof(addr);
+    getsockname(m_listenFd, (struct sockaddr *) &addr, &len);
+    m_port = ntohs(addr.sin_port);
+
+    m_running = true;
+    m_acceptThread = std::thread(&MockPool::acceptLoop, this);
+
+    ESP_LOGI(TAG, "listening on %s:%d", m_config.bindAddress, m_port);
+    return true;
+}
+
+void MockPool::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+
+    shutdown(m_listenFd, SHUT_RDWR);
+    close(m_listenFd);
+    m_acceptThread.join();
+
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (int fd : m_clientFds) {
+            shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(m_clientThreads);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+}
+
+void MockPool::acceptLoop()
+{
+    pthread_setname_np(pthread_self(), "pool-accept");
+
+    while (m_running) {
+        int fd = accept(m_listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.connections++;
+        m_clientFds.push_back(fd);
+        m_clientThreads.emplace_back(&MockPool::serve, this, fd);
+    }
+}
+
+void MockPool::serve(int fd)
+{
+    pthread_setname_np(pthread_self(), "pool-client");
+
+    uint32_t seed;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        seed = m_config.seed + (uint32_t) m_stats.connections;
+    }
+
+    ESP_LOGI(TAG, "miner connected");
+    Client client(this, fd, seed);
+    client.run();
+    ESP_LOGI(TAG, "miner disconnected");
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_clientFds.erase(std::remove(m_clientFds.begin(), m_clientFds.end(), fd), m_clientFds.end());
+    close(fd);
+}
+
+MockPoolStats MockPool::getStats()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
+
+LatencySummary MockPool::getAcceptLatencyUs()
+{
+    std::vector<double> samples;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        samples = m_acceptLatencyUs;
+    }
+    return summarize_latency(samples);
+}
+
+bool MockPool::getNotifyTime(uint32_t ntime, int64_t *timeUs)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_notifyTimes.find(ntime);
+    if (it == m_notifyTimes.end()) {
+        return false;
+    }
+    *timeUs = it->second;
+    return true;
+}
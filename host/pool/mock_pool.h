@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Stratum V1 pool for load tests on Linux.
+//
+// Serves any number of miners (subscribe, configure, authorize,
+// suggest_difficulty, submit) and issues mining.notify at a fixed rate
+// with a configurable number of merkle branches. Every submitted share is
+// validated by rebuilding the block header from the job, the extranonces,
+// ntime, nonce and version bits, so a miner that builds wrong headers gets
+// its shares rejected instead of silently accepted.
+//
+// Faults that can be injected:
+//   - difficulty changes every N notifies (fractional difficulties are
+//     allowed, the firmware truncates them to 0 and submits every nonce)
+//   - clean jobs every N notifies, old jobs become stale
+//   - client.reconnect followed by closing the connection
+//   - delayed submit responses
+//   - malformed lines (garbage, truncated json, binary)
+//
+// The ntime of every notify is unique, so it can be used to follow a job
+// through the miner (see getNotifyTime).
+
+typedef struct
+{
+    const char *bindAddress = "127.0.0.1";
+    int port = 3333; // 0 binds to any free port, see getPort
+
+    int notifyIntervalMs = 10000;
+    int numBranches = 12;
+    int cleanJobsEvery = 10; // every Nth notify starts a new block, 0 = never
+
+    std::vector<double> difficulties = {1024.0};
+    int difficultyEvery = 0; // next difficulty every N notifies, 0 = fixed
+
+    int reconnectEverySec = 0; // client.reconnect and disconnect, 0 = off
+
+    double slowResponseProbability = 0.0;
+    int slowResponseMs = 2000;
+
+    double malformedProbability = 0.0; // per notify
+
+    uint32_t versionMask = 0x1fffe000;
+    int extranonce2Len = 4;
+    uint32_t seed = 1;
+} MockPoolConfig;
+
+typedef struct
+{
+    uint64_t connections;
+    uint64_t notifies;
+    uint64_t difficultyChanges;
+    uint64_t reconnects;
+    uint64_t malformed;
+    uint64_t slowResponses;
+
+    uint64_t submits;
+    uint64_t accepted;
+    uint64_t rejectedStale;
+    uint64_t rejectedDuplicate;
+    uint64_t rejectedLowDifficulty;
+    uint64_t rejectedInvalid;
+
+    double bestDifficulty;
+} MockPoolStats;
+
+typedef struct
+{
+    size_t count;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+} LatencySummary;
+
+static inline LatencySummary summarize_latency(std::vector<double> samples)
+{
+    LatencySummary summary = {};
+    summary.count = samples.size();
+    if (samples.empty()) {
+        return summary;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) { return samples[std::min(samples.size() - 1, (size_t) (q * (double) samples.size()))]; };
+    summary.p50 = at(0.50);
+    summary.p90 = at(0.90);
+    summary.p99 = at(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+class MockPool {
+  protected:
+    class Client;
+    friend class Client;
+
+    MockPoolConfig m_config;
+    int m_listenFd = -1;
+    int m_port = 0;
+
+    std::atomic<bool> m_running{false};
+    std::thread m_acceptThread;
+
+    std::mutex m_lock;
+    std::vector<std::thread> m_clientThreads;
+    std::vector<int> m_clientFds;
+
+    MockPoolStats m_stats = {};
+    std::vector<double> m_acceptLatencyUs;
+    std::map<uint32_t, int64_t> m_notifyTimes;
+
+    std::atomic<uint32_t> m_extranonce1{0};
+    std::atomic<uint32_t> m_jobCounter{0};
+
+    void acceptLoop();
+    void serve(int fd);
+
+  public:
+    MockPool(const MockPoolConfig &config);
+    ~MockPool();
+
+    bool start();
+    void stop();
+
+    int getPort()
+    {
+        return m_port;
+    }
+
+    MockPoolStats getStats();
+
+    // time from a submit to its response, includes injected delays
+    LatencySummary getAcceptLatencyUs();
+
+    // esp_timer_get_time compatible time (CLOCK_MONOTONIC, us) when the
+    // notify with this ntime was sent first
+    bool getNotifyTime(uint32_t ntime, int64_t *timeUs);
+};
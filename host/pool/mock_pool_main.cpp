@@ -0,0 +1,132 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mock_pool.h"
+
+// Standalone mock pool, e.g. to load test a miner on the bench:
+//
+//   ./mock_pool --bind 0.0.0.0 --port 3333 --notify-ms 1000 --difficulty 256,1024 --difficulty-every 5
+//
+// Prints the statistics every 10 s and on exit.
+
+static volatile bool s_running = true;
+
+static void on_signal(int)
+{
+    s_running = false;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--bind ADDR] [--port N] [--notify-ms MS] [--branches N] [--difficulty D[,D..]]\n"
+            "          [--difficulty-every N] [--clean-every N] [--reconnect S] [--slow P] [--slow-ms MS] [--malformed P]\n",
+            name);
+}
+
+static void print_stats(MockPool &pool)
+{
+    MockPoolStats stats = pool.getStats();
+    LatencySummary latency = pool.getAcceptLatencyUs();
+    printf("%llu connections, %llu notifies, %llu submits, %llu accepted, rejected %llu stale / %llu duplicate / %llu low diff / "
+           "%llu invalid, best %.4g, latency p50 %.2f / p99 %.2f / max %.2f ms\n",
+           (unsigned long long) stats.connections, (unsigned long long) stats.notifies, (unsigned long long) stats.submits,
+           (unsigned long long) stats.accepted, (unsigned long long) stats.rejectedStale,
+           (unsigned long long) stats.rejectedDuplicate, (unsigned long long) stats.rejectedLowDifficulty,
+           (unsigned long long) stats.rejectedInvalid, stats.bestDifficulty, latency.p50 / 1000.0, latency.p99 / 1000.0,
+           latency.max / 1000.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    MockPoolConfig config;
+
+    static const struct option options[] = {
+        {"bind", required_argument, nullptr, 'b'},
+        {"port", required_argument, nullptr, 'p'},
+        {"notify-ms", required_argument, nullptr, 'n'},
+        {"branches", required_argument, nullptr, 'm'},
+        {"difficulty", required_argument, nullptr, 'd'},
+        {"difficulty-every", required_argument, nullptr, 'e'},
+        {"clean-every", required_argument, nullptr, 'c'},
+        {"reconnect", required_argument, nullptr, 'r'},
+        {"slow", required_argument, nullptr, 's'},
+        {"slow-ms", required_argument, nullptr, 'S'},
+        {"malformed", required_argument, nullptr, 'x'},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:p:n:m:d:e:c:r:s:S:x:", options, nullptr)) != -1) {
+        switch (opt) {
+        case 'b':
+            config.bindAddress = optarg;
+            break;
+        case 'p':
+            config.port = atoi(optarg);
+            break;
+        case 'n':
+            config.notifyIntervalMs = atoi(optarg);
+            break;
+        case 'm':
+            config.numBranches = atoi(optarg);
+            break;
+        case 'd': {
+            config.difficulties.clear();
+            char *save;
+            for (char *tok = strtok_r(optarg, ",", &save); tok; tok = strtok_r(nullptr, ",", &save)) {
+                config.difficulties.push_back(atof(tok));
+            }
+            break;
+        }
+        case 'e':
+            config.difficultyEvery = atoi(optarg);
+            break;
+        case 'c':
+            config.cleanJobsEvery = atoi(optarg);
+            break;
+        case 'r':
+            config.reconnectEverySec = atoi(optarg);
+            break;
+        case 's':
+            config.slowResponseProbability = atof(optarg);
+            break;
+        case 'S':
+            config.slowResponseMs = atoi(optarg);
+            break;
+        case 'x':
+            config.malformedProbability = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    MockPool pool(config);
+    if (!pool.start()) {
+        return 1;
+    }
+    printf("stratum+tcp://%s:%d\n", config.bindAddress, pool.getPort());
+    fflush(stdout);
+
+    int ticks = 0;
+    while (s_running) {
+        usleep(100 * 1000);
+        if (++ticks % 100 == 0) {
+            print_stats(pool);
+        }
+    }
+
+    pool.stop();
+    print_stats(pool);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "power_cap.h"
+
+// Runs the power cap controller of the firmware (main/power_cap.cpp) against
+// a simple board model: input power grows linearly with the frequency and
+// with the square of the core voltage, plus noise on the readings. Samples
+// come every second like the fast telemetry of the power management task.
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            s_failures++;                                                                                                          \
+        }                                                                                                                          \
+    } while (0)
+
+// NerdQAxe+ at 490MHz / 1250mV draws about 62W
+#define IDLE_W 8.0f
+#define W_PER_MHZ 0.11f
+#define NOMINAL_MV 1250.0f
+
+typedef struct
+{
+    PowerCap cap;
+    PowerCapLimits limits;
+    uint32_t seed;
+    int frequencyChanges;
+    int voltageChanges;
+} Sim;
+
+static float board_power(float frequency, uint16_t voltage)
+{
+    float scale = (float) voltage / NOMINAL_MV;
+    return IDLE_W + W_PER_MHZ * frequency * scale * scale;
+}
+
+static float noise(Sim *sim, float amplitude)
+{
+    sim->seed = sim->seed * 1103515245u + 12345u;
+    return ((float) ((sim->seed >> 16) & 0x7fff) / 32767.0f * 2.0f - 1.0f) * amplitude;
+}
+
+static void sim_init(Sim *sim)
+{
+    sim->limits.maxFrequency = 490.0f;
+    sim->limits.minFrequency = sim->limits.maxFrequency * POWER_CAP_MIN_FREQUENCY;
+    sim->limits.maxVoltage = 1250;
+    sim->limits.minVoltage = 1100;
+    sim->seed = 1;
+    sim->cap.reset(sim->limits.maxFrequency, sim->limits.maxVoltage);
+}
+
+// runs the controller for seconds, returns the mean true power of the
+// last half
+static float sim_run(Sim *sim, float capW, int seconds, float noiseW)
+{
+    sim->frequencyChanges = 0;
+    sim->voltageChanges = 0;
+
+    double sum = 0.0;
+    int n = 0;
+    for (int t = 0; t < seconds; t++) {
+        float power = board_power(sim->cap.getFrequency(), sim->cap.getVoltage());
+        float frequency = sim->cap.getFrequency();
+        uint16_t voltage = sim->cap.getVoltage();
+
+        sim->cap.update(power + noise(sim, noiseW), 1.0f, capW, &sim->limits);
+
+        if (sim->cap.getFrequency() != frequency) {
+            sim->frequencyChanges++;
+
+            float f = sim->cap.getFrequency();
+            bool onGrid = fmodf(f, POWER_CAP_STEP_MHZ) == 0.0f || f == sim->limits.maxFrequency || f == sim->limits.minFrequency;
+            CHECK(onGrid, "frequency %.2f is off the PLL grid", f);
+            CHECK(fabsf(f - frequency) <= POWER_CAP_MAX_SLEW_MHZ, "step %.2f -> %.2f is over the slew limit", frequency, f);
+        }
+        if (sim->cap.getVoltage() != voltage) {
+            sim->voltageChanges++;
+        }
+        CHECK(sim->cap.getFrequency() >= sim->limits.minFrequency && sim->cap.getFrequency() <= sim->limits.maxFrequency,
+              "frequency %.2f out of the limits", sim->cap.getFrequency());
+
+        if (t >= seconds / 2) {
+            sum += power;
+            n++;
+        }
+    }
+    return (float) (sum / n);
+}
+
+static void test_holds_cap()
+{
+    Sim sim;
+    sim_init(&sim);
+
+    float mean = sim_run(&sim, 55.0f, 600, 1.0f);
+    printf("cap 55W: mean %.2fW, %.2fMHz, %umV, headroom %.2fW\n", mean, sim.cap.getFrequency(), sim.cap.getVoltage(),
+           sim.cap.getHeadroom(55.0f));
+
+    CHECK(mean < 55.0f, "mean power %.2fW over the cap", mean);
+    CHECK(mean > 55.0f * (1.0f - 4.0f * POWER_CAP_BAND), "mean power %.2fW far under the cap", mean);
+    CHECK(sim.cap.getVoltage() == sim.limits.maxVoltage, "voltage lowered to %u while the frequency had room",
+          sim.cap.getVoltage());
+
+    // settled: the hysteresis keeps the frequency from toggling
+    sim_run(&sim, 55.0f, 300, 1.0f);
+    printf("cap 55W settled: %d frequency changes in 300s\n", sim.frequencyChanges);
+    CHECK(sim.frequencyChanges <= 10, "%d frequency changes in 300s", sim.frequencyChanges);
+}
+
+static void test_no_cap_needed()
+{
+    Sim sim;
+    sim_init(&sim);
+
+    sim_run(&sim, 100.0f, 120, 1.0f);
+    CHECK(sim.cap.getFrequency() == sim.limits.maxFrequency, "frequency %.2f under the configured one",
+          sim.cap.getFrequency());
+    CHECK(sim.frequencyChanges == 0, "%d frequency changes without need", sim.frequencyChanges);
+}
+
+static void test_unreachable_and_windup()
+{
+    Sim sim;
+    sim_init(&sim);
+
+    // can't be held: minimum frequency, then the voltage goes down
+    float mean = sim_run(&sim, 25.0f, 600, 0.5f);
+    printf("cap 25W: mean %.2fW, %.2fMHz, %umV, headroom %.2fW\n", mean, sim.cap.getFrequency(), sim.cap.getVoltage(),
+           sim.cap.getHeadroom(25.0f));
+    CHECK(sim.cap.getFrequency() == sim.limits.minFrequency, "frequency %.2f not at the minimum", sim.cap.getFrequency());
+    CHECK(sim.cap.getVoltage() == sim.limits.minVoltage, "voltage %u not at the minimum", sim.cap.getVoltage());
+    CHECK(sim.cap.getHeadroom(25.0f) < 0.0f, "headroom %.2f should be negative", sim.cap.getHeadroom(25.0f));
+
+    // the cap is lifted: without anti-windup the integrator would hold the
+    // frequency down for minutes
+    int seconds = 0;
+    while (seconds < 600 && (sim.cap.getFrequency() < sim.limits.maxFrequency || sim.cap.getVoltage() < sim.limits.maxVoltage)) {
+        sim_run(&sim, 100.0f, 1, 0.5f);
+        seconds++;
+    }
+    printf("cap lifted: back at %.2fMHz / %umV after %ds\n", sim.cap.getFrequency(), sim.cap.getVoltage(), seconds);
+    CHECK(sim.cap.getVoltage() == sim.limits.maxVoltage, "voltage %u not restored", sim.cap.getVoltage());
+    CHECK(seconds < 120, "recovery took %ds", seconds);
+}
+
+static void test_step_down()
+{
+    Sim sim;
+    sim_init(&sim);
+
+    sim_run(&sim, 58.0f, 300, 1.0f);
+
+    // the circuit budget is lowered while mining
+    float mean = sim_run(&sim, 45.0f, 300, 1.0f);
+    printf("cap 58W -> 45W: mean %.2fW, %.2fMHz\n", mean, sim.cap.getFrequency());
+    CHECK(mean < 45.0f, "mean power %.2fW over the new cap", mean);
+    CHECK(sim.cap.getVoltage() == sim.limits.maxVoltage, "voltage lowered to %u", sim.cap.getVoltage());
+}
+
+int main()
+{
+    test_holds_cap();
+    test_no_cap_needed();
+    test_unreachable_and_windup();
+    test_step_down();
+
+    if (s_failures) {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "profile_schedule.h"
+
+// Parses schedules like the firmware does when /api/schedule is patched and
+// checks which rule is in effect over the week.
+
+static int s_failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            s_failures++;                                                                                                          \
+        }                                                                                                                          \
+    } while (0)
+
+#define SUN 0
+#define MON 1
+#define FRI 5
+#define SAT 6
+#define HM(h, m) ((h) * 60 + (m))
+
+static const char *TARIFF = R"({
+  "enabled": true,
+  "timezone": "CET-1CEST,M3.5.0,M10.5.0/3",
+  "profiles": [
+    {"name": "peak", "pause": true, "frequency": 300, "coreVoltage": 1100, "price": 0.42},
+    {"name": "eco", "frequency": 400, "coreVoltage": 1150, "powerCap": 45, "price": 0.30},
+    {"name": "night", "autofanspeed": 0, "fanspeed": 100, "price": 0.18}
+  ],
+  "rules": [
+    {"days": "mon-fri", "start": "07:00", "profile": "eco"},
+    {"days": "mon-fri", "start": "17:00", "profile": "peak"},
+    {"days": "*", "start": "22:00", "profile": "night"},
+    {"days": "sat,sun", "start": "09:00", "profile": "eco"}
+  ]
+})";
+
+static bool parse(const char *json, schedule_config_t *config, char *err, size_t errLen)
+{
+    return schedule_parse(json, strlen(json), config, err, errLen);
+}
+
+static const char *active(const schedule_config_t *config, int wday, int minute)
+{
+    int rule = schedule_active_rule(config, wday, minute);
+    if (rule < 0) {
+        return "-";
+    }
+    int profile = config->rules[rule].profile;
+    return profile < 0 ? SCHEDULE_DEFAULT_PROFILE : config->profiles[profile].name;
+}
+
+static void test_parse()
+{
+    schedule_config_t config;
+    char err[96];
+
+    CHECK(parse(TARIFF, &config, err, sizeof(err)), "tariff rejected: %s", err);
+    CHECK(config.enabled, "not enabled");
+    CHECK(config.numProfiles == 3 && config.numRules == 4, "%d profiles, %d rules", config.numProfiles, config.numRules);
+    CHECK(!strcmp(config.timezone, "CET-1CEST,M3.5.0,M10.5.0/3"), "timezone '%s'", config.timezone);
+
+    const schedule_profile_t *peak = &config.profiles[schedule_find_profile(&config, "peak")];
+    CHECK(peak->pause && peak->frequency == 300 && peak->coreVoltage == 1100, "peak profile");
+    CHECK(peak->fanMode == -1 && peak->fanSpeed == -1 && peak->powerCap == -1, "peak keeps the fan and the cap");
+
+    const schedule_profile_t *night = &config.profiles[schedule_find_profile(&config, "night")];
+    CHECK(!night->frequency && !night->coreVoltage && night->fanMode == 0 && night->fanSpeed == 100, "night profile");
+
+    CHECK(config.rules[0].days == 0x3e, "mon-fri is %02x", config.rules[0].days);
+    CHECK(config.rules[2].days == 0x7f, "* is %02x", config.rules[2].days);
+    CHECK(config.rules[3].days == 0x41, "sat,sun is %02x", config.rules[3].days);
+    CHECK(config.rules[1].minute == HM(17, 0), "17:00 is %d", config.rules[1].minute);
+
+    // an empty config is an empty, disabled schedule
+    CHECK(parse("", &config, err, sizeof(err)) && !config.enabled && !config.numRules, "empty config");
+    CHECK(!strcmp(config.timezone, ""), "empty config timezone");
+
+    CHECK(parse(R"({"profiles": [], "rules": [{"days": "fri-mon", "start": "00:00", "profile": "x"}]})", &config, err,
+                sizeof(err)) == false,
+          "unknown profile accepted");
+    CHECK(strstr(err, "unknown profile"), "error '%s'", err);
+
+    const char *invalid[] = {
+        "{",
+        R"({"profiles": [{"name": "default"}]})",
+        R"({"profiles": [{"name": "a"}, {"name": "a"}]})",
+        R"({"profiles": [{"name": "a", "autofanspeed": 1}]})",
+        R"({"profiles": [{"name": "a", "fanspeed": 101}]})",
+        R"({"profiles": [{"name": "a"}], "rules": [{"days": "mon-fry", "start": "07:00", "profile": "a"}]})",
+        R"({"profiles": [{"name": "a"}], "rules": [{"days": "mon", "start": "24:00", "profile": "a"}]})",
+        R"({"profiles": [{"name": "a"}], "rules": [{"days": "mon", "start": "7", "profile": "a"}]})",
+        R"({"profiles": [{"name": "a"}], "rules": [{"days": "", "start": "07:00", "profile": "a"}]})",
+    };
+    for (const char *json : invalid) {
+        CHECK(!parse(json, &config, err, sizeof(err)), "accepted %s", json);
+        CHECK(*err, "no error for %s", json);
+    }
+
+    // wrapping range
+    CHECK(parse(R"({"profiles": [{"name": "a"}], "rules": [{"days": "fri-mon", "start": "00:00", "profile": "a"}]})", &config, err,
+                sizeof(err)),
+          "fri-mon rejected: %s", err);
+    CHECK(config.rules[0].days == 0x63, "fri-mon is %02x", config.rules[0].days);
+
+    // back to the configured settings
+    CHECK(parse(R"({"profiles": [{"name": "a"}], "rules": [{"start": "08:00", "profile": "a"},
+                {"start": "18:00", "profile": "default"}]})", &config, err, sizeof(err)),
+          "default rule rejected: %s", err);
+    CHECK(config.rules[1].profile == -1, "default rule is profile %d", config.rules[1].profile);
+    CHECK(!strcmp(active(&config, MON, HM(19, 0)), SCHEDULE_DEFAULT_PROFILE), "mon 19:00 %s", active(&config, MON, HM(19, 0)));
+}
+
+static void test_week()
+{
+    schedule_config_t config;
+    char err[96];
+    parse(TARIFF, &config, err, sizeof(err));
+
+    CHECK(!strcmp(active(&config, MON, HM(7, 0)), "eco"), "mon 07:00 %s", active(&config, MON, HM(7, 0)));
+    CHECK(!strcmp(active(&config, MON, HM(12, 30)), "eco"), "mon 12:30");
+    CHECK(!strcmp(active(&config, MON, HM(17, 0)), "peak"), "mon 17:00");
+    CHECK(!strcmp(active(&config, MON, HM(21, 59)), "peak"), "mon 21:59");
+    CHECK(!strcmp(active(&config, MON, HM(22, 0)), "night"), "mon 22:00");
+
+    // before the first rule of the day the one of the night before holds
+    CHECK(!strcmp(active(&config, MON, HM(3, 0)), "night"), "mon 03:00 %s", active(&config, MON, HM(3, 0)));
+    CHECK(!strcmp(active(&config, SAT, HM(8, 59)), "night"), "sat 08:59");
+    CHECK(!strcmp(active(&config, SAT, HM(9, 0)), "eco"), "sat 09:00");
+    CHECK(!strcmp(active(&config, SAT, HM(17, 30)), "eco"), "sat 17:30 %s", active(&config, SAT, HM(17, 30)));
+    CHECK(!strcmp(active(&config, SUN, HM(23, 0)), "night"), "sun 23:00");
+
+    CHECK(schedule_minutes_to_next(&config, MON, HM(7, 0)) == 10 * 60, "next after mon 07:00 in %d",
+          schedule_minutes_to_next(&config, MON, HM(7, 0)));
+    CHECK(schedule_minutes_to_next(&config, FRI, HM(22, 0)) == 11 * 60, "next after fri 22:00 in %d",
+          schedule_minutes_to_next(&config, FRI, HM(22, 0)));
+    CHECK(schedule_minutes_to_next(&config, SUN, HM(22, 30)) == 8 * 60 + 30, "next after sun 22:30 in %d",
+          schedule_minutes_to_next(&config, SUN, HM(22, 30)));
+
+    // a single rule holds all week, the next start is a week away
+    parse(R"({"profiles": [{"name": "a"}, {"name": "b"}], "rules": [{"days": "wed", "start": "12:00", "profile": "a"}]})",
+          &config, err, sizeof(err));
+    CHECK(!strcmp(active(&config, MON, 0), "a"), "single rule");
+    CHECK(schedule_minutes_to_next(&config, 3, HM(12, 0)) == SCHEDULE_MINUTES_PER_WEEK, "next of a single rule");
+
+    // the later rule wins on the same start
+    parse(R"({"profiles": [{"name": "a"}, {"name": "b"}], "rules": [
+        {"days": "*", "start": "06:00", "profile": "a"},
+        {"days": "sun", "start": "06:00", "profile": "b"}]})",
+          &config, err, sizeof(err));
+    CHECK(!strcmp(active(&config, SUN, HM(6, 0)), "b"), "same start on sunday");
+    CHECK(!strcmp(active(&config, MON, HM(6, 0)), "a"), "same start on monday");
+
+    parse(R"({"profiles": [{"name": "a"}]})", &config, err, sizeof(err));
+    CHECK(schedule_active_rule(&config, MON, 0) == -1, "no rules");
+    CHECK(schedule_minutes_to_next(&config, MON, 0) == -1, "no next rule");
+}
+
+int main()
+{
+    test_parse();
+    test_week();
+
+    if (s_failures) {
+        printf("%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
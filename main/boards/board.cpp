@@ -3,6 +3,7 @@
 
 #include "board.h"
 #include "nvs_config.h"
+#include "task_topology.h"
 #include "esp_log.h"
 #include "../displays/displayDriver.h"
 
@@ -12,6 +13,8 @@ Board::Board() {
     m_fanAutoPolarity = true; // default detect polarity
     m_absMaxAsicFrequency = 0;
     m_absMaxAsicVoltageMillis = 0;
+    m_miningCore = 1; // Wi-Fi and lwIP run on core 0
+    m_asicMaxBaud = 3125000; // fastest divider of the BM13xx fast UART
 }
 
 void Board::loadSettings()
@@ -19,9 +22,11 @@ void Board::loadSettings()
     m_fanPerc = Config::getFanSpeed();
 
     // default values are initialized in the constructor of each board
-    m_asicFrequency = Config::getAsicFrequency(m_asicFrequency);
-    m_asicVoltageMillis = Config::getAsicVoltage(m_asicVoltageMillis);
+    m_configAsicFrequency = Config::getAsicFrequency(m_defaultAsicFrequency);
+    m_configAsicVoltageMillis = Config::getAsicVoltage(m_defaultAsicVoltageMillis);
+    setProfileSettings(m_profileAsicFrequency, m_profileAsicVoltageMillis);
     m_asicJobIntervalMs = Config::getAsicJobInterval(m_asicJobIntervalMs);
+    m_miningCore = Config::getMiningCore(m_miningCore);
     m_fanInvertPolarity = Config::isInvertFanPolarityEnabled(m_fanInvertPolarity);
     m_fanAutoPolarity = Config::isAutoFanPolarityEnabled(m_fanAutoPolarity);
     m_flipScreen = Config::isFlipScreenEnabled(m_flipScreen);
@@ -38,6 +43,14 @@ void Board::loadSettings()
     ESP_LOGI(TAG, "fan speed: %d%%", (int) m_fanPerc);
 }
 
+void Board::setProfileSettings(int frequency, int voltageMillis)
+{
+    m_profileAsicFrequency = frequency;
+    m_profileAsicVoltageMillis = voltageMillis;
+    m_asicFrequency = frequency ? frequency : m_configAsicFrequency;
+    m_asicVoltageMillis = voltageMillis ? voltageMillis : m_configAsicVoltageMillis;
+}
+
 bool Board::initBoard() {
     m_chipTemps = new float[m_asicCount]();
     return true;
@@ -88,6 +101,11 @@ int Board::getAsicJobIntervalMs()
     return m_asicJobIntervalMs;
 }
 
+int Board::getMiningCore()
+{
+    return m_miningCore;
+}
+
 bool Board::selfTest(){
 
     // Initialize the display
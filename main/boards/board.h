@@ -1,11 +1,13 @@
 #pragma once
 
 #include <vector>
+#include "driver/gpio.h"
 #include "../displays/images/themes/themes.h"
 #include "asic.h"
 #include "bm1368.h"
 #include "nvs_config.h"
 #include "../pid/PID_v1_bc.h"
+#include "drivers/pmbus_status.h"
 
 enum FanPolarityGuess {
     POLARITY_UNKNOWN,
@@ -30,9 +32,19 @@ class Board {
 
     // asic settings
     int m_asicJobIntervalMs;
+
+    // core of the mining tasks, 0, 1 or TASK_TOPOLOGY_UNPINNED
+    int m_miningCore;
     int m_asicFrequency;
     int m_asicVoltageMillis;
     int m_absMaxAsicFrequency;
+
+    // the configured values, a mining profile of the scheduler replaces
+    // them in m_asicFrequency and m_asicVoltageMillis while it's active
+    int m_configAsicFrequency = 0;
+    int m_configAsicVoltageMillis = 0;
+    int m_profileAsicFrequency = 0;
+    int m_profileAsicVoltageMillis = 0;
     int m_absMaxAsicVoltageMillis;
 
     // frequency and voltage options
@@ -47,9 +59,16 @@ class Board {
     uint32_t m_asicMinDifficulty;
     uint32_t m_asicMaxDifficulty;
 
+    // the UART is negotiated up to this baud, the result is in m_asicBaud
+    int m_asicMaxBaud;
+    int m_asicBaud = 0;
+
     // Voltage regulator max temperature
     float m_vr_maxTemp = 0.0;
 
+    // SMBALERT# of the core regulator, without it the status is polled
+    gpio_num_t m_vrAlertPin = GPIO_NUM_NC;
+
     // fans
     bool m_fanInvertPolarity;
     bool m_fanAutoPolarity;
@@ -84,6 +103,7 @@ class Board {
     const char *getAsicModel();
     int getAsicCount();
     int getAsicJobIntervalMs();
+    int getMiningCore();
     uint32_t getInitialASICDifficulty();
     virtual bool setAsicFrequency(float f);
 
@@ -120,6 +140,22 @@ class Board {
         return false;
     }
 
+    // PMBus status of the core regulator, false on boards without one
+    virtual bool readVRStatus(VRStatus *status)
+    {
+        return false;
+    }
+
+    // clears the latched status bits and releases SMBALERT#
+    virtual void clearVRFaults()
+    {
+    }
+
+    gpio_num_t getVRAlertPin()
+    {
+        return m_vrAlertPin;
+    }
+
     virtual bool selfTest();
 
     Theme *getTheme()
@@ -137,6 +173,11 @@ class Board {
         return m_asicMinDifficulty;
     };
 
+    int getAsicBaud()
+    {
+        return m_asicBaud;
+    };
+
     bool isInitialized()
     {
         return m_isInitialized;
@@ -157,6 +198,20 @@ class Board {
         return m_asicFrequency;
     }
 
+    int getConfigAsicVoltageMillis()
+    {
+        return m_configAsicVoltageMillis;
+    }
+
+    int getConfigAsicFrequency()
+    {
+        return m_configAsicFrequency;
+    }
+
+    // frequency and voltage of a mining profile, 0 goes back to the
+    // configured value. The power management task applies them.
+    void setProfileSettings(int frequency, int voltageMillis);
+
     int getAbsMaxAsicFrequency() {
         return m_absMaxAsicFrequency;
     }
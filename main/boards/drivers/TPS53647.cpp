@@ -39,6 +39,7 @@ TPS53647::TPS53647()
     m_initOnOffConfig = 0b00010111;
     m_initOtWarnLimit = 95.0f;
     m_initOtFaultLimit = 125.0f;
+    m_initialized = false;
 }
 
 /**
@@ -543,3 +544,36 @@ uint8_t TPS53647::get_status_byte(void)
     read_byte(PMBUS_STATUS_BYTE, &status_byte);
     return status_byte;
 }
+
+bool TPS53647::read_status(VRStatus *status)
+{
+    memset(status, 0, sizeof(VRStatus));
+
+    if (!m_initialized) {
+        return false;
+    }
+
+    if (read_word(PMBUS_STATUS_WORD, &status->word) != ESP_OK) {
+        return false;
+    }
+
+    // suppress weird coms error
+    status->word &= ~PMBUS_SW_CML;
+
+    if (status->word & PMBUS_SW_VOUT) {
+        read_byte(PMBUS_STATUS_VOUT, &status->vout);
+    }
+    if (status->word & (PMBUS_SW_IOUT_POUT | PMBUS_SW_IOUT_OC)) {
+        read_byte(PMBUS_STATUS_IOUT, &status->iout);
+    }
+    if (status->word & (PMBUS_SW_INPUT | PMBUS_SW_VIN_UV)) {
+        read_byte(PMBUS_STATUS_INPUT, &status->input);
+    }
+    if (status->word & PMBUS_SW_TEMPERATURE) {
+        read_byte(PMBUS_STATUS_TEMPERATURE, &status->temperature);
+    }
+    if (status->word & PMBUS_SW_MFR) {
+        read_byte(PMBUS_STATUS_MFR_SPECIFIC, &status->mfr);
+    }
+    return true;
+}
@@ -3,6 +3,8 @@
 #include "driver/i2c.h"
 #include "esp_err.h"
 
+#include "pmbus_status.h"
+
 class TPS53647 {
 protected:
     uint8_t m_i2cAddr;
@@ -54,6 +56,9 @@ public:
 
     uint8_t get_status_byte();
 
+    // one read of STATUS_WORD, the detail registers only when it is set
+    bool read_status(VRStatus *status);
+
 };
 
 
@@ -757,6 +757,48 @@ void TPS546_print_status(void) {
     }
 }
 
+/**
+ * @brief Reads STATUS_WORD and the status registers it points at
+ */
+bool TPS546_read_status(VRStatus *status)
+{
+    memset(status, 0, sizeof(VRStatus));
+
+    if (!is_initialized) {
+        return false;
+    }
+
+    if (smb_read_word(PMBUS_STATUS_WORD, &status->word) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not read STATUS_WORD");
+        return false;
+    }
+
+    if (status->word & PMBUS_SW_VOUT) {
+        smb_read_byte(PMBUS_STATUS_VOUT, &status->vout);
+    }
+    if (status->word & (PMBUS_SW_IOUT_POUT | PMBUS_SW_IOUT_OC)) {
+        smb_read_byte(PMBUS_STATUS_IOUT, &status->iout);
+    }
+    if (status->word & (PMBUS_SW_INPUT | PMBUS_SW_VIN_UV)) {
+        smb_read_byte(PMBUS_STATUS_INPUT, &status->input);
+    }
+    if (status->word & PMBUS_SW_TEMPERATURE) {
+        smb_read_byte(PMBUS_STATUS_TEMPERATURE, &status->temperature);
+    }
+    if (status->word & PMBUS_SW_MFR) {
+        smb_read_byte(PMBUS_STATUS_MFR_SPECIFIC, &status->mfr);
+    }
+    return true;
+}
+
+/**
+ * @brief Clears the latched status bits, releases SMBALERT
+ */
+void TPS546_clear_faults(void)
+{
+    smb_write_command(PMBUS_CLEAR_FAULTS);
+}
+
 /**
  * @brief Sets the core voltage
  * this function controls the regulator ontput state
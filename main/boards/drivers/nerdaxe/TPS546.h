@@ -1,6 +1,8 @@
 #ifndef TPS546_H_
 #define TPS546_H_
 
+#include "pmbus_status.h"
+
 #define TPS546_I2CADDR         0x24  //< TPS546 i2c address
 #define TPS546_MANUFACTURER_ID 0xFE  //< Manufacturer ID
 #define TPS546_REVISION        0xFF  //< Chip revision
@@ -85,5 +87,7 @@ float TPS546_get_vout(void);
 bool TPS546_set_vout(float volts);
 void TPS546_show_voltage_settings(void);
 void TPS546_print_status(void);
+bool TPS546_read_status(VRStatus *status);
+void TPS546_clear_faults(void);
 
 #endif /* TPS546_H_ */
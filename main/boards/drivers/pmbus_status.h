@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+// STATUS_WORD, the low byte is STATUS_BYTE (PMBus part II, 17.1 and 17.2)
+#define PMBUS_SW_NONE_OF_ABOVE 0x0001
+#define PMBUS_SW_CML 0x0002
+#define PMBUS_SW_TEMPERATURE 0x0004
+#define PMBUS_SW_VIN_UV 0x0008
+#define PMBUS_SW_IOUT_OC 0x0010
+#define PMBUS_SW_VOUT_OV 0x0020
+#define PMBUS_SW_OFF 0x0040
+#define PMBUS_SW_BUSY 0x0080
+#define PMBUS_SW_UNKNOWN 0x0100
+#define PMBUS_SW_OTHER 0x0200
+#define PMBUS_SW_FANS 0x0400
+#define PMBUS_SW_POWER_GOOD_N 0x0800
+#define PMBUS_SW_MFR 0x1000
+#define PMBUS_SW_INPUT 0x2000
+#define PMBUS_SW_IOUT_POUT 0x4000
+#define PMBUS_SW_VOUT 0x8000
+
+// STATUS_VOUT
+#define PMBUS_VOUT_OV_FAULT 0x80
+#define PMBUS_VOUT_OV_WARN 0x40
+#define PMBUS_VOUT_UV_WARN 0x20
+#define PMBUS_VOUT_UV_FAULT 0x10
+
+// STATUS_IOUT
+#define PMBUS_IOUT_OC_FAULT 0x80
+#define PMBUS_IOUT_OC_LV_FAULT 0x40
+#define PMBUS_IOUT_OC_WARN 0x20
+
+// STATUS_INPUT
+#define PMBUS_INPUT_VIN_OV_FAULT 0x80
+#define PMBUS_INPUT_VIN_OV_WARN 0x40
+#define PMBUS_INPUT_VIN_UV_WARN 0x20
+#define PMBUS_INPUT_VIN_UV_FAULT 0x10
+#define PMBUS_INPUT_LOW_VIN_OFF 0x08
+#define PMBUS_INPUT_IIN_OC_FAULT 0x04
+#define PMBUS_INPUT_IIN_OC_WARN 0x02
+#define PMBUS_INPUT_PIN_OP_WARN 0x01
+
+// STATUS_TEMPERATURE
+#define PMBUS_TEMP_OT_FAULT 0x80
+#define PMBUS_TEMP_OT_WARN 0x40
+
+// status of a regulator, the detail registers are only read when
+// STATUS_WORD points at them and are 0 otherwise
+typedef struct
+{
+    uint16_t word;
+    uint8_t vout;
+    uint8_t iout;
+    uint8_t input;
+    uint8_t temperature;
+    uint8_t mfr;
+} VRStatus;
+
+// conditions the regulator shut down or will shut down for
+static inline bool pmbus_is_fault(const VRStatus *status)
+{
+    return (status->word & (PMBUS_SW_VIN_UV | PMBUS_SW_IOUT_OC | PMBUS_SW_VOUT_OV)) ||
+           (status->vout & (PMBUS_VOUT_OV_FAULT | PMBUS_VOUT_UV_FAULT)) ||
+           (status->iout & (PMBUS_IOUT_OC_FAULT | PMBUS_IOUT_OC_LV_FAULT)) ||
+           (status->input & (PMBUS_INPUT_VIN_OV_FAULT | PMBUS_INPUT_VIN_UV_FAULT | PMBUS_INPUT_IIN_OC_FAULT)) ||
+           (status->temperature & PMBUS_TEMP_OT_FAULT);
+}
+
+// a limit is close, the telemetry is polled faster
+static inline bool pmbus_is_warning(const VRStatus *status)
+{
+    return (status->vout & (PMBUS_VOUT_OV_WARN | PMBUS_VOUT_UV_WARN)) || (status->iout & PMBUS_IOUT_OC_WARN) ||
+           (status->input & (PMBUS_INPUT_VIN_OV_WARN | PMBUS_INPUT_VIN_UV_WARN | PMBUS_INPUT_IIN_OC_WARN |
+                             PMBUS_INPUT_PIN_OP_WARN)) ||
+           (status->temperature & PMBUS_TEMP_OT_WARN);
+}
@@ -10,6 +10,7 @@
 #include "board.h"
 #include "nerdaxe.h"
 #include "nvs_config.h"
+#include "task_topology.h"
 #include "../displays/displayDriver.h"
 
 #include "drivers/nerdaxe/DS4432U.h"
@@ -38,6 +39,7 @@ NerdAxe::NerdAxe() : Board() {
     m_asicModel = "BM1366";
     m_asicCount = 1;
     m_asicJobIntervalMs = 1500;
+    m_miningCore = TASK_TOPOLOGY_UNPINNED; // a single ASIC keeps the mining tasks idle most of the time
     m_asicFrequencies = {400, 425, 450, 475, 485, 500, 525, 550, 575};
     m_asicVoltages = {1100, 1150, 1200, 1250, 1300};
     m_defaultAsicFrequency = m_asicFrequency = 485;
@@ -159,11 +161,11 @@ bool NerdAxe::initAsics()
         ESP_LOGE(TAG, "error initializing asics!");
         return false;
     }
-    int maxBaud = m_asics->setMaxBaud();
-    // no idea why a delay is needed here starting with esp-idf 5.4 🙈
-    vTaskDelay(pdMS_TO_TICKS(500));
-    SERIAL_set_baud(maxBaud);
-    SERIAL_clear_buffer();
+    m_asicBaud = m_asics->negotiateBaud(m_chipsDetected, m_asicMaxBaud);
+    if (!m_asicBaud) {
+        ESP_LOGE(TAG, "error negotiating the uart baud!");
+        return false;
+    }
 
     vTaskDelay(pdMS_TO_TICKS(500));
 
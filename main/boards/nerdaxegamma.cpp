@@ -129,11 +129,11 @@ bool NerdaxeGamma::initAsics() {
         ESP_LOGE(TAG, "error initializing asics!");
         return false;
     }
-    int maxBaud = m_asics->setMaxBaud();
-    // no idea why a delay is needed here starting with esp-idf 5.4 🙈
-    vTaskDelay(pdMS_TO_TICKS(500));
-    SERIAL_set_baud(maxBaud);
-    SERIAL_clear_buffer();
+    m_asicBaud = m_asics->negotiateBaud(m_chipsDetected, m_asicMaxBaud);
+    if (!m_asicBaud) {
+        ESP_LOGE(TAG, "error negotiating the uart baud!");
+        return false;
+    }
 
     vTaskDelay(pdMS_TO_TICKS(500));
 
@@ -198,3 +198,11 @@ float NerdaxeGamma::getPout() {
     return getPin();
 }
 
+bool NerdaxeGamma::readVRStatus(VRStatus *status) {
+    return TPS546_read_status(status);
+}
+
+void NerdaxeGamma::clearVRFaults() {
+    TPS546_clear_faults();
+}
+
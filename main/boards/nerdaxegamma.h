@@ -29,4 +29,7 @@ class NerdaxeGamma : public NerdAxe {
     virtual float getVout();
     virtual float getIout();
     virtual float getPout();
+
+    virtual bool readVRStatus(VRStatus *status);
+    virtual void clearVRFaults();
 };
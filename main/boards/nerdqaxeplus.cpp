@@ -154,11 +154,11 @@ bool NerdQaxePlus::initAsics()
         ESP_LOGE(TAG, "error initializing asics!");
         return false;
     }
-    int maxBaud = m_asics->setMaxBaud();
-    // no idea why a delay is needed here starting with esp-idf 5.4 🙈
-    vTaskDelay(pdMS_TO_TICKS(500));
-    SERIAL_set_baud(maxBaud);
-    SERIAL_clear_buffer();
+    m_asicBaud = m_asics->negotiateBaud(m_chipsDetected, m_asicMaxBaud);
+    if (!m_asicBaud) {
+        ESP_LOGE(TAG, "error negotiating the uart baud!");
+        return false;
+    }
 
     vTaskDelay(pdMS_TO_TICKS(500));
 
@@ -281,6 +281,14 @@ bool NerdQaxePlus::getPSUFault() {
     return ((vid == 0x97) || (status_byte & 0x08));
 }
 
+bool NerdQaxePlus::readVRStatus(VRStatus *status) {
+    return m_tps->read_status(status);
+}
+
+void NerdQaxePlus::clearVRFaults() {
+    m_tps->clear_faults();
+}
+
 bool NerdQaxePlus::selfTest(){
     //Test Core Voltage
     #define CORE_VOLTAGE_TARGET_MIN 1.1 //mV
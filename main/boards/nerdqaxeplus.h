@@ -46,5 +46,7 @@ class NerdQaxePlus : public Board {
     virtual void requestBuckTelemtry();
 
     virtual bool getPSUFault();
+    virtual bool readVRStatus(VRStatus *status);
+    virtual void clearVRFaults();
     virtual bool selfTest();
 };
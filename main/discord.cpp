@@ -4,9 +4,12 @@
 #include "esp_crt_bundle.h"
 #include "esp_http_client.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_config.h"
 #include "connect.h"
 
+#include "ArduinoJson.h"
+#include "psram_allocator.h"
 #include "global_state.h"
 
 static const char *TAG = "discord";
@@ -39,111 +42,233 @@ Alerter::Alerter() : m_messageBuffer(nullptr), m_payloadBuffer(nullptr), m_enabl
 }
 
 void Alerter::init() {
+    m_textBuffer = (char *) MALLOC(messageBufferSize);
     m_messageBuffer = (char *) MALLOC(messageBufferSize);
     m_payloadBuffer = (char *) MALLOC(payloadBufferSize);
 }
 
-DiscordAlerter::DiscordAlerter() : Alerter(), m_webhookUrl(nullptr)
+void Alerter::closeClient()
 {
-    // NOP
+    if (m_client) {
+        esp_http_client_cleanup(m_client);
+        m_client = nullptr;
+    }
 }
 
-void DiscordAlerter::loadConfig()
+void Alerter::closeIdle()
 {
-    if (m_webhookUrl) {
-        free(m_webhookUrl);
-        m_webhookUrl = nullptr;
+    pthread_mutex_lock(&m_lock);
+    if (m_client && esp_timer_get_time() - m_lastUseUs > ALERT_IDLE_CLOSE_US) {
+        ESP_LOGD(TAG, "closing idle webhook connection");
+        closeClient();
     }
-
-    m_webhookUrl = Config::getDiscordWebhook();
-    m_enabled = Config::isDiscordAlertEnabled();
-}
-
-void DiscordAlerter::init() {
-    Alerter::init();
+    pthread_mutex_unlock(&m_lock);
 }
 
-bool DiscordAlerter::sendRaw(const char *message)
+// POSTs the payload on the kept-alive connection. When the server closed it
+// in the meantime the first attempt fails and the second one reconnects.
+bool Alerter::post(const char *url, const char *payload)
 {
-    if (m_webhookUrl == nullptr || message == nullptr) {
-        ESP_LOGE(TAG, "Webhook URL or message is null");
-        return false;
-    }
+    bool ok = false;
 
-    if (!m_payloadBuffer) {
-        ESP_LOGE(TAG, "payload buffer is nullptr");
-    }
+    for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+        if (!m_client) {
+            esp_http_client_config_t config = {};
+            config.url = url;
+            config.method = HTTP_METHOD_POST;
+            config.timeout_ms = 5000;
+            config.keep_alive_enable = true;
+            config.crt_bundle_attach = esp_crt_bundle_attach;
 
-    ESP_LOGI(TAG, "discord message: %s", message);
+            m_client = esp_http_client_init(&config);
+            if (m_client == nullptr) {
+                ESP_LOGE(TAG, "Failed to init HTTP client");
+                break;
+            }
+            esp_http_client_set_header(m_client, "Content-Type", "application/json");
+        } else {
+            esp_http_client_set_url(m_client, url);
+        }
 
-    snprintf(m_payloadBuffer, payloadBufferSize - 1, "{\"content\": \"%s\"}", message);
+        esp_http_client_set_method(m_client, HTTP_METHOD_POST);
+        esp_http_client_set_post_field(m_client, payload, strlen(payload));
 
-    ESP_LOGD(TAG, "discord payload: %s", m_payloadBuffer);
+        esp_err_t err = esp_http_client_perform(m_client);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
+            closeClient();
+            continue;
+        }
+
+        int status = esp_http_client_get_status_code(m_client);
+        if (status < 200 || status >= 300) {
+            // e.g. 429 when Discord rate limits, a retry doesn't help
+            ESP_LOGE(TAG, "webhook responded with HTTP %d", status);
+            break;
+        }
+        ESP_LOGI(TAG, "alert sent (HTTP %d)", status);
+        ok = true;
+    }
 
-    esp_http_client_config_t config = {};
-    config.url = m_webhookUrl;
-    config.method = HTTP_METHOD_POST;
-    config.timeout_ms = 5000;
-    config.crt_bundle_attach = esp_crt_bundle_attach;
+    m_lastUseUs = esp_timer_get_time();
+    return ok;
+}
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (client == nullptr) {
-        ESP_LOGE(TAG, "Failed to init HTTP client");
+bool Alerter::sendTestMessage()
+{
+    pthread_mutex_lock(&m_lock);
+    bool ok = m_payloadBuffer && deliver("This is a test message!", nullptr, 0);
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
+
+bool Alerter::sendMessage(const char *message)
+{
+    if (!m_enabled) {
+        ESP_LOGI(TAG, "Alert disabled – skipping send");
         return false;
     }
 
-    esp_http_client_set_method(client, HTTP_METHOD_POST);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_post_field(client, m_payloadBuffer, strlen(m_payloadBuffer));
+    pthread_mutex_lock(&m_lock);
+    bool ok = m_payloadBuffer && deliver(message, nullptr, 0);
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
 
-    esp_err_t err = esp_http_client_perform(client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP POST failed: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
+bool Alerter::sendDigest(const AlertEntry *entries, int numEntries)
+{
+    if (!m_enabled || !numEntries) {
         return false;
     }
 
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
-
-    if (status >= 200 && status < 300) {
-        ESP_LOGI(TAG, "Discord message sent successfully (HTTP %d)", status);
-        return true;
-    } else {
-        ESP_LOGE(TAG, "Discord responded with HTTP %d", status);
+    pthread_mutex_lock(&m_lock);
+    if (!m_textBuffer || !m_payloadBuffer) {
+        pthread_mutex_unlock(&m_lock);
         return false;
     }
+
+    int64_t now = esp_timer_get_time();
+    size_t len = 0;
+    if (numEntries > 1) {
+        len = snprintf(m_textBuffer, messageBufferSize, "%d alerts:\n", numEntries);
+    }
+    for (int i = 0; i < numEntries && len < messageBufferSize; i++) {
+        const AlertEntry *entry = &entries[i];
+        len += snprintf(m_textBuffer + len, messageBufferSize - len, "%s**%s**: %s", numEntries > 1 ? "- " : "", entry->title,
+                        entry->message);
+        if (len < messageBufferSize && entry->count > 1) {
+            len += snprintf(m_textBuffer + len, messageBufferSize - len, " (%u times, last %llds ago)", entry->count,
+                            (long long) ((now - entry->lastUs) / 1000000));
+        }
+        if (len + 1 < messageBufferSize && i + 1 < numEntries) {
+            m_textBuffer[len++] = '\n';
+            m_textBuffer[len] = 0;
+        }
+    }
+
+    bool ok = deliver(m_textBuffer, entries, numEntries);
+    pthread_mutex_unlock(&m_lock);
+    return ok;
 }
 
-bool DiscordAlerter::sendMessage(const char *message)
+DiscordAlerter::DiscordAlerter() : Alerter(), m_webhookUrl(nullptr)
 {
-    if (!m_enabled) {
-        ESP_LOGI(TAG, "Alert disabled – skipping Discord send");
-        return false;
+    // NOP
+}
+
+void DiscordAlerter::loadConfig()
+{
+    pthread_mutex_lock(&m_lock);
+    if (m_webhookUrl) {
+        free(m_webhookUrl);
+        m_webhookUrl = nullptr;
     }
 
-    if (!m_messageBuffer) {
-        ESP_LOGE(TAG, "message buffer is nullptr");
+    m_webhookUrl = Config::getDiscordWebhook();
+    m_enabled = Config::isDiscordAlertEnabled();
+
+    // the url may point somewhere else now
+    closeClient();
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool DiscordAlerter::deliver(const char *text, const AlertEntry *entries, int numEntries)
+{
+    if (m_webhookUrl == nullptr || !*m_webhookUrl) {
+        ESP_LOGE(TAG, "Webhook URL is not set");
         return false;
     }
 
     char ip[20] = {0};
     connect_get_ip_addr(ip, sizeof(ip));
-    //ESP_LOGI(TAG, "IP: %s", ip);
     const char *mac = SYSTEM_MODULE.getMacAddress();
-    //ESP_LOGI(TAG, "MAC: %s", mac);
     char *hostname = Config::getHostname();
-    //ESP_LOGI(TAG, "Hostname: %s", hostname);
 
-    snprintf(m_messageBuffer, messageBufferSize - 1, "%s\\n```\\nHostname: %s\\nIP:       %s\\nMAC:      %s\\n```", message,
+    snprintf(m_messageBuffer, messageBufferSize, "%s\n```\nHostname: %s\nIP:       %s\nMAC:      %s\n```", text,
              hostname ? hostname : "unknown", ip, mac ? mac : "unknown");
 
     free(hostname);
 
-    return sendRaw(m_messageBuffer);
+    ESP_LOGI(TAG, "discord message: %s", m_messageBuffer);
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    doc["content"] = (const char *) m_messageBuffer;
+    serializeJson(doc, m_payloadBuffer, payloadBufferSize);
+
+    ESP_LOGD(TAG, "discord payload: %s", m_payloadBuffer);
+
+    return post(m_webhookUrl, m_payloadBuffer);
+}
+
+WebhookAlerter::WebhookAlerter() : Alerter(), m_url(nullptr)
+{
+    // NOP
+}
+
+void WebhookAlerter::loadConfig()
+{
+    pthread_mutex_lock(&m_lock);
+    free(m_url);
+    m_url = Config::getAlertWebhook();
+    m_enabled = Config::isAlertWebhookEnabled();
+    closeClient();
+    pthread_mutex_unlock(&m_lock);
 }
 
-bool DiscordAlerter::sendTestMessage()
+bool WebhookAlerter::deliver(const char *text, const AlertEntry *entries, int numEntries)
 {
-    return sendRaw("This is a test message!");
+    if (m_url == nullptr || !*m_url) {
+        ESP_LOGE(TAG, "Webhook URL is not set");
+        return false;
+    }
+
+    char ip[20] = {0};
+    connect_get_ip_addr(ip, sizeof(ip));
+    const char *mac = SYSTEM_MODULE.getMacAddress();
+    int64_t now = esp_timer_get_time();
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    doc["hostname"] = SYSTEM_MODULE.getHostname();
+    doc["ip"] = (const char *) ip;
+    doc["mac"] = mac ? mac : "unknown";
+    doc["text"] = text;
+
+    JsonArray events = doc["events"].to<JsonArray>();
+    for (int i = 0; i < numEntries; i++) {
+        JsonObject event = events.add<JsonObject>();
+        event["type"] = entries[i].type;
+        event["count"] = entries[i].count;
+        event["ageS"] = (now - entries[i].lastUs) / 1000000;
+        event["message"] = entries[i].message;
+    }
+
+    if (measureJson(doc) >= payloadBufferSize) {
+        ESP_LOGE(TAG, "webhook payload too long");
+        return false;
+    }
+    serializeJson(doc, m_payloadBuffer, payloadBufferSize);
+
+    return post(m_url, m_payloadBuffer);
 }
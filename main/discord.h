@@ -1,36 +1,90 @@
 #pragma once
 
+#include <pthread.h>
+#include <stdint.h>
+
+#include "esp_http_client.h"
+
+// the connection to the webhook is closed after this long without a message
+#define ALERT_IDLE_CLOSE_US (120ll * 1000000ll)
+
+// one event type of a digest, see AlertEngine
+typedef struct
+{
+    const char *type;  // "overheat"
+    const char *title; // "Overheat"
+    uint16_t count;    // events since the last digest, suppressed ones included
+    int64_t lastUs;
+    const char *message; // text of the last event
+} AlertEntry;
+
 class Alerter {
   protected:
-    static constexpr uint32_t messageBufferSize = 700;
-    static constexpr uint32_t payloadBufferSize = 768;
+    // Discord allows 2000 characters
+    static constexpr uint32_t messageBufferSize = 1800;
+    static constexpr uint32_t payloadBufferSize = 2048;
 
-    char* m_messageBuffer = nullptr;
-    char* m_payloadBuffer = nullptr;
+    char* m_textBuffer = nullptr;    // digest text
+    char* m_messageBuffer = nullptr; // text with the device info
+    char* m_payloadBuffer = nullptr; // JSON
 
     bool m_enabled = false;
 
+    // the client (and with it the TLS session) is kept open between messages,
+    // the lock also protects the buffers
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    esp_http_client_handle_t m_client = nullptr;
+    int64_t m_lastUseUs = 0;
+
+    // called with the lock held, entries are nullptr for a plain message
+    virtual bool deliver(const char *text, const AlertEntry *entries, int numEntries) = 0;
+
+    bool post(const char *url, const char *payload);
+    void closeClient();
+
   public:
     Alerter();
 
     virtual void init();
-
     virtual void loadConfig() = 0;
-    virtual bool sendTestMessage() = 0;
-    virtual bool sendMessage(const char* message) = 0;
+
+    bool sendTestMessage();
+    bool sendMessage(const char* message);
+    bool sendDigest(const AlertEntry *entries, int numEntries);
+
+    bool isEnabled()
+    {
+        return m_enabled;
+    }
+
+    // closes the connection when it wasn't used for ALERT_IDLE_CLOSE_US
+    void closeIdle();
 };
 
 class DiscordAlerter : public Alerter {
   protected:
     char *m_webhookUrl = nullptr;
 
-    bool sendRaw(const char* message);
+    virtual bool deliver(const char *text, const AlertEntry *entries, int numEntries);
 
   public:
     DiscordAlerter();
 
-    virtual void init();
     virtual void loadConfig();
-    virtual bool sendTestMessage();
-    virtual bool sendMessage(const char* message);
+};
+
+// generic JSON webhook, e.g. for Home Assistant, ntfy or Node-RED:
+//
+//   {"hostname": "...", "ip": "...", "mac": "...", "text": "...",
+//    "events": [{"type": "overheat", "count": 2, "ageS": 30, "message": "..."}]}
+class WebhookAlerter : public Alerter {
+  protected:
+    char *m_url = nullptr;
+
+    virtual bool deliver(const char *text, const AlertEntry *entries, int numEntries);
+
+  public:
+    WebhookAlerter();
+
+    virtual void loadConfig();
 };
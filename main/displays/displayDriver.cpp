@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <atomic>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "lv_conf.h"
 
@@ -17,7 +20,11 @@
 #include "ui.h"
 #include "ui_helpers.h"
 #include "global_state.h"
+#include "history.h"
 #include "system.h"
+#include "task_topology.h"
+#include "metrics.h"
+#include "profiler.h"
 
 #include "nvs_config.h"
 #include "displayDriver.h"
@@ -26,10 +33,31 @@
 
 static const char *TAG = "TDisplayS3";
 
+static Counter s_frames("display_frames", "Display refreshes rendered by LVGL");
+static HistogramN<10> s_renderTime("display_render_ms", "Time to render and flush one refresh", METRICS_LATENCY_MS_BUCKETS);
+static Counter s_flushes("display_flushes", "Areas sent to the panel");
+static Counter s_flushBytes("display_flush_bytes", "Bytes sent to the panel over the i80 bus");
+static Counter s_busTime("display_bus_us", "Time the i80 bus was busy with flushes");
+static Counter s_labelsChanged("display_label_updates", "Label updates", "result=\"changed\"");
+static Counter s_labelsUnchanged("display_label_updates", "Label updates", "result=\"unchanged\"");
+
+// start and end of the last transfer, the end is set in the DMA done ISR
+static uint32_t s_flushStartUs = 0;
+static std::atomic<uint32_t> s_flushEndUs{0};
+static bool s_flushPending = false;
+
+static Counter s_wakeupsButton("display_wakeups", "Wakeups of the LVGL task", "reason=\"button\"");
+static Counter s_wakeupsUpdate("display_wakeups", "Wakeups of the LVGL task", "reason=\"update\"");
+static Counter s_wakeupsTimer("display_wakeups", "Wakeups of the LVGL task", "reason=\"timer\"");
+static Counter s_buttonBounces("display_button_bounces", "Button edges ignored as contact bounce");
+static TaskLoop s_loop("display");
+
+// the splash screens and the auto off countdown need the task to wake up regularly
+#define SPLASH_POLL_MS 100
+#define AUTO_OFF_POLL_MS 1000
+
 DisplayDriver::DisplayDriver() {
-    m_animationsEnabled = false;
-    m_button1PressedFlag = false;
-    m_button2PressedFlag = false;
+    m_lvglTask = NULL;
     m_lastKeypressTime = 0;
     m_displayIsOn = false;
     m_screenStatus = STATE_ONINIT;
@@ -39,10 +67,41 @@ DisplayDriver::DisplayDriver() {
     m_btcPrice = 0;
     m_blockHeight = 0;
     m_isActiveOverlay = false;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&m_lvglLock, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void DisplayDriver::lock()
+{
+    pthread_mutex_lock(&m_lvglLock);
+}
+
+void DisplayDriver::unlock()
+{
+    pthread_mutex_unlock(&m_lvglLock);
+}
+
+void DisplayDriver::notify(uint32_t events)
+{
+    if (!m_lvglTask) {
+        return;
+    }
+    if (xPortInIsrContext()) {
+        BaseType_t woken = pdFALSE;
+        xTaskNotifyFromISR(m_lvglTask, events, eSetBits, &woken);
+        portYIELD_FROM_ISR(woken);
+    } else {
+        xTaskNotify(m_lvglTask, events, eSetBits);
+    }
 }
 
 bool DisplayDriver::notifyLvglFlushReady(esp_lcd_panel_io_handle_t panelIo, esp_lcd_panel_io_event_data_t* edata,
                                    void* userCtx) {
+    s_flushEndUs.store((uint32_t) esp_timer_get_time(), std::memory_order_relaxed);
     lv_disp_drv_t* dispDriver = (lv_disp_drv_t*)userCtx;
     lv_disp_flush_ready(dispDriver);
     return false;
@@ -54,10 +113,38 @@ void DisplayDriver::lvglFlushCallback(lv_disp_drv_t* drv, const lv_area_t* area,
     int offsetx2 = area->x2;
     int offsety1 = area->y1;
     int offsety2 = area->y2;
-    // Copy buffer content to the display
+
+    // LVGL waits for the previous transfer before it flushes the other buffer,
+    // so it is done and can be accounted here instead of in the ISR
+    if (s_flushPending) {
+        s_busTime.inc(s_flushEndUs.load(std::memory_order_relaxed) - s_flushStartUs);
+    }
+    s_flushes.inc();
+    s_flushBytes.inc((uint64_t) (offsetx2 - offsetx1 + 1) * (offsety2 - offsety1 + 1) * sizeof(lv_color_t));
+    s_flushStartUs = (uint32_t) esp_timer_get_time();
+    s_flushPending = true;
+
+    // queues the DMA transfer, LVGL renders into the other buffer meanwhile
     esp_lcd_panel_draw_bitmap(panelHandle, offsetx1, offsety1, offsetx2 + 1, offsety2 + 1, colorMap);
 }
 
+void DisplayDriver::lvglMonitorCallback(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    s_frames.inc();
+    s_renderTime.observe((float) time);
+}
+
+void DisplayDriver::setLabel(lv_obj_t *label, const char *text)
+{
+    const char *current = lv_label_get_text(label);
+    if (current && !strcmp(current, text)) {
+        s_labelsUnchanged.inc();
+        return;
+    }
+    s_labelsChanged.inc();
+    lv_label_set_text(label, text);
+}
+
 /************ DISPLAY TURN ON/OFF FUNCTIONS *************/
 void DisplayDriver::displayTurnOff(void) {
     if (!m_displayIsOn) {
@@ -77,6 +164,9 @@ void DisplayDriver::displayTurnOn(void) {
     gpio_set_level(TDISPLAYS3_PIN_NUM_BK_LIGHT, TDISPLAYS3_LCD_BK_LIGHT_ON_LEVEL);
     ESP_LOGI(TAG, "Screen on");
     m_displayIsOn = true;
+
+    // nothing was rendered while the display was off
+    lv_obj_invalidate(lv_scr_act());
 }
 
 /************ AUTO TURN OFF DISPLAY FUNCTIONS *************/
@@ -133,46 +223,50 @@ void DisplayDriver::checkAutoTurnOffScreen(void) {
     }
 }
 
-void DisplayDriver::increaseLvglTick() {
-    lv_tick_inc(TDISPLAYS3_LVGL_TICK_PERIOD_MS);
-}
-
 // Refresh screen values
 void DisplayDriver::refreshScreen(void) {
-    lv_timer_handler();
-    increaseLvglTick();
+    notify(DISPLAY_EVENT_UPDATE);
 }
 
 void DisplayDriver::showError(const char *error_message, uint32_t error_code) {
+    lock();
     // hide the overlay and free the memory in case it was open
     m_ui->hideErrorOverlay();
 
     // now show the (new) error overlay
     m_ui->showErrorOverlay(error_message, error_code);
     m_isActiveOverlay = true;
+    unlock();
     refreshScreen();
 }
 
 void DisplayDriver::hideError() {
+    lock();
     // hide the overlay and free the memory
     m_ui->hideErrorOverlay();
     m_isActiveOverlay = false;
+    unlock();
+    refreshScreen();
 }
 
 void DisplayDriver::showFoundBlockOverlay() {
+    lock();
     // hide the overlay and free the memory in case it was open
     m_ui->hideImageOverlay();
 
     // now show the (new) image overlay
     m_ui->showImageOverlay(&ui_img_found_block_png);
     m_isActiveOverlay = true;
+    unlock();
     refreshScreen();
 }
 
 void DisplayDriver::hideFoundBlockOverlay() {
+    lock();
     // hide the overlay and free the memory
     m_ui->hideImageOverlay();
     m_isActiveOverlay = false;
+    unlock();
 }
 
 void DisplayDriver::changeScreen(void) {
@@ -194,6 +288,20 @@ void DisplayDriver::changeScreen(void) {
         m_screenStatus = SCREEN_GLBSTATS;
         ESP_LOGI("UI", "New Screen Global Stats displayed");
     } else if (m_screenStatus == SCREEN_GLBSTATS) {
+        if (m_ui->ui_ChartScreen == NULL)
+            m_ui->chartScreenInit();
+        showChart(SYSTEM_MODULE.getHistory()->getTier1h(), "1h");
+        enableLvglAnimations(true);
+        _ui_screen_change(m_ui->ui_ChartScreen, LV_SCR_LOAD_ANIM_MOVE_LEFT, 350, 0);
+        m_screenStatus = SCREEN_CHART1H;
+        ESP_LOGI("UI", "New Screen Chart 1h displayed");
+    } else if (m_screenStatus == SCREEN_CHART1H) {
+        // same screen, only the data changes
+        showChart(SYSTEM_MODULE.getHistory()->getTier1d(), "24h");
+        m_screenStatus = SCREEN_CHART1D;
+        ESP_LOGI("UI", "New Screen Chart 24h displayed");
+    } else if (m_screenStatus == SCREEN_CHART1D) {
+        m_chartTier = nullptr;
         enableLvglAnimations(true);
         _ui_screen_change(m_ui->ui_MiningScreen, LV_SCR_LOAD_ANIM_MOVE_RIGHT, 350, 0);
         m_screenStatus = SCREEN_MINING;
@@ -201,6 +309,90 @@ void DisplayDriver::changeScreen(void) {
     }
 }
 
+// sets the range of the axis to the values of the series with some margin
+static void chartAutoRange(lv_obj_t *chart, lv_chart_series_t *series, lv_chart_axis_t axis)
+{
+    lv_coord_t *values = lv_chart_get_y_array(chart, series);
+    uint16_t count = lv_chart_get_point_count(chart);
+    lv_coord_t min = LV_COORD_MAX;
+    lv_coord_t max = LV_COORD_MIN;
+    for (uint16_t i = 0; i < count; i++) {
+        if (values[i] == LV_CHART_POINT_NONE) {
+            continue;
+        }
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+    if (min > max) {
+        return;
+    }
+    lv_coord_t margin = std::max((max - min) / 10, 1);
+    lv_chart_set_range(chart, axis, std::max(min - margin, 0), max + margin);
+}
+
+static lv_coord_t chartValue(float value)
+{
+    return (lv_coord_t) std::min(std::max(value + 0.5f, 0.0f), (float) LV_COORD_MAX);
+}
+
+void DisplayDriver::showChart(HistoryTier *tier, const char *title)
+{
+    lv_label_set_text(m_ui->ui_lblChartTitle, title);
+
+    uint16_t count = tier->getMaxPoints();
+    lv_chart_set_point_count(m_ui->ui_chartHashrate, count);
+    lv_chart_set_point_count(m_ui->ui_chartTempPower, count);
+    lv_chart_set_all_value(m_ui->ui_chartHashrate, m_ui->ui_serHashrate, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(m_ui->ui_chartTempPower, m_ui->ui_serTemp, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(m_ui->ui_chartTempPower, m_ui->ui_serPower, LV_CHART_POINT_NONE);
+    setLabel(m_ui->ui_lblChartValues, "");
+
+    m_chartTier = tier;
+    m_chartNextPoint = 0;
+    updateChart();
+}
+
+void DisplayDriver::updateChart()
+{
+    if (!m_chartTier) {
+        return;
+    }
+
+    // copy the new points so the history (and the share processing) isn't
+    // blocked while the charts are updated
+    history_point_t points[HISTORY_TIER_MAX_POINTS];
+    int numPoints = 0;
+
+    History *history = SYSTEM_MODULE.getHistory();
+    history->lock();
+    // points that dropped out of the tier are skipped
+    m_chartNextPoint = std::max(m_chartNextPoint, m_chartTier->getFirstPoint());
+    for (; m_chartNextPoint < m_chartTier->getNumPoints(); m_chartNextPoint++) {
+        points[numPoints++] = m_chartTier->getPoint(m_chartNextPoint);
+    }
+    history->unlock();
+
+    if (!numPoints) {
+        return;
+    }
+
+    for (int i = 0; i < numPoints; i++) {
+        lv_chart_set_next_value(m_ui->ui_chartHashrate, m_ui->ui_serHashrate, chartValue(points[i].hashrate));
+        lv_chart_set_next_value(m_ui->ui_chartTempPower, m_ui->ui_serTemp, chartValue(points[i].temp));
+        lv_chart_set_next_value(m_ui->ui_chartTempPower, m_ui->ui_serPower, chartValue(points[i].power));
+    }
+
+    chartAutoRange(m_ui->ui_chartHashrate, m_ui->ui_serHashrate, LV_CHART_AXIS_PRIMARY_Y);
+    chartAutoRange(m_ui->ui_chartTempPower, m_ui->ui_serTemp, LV_CHART_AXIS_PRIMARY_Y);
+    chartAutoRange(m_ui->ui_chartTempPower, m_ui->ui_serPower, LV_CHART_AXIS_SECONDARY_Y);
+
+    const history_point_t &last = points[numPoints - 1];
+    char strData[64];
+    snprintf(strData, sizeof(strData), "#F7931A %.0fGH/s#  #FF5050 %.0fC#  #3DB8FF %.1fW#", last.hashrate, last.temp,
+             last.power);
+    setLabel(m_ui->ui_lblChartValues, strData);
+}
+
 void DisplayDriver::lvglTimerTaskWrapper(void *param) {
     DisplayDriver *display = (DisplayDriver*) param;
     display->lvglTimerTask(NULL);
@@ -209,48 +401,44 @@ void DisplayDriver::lvglTimerTaskWrapper(void *param) {
 void DisplayDriver::lvglTimerTask(void *param)
 {
     int64_t myLastTime = esp_timer_get_time();
+    int64_t lastTick = myLastTime;
     bool autoOffEnabled = Config::isAutoScreenOffEnabled();
-    // int64_t current_time = esp_timer_get_time();
 
+    lock();
     displayTurnOn();
+    unlock();
 
-    // Check if screen is changing to avoid problems during change
-    // if ((current_time - last_screen_change_time) < 1500000) return; // 1500000 microsegundos = 1500 ms = 1.5s - No cambies
-    // pantalla last_screen_change_time = current_time;
-
-    int32_t elapsed_Ani_cycles = 0;
+    // the task sleeps until a button is pressed, the content changed or LVGL has a timer due
+    uint32_t waitMs = 0;
     while (1) {
-
-        // Enabled when change screen animation is activated
-        if (m_animationsEnabled) {
-            increaseLvglTick();
-            lv_timer_handler();                 // Process pending LVGL tasks
-            vTaskDelay(pdMS_TO_TICKS(5)); // Delay during animations
-            if (elapsed_Ani_cycles++ > 80) {
-                // After 1s aprox stop animations
-                m_animationsEnabled = false;
-                elapsed_Ani_cycles = 0;
-            }
+        uint32_t events = 0;
+        TickType_t timeout = (waitMs == LV_NO_TIMER_READY) ? portMAX_DELAY : pdMS_TO_TICKS(waitMs);
+        if (xTaskNotifyWait(0, UINT32_MAX, &events, timeout) != pdTRUE) {
+            s_wakeupsTimer.inc();
+        } else if (events & (DISPLAY_EVENT_BUTTON1 | DISPLAY_EVENT_BUTTON2)) {
+            s_wakeupsButton.inc();
         } else {
-            if (m_button1PressedFlag) {
-                m_button1PressedFlag = false;
-                m_lastKeypressTime = esp_timer_get_time();
+            s_wakeupsUpdate.inc();
+        }
 
-                if (m_isActiveOverlay) {
-                    hideFoundBlockOverlay();
-                } else {
-                    if (!m_displayIsOn) {
-                        displayTurnOn();
-                    }
-                    changeScreen();
+        int64_t start = esp_timer_get_time();
+        lock();
+
+        if (events & DISPLAY_EVENT_BUTTON1) {
+            m_lastKeypressTime = start;
+
+            if (m_isActiveOverlay) {
+                hideFoundBlockOverlay();
+            } else {
+                if (!m_displayIsOn) {
+                    displayTurnOn();
                 }
+                changeScreen();
             }
-            vTaskDelay(pdMS_TO_TICKS(200)); // Delay waiting animation trigger
         }
 
-        if (m_button2PressedFlag) {
-            m_button2PressedFlag = false;
-            m_lastKeypressTime = esp_timer_get_time();
+        if (events & DISPLAY_EVENT_BUTTON2) {
+            m_lastKeypressTime = start;
 
             if (m_displayIsOn) {
                 if (m_isActiveOverlay) {
@@ -263,7 +451,6 @@ void DisplayDriver::lvglTimerTask(void *param)
             }
         }
 
-
         // Check if we have a screen turned-on override
         if (m_isActiveOverlay) {
             displayTurnOn();
@@ -272,81 +459,102 @@ void DisplayDriver::lvglTimerTask(void *param)
             checkAutoTurnOffScreen();
         }
 
-        if ((m_screenStatus > STATE_INIT_OK))
-            continue; // Doesn't need to do the initial animation screens
-
-        // Screen initial process
-        int32_t elapsed = (esp_timer_get_time() - myLastTime) / 1000;
-        switch (m_screenStatus) {
-        case STATE_ONINIT: // First splash Screen
-            if (elapsed > 3000) {
-                ESP_LOGI(TAG, "Changing Screen to SPLASH2");
-                if (m_ui->ui_Splash2 == NULL)
-                    m_ui->splash2ScreenInit();
-                enableLvglAnimations(true);
-                _ui_screen_change(m_ui->ui_Splash2, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
-                m_screenStatus = STATE_SPLASH1;
-                myLastTime = esp_timer_get_time();
+        if (m_screenStatus <= STATE_INIT_OK) {
+            splashScreens(&myLastTime);
+        }
+
+        // LVGL runs on real time, nothing is rendered while the display is off
+        lv_tick_inc((uint32_t) ((start - lastTick) / 1000));
+        lastTick += ((start - lastTick) / 1000) * 1000;
+        waitMs = m_displayIsOn ? lv_timer_handler() : LV_NO_TIMER_READY;
+
+        unlock();
+        s_loop.record(esp_timer_get_time() - start);
+
+        if (m_screenStatus <= STATE_INIT_OK) {
+            waitMs = std::min(waitMs, (uint32_t) SPLASH_POLL_MS);
+        } else if (m_displayIsOn && (autoOffEnabled || m_countdownActive)) {
+            waitMs = std::min(waitMs, (uint32_t) AUTO_OFF_POLL_MS);
+        }
+    }
+}
+
+void DisplayDriver::splashScreens(int64_t *myLastTime)
+{
+    // Screen initial process
+    int32_t elapsed = (esp_timer_get_time() - *myLastTime) / 1000;
+    switch (m_screenStatus) {
+    case STATE_ONINIT: // First splash Screen
+        if (elapsed > 3000) {
+            ESP_LOGI(TAG, "Changing Screen to SPLASH2");
+            if (m_ui->ui_Splash2 == NULL)
+                m_ui->splash2ScreenInit();
+            enableLvglAnimations(true);
+            _ui_screen_change(m_ui->ui_Splash2, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
+            m_screenStatus = STATE_SPLASH1;
+            *myLastTime = esp_timer_get_time();
+        }
+        break;
+    case STATE_SPLASH1: // Second splash screen
+        if (elapsed > 3000) {
+            // Init done, wait until on portal or mining is shown
+            m_screenStatus = STATE_INIT_OK;
+            ESP_LOGI(TAG, "Changing Screen to WAIT SELECTION");
+            if (m_ui->ui_Splash1) {
+                lv_obj_clean(m_ui->ui_Splash1);
             }
-            break;
-        case STATE_SPLASH1: // Second splash screen
-            if (elapsed > 3000) {
-                // Init done, wait until on portal or mining is shown
-                m_screenStatus = STATE_INIT_OK;
-                ESP_LOGI(TAG, "Changing Screen to WAIT SELECTION");
-                if (m_ui->ui_Splash1) {
-                    lv_obj_clean(m_ui->ui_Splash1);
-                }
-                m_ui->ui_Splash1 = NULL;
+            m_ui->ui_Splash1 = NULL;
+        }
+        break;
+    case STATE_INIT_OK: // Show portal
+        if (m_nextScreen == SCREEN_PORTAL) {
+            ESP_LOGI(TAG, "Changing Screen to Show Portal");
+            m_screenStatus = SCREEN_PORTAL;
+            if (m_ui->ui_PortalScreen == NULL) {
+                m_ui->portalScreenInit();
             }
-            break;
-        case STATE_INIT_OK: // Show portal
-            if (m_nextScreen == SCREEN_PORTAL) {
-                ESP_LOGI(TAG, "Changing Screen to Show Portal");
-                m_screenStatus = SCREEN_PORTAL;
-                if (m_ui->ui_PortalScreen == NULL) {
-                    m_ui->portalScreenInit();
-                }
-                lv_label_set_text(m_ui->ui_lbSSID, m_portalWifiName); // Actualiza el label
-                enableLvglAnimations(true);
-                _ui_screen_change(m_ui->ui_PortalScreen, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
-                if (m_ui->ui_Splash2) {
-                    lv_obj_clean(m_ui->ui_Splash2);
-                }
-                m_ui->ui_Splash2 = NULL;
-            } else if (m_nextScreen == SCREEN_MINING) {
-                // Show Mining screen
-                ESP_LOGI(TAG, "Changing Screen to Mining screen");
-                m_screenStatus = SCREEN_MINING;
-                if (m_ui->ui_MiningScreen == NULL)
-                    m_ui->miningScreenInit();
-                if (m_ui->ui_SettingsScreen == NULL)
-                    m_ui->settingsScreenInit();
-                if (m_ui->ui_BTCScreen == NULL)
-                    m_ui->bTCScreenInit();
-                if (m_ui->ui_GlobalStats == NULL)
-                    m_ui->globalStatsScreenInit();
-                enableLvglAnimations(true);
-                _ui_screen_change(m_ui->ui_MiningScreen, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
-                if (m_ui->ui_Splash2) {
-                    lv_obj_clean(m_ui->ui_Splash2);
-                }
-                m_ui->ui_Splash2 = NULL;
+            lv_label_set_text(m_ui->ui_lbSSID, m_portalWifiName); // Actualiza el label
+            enableLvglAnimations(true);
+            _ui_screen_change(m_ui->ui_PortalScreen, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
+            if (m_ui->ui_Splash2) {
+                lv_obj_clean(m_ui->ui_Splash2);
             }
-            break;
+            m_ui->ui_Splash2 = NULL;
+        } else if (m_nextScreen == SCREEN_MINING) {
+            // Show Mining screen
+            ESP_LOGI(TAG, "Changing Screen to Mining screen");
+            m_screenStatus = SCREEN_MINING;
+            if (m_ui->ui_MiningScreen == NULL)
+                m_ui->miningScreenInit();
+            if (m_ui->ui_SettingsScreen == NULL)
+                m_ui->settingsScreenInit();
+            if (m_ui->ui_BTCScreen == NULL)
+                m_ui->bTCScreenInit();
+            if (m_ui->ui_GlobalStats == NULL)
+                m_ui->globalStatsScreenInit();
+            enableLvglAnimations(true);
+            _ui_screen_change(m_ui->ui_MiningScreen, LV_SCR_LOAD_ANIM_FADE_ON, 500, 0);
+            if (m_ui->ui_Splash2) {
+                lv_obj_clean(m_ui->ui_Splash2);
+            }
+            m_ui->ui_Splash2 = NULL;
         }
+        break;
     }
 }
 
 // Función para activar las actualizaciones
 void DisplayDriver::enableLvglAnimations(bool enable)
 {
-    m_animationsEnabled = enable;
+    // LVGL schedules the animation frames itself once the task runs
+    if (enable) {
+        notify(DISPLAY_EVENT_UPDATE);
+    }
 }
 
 void DisplayDriver::mainCreatSysteTasks(void)
 {
-    xTaskCreatePinnedToCore(lvglTimerTaskWrapper, "lvgl Timer", 6000, (void*) this, 4, NULL, 1); // Antes 10000
+    TASK_TOPOLOGY.create(lvglTimerTaskWrapper, "lvgl Timer", 6000, (void*) this, 4, &m_lvglTask, TaskGroup::DISPLAY); // Antes 10000
 }
 
 lv_obj_t *DisplayDriver::initTDisplayS3(void)
@@ -449,18 +657,21 @@ lv_obj_t *DisplayDriver::initTDisplayS3(void)
     lv_init();
     // alloc draw buffers used by LVGL
     // it's recommended to choose the size of the draw buffer(s) to be at least 1/10 screen sized
+    // two buffers of 1/8 screen use the same internal RAM as the single 1/4 screen buffer
+    // before, LVGL renders into one while the other one is sent by DMA
     lv_color_t *buf1 = (lv_color_t*) heap_caps_malloc(LVGL_LCD_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_DMA);
     assert(buf1);
-    //    lv_color_t *buf2 = heap_caps_malloc(LVGL_LCD_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_DMA );
-    //    assert(buf2);
+    lv_color_t *buf2 = (lv_color_t*) heap_caps_malloc(LVGL_LCD_BUF_SIZE * sizeof(lv_color_t), MALLOC_CAP_DMA);
+    assert(buf2);
     // initialize LVGL draw buffers
-    lv_disp_draw_buf_init(&disp_buf, buf1, NULL, LVGL_LCD_BUF_SIZE);
+    lv_disp_draw_buf_init(&disp_buf, buf1, buf2, LVGL_LCD_BUF_SIZE);
 
     ESP_LOGI(TAG, "Register display driver to LVGL");
     lv_disp_drv_init(&disp_drv);
     disp_drv.hor_res = TDISPLAYS3_LCD_H_RES;
     disp_drv.ver_res = TDISPLAYS3_LCD_V_RES;
     disp_drv.flush_cb = lvglFlushCallback;
+    disp_drv.monitor_cb = lvglMonitorCallback;
     disp_drv.draw_buf = &disp_buf;
     disp_drv.user_data = panel_handle;
     lv_disp_t *disp = lv_disp_drv_register(&disp_drv);
@@ -497,15 +708,15 @@ void DisplayDriver::updateHashrate(System *module, float power)
         snprintf(strData, sizeof(strData), "%.1f", hashrate);
     }
 
-    lv_label_set_text(m_ui->ui_lbHashrate, strData);    // Update hashrate
-    lv_label_set_text(m_ui->ui_lbHashrateSet, strData); // Update hashrate
-    lv_label_set_text(m_ui->ui_lblHashPrice, strData);  // Update hashrate
+    setLabel(m_ui->ui_lbHashrate, strData);    // Update hashrate
+    setLabel(m_ui->ui_lbHashrateSet, strData); // Update hashrate
+    setLabel(m_ui->ui_lblHashPrice, strData);  // Update hashrate
 
     snprintf(strData, sizeof(strData), "%.1f", efficiency);
-    lv_label_set_text(m_ui->ui_lbEficiency, strData); // Update eficiency label
+    setLabel(m_ui->ui_lbEficiency, strData); // Update eficiency label
 
     snprintf(strData, sizeof(strData), "%.3fW", power);
-    lv_label_set_text(m_ui->ui_lbPower, strData); // Actualiza el label
+    setLabel(m_ui->ui_lbPower, strData); // Actualiza el label
 }
 
 void DisplayDriver::updateShares(System *module)
@@ -513,11 +724,11 @@ void DisplayDriver::updateShares(System *module)
     char strData[20];
 
     snprintf(strData, sizeof(strData), "%lld/%lld", module->getSharesAccepted(), module->getSharesRejected());
-    lv_label_set_text(m_ui->ui_lbShares, strData); // Update shares
+    setLabel(m_ui->ui_lbShares, strData); // Update shares
 
     snprintf(strData, sizeof(strData), "%s", module->getBestDiffString());
-    lv_label_set_text(m_ui->ui_lbBestDifficulty, module->getBestDiffString());    // Update Bestdifficulty
-    lv_label_set_text(m_ui->ui_lbBestDifficultySet, module->getBestDiffString()); // Update Bestdifficulty
+    setLabel(m_ui->ui_lbBestDifficulty, module->getBestDiffString());    // Update Bestdifficulty
+    setLabel(m_ui->ui_lbBestDifficultySet, module->getBestDiffString()); // Update Bestdifficulty
 }
 void DisplayDriver::updateTime(System *module)
 {
@@ -534,40 +745,45 @@ void DisplayDriver::updateTime(System *module)
     int current_seconds = remaining_seconds % 60;
 
     snprintf(strData, sizeof(strData), "%dd %ih %im %is", uptime_in_days, uptime_in_hours, uptime_in_minutes, current_seconds);
-    lv_label_set_text(m_ui->ui_lbTime, strData); // Update label
+    setLabel(m_ui->ui_lbTime, strData); // Update label
 }
 
 void DisplayDriver::updateCurrentSettings()
 {
     char strData[20];
-    if (m_ui->ui_SettingsScreen == NULL)
+
+    lock();
+    if (m_ui->ui_SettingsScreen == NULL) {
+        unlock();
         return;
+    }
 
     Board *board = SYSTEM_MODULE.getBoard();
 
-    lv_label_set_text(m_ui->ui_lbPoolSet, STRATUM_MANAGER.getCurrentPoolHost()); // Update label
+    setLabel(m_ui->ui_lbPoolSet, STRATUM_MANAGER.getCurrentPoolHost()); // Update label
 
     snprintf(strData, sizeof(strData), "%d", STRATUM_MANAGER.getCurrentPoolPort());
-    lv_label_set_text(m_ui->ui_lbPortSet, strData); // Update label
+    setLabel(m_ui->ui_lbPortSet, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%d", board->getAsicFrequency());
-    lv_label_set_text(m_ui->ui_lbFreqSet, strData); // Update label
+    setLabel(m_ui->ui_lbFreqSet, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%d", board->getAsicVoltageMillis());
-    lv_label_set_text(m_ui->ui_lbVcoreSet, strData); // Update label
+    setLabel(m_ui->ui_lbVcoreSet, strData); // Update label
 
     switch (Config::getTempControlMode()) {
         case 1:
-            lv_label_set_text(m_ui->ui_lbFanSet, "AUTO"); // Update label
+            setLabel(m_ui->ui_lbFanSet, "AUTO"); // Update label
             break;
         case 2:
-            lv_label_set_text(m_ui->ui_lbFanSet, "PID"); // Update label
+            setLabel(m_ui->ui_lbFanSet, "PID"); // Update label
             break;
         default:
             snprintf(strData, sizeof(strData), "%d", Config::getFanSpeed());
-            lv_label_set_text(m_ui->ui_lbFanSet, strData); // Update label
+            setLabel(m_ui->ui_lbFanSet, strData); // Update label
             break;
     }
+    unlock();
 }
 
 
@@ -580,7 +796,7 @@ void DisplayDriver::updateBTCprice(void)
 
     m_btcPrice = APIs_FETCHER.getPrice();
     snprintf(price_str, sizeof(price_str), "%u$", m_btcPrice);
-    lv_label_set_text(m_ui->ui_lblBTCPrice, price_str); // Update label
+    setLabel(m_ui->ui_lblBTCPrice, price_str); // Update label
 }
 
 void DisplayDriver::updateGlobalMiningStats(void)
@@ -593,92 +809,98 @@ void DisplayDriver::updateGlobalMiningStats(void)
 
     m_blockHeight = APIs_FETCHER.getBlockHeight();
     snprintf(strData, sizeof(strData), "%lu", m_blockHeight);
-    lv_label_set_text(m_ui->ui_lblBlock, strData); // Update label
+    setLabel(m_ui->ui_lblBlock, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lu", APIs_FETCHER.getBlocksToHalving());
-    lv_label_set_text(m_ui->ui_lblBlocksToHalving, strData); // Update label
+    setLabel(m_ui->ui_lblBlocksToHalving, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lu%%", APIs_FETCHER.getHalvingPercent());
-    lv_label_set_text(m_ui->ui_lblHalvingPercent, strData); // Update label
+    setLabel(m_ui->ui_lblHalvingPercent, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%llu", APIs_FETCHER.getNetHash());
-    lv_label_set_text(m_ui->ui_lblGlobalHash, strData); // Update label
+    setLabel(m_ui->ui_lblGlobalHash, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lluT", APIs_FETCHER.getNetDifficulty());
-    lv_label_set_text(m_ui->ui_lblDifficulty, strData); // Update label
+    setLabel(m_ui->ui_lblDifficulty, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lu", APIs_FETCHER.getLowestFee());
-    lv_label_set_text(m_ui->ui_lbllowFee, strData); // Update label
+    setLabel(m_ui->ui_lbllowFee, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lu", APIs_FETCHER.getMidFee());
-    lv_label_set_text(m_ui->ui_lblmedFee, strData); // Update label
+    setLabel(m_ui->ui_lblmedFee, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%lu", APIs_FETCHER.getFastestFee());
-    lv_label_set_text(m_ui->ui_lblhighFee, strData); // Update label
+    setLabel(m_ui->ui_lblhighFee, strData); // Update label
 }
 
 void DisplayDriver::updateGlobalState()
 {
     char strData[20];
 
-    if (m_ui->ui_MiningScreen == NULL)
-        return;
-    if (m_ui->ui_SettingsScreen == NULL)
+    lock();
+    if (m_ui->ui_MiningScreen == NULL || m_ui->ui_SettingsScreen == NULL) {
+        unlock();
         return;
+    }
 
     // snprintf(strData, sizeof(strData), "%.0f", power_management->chip_temp);
     snprintf(strData, sizeof(strData), "%.0f", POWER_MANAGEMENT_MODULE.getChipTempMax());
-    lv_label_set_text(m_ui->ui_lbTemp, strData);       // Update label
-    lv_label_set_text(m_ui->ui_lblTempPrice, strData); // Update label
+    setLabel(m_ui->ui_lbTemp, strData);       // Update label
+    setLabel(m_ui->ui_lblTempPrice, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%d", POWER_MANAGEMENT_MODULE.getFanRPM());
-    lv_label_set_text(m_ui->ui_lbRPM, strData); // Update label
+    setLabel(m_ui->ui_lbRPM, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%.3fW", POWER_MANAGEMENT_MODULE.getPower());
-    lv_label_set_text(m_ui->ui_lbPower, strData); // Update label
+    setLabel(m_ui->ui_lbPower, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%imA", (int) POWER_MANAGEMENT_MODULE.getCurrent());
-    lv_label_set_text(m_ui->ui_lbIntensidad, strData); // Update label
+    setLabel(m_ui->ui_lbIntensidad, strData); // Update label
 
     snprintf(strData, sizeof(strData), "%imV", (int) POWER_MANAGEMENT_MODULE.getVoltage());
-    lv_label_set_text(m_ui->ui_lbVinput, strData); // Update label
+    setLabel(m_ui->ui_lbVinput, strData); // Update label
 
     updateTime(&SYSTEM_MODULE);
     updateShares(&SYSTEM_MODULE);
     updateHashrate(&SYSTEM_MODULE, POWER_MANAGEMENT_MODULE.getPower());
     updateBTCprice();
     updateGlobalMiningStats();
+    updateChart();
 
     Board *board = SYSTEM_MODULE.getBoard();
     uint16_t vcore = (int) (board->getVout() * 1000.0f);
     snprintf(strData, sizeof(strData), "%umV", vcore);
-    lv_label_set_text(m_ui->ui_lbVcore, strData); // Update label
+    setLabel(m_ui->ui_lbVcore, strData); // Update label
+    unlock();
 }
 
 void DisplayDriver::updateIpAddress(char *ip_address_str)
 {
-    if (m_ui->ui_MiningScreen == NULL)
-        return;
-    if (m_ui->ui_SettingsScreen == NULL)
-        return;
-
-    lv_label_set_text(m_ui->ui_lbIP, ip_address_str);    // Update label
-    lv_label_set_text(m_ui->ui_lbIPSet, ip_address_str); // Update label
+    lock();
+    if (m_ui->ui_MiningScreen != NULL && m_ui->ui_SettingsScreen != NULL) {
+        setLabel(m_ui->ui_lbIP, ip_address_str);    // Update label
+        setLabel(m_ui->ui_lbIPSet, ip_address_str); // Update label
+    }
+    unlock();
+    refreshScreen();
 }
 
 void DisplayDriver::logMessage(const char *message)
 {
+    lock();
     m_screenStatus = SCREEN_LOG;
     if (m_ui->ui_LogScreen == NULL)
         m_ui->logScreenInit();
     lv_label_set_text(m_ui->ui_LogLabel, message);
-    enableLvglAnimations(true);
     _ui_screen_change(m_ui->ui_LogScreen, LV_SCR_LOAD_ANIM_NONE, 500, 0);
+    unlock();
+    enableLvglAnimations(true);
 }
 
 void DisplayDriver::miningScreen(void)
 {
     // Only called once at the beggining from system lib
+    lock();
     if (m_ui->ui_MiningScreen == NULL)
         m_ui->miningScreenInit();
     if (m_ui->ui_SettingsScreen == NULL)
@@ -688,33 +910,56 @@ void DisplayDriver::miningScreen(void)
     if (m_ui->ui_GlobalStats == NULL)
         m_ui->globalStatsScreenInit();
     m_nextScreen = SCREEN_MINING;
+    unlock();
+    refreshScreen();
 }
 
 void DisplayDriver::portalScreen(const char *message)
 {
+    lock();
     m_nextScreen = SCREEN_PORTAL;
     strcpy(m_portalWifiName, message);
+    unlock();
+    refreshScreen();
 }
 void DisplayDriver::updateWifiStatus(const char *message)
 {
+    lock();
     if (m_ui->ui_lbConnect != NULL)
         lv_label_set_text(m_ui->ui_lbConnect, message); // Actualiza el label
+    unlock();
     refreshScreen();
 }
 
+// called from the button ISRs, a bouncing contact doesn't wake the LVGL task
+bool DisplayDriver::debounceButton(int button)
+{
+    int64_t now = esp_timer_get_time();
+    if (now - m_lastButtonEdge[button] < DISPLAY_BUTTON_DEBOUNCE_US) {
+        s_buttonBounces.inc();
+        return false;
+    }
+    m_lastButtonEdge[button] = now;
+    return true;
+}
+
 // ISR Handler para el DownButton (Change Screen)
 void DisplayDriver::button1IsrHandler(void *arg)
 {
     DisplayDriver *display = (DisplayDriver*) arg;
     // ESP_LOGI("UI", "Button pressed changing screen");
-    display->m_button1PressedFlag = true;
+    if (display->debounceButton(0)) {
+        display->notify(DISPLAY_EVENT_BUTTON1);
+    }
 }
 
 // ISR Handler para el UpButton (Change Screen)
 void DisplayDriver::button2IsrHandler(void *arg)
 {
     DisplayDriver *display = (DisplayDriver*) arg;
-    display->m_button2PressedFlag = true;
+    if (display->debounceButton(1)) {
+        display->notify(DISPLAY_EVENT_BUTTON2);
+    }
 }
 
 void DisplayDriver::buttonsInit(void)
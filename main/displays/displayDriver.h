@@ -2,7 +2,11 @@
 
 //#include "../global_state.h"
 
+#include <pthread.h>
+
 #include "../boards/board.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_lcd_panel_io.h"
 #include "ui.h"
 #include "ui_helpers.h"
@@ -42,7 +46,7 @@
 // LCD resolution and buffer size
 #define TDISPLAYS3_LCD_H_RES 320                                            // Horizontal resolution
 #define TDISPLAYS3_LCD_V_RES 170                                            // Vertical resolution
-#define LVGL_LCD_BUF_SIZE (TDISPLAYS3_LCD_H_RES * TDISPLAYS3_LCD_V_RES) / 4 // Buffer size for display
+#define LVGL_LCD_BUF_SIZE (TDISPLAYS3_LCD_H_RES * TDISPLAYS3_LCD_V_RES) / 8 // Size of each of the two draw buffers
 
 // Bit sizes for LCD commands and parameters
 #define TDISPLAYS3_LCD_CMD_BITS 8   // Bits for LCD commands
@@ -62,15 +66,25 @@
 #define SCREEN_SETTINGS 6 // Settings screen
 #define SCREEN_LOG 7      // Log screen
 #define SCREEN_GLBSTATS 8 // Global Mining stats screen
+#define SCREEN_CHART1H 9  // 1h chart screen
+#define SCREEN_CHART1D 10 // 24h chart screen
+
+// Events that wake the LVGL task (notification bits)
+#define DISPLAY_EVENT_BUTTON1 (1 << 0) // Button 1 pressed
+#define DISPLAY_EVENT_BUTTON2 (1 << 1) // Button 2 pressed
+#define DISPLAY_EVENT_UPDATE (1 << 2)  // Screen content changed
+
+// edges of a button within this time after a press are contact bounce
+#define DISPLAY_BUTTON_DEBOUNCE_US (50 * 1000)
 
 /* CLASS DECLARATION -----------------------------------------------------*/
 class System;
+class HistoryTier;
 
 class DisplayDriver {
   protected:
-    bool m_animationsEnabled;   // Flag for enabling animations
-    bool m_button1PressedFlag;  // Flag indicating button 1 is pressed
-    bool m_button2PressedFlag;  // Flag indicating button 2 is pressed
+    TaskHandle_t m_lvglTask;    // LVGL task, woken by notifications
+    pthread_mutex_t m_lvglLock; // LVGL isn't thread safe, recursive
     int64_t m_lastKeypressTime; // Time of the last keypress event
     bool m_displayIsOn;         // Flag indicating if the display is currently on
     int m_screenStatus;         // Current screen status
@@ -85,15 +99,29 @@ class DisplayDriver {
     unsigned int m_btcPrice; // Current Bitcoin price
     uint32_t m_blockHeight; // Current Bitcoin price
 
+    HistoryTier *m_chartTier = nullptr; // Tier shown on the chart screen, null if not shown
+    uint32_t m_chartNextPoint = 0;      // Next point of the tier to append
+
+    int64_t m_lastButtonEdge[2] = {}; // Last accepted edge per button, set in the ISRs
+
     UI *m_ui;
 
     // Helper methods for LVGL handling
     static bool notifyLvglFlushReady(esp_lcd_panel_io_handle_t panelIo, esp_lcd_panel_io_event_data_t *edata, void *userCtx);
     static void lvglFlushCallback(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *colorMap);
+    static void lvglMonitorCallback(lv_disp_drv_t *drv, uint32_t time, uint32_t px);
+
+    // sets the text only if it changed, so unchanged labels aren't redrawn
+    static void setLabel(lv_obj_t *label, const char *text);
 
-    // Enables or disables animations for LVGL
+    // Wakes the LVGL task to run animations
     void enableLvglAnimations(bool enable);
 
+    // Wakes the LVGL task with the events, safe to call from ISRs and from the task itself
+    void notify(uint32_t events);
+    void lock();
+    void unlock();
+
     void updateBTCprice(void);
 
     // Display-related functions
@@ -102,10 +130,10 @@ class DisplayDriver {
     void startCountdown();         // Start the screen countdown timer
     void displayHideCountdown();   // Hide the countdown overlay
     void checkAutoTurnOffScreen(); // Check if the screen should auto-turn off
-    void increaseLvglTick();       // Increments the LVGL tick counter
 
     // Button initialization and handling
     void buttonsInit();                    // Initialize GPIO buttons
+    bool debounceButton(int button);       // False for an edge that is contact bounce
     static void button1IsrHandler(void *); // ISR handler for button 1
     static void button2IsrHandler(void *); // ISR handler for button 2
 
@@ -113,11 +141,14 @@ class DisplayDriver {
     void changeScreen();   // Change between screens
     void updateBtcPrice(); // Update Bitcoin price on the screen
     void updateGlobalMiningStats(); // Update Global mining stats
+    void showChart(HistoryTier *tier, const char *title); // Load a tier into the charts
+    void updateChart();                                   // Append the new points of the tier
 
     // LVGL task handling
     void mainCreatSysteTasks();                    // Creates system tasks for LVGL
     static void lvglTimerTaskWrapper(void *param); // Wrapper for LVGL timer task
     void lvglTimerTask(void *param);               // LVGL timer task implementation
+    void splashScreens(int64_t *myLastTime);       // Splash screen state machine
 
     // Display initialization
     lv_obj_t *initTDisplayS3(); // Initialize the TDisplay S3
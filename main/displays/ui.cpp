@@ -665,6 +665,56 @@ void UI::hideImageOverlay()
     }
 }
 
+static lv_obj_t *chartCreate(lv_obj_t *parent, lv_coord_t y)
+{
+    lv_obj_t *chart = lv_chart_create(parent);
+    lv_obj_set_size(chart, 320, 70);
+    lv_obj_set_pos(chart, 0, y);
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_SHIFT);
+    lv_chart_set_div_line_count(chart, 3, 0);
+    lv_obj_set_style_bg_opa(chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_border_width(chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_pad_all(chart, 2, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_line_color(chart, lv_color_hex(0x404040), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_line_width(chart, 2, LV_PART_ITEMS | LV_STATE_DEFAULT);
+    // no dots on the points, only lines
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR | LV_STATE_DEFAULT);
+    lv_obj_clear_flag(chart, LV_OBJ_FLAG_SCROLLABLE);
+    return chart;
+}
+
+void UI::chartScreenInit(void)
+{
+    ui_ChartScreen = lv_obj_create(NULL);
+    lv_obj_clear_flag(ui_ChartScreen, LV_OBJ_FLAG_SCROLLABLE); /// Flags
+    lv_obj_set_style_bg_color(ui_ChartScreen, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_opa(ui_ChartScreen, 255, LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    ui_lblChartTitle = lv_label_create(ui_ChartScreen);
+    lv_obj_set_pos(ui_lblChartTitle, 4, 2);
+    lv_label_set_text(ui_lblChartTitle, "1h");
+    lv_obj_set_style_text_color(ui_lblChartTitle, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(ui_lblChartTitle, &ui_font_OpenSansBold14, LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    // legend and the latest values in the colors of the series
+    ui_lblChartValues = lv_label_create(ui_ChartScreen);
+    lv_obj_set_align(ui_lblChartValues, LV_ALIGN_TOP_RIGHT);
+    lv_obj_set_pos(ui_lblChartValues, -4, 2);
+    lv_label_set_recolor(ui_lblChartValues, true);
+    lv_label_set_text(ui_lblChartValues, "");
+    lv_obj_set_style_text_color(ui_lblChartValues, lv_color_hex(0xC6C6C5), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(ui_lblChartValues, &ui_font_OpenSansBold14, LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    ui_chartHashrate = chartCreate(ui_ChartScreen, 22);
+    ui_serHashrate = lv_chart_add_series(ui_chartHashrate, lv_color_hex(0xF7931A), LV_CHART_AXIS_PRIMARY_Y);
+
+    // temperature on the primary, power on the secondary axis
+    ui_chartTempPower = chartCreate(ui_ChartScreen, 98);
+    ui_serTemp = lv_chart_add_series(ui_chartTempPower, lv_color_hex(0xFF5050), LV_CHART_AXIS_PRIMARY_Y);
+    ui_serPower = lv_chart_add_series(ui_chartTempPower, lv_color_hex(0x3DB8FF), LV_CHART_AXIS_SECONDARY_Y);
+}
+
 void UI::init(Board* board)
 {
     m_board = board;
@@ -76,6 +76,14 @@ protected:
     lv_obj_t *ui_lbllowFee = nullptr;
     lv_obj_t *ui_lblmedFee = nullptr;
     lv_obj_t *ui_lblhighFee = nullptr;
+    lv_obj_t *ui_ChartScreen = nullptr;
+    lv_obj_t *ui_lblChartTitle = nullptr;
+    lv_obj_t *ui_lblChartValues = nullptr;
+    lv_obj_t *ui_chartHashrate = nullptr;
+    lv_obj_t *ui_chartTempPower = nullptr;
+    lv_chart_series_t *ui_serHashrate = nullptr;
+    lv_chart_series_t *ui_serTemp = nullptr;
+    lv_chart_series_t *ui_serPower = nullptr;
 
     Board* m_board;
     Theme* m_theme;
@@ -101,6 +109,7 @@ public:
     void logScreenInit(void);
     void bTCScreenInit(void);
     void globalStatsScreenInit(void);
+    void chartScreenInit(void);
 
     void showErrorOverlay(const char *error_message, uint32_t error_code);
     void hideErrorOverlay();
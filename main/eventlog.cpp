@@ -0,0 +1,206 @@
+#include <new>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "eventlog.h"
+#include "metrics.h"
+
+#pragma GCC diagnostic error "-Wall"
+#pragma GCC diagnostic error "-Wextra"
+
+static const char *TAG = "eventlog";
+
+#ifdef CONFIG_SPIRAM
+#define ALLOC(s) heap_caps_malloc(s, MALLOC_CAP_SPIRAM)
+#else
+#define ALLOC(s) malloc(s)
+#endif
+
+#ifndef CONFIG_EVENTLOG_DEFAULT_LEVEL
+#define CONFIG_EVENTLOG_DEFAULT_LEVEL 3
+#endif
+
+typedef struct
+{
+    const char *name;
+    const char *types; // one char per argument: u, i, x or f
+    const char *argNames[EVENTLOG_MAX_ARGS];
+} event_desc_t;
+
+// indexed by EventId
+static const event_desc_t s_events[] = {
+    {"unknown", "", {}},
+    {"asic_nonce", "xuxxfu", {"job", "asic", "ver", "nonce", "diff", "pool_diff"}},
+    {"asic_temp", "uf", {"asic", "temp"}},
+    {"asic_invalid_job", "x", {"job"}},
+    {"history_share", "uffffx", {"asic", "1m", "10m", "1h", "1d", "preliminary"}},
+    {"stratum_rx", "uu", {"len", "line"}},
+};
+
+static_assert(sizeof(s_events) / sizeof(s_events[0]) == (size_t) EventId::NUM_EVENTS, "event table out of sync");
+
+static const char *s_modules[] = {"asic", "history", "stratum"};
+static const char *s_levels[] = {"none", "error", "warn", "info", "debug"};
+
+static Counter s_events_written("eventlog_events", "Events written to the binary event log");
+
+EventLog EVENT_LOG;
+
+EventLog::EventLog()
+{
+    for (int i = 0; i < (int) EventModule::NUM_MODULES; i++) {
+        m_level[i].store(CONFIG_EVENTLOG_DEFAULT_LEVEL, std::memory_order_relaxed);
+    }
+}
+
+bool EventLog::init(uint32_t records)
+{
+    if (!records || (records & (records - 1))) {
+        ESP_LOGE(TAG, "number of records must be a power of 2");
+        return false;
+    }
+
+    slot_t *slots = (slot_t *) ALLOC(records * sizeof(slot_t));
+    if (!slots) {
+        ESP_LOGE(TAG, "error allocating event log");
+        return false;
+    }
+    for (uint32_t i = 0; i < records; i++) {
+        new (&slots[i].seq) std::atomic<uint32_t>(0);
+    }
+
+    m_mask = records - 1;
+    m_slots = slots;
+    return true;
+}
+
+void EventLog::write(EventModule module, EventId id, const uint32_t *args, int numArgs)
+{
+    if (!m_slots) {
+        return;
+    }
+
+    // reserving the slot is the only synchronization between writers
+    uint32_t seq = m_next.fetch_add(1, std::memory_order_relaxed);
+    slot_t *slot = &m_slots[seq & m_mask];
+
+    // readers skip the slot until the sequence number is set again
+    slot->seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->id = (uint16_t) id;
+    slot->module = (uint8_t) module;
+    slot->numArgs = (uint8_t) numArgs;
+    slot->timestamp = esp_timer_get_time();
+    memcpy(slot->args, args, numArgs * sizeof(uint32_t));
+
+    slot->seq.store(seq, std::memory_order_release);
+
+    s_events_written.inc();
+}
+
+bool EventLog::read(uint32_t seq, EventRecord *record)
+{
+    if (!m_slots || !seq) {
+        return false;
+    }
+
+    const slot_t *slot = &m_slots[seq & m_mask];
+    if (slot->seq.load(std::memory_order_acquire) != seq) {
+        return false;
+    }
+
+    record->seq = seq;
+    record->id = slot->id;
+    record->module = slot->module;
+    record->numArgs = slot->numArgs;
+    record->timestamp = slot->timestamp;
+    memset(record->args, 0, sizeof(record->args));
+    memcpy(record->args, slot->args, record->numArgs * sizeof(uint32_t));
+
+    // a writer may have reused the slot while we copied it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+uint32_t EventLog::getFirstSeq()
+{
+    uint32_t next = getNextSeq();
+    uint32_t records = m_mask + 1;
+    return (next > records) ? next - records : 1;
+}
+
+int EventLog::format(const EventRecord *record, char *buf, size_t len)
+{
+    const event_desc_t *desc = (record->id < (uint16_t) EventId::NUM_EVENTS) ? &s_events[record->id] : &s_events[0];
+    const char *module = (record->module < (uint8_t) EventModule::NUM_MODULES) ? s_modules[record->module] : "?";
+
+    int pos = snprintf(buf, len, "%lu %lld.%03lld %s %s", (unsigned long) record->seq, (long long) (record->timestamp / 1000000),
+                       (long long) ((record->timestamp / 1000) % 1000), module, desc->name);
+
+    for (int i = 0; i < record->numArgs && i < EVENTLOG_MAX_ARGS && pos >= 0 && (size_t) pos < len; i++) {
+        const char *name = desc->argNames[i] ? desc->argNames[i] : "arg";
+        char type = desc->types[i] ? desc->types[i] : 'x';
+        uint32_t raw = record->args[i];
+
+        switch (type) {
+        case 'f': {
+            float f;
+            memcpy(&f, &raw, sizeof(f));
+            pos += snprintf(&buf[pos], len - pos, " %s=%.3f", name, (double) f);
+            break;
+        }
+        case 'i':
+            pos += snprintf(&buf[pos], len - pos, " %s=%ld", name, (long) (int32_t) raw);
+            break;
+        case 'u':
+            pos += snprintf(&buf[pos], len - pos, " %s=%lu", name, (unsigned long) raw);
+            break;
+        default:
+            pos += snprintf(&buf[pos], len - pos, " %s=0x%08lx", name, (unsigned long) raw);
+            break;
+        }
+    }
+
+    if (pos < 0) {
+        return 0;
+    }
+    return ((size_t) pos < len) ? pos : (int) len - 1;
+}
+
+const char *EventLog::moduleName(EventModule module)
+{
+    return ((int) module < (int) EventModule::NUM_MODULES) ? s_modules[(int) module] : "?";
+}
+
+const char *EventLog::levelName(EventLevel level)
+{
+    return ((int) level <= (int) EventLevel::DEBUG) ? s_levels[(int) level] : "?";
+}
+
+bool EventLog::parseModule(const char *name, EventModule *module)
+{
+    for (int i = 0; i < (int) EventModule::NUM_MODULES; i++) {
+        if (!strcasecmp(name, s_modules[i])) {
+            *module = (EventModule) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool EventLog::parseLevel(const char *name, EventLevel *level)
+{
+    for (int i = 0; i <= (int) EventLevel::DEBUG; i++) {
+        if (!strcasecmp(name, s_levels[i])) {
+            *level = (EventLevel) i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+// Structured binary event log for the hot paths.
+//
+// Instead of formatting a log line for every nonce, share or stratum
+// message, the hot paths write a fixed size record with the event id,
+// a timestamp and the raw arguments into a lock-free ring. The records
+// are decoded later on /api/events or off-device.
+//
+// Every module has a runtime verbosity. At INFO the binary events are
+// recorded, at DEBUG the old text lines are printed as well. The text
+// lines can be removed at compile time with CONFIG_EVENTLOG_TEXT=n and
+// events above CONFIG_EVENTLOG_MAX_LEVEL are not compiled in at all.
+//
+//   EVENT_LOGI(EventModule::ASIC, EventId::ASIC_TEMP, asic_nr, temp);
+//   EVENT_TEXT(EventModule::ASIC, TAG, "asic %d temp: %.3f", asic_nr, temp);
+
+#ifndef CONFIG_EVENTLOG_RECORDS
+#define CONFIG_EVENTLOG_RECORDS 1024
+#endif
+
+#ifndef CONFIG_EVENTLOG_MAX_LEVEL
+#define CONFIG_EVENTLOG_MAX_LEVEL 4
+#endif
+
+#define EVENTLOG_MAX_ARGS 6
+
+enum class EventLevel : uint8_t
+{
+    NONE = 0,
+    ERROR,
+    WARN,
+    INFO,
+    DEBUG, // binary events and text lines
+};
+
+enum class EventModule : uint8_t
+{
+    ASIC = 0,
+    HISTORY,
+    STRATUM,
+    NUM_MODULES
+};
+
+// ids are part of the binary format, only append
+enum class EventId : uint16_t
+{
+    ASIC_NONCE = 1,
+    ASIC_TEMP,
+    ASIC_INVALID_JOB,
+    HISTORY_SHARE,
+    STRATUM_RX,
+    NUM_EVENTS
+};
+
+// decoded record as it is exported on /api/events (little endian, packed)
+typedef struct __attribute__((packed))
+{
+    uint32_t seq;
+    uint16_t id;
+    uint8_t module;
+    uint8_t numArgs;
+    int64_t timestamp; // us since boot
+    uint32_t args[EVENTLOG_MAX_ARGS];
+} EventRecord;
+
+// raw argument, floats keep their bit pattern
+template <typename T> static inline uint32_t eventArg(T value)
+{
+    static_assert(sizeof(T) <= sizeof(uint64_t), "unsupported event argument");
+    if constexpr (std::is_floating_point<T>::value) {
+        float f = (float) value;
+        uint32_t u;
+        memcpy(&u, &f, sizeof(u));
+        return u;
+    } else {
+        return (uint32_t) value;
+    }
+}
+
+class EventLog {
+  protected:
+    typedef struct
+    {
+        std::atomic<uint32_t> seq; // 0 while the slot is written
+        uint16_t id;
+        uint8_t module;
+        uint8_t numArgs;
+        int64_t timestamp;
+        uint32_t args[EVENTLOG_MAX_ARGS];
+    } slot_t;
+
+    slot_t *m_slots = nullptr;
+    uint32_t m_mask = 0;
+    std::atomic<uint32_t> m_next{1};
+
+    std::atomic<uint8_t> m_level[(int) EventModule::NUM_MODULES];
+
+    void write(EventModule module, EventId id, const uint32_t *args, int numArgs);
+
+  public:
+    EventLog();
+
+    // allocates the ring, records must be a power of 2
+    bool init(uint32_t records);
+
+    bool enabled(EventModule module, EventLevel level)
+    {
+        return m_level[(int) module].load(std::memory_order_relaxed) >= (uint8_t) level;
+    }
+
+    template <typename... T> void log(EventModule module, EventLevel level, EventId id, T... args)
+    {
+        static_assert(sizeof...(T) <= EVENTLOG_MAX_ARGS, "too many event arguments");
+        if (!enabled(module, level)) {
+            return;
+        }
+        uint32_t raw[sizeof...(T) + 1] = {eventArg(args)...};
+        write(module, id, raw, sizeof...(T));
+    }
+
+    // copies the record with sequence number seq, returns false if it was
+    // overwritten or not written yet
+    bool read(uint32_t seq, EventRecord *record);
+
+    uint32_t getFirstSeq();
+    uint32_t getNextSeq()
+    {
+        return m_next.load(std::memory_order_acquire);
+    }
+
+    void setLevel(EventModule module, EventLevel level)
+    {
+        m_level[(int) module].store((uint8_t) level, std::memory_order_relaxed);
+    }
+    EventLevel getLevel(EventModule module)
+    {
+        return (EventLevel) m_level[(int) module].load(std::memory_order_relaxed);
+    }
+
+    // decodes a record into a text line, returns the length
+    static int format(const EventRecord *record, char *buf, size_t len);
+
+    static const char *moduleName(EventModule module);
+    static const char *levelName(EventLevel level);
+    static bool parseModule(const char *name, EventModule *module);
+    static bool parseLevel(const char *name, EventLevel *level);
+};
+
+extern EventLog EVENT_LOG;
+
+#define EVENT_LOG_AT(lvl, module, id, ...)                                                                                         \
+    do {                                                                                                                           \
+        if ((int) (lvl) <= CONFIG_EVENTLOG_MAX_LEVEL) {                                                                            \
+            EVENT_LOG.log(module, lvl, id, ##__VA_ARGS__);                                                                         \
+        }                                                                                                                          \
+    } while (0)
+
+#define EVENT_LOGE(module, id, ...) EVENT_LOG_AT(EventLevel::ERROR, module, id, ##__VA_ARGS__)
+#define EVENT_LOGW(module, id, ...) EVENT_LOG_AT(EventLevel::WARN, module, id, ##__VA_ARGS__)
+#define EVENT_LOGI(module, id, ...) EVENT_LOG_AT(EventLevel::INFO, module, id, ##__VA_ARGS__)
+#define EVENT_LOGD(module, id, ...) EVENT_LOG_AT(EventLevel::DEBUG, module, id, ##__VA_ARGS__)
+
+// true if the module wants the text lines of the hot path
+#ifdef CONFIG_EVENTLOG_TEXT
+#define EVENT_TEXT_ENABLED(module) EVENT_LOG.enabled(module, EventLevel::DEBUG)
+#else
+#define EVENT_TEXT_ENABLED(module) false
+#endif
+
+#define EVENT_TEXT(module, tag, format, ...)                                                                                       \
+    do {                                                                                                                           \
+        if (EVENT_TEXT_ENABLED(module)) {                                                                                          \
+            ESP_LOGI(tag, format, ##__VA_ARGS__);                                                                                  \
+        }                                                                                                                          \
+    } while (0)
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "ArduinoJson.h"
+
+#include "fleet_ota_manifest.h"
+#include "psram_allocator.h"
+
+static void resolveUrl(const char *mirrorUrl, const char *ref, char *out, size_t len)
+{
+    if (strstr(ref, "://")) {
+        strlcpy(out, ref, len);
+        return;
+    }
+    // relative to the directory of the mirror url
+    size_t baseLen = strlen(mirrorUrl);
+    while (baseLen && mirrorUrl[baseLen - 1] == '/') {
+        baseLen--;
+    }
+    while (*ref == '/') {
+        ref++;
+    }
+    snprintf(out, len, "%.*s/%s", (int) baseLen, mirrorUrl, ref);
+}
+
+static bool parseImage(JsonVariantConst obj, const char *mirrorUrl, fleet_ota_image_t *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    const char *url = obj["url"];
+    const char *sha256 = obj["sha256"];
+    uint32_t size = obj["size"] | 0;
+    if (!url || !sha256 || strlen(sha256) != 64 || !size) {
+        return false;
+    }
+
+    resolveUrl(mirrorUrl, url, image->url, sizeof(image->url));
+    strlcpy(image->sha256, sha256, sizeof(image->sha256));
+    image->size = size;
+    image->present = true;
+    return true;
+}
+
+static bool parseDelta(JsonVariantConst obj, const char *mirrorUrl, fleet_ota_image_t *image)
+{
+    memset(image, 0, sizeof(*image));
+
+    const char *url = obj["url"];
+    uint32_t size = obj["size"] | 0;
+    if (!url || !size) {
+        return false;
+    }
+
+    resolveUrl(mirrorUrl, url, image->url, sizeof(image->url));
+    image->size = size;
+    image->present = true;
+    return true;
+}
+
+bool fleet_ota_parse_manifest(const char *json, size_t len, const char *mirrorUrl, const char *deviceModel,
+                              const char *firmwareSha256, fleet_ota_manifest_t *manifest)
+{
+    memset(manifest, 0, sizeof(*manifest));
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    if (deserializeJson(doc, json, len)) {
+        return false;
+    }
+
+    const char *version = doc["version"];
+    if (!version || !*version) {
+        return false;
+    }
+    strlcpy(manifest->version, version, sizeof(manifest->version));
+    manifest->rolloutPercent = doc["rolloutPercent"] | 100;
+    manifest->staggerMinutes = doc["staggerMinutes"] | 0;
+
+    // an image that is there but broken makes the whole manifest invalid
+    JsonVariantConst firmware = doc["firmware"][deviceModel];
+    if (!firmware.isNull() && !parseImage(firmware, mirrorUrl, &manifest->firmware)) {
+        return false;
+    }
+    // a broken delta is skipped, the full image is there
+    if (*firmwareSha256) {
+        for (JsonVariantConst delta : firmware["deltas"].as<JsonArrayConst>()) {
+            const char *from = delta["from"] | "";
+            if (!strcasecmp(from, firmwareSha256) && parseDelta(delta, mirrorUrl, &manifest->delta)) {
+                break;
+            }
+        }
+    }
+    JsonVariantConst www = doc["www"];
+    if (!www.isNull() && !parseImage(www, mirrorUrl, &manifest->www)) {
+        return false;
+    }
+    return true;
+}
+
+int fleet_ota_plan(const fleet_ota_manifest_t *manifest, const char *runningVersion, const char *firmwareSha256,
+                   const char *wwwSha256)
+{
+    int updates = 0;
+    bool sameVersion = !strcmp(manifest->version, runningVersion);
+
+    // the version an image reports may differ from the one of the manifest,
+    // a pulled image is only compared by its hash so it isn't pulled again
+    if (manifest->firmware.present &&
+        (*firmwareSha256 ? strcasecmp(manifest->firmware.sha256, firmwareSha256) != 0 : !sameVersion)) {
+        updates |= FLEET_OTA_FIRMWARE;
+    }
+
+    // without a pulled www image the one of the running release is assumed
+    // to be current
+    if (manifest->www.present && strcasecmp(manifest->www.sha256, wwwSha256) && (*wwwSha256 || !sameVersion)) {
+        updates |= FLEET_OTA_WWW;
+    }
+    return updates;
+}
+
+bool fleet_ota_parse_content_range(const char *value, size_t *start)
+{
+    unsigned long first, last;
+    if (strncasecmp(value, "bytes ", 6) || sscanf(value + 6, "%lu-%lu", &first, &last) != 2 || last < first) {
+        return false;
+    }
+    *start = first;
+    return true;
+}
+
+uint32_t fleet_ota_device_slot(const uint8_t mac[6])
+{
+    // FNV-1a, the last bytes of MACs of one batch are close together
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        hash ^= mac[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool fleet_ota_in_rollout(uint32_t slot, int rolloutPercent)
+{
+    return (int) (slot % 100) < rolloutPercent;
+}
+
+int fleet_ota_stagger_delay_s(uint32_t slot, int staggerMinutes)
+{
+    if (staggerMinutes <= 0) {
+        return 0;
+    }
+    return (int) ((slot / 100) % (uint32_t) (staggerMinutes * 60));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Manifest of a local update mirror, <mirror>/manifest.json:
+//
+//   {
+//     "version": "v1.0.31",
+//     "rolloutPercent": 100,        // share of the fleet that takes it
+//     "staggerMinutes": 60,         // devices spread their start over this
+//     "firmware": {
+//       "NerdQAxe++": {"url": "nerdqaxeplus/esp-miner.bin", "size": 1234567, "sha256": "...",
+//                      "deltas": [{"from": "<sha256 of v1.0.30>", "url": "nerdqaxeplus/v1.0.30.patch", "size": 81234}]},
+//       ...
+//     },
+//     "www": {"url": "www.bin", "size": 3145728, "sha256": "..."}
+//   }
+//
+// Firmware images are per device model, urls are relative to the mirror
+// or absolute. A delta is an esp_delta_ota (detools) patch from the image
+// with the "from" hash to this one, it is used when the device runs that
+// image. The patched image is checked against size and sha256 of the full
+// one.
+
+#define FLEET_OTA_URL_MAX 192
+#define FLEET_OTA_VERSION_MAX 32
+#define FLEET_OTA_SHA256_HEX 65
+
+#define FLEET_OTA_FIRMWARE 0x01
+#define FLEET_OTA_WWW 0x02
+
+typedef struct
+{
+    bool present;
+    char url[FLEET_OTA_URL_MAX];
+    uint32_t size;
+    char sha256[FLEET_OTA_SHA256_HEX]; // "" for a delta
+} fleet_ota_image_t;
+
+typedef struct
+{
+    char version[FLEET_OTA_VERSION_MAX];
+    int rolloutPercent;
+    int staggerMinutes;
+    fleet_ota_image_t firmware;
+    fleet_ota_image_t delta; // to firmware from the running image
+    fleet_ota_image_t www;
+} fleet_ota_manifest_t;
+
+// parses the manifest and resolves the image urls against the mirror,
+// firmwareSha256 picks the delta ("" if the running image isn't known)
+bool fleet_ota_parse_manifest(const char *json, size_t len, const char *mirrorUrl, const char *deviceModel,
+                              const char *firmwareSha256, fleet_ota_manifest_t *manifest);
+
+// images of the manifest that differ from what the device runs. The sha256
+// are the ones of the pulled images that are in use, "" if not known, the
+// version is only compared without them.
+int fleet_ota_plan(const fleet_ota_manifest_t *manifest, const char *runningVersion, const char *firmwareSha256,
+                   const char *wwwSha256);
+
+// start of "bytes <start>-<end>/<size>" of a 206 response
+bool fleet_ota_parse_content_range(const char *value, size_t *start);
+
+// stable position of the device in the fleet, from its MAC
+uint32_t fleet_ota_device_slot(const uint8_t mac[6]);
+
+bool fleet_ota_in_rollout(uint32_t slot, int rolloutPercent);
+
+// seconds the device waits after it first saw a new version
+int fleet_ota_stagger_delay_s(uint32_t slot, int staggerMinutes);
@@ -15,7 +15,7 @@
 
 #include "boards/nerdqaxeplus.h"
 #include "system.h"
-#include "discord.h"
+#include "tasks/alert_task.h"
 
 extern System SYSTEM_MODULE;
 extern PowerManagementTask POWER_MANAGEMENT_MODULE;
@@ -23,4 +23,3 @@ extern StratumManager STRATUM_MANAGER;
 extern APIsFetcher APIs_FETCHER;
 
 extern AsicJobs asicJobs;
-extern DiscordAlerter discordAlerter;
@@ -1,15 +1,14 @@
+#include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdint.h>
 
 #include "esp_log.h"
-#include "esp_timer.h" // Include esp_timer for esp_timer_get_time
-#include "freertos/FreeRTOS.h"
-#include "freertos/queue.h"
-#include "freertos/task.h"
 
-#include "global_state.h"
+#include "eventlog.h"
 #include "history.h"
+#include "metrics.h"
+#include "platform.h"
 
 #pragma GCC diagnostic error "-Wall"
 #pragma GCC diagnostic error "-Wextra"
@@ -17,6 +16,32 @@
 
 static const char *TAG = "history";
 
+static Counter s_shares("history_shares", "Shares added to the history");
+static HistogramN<10> s_pushShareTime("history_push_share_us", "Time to add a share and update the averages",
+                                      METRICS_LATENCY_US_BUCKETS);
+
+// the gauges read the history that was initialized last (there is only one)
+static History *s_history = nullptr;
+
+static float currentHashrate(double (History::*getter)())
+{
+    History *history = s_history;
+    return history ? (float) (history->*getter)() : 0.0f;
+}
+
+static Gauge s_hashrate1m("history_hashrate_ghs", "Average hashrate", []() {
+    return currentHashrate(&History::getCurrentHashrate1m);
+}, "window=\"1m\"");
+static Gauge s_hashrate10m("history_hashrate_ghs", "Average hashrate", []() {
+    return currentHashrate(&History::getCurrentHashrate10m);
+}, "window=\"10m\"");
+static Gauge s_hashrate1h("history_hashrate_ghs", "Average hashrate", []() {
+    return currentHashrate(&History::getCurrentHashrate1h);
+}, "window=\"1h\"");
+static Gauge s_hashrate1d("history_hashrate_ghs", "Average hashrate", []() {
+    return currentHashrate(&History::getCurrentHashrate1d);
+}, "window=\"1d\"");
+
 // define for wrapped access of psram
 #define WRAP(a) ((a) & (HISTORY_MAX_SAMPLES - 1))
 
@@ -51,7 +76,7 @@ void NonceDistribution::toLog()
 
     // Iterate through each ASIC and append its count to the log message
     for (int i = 0; i < m_numAsics; i++) {
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "%lu/", m_distribution[i]);
+        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "%" PRIu32 "/", m_distribution[i]);
     }
     if (offset > 0) {
         buffer[offset - 1] = 0; // remove trailing slash
@@ -127,22 +152,27 @@ bool History::isAvailable()
     return m_shares && m_timestamps && m_hashrate10m && m_hashrate1h && m_hashrate1d;
 }
 
-History::History() : m_avg1m(this, 60llu * 1000llu), m_avg10m(this, 600llu * 1000llu), m_avg1h(this, 3600llu * 1000llu), m_avg1d(this, 86400llu * 1000llu)
+History::History() : m_avg1m(this, 60llu * 1000llu), m_avg10m(this, 600llu * 1000llu), m_avg1h(this, 3600llu * 1000llu), m_avg1d(this, 86400llu * 1000llu),
+    m_tier1h(60llu * 1000llu, 60), m_tier1d(900llu * 1000llu, 96)
 {
     // NOP
 }
 
 bool History::init(int num_asics)
 {
-    m_shares = (uint32_t *) heap_caps_malloc(HISTORY_MAX_SAMPLES * sizeof(uint32_t), MALLOC_CAP_SPIRAM);
-    m_timestamps = (uint64_t *) heap_caps_malloc(HISTORY_MAX_SAMPLES * sizeof(uint64_t), MALLOC_CAP_SPIRAM);
-    m_hashrate10m = (float *) heap_caps_malloc(HISTORY_MAX_SAMPLES * sizeof(float), MALLOC_CAP_SPIRAM);
-    m_hashrate1h = (float *) heap_caps_malloc(HISTORY_MAX_SAMPLES * sizeof(float), MALLOC_CAP_SPIRAM);
-    m_hashrate1d = (float *) heap_caps_malloc(HISTORY_MAX_SAMPLES * sizeof(float), MALLOC_CAP_SPIRAM);
+    m_shares = (uint32_t *) platform_malloc(HISTORY_MAX_SAMPLES * sizeof(uint32_t));
+    m_timestamps = (uint64_t *) platform_malloc(HISTORY_MAX_SAMPLES * sizeof(uint64_t));
+    m_hashrate10m = (float *) platform_malloc(HISTORY_MAX_SAMPLES * sizeof(float));
+    m_hashrate1h = (float *) platform_malloc(HISTORY_MAX_SAMPLES * sizeof(float));
+    m_hashrate1d = (float *) platform_malloc(HISTORY_MAX_SAMPLES * sizeof(float));
 
     m_distribution.init(num_asics);
 
-    return isAvailable();
+    if (!isAvailable()) {
+        return false;
+    }
+    s_history = this;
+    return true;
 }
 
 void History::getTimestamps(uint64_t *first, uint64_t *last, int *num_samples)
@@ -160,6 +190,50 @@ void History::getTimestamps(uint64_t *first, uint64_t *last, int *num_samples)
     *num_samples = _num_samples;
 }
 
+void History::pushChartSample(uint64_t timestamp, float temp, float power)
+{
+    history_point_t sample;
+    sample.hashrate = m_avg1m.getGh();
+    sample.temp = temp;
+    sample.power = power;
+
+    lock();
+    m_tier1h.addSample(timestamp, sample);
+    m_tier1d.addSample(timestamp, sample);
+    unlock();
+}
+
+HistoryTier::HistoryTier(uint64_t bucketMs, int maxPoints)
+{
+    m_bucketMs = bucketMs;
+    m_maxPoints = (maxPoints > HISTORY_TIER_MAX_POINTS) ? HISTORY_TIER_MAX_POINTS : maxPoints;
+}
+
+// averages the samples of the running bucket, when the bucket is over the
+// average becomes the next point
+void HistoryTier::addSample(uint64_t timestamp, const history_point_t &sample)
+{
+    if (m_sumCount && timestamp - m_bucketStart >= m_bucketMs) {
+        history_point_t &point = m_points[m_numPoints % m_maxPoints];
+        point.hashrate = m_sum.hashrate / m_sumCount;
+        point.temp = m_sum.temp / m_sumCount;
+        point.power = m_sum.power / m_sumCount;
+        m_numPoints++;
+
+        m_sum = {};
+        m_sumCount = 0;
+    }
+
+    if (!m_sumCount) {
+        // buckets start on multiples of their length
+        m_bucketStart = timestamp - (timestamp % m_bucketMs);
+    }
+    m_sum.hashrate += sample.hashrate;
+    m_sum.temp += sample.temp;
+    m_sum.power += sample.power;
+    m_sumCount++;
+}
+
 HistoryAvg::HistoryAvg(History *history, uint64_t timespan)
 {
     m_history = history;
@@ -223,6 +297,8 @@ void History::pushShare(uint32_t diff, uint64_t timestamp, int asic_nr)
         return;
     }
 
+    int64_t start = platform_time_us();
+
     lock();
     m_shares[WRAP(m_numSamples)] = diff;
     m_timestamps[WRAP(m_numSamples)] = timestamp;
@@ -241,6 +317,18 @@ void History::pushShare(uint32_t diff, uint64_t timestamp, int asic_nr)
 
     unlock();
 
+    s_shares.inc();
+    s_pushShareTime.observe((float) (platform_time_us() - start));
+
+    uint32_t preliminary = (m_avg1m.isPreliminary() ? 1 : 0) | (m_avg10m.isPreliminary() ? 2 : 0) |
+                           (m_avg1h.isPreliminary() ? 4 : 0) | (m_avg1d.isPreliminary() ? 8 : 0);
+    EVENT_LOGI(EventModule::HISTORY, EventId::HISTORY_SHARE, asic_nr, m_avg1m.getGh(), m_avg10m.getGh(), m_avg1h.getGh(),
+               m_avg1d.getGh(), preliminary);
+
+    if (!EVENT_TEXT_ENABLED(EventModule::HISTORY)) {
+        return;
+    }
+
     char preliminary_1m = (m_avg1m.isPreliminary()) ? '*' : ' ';
     char preliminary_10m = (m_avg10m.isPreliminary()) ? '*' : ' ';
     char preliminary_1h = (m_avg1h.isPreliminary()) ? '*' : ' ';
@@ -270,7 +358,7 @@ int History::searchNearestTimestamp(int64_t timestamp)
     while (current = (highest_index + lowest_index) / 2, num_elements = highest_index - lowest_index + 1, num_elements > 1) {
         // Get timestamp at the current index, wrapping as necessary
         uint64_t stored_timestamp = getTimestampSample(current);
-        ESP_LOGD(TAG, "current %d num_elements %d stored_timestamp %llu wrapped-current %d", current, num_elements,
+        ESP_LOGD(TAG, "current %d num_elements %d stored_timestamp %" PRIu64 " wrapped-current %d", current, num_elements,
                  stored_timestamp, WRAP(current));
 
         if ((int64_t) stored_timestamp > timestamp) {
@@ -304,7 +392,7 @@ void History::exportHistoryData(JsonObject &json_history, uint64_t start_timesta
     int64_t rel_end   = (int64_t) end_timestamp - (int64_t) current_timestamp;
 
     // Get current system timestamp (in ms)
-    uint64_t sys_timestamp = esp_timer_get_time() / 1000ULL;
+    uint64_t sys_timestamp = platform_time_us() / 1000ULL;
     int64_t sys_start = (int64_t) sys_timestamp + rel_start;
     int64_t sys_end   = (int64_t) sys_timestamp + rel_end;
 
@@ -8,6 +8,9 @@
 // must be power of two
 #define HISTORY_MAX_SAMPLES 0x20000
 
+// points of the downsampled chart tiers
+#define HISTORY_TIER_MAX_POINTS 96
+
 class History;
 
 class NonceDistribution {
@@ -20,6 +23,17 @@ class NonceDistribution {
     void init(int numAsics);
     void addShare(int asicNr);
     void toLog();
+
+    int getNumAsics()
+    {
+        return m_distribution ? m_numAsics : 0;
+    };
+
+    // shares (at the ASIC difficulty) of a chip since boot
+    uint32_t getShares(int asicNr)
+    {
+        return m_distribution[asicNr];
+    };
 };
 
 class HistoryAvg {
@@ -55,6 +69,55 @@ class HistoryAvg {
     void update();
 };
 
+typedef struct
+{
+    float hashrate; // GH/s
+    float temp;     // °C
+    float power;    // W
+} history_point_t;
+
+// Downsampled series for the charts. Samples are averaged into buckets of
+// a fixed length, each finished bucket is one point. Points are numbered
+// since boot so readers can append only the ones they haven't seen yet.
+class HistoryTier {
+  protected:
+    uint64_t m_bucketMs;
+    int m_maxPoints;
+    history_point_t m_points[HISTORY_TIER_MAX_POINTS] = {};
+    uint32_t m_numPoints = 0;
+
+    uint64_t m_bucketStart = 0;
+    history_point_t m_sum = {};
+    int m_sumCount = 0;
+
+  public:
+    HistoryTier(uint64_t bucketMs, int maxPoints);
+
+    void addSample(uint64_t timestamp, const history_point_t &sample);
+
+    // number of finished points since boot
+    uint32_t getNumPoints()
+    {
+        return m_numPoints;
+    };
+
+    // oldest point that is still kept
+    uint32_t getFirstPoint()
+    {
+        return (m_numPoints > (uint32_t) m_maxPoints) ? m_numPoints - m_maxPoints : 0;
+    };
+
+    const history_point_t &getPoint(uint32_t index)
+    {
+        return m_points[index % m_maxPoints];
+    };
+
+    int getMaxPoints()
+    {
+        return m_maxPoints;
+    };
+};
+
 class History {
   protected:
     int m_numSamples = 0;
@@ -72,6 +135,9 @@ class History {
     HistoryAvg m_avg1d;
     NonceDistribution m_distribution;
 
+    HistoryTier m_tier1h; // 60 x 1 minute
+    HistoryTier m_tier1d; // 96 x 15 minutes
+
   public:
     History();
     bool init(int numAsics);
@@ -79,9 +145,27 @@ class History {
     void getTimestamps(uint64_t *first, uint64_t *last, int *num_samples);
     void pushShare(uint32_t diff, uint64_t timestamp, int asic_nr);
 
+    // adds the current 1m hashrate, temperature and power to the chart tiers
+    void pushChartSample(uint64_t timestamp, float temp, float power);
+
+    // access with the history locked
+    HistoryTier *getTier1h()
+    {
+        return &m_tier1h;
+    };
+    HistoryTier *getTier1d()
+    {
+        return &m_tier1d;
+    };
+
     void lock();
     void unlock();
 
+    NonceDistribution *getNonceDistribution()
+    {
+        return &m_distribution;
+    };
+
     uint64_t getTimestampSample(int index);
     float getHashrate10mSample(int index);
     float getHashrate1hSample(int index);
@@ -1,4 +1,13 @@
 export interface IAlertSettings {
   alertDiscordEnable: number;
   alertDiscordWebhook: string;
+  alertWebhookEnable?: number;
+  alertWebhook?: string;
+  // bit mask over alertEventNames
+  alertEvents?: number;
+  alertCooldown?: number;
+  alertDigest?: number;
+  alertHashrateDrop?: number;
+  alertChipPercent?: number;
+  alertEventNames?: string[];
 }
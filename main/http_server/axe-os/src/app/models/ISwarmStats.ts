@@ -0,0 +1,42 @@
+// one device of /api/swarm/stats, the stats are missing until it answered once
+export interface ISwarmDevice {
+    ip: string,
+    health: 'ok' | 'stale' | 'hot' | 'no pool' | 'no hashrate' | 'offline',
+    ageS: number,
+    latencyMs: number,
+    self?: boolean,
+
+    hostname?: string,
+    deviceModel?: string,
+    ASICModel?: string,
+    version?: string,
+    hashRate?: number,
+    hashRate_1m?: number,
+    power?: number,
+    efficiency?: number,
+    temp?: number,
+    vrTemp?: number,
+    sharesAccepted?: number,
+    sharesRejected?: number,
+    uptimeSeconds?: number,
+    isStratumConnected?: boolean,
+    bestDiff?: string,
+    bestSessionDiff?: string,
+    poolDifficulty?: number
+}
+
+export interface ISwarmStats {
+    devices: ISwarmDevice[],
+    total: {
+        devices: number,
+        online: number,
+        hashRate: number,
+        power: number,
+        efficiency: number,
+        maxTemp: number,
+        sharesAccepted: number,
+        sharesRejected: number
+    },
+    ageS: number,
+    roundMs: number
+}
@@ -68,10 +68,23 @@ export interface ISystemInfo {
     boardtemp2?: number,
     overheat_temp: number,
 
+    // watts, 0 = off
+    powerCap?: number,
+    powerCapActive?: number,
+    powerCapFrequency?: number,
+    powerCapHeadroom?: number,
+    powerCapProfile?: number,
+    frequencyProfile?: number,
+    coreVoltageProfile?: number,
+    miningProfile?: string,
+    miningPaused?: number,
+    swarmAggregator?: number,
+
     pidTargetTemp: number,
     pidP: number,
     pidI: number,
     pidD: number,
 
-    history: IHistory
+    // only in answers to a request with ts
+    history?: IHistory
 }
@@ -0,0 +1,10 @@
+export type TelemetryTopic = 'hashrate' | 'power' | 'temps' | 'shares' | 'pool';
+
+// frame of /api/ws/telemetry, after the full frame of a subscription only
+// the changed fields are in data
+export interface ITelemetryFrame {
+    topic: TelemetryTopic,
+    seq: number,
+    full?: boolean,
+    data: { [field: string]: number | string }
+}
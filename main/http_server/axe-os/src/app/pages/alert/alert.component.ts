@@ -16,6 +16,7 @@ import { IAlertSettings } from '../../models/IAlertSettings';
 export class AlertComponent implements OnInit {
 
   public form!: FormGroup;
+  public eventNames: string[] = [];
   @Input() uri = '';
 
   constructor(
@@ -35,6 +36,21 @@ export class AlertComponent implements OnInit {
             Validators.pattern(/^https:\/\/discord\.com\/api\/webhooks\/.+$/)
           ]],
           alertDiscordEnable: [data.alertDiscordEnable === 1],
+          alertWebhook: ['', [
+            Validators.pattern(/^https?:\/\/.+$/)
+          ]],
+          alertWebhookEnable: [data.alertWebhookEnable === 1],
+          alertCooldown: [data.alertCooldown ?? 30, [Validators.required, Validators.min(0), Validators.max(1440)]],
+          alertDigest: [data.alertDigest ?? 60, [Validators.required, Validators.min(0), Validators.max(3600)]],
+          alertHashrateDrop: [data.alertHashrateDrop ?? 25, [Validators.required, Validators.min(0), Validators.max(99)]],
+          alertChipPercent: [data.alertChipPercent ?? 50, [Validators.required, Validators.min(0), Validators.max(100)]],
+        });
+
+        // one checkbox per event type, the firmware stores them as a bit mask
+        this.eventNames = data.alertEventNames ?? [];
+        const mask = data.alertEvents ?? 0xffff;
+        this.eventNames.forEach((name, i) => {
+          this.form.addControl('event_' + name, this.fb.control((mask & (1 << i)) !== 0));
         });
       });
   }
@@ -46,6 +62,22 @@ export class AlertComponent implements OnInit {
       delete form.alertDiscordWebhook;
     }
 
+    // the stored URL isn't sent by the device, empty keeps it
+    if (!form.alertWebhook) {
+      delete form.alertWebhook;
+    }
+
+    if (this.eventNames.length) {
+      let mask = 0;
+      this.eventNames.forEach((name, i) => {
+        if (form['event_' + name]) {
+          mask |= 1 << i;
+        }
+        delete form['event_' + name];
+      });
+      form.alertEvents = mask;
+    }
+
     this.systemService.updateAlertInfo(this.uri, form)
       .pipe(this.loadingService.lockUIUntilComplete())
       .subscribe({
@@ -58,12 +90,17 @@ export class AlertComponent implements OnInit {
       });
   }
 
+  public eventLabel(name: string): string {
+    const label = name.replace(/_/g, ' ');
+    return label.charAt(0).toUpperCase() + label.slice(1);
+  }
+
   public sendTest() {
     this.systemService.sendAlertTest(this.uri)
       .pipe(this.loadingService.lockUIUntilComplete())
       .subscribe({
         next: () => {
-          this.toastrService.success('Test alert sent to Discord.', 'Success');
+          this.toastrService.success('Test alert sent.', 'Success');
         },
         error: () => {
           this.toastrService.danger('Failed to send test alert.', 'Error');
@@ -180,6 +180,11 @@ export class EditComponent implements OnInit {
           Validators.min(40),
           Validators.max(90),
           Validators.required
+        ]],
+        powerCap: [info.powerCap ?? 0, [
+          Validators.min(0),
+          Validators.max(1000),
+          Validators.required
         ]]
       });
 
@@ -1,8 +1,10 @@
 import { Component, AfterViewChecked, OnInit, OnDestroy } from '@angular/core';
-import { interval, map, Observable, shareReplay, startWith, switchMap, tap } from 'rxjs';
+import { distinctUntilChanged, ignoreElements, interval, map, merge, Observable, scan, shareReplay, startWith, switchMap, tap } from 'rxjs';
 import { HashSuffixPipe } from '../../pipes/hash-suffix.pipe';
 import { SystemService } from '../../services/system.service';
+import { TelemetryService } from '../../services/telemetry.service';
 import { ISystemInfo } from '../../models/ISystemInfo';
+import { ITelemetryFrame } from '../../models/ITelemetryFrame';
 import { Chart } from 'chart.js';  // Import Chart.js
 import { ElementRef, ViewChild } from "@angular/core";
 import { TimeScale} from "chart.js/auto";
@@ -40,6 +42,10 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
   private localStorageKey = 'chartData';
   private timestampKey = 'lastTimestamp'; // Key to store lastTimestamp
 
+  // while the telemetry socket is up the chart gets a point this often
+  private liveChartIntervalMs = 30000;
+  private lastLiveChartPoint = 0;
+
   ngAfterViewChecked(): void {
     // Ensure chart is initialized only once when the canvas becomes available
     if (!this.chartInitialized && this.ctx && this.ctx.nativeElement) {
@@ -62,7 +68,8 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
 
   constructor(
     private themeService: NbThemeService,
-    private systemService: SystemService
+    private systemService: SystemService,
+    private telemetryService: TelemetryService
   ) {
     const documentStyle = getComputedStyle(document.documentElement);
     const bodyStyle = getComputedStyle(document.body);
@@ -151,18 +158,29 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
       }
     };
 
-    this.info$ = interval(5000).pipe(
-      startWith(0), // Immediately start the interval observable
-      switchMap(() => {
-        const storedLastTimestamp = this.getStoredTimestamp();
-        const currentTimestamp = new Date().getTime();
-        const oneHourAgo = currentTimestamp - 3600 * 1000;
-
-        // Cap the startTimestamp to be at most one hour ago
-        let startTimestamp = storedLastTimestamp ? Math.max(storedLastTimestamp + 1, oneHourAgo) : oneHourAgo;
+    const frames$ = this.telemetryService.getFrames();
+
+    // live values come from the telemetry socket, the REST API is read once
+    // for the settings and the history when it opens. It is only polled
+    // while the socket is down, the socket is kept open (or retried) as long
+    // as the dashboard is shown.
+    const info$ = this.telemetryService.connected$.pipe(
+      distinctUntilChanged(),
+      switchMap(live => live
+        ? this.fetchInfo().pipe(
+          switchMap(info => frames$.pipe(
+            scan((current, frame) => this.applyTelemetry(current, frame), info),
+            startWith(info)
+          ))
+        )
+        : interval(5000).pipe(
+          startWith(0), // Immediately start the interval observable
+          switchMap(() => this.fetchInfo())
+        )
+      )
+    );
 
-        return this.systemService.getInfo(startTimestamp);
-      }),
+    this.info$ = merge(info$, frames$.pipe(ignoreElements())).pipe(
       tap(info => {
         if (!info) {
           return;
@@ -173,12 +191,16 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
         }
         if (info.history) {
           this.importHistoricalData(info.history);
+        } else if (this.telemetryService.connected$.value) {
+          this.addLiveChartPoint(info);
         }
       }),
       map(info => {
         if (!info) {
           return SystemService.defaultInfo(); // Return empty object if no info
         }
+        // the live info is updated frame by frame, it must stay unscaled
+        info = { ...info };
         info.minVoltage = parseFloat(info.minVoltage.toFixed(1));
         info.maxVoltage = parseFloat(info.maxVoltage.toFixed(1));
         info.minPower = parseFloat(info.minPower.toFixed(1));
@@ -192,7 +214,8 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
 
         info.current = parseFloat((info.current / 1000).toFixed(1));
         info.coreVoltageActual = parseFloat((info.coreVoltageActual / 1000).toFixed(2));
-        info.coreVoltage = parseFloat((info.coreVoltage / 1000).toFixed(2));
+        // the dashboard shows what is in effect, a mining profile may override the settings
+        info.coreVoltage = parseFloat(((info.coreVoltageProfile ?? info.coreVoltage) / 1000).toFixed(2));
         info.temp = parseFloat(info.temp.toFixed(1));
         info.vrTemp = parseFloat(info.vrTemp.toFixed(1));
 
@@ -215,6 +238,86 @@ export class HomeComponent implements AfterViewChecked, OnInit, OnDestroy {
     );
   }
 
+  private fetchInfo(): Observable<ISystemInfo> {
+    const storedLastTimestamp = this.getStoredTimestamp();
+    const currentTimestamp = new Date().getTime();
+    const oneHourAgo = currentTimestamp - 3600 * 1000;
+
+    // Cap the startTimestamp to be at most one hour ago
+    let startTimestamp = storedLastTimestamp ? Math.max(storedLastTimestamp + 1, oneHourAgo) : oneHourAgo;
+
+    return this.systemService.getInfo(startTimestamp);
+  }
+
+  // the changed fields of a telemetry frame on top of the last info, the
+  // history was imported with the first one
+  private applyTelemetry(info: ISystemInfo, frame: ITelemetryFrame): ISystemInfo {
+    const next: ISystemInfo = { ...info, history: undefined };
+    const d = frame.data;
+    const set = <K extends keyof ISystemInfo>(key: K, value: number | string | undefined, convert = (v: any) => v) => {
+      if (value !== undefined) {
+        next[key] = convert(value);
+      }
+    };
+
+    switch (frame.topic) {
+      case 'hashrate':
+        set('hashRate', d['10m']);
+        set('hashRate_10m', d['10m']);
+        set('hashRate_1h', d['1h']);
+        set('hashRate_1d', d['1d']);
+        if (d['10m'] !== undefined) {
+          next.hashRateTimestamp = Date.now();
+        }
+        break;
+      case 'power':
+        set('power', d['power']);
+        set('voltage', d['voltage']);
+        set('current', d['current']);
+        set('coreVoltageProfile', d['coreVoltage']);
+        set('coreVoltageActual', d['coreVoltageActual']);
+        set('frequencyProfile', d['frequency']);
+        break;
+      case 'temps':
+        set('temp', d['asic']);
+        set('vrTemp', d['vr']);
+        set('fanrpm', d['fanRpm']);
+        set('fanspeed', d['fanPerc']);
+        break;
+      case 'shares':
+        set('sharesAccepted', d['accepted']);
+        set('sharesRejected', d['rejected']);
+        set('poolDifficulty', d['poolDifficulty']);
+        set('bestDiff', d['bestDiffString']);
+        set('bestSessionDiff', d['bestSessionDiffString']);
+        break;
+      case 'pool':
+        set('isStratumConnected', d['connected'], v => !!v);
+        set('isUsingFallbackStratum', d['fallback'], v => !!v);
+        set('lastpingrtt', d['pingRtt']);
+        break;
+    }
+    return next;
+  }
+
+  // the socket has no history, the chart is continued with the live values
+  private addLiveChartPoint(info: ISystemInfo): void {
+    const now = Date.now();
+    if (now - this.lastLiveChartPoint < this.liveChartIntervalMs) {
+      return;
+    }
+    this.lastLiveChartPoint = now;
+
+    // in the units of the history, GH/s * 100
+    this.importHistoricalData({
+      timestamps: [now],
+      timestampBase: 0,
+      hashrate_10m: [info.hashRate_10m * 100],
+      hashrate_1h: [info.hashRate_1h * 100],
+      hashrate_1d: [info.hashRate_1d * 100]
+    });
+  }
+
   private getQuickLink(stratumURL: string, stratumUser: string): string | undefined {
     const address = stratumUser.split('.')[0];
 
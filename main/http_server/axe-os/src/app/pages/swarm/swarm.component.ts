@@ -1,15 +1,19 @@
 import { HttpClient } from '@angular/common/http';
 import { Component, OnDestroy, OnInit } from '@angular/core';
 import { FormBuilder, FormGroup, Validators, FormControl } from '@angular/forms';
-import { catchError, forkJoin, from, map, mergeMap, of, take, timeout, toArray } from 'rxjs';
+import { catchError, forkJoin, from, map, merge, mergeMap, Observable, of, switchMap, take, timeout, toArray } from 'rxjs';
 import { LocalStorageService } from '../../services/local-storage.service';
 import { SystemService } from 'src/app/services/system.service';
 import { NbToastrService } from '@nebular/theme';
 import { LoadingService } from '../../services/loading.service';
+import { ISwarmDevice, ISwarmStats } from '../../models/ISwarmStats';
 
 const SWARM_DATA = 'SWARM_DATA';
 const SWARM_REFRESH_TIME = 'SWARM_REFRESH_TIME';
 
+// the aggregator may have to finish a polling round before it answers
+const SWARM_STATS_TIMEOUT_MS = 15000;
+
 @Component({
   selector: 'app-swarm',
   templateUrl: './swarm.component.html',
@@ -38,6 +42,9 @@ export class SwarmComponent implements OnInit, OnDestroy {
 
   public ipAddress: string;
 
+  // this device polls the peers, the page reads /api/swarm/stats
+  public swarmAggregator = false;
+
   // Legende
   public colorLegend: { color: string; label: string; count: number }[] = [];
 
@@ -74,6 +81,7 @@ export class SwarmComponent implements OnInit, OnDestroy {
       .subscribe({
         next: (info) => {
           this.ipAddress = info.hostip;
+          this.swarmAggregator = !!info.swarmAggregator;
           const swarmData = this.localStorageService.getObject(SWARM_DATA);
 
           if (swarmData == null) {
@@ -179,6 +187,7 @@ export class SwarmComponent implements OnInit, OnDestroy {
         const newItems = validResults.filter(item => !existingIps.has(item.IP));
         this.swarm = [...this.swarm, ...newItems].sort(this.sortByIp.bind(this));
         this.localStorageService.setObject(SWARM_DATA, this.swarm);
+        this.syncSwarmPeers();
         this.calculateTotals();
         this.rebuildColorLegend();
       },
@@ -221,6 +230,7 @@ export class SwarmComponent implements OnInit, OnDestroy {
         this.swarm.push(merged);
         this.swarm = this.swarm.sort(this.sortByIp.bind(this));
         this.localStorageService.setObject(SWARM_DATA, this.swarm);
+        this.syncSwarmPeers();
         this.calculateTotals();
         this.rebuildColorLegend();
       }
@@ -255,10 +265,18 @@ export class SwarmComponent implements OnInit, OnDestroy {
   public remove(axeOs: any) {
     this.swarm = this.swarm.filter(axe => axe.IP != axeOs.IP);
     this.localStorageService.setObject(SWARM_DATA, this.swarm);
+    this.syncSwarmPeers();
     this.calculateTotals();
     this.rebuildColorLegend();
   }
 
+  // the device keeps the peer list for the swarm aggregator (/api/swarm/stats)
+  private syncSwarmPeers(): void {
+    this.systemService.updateSwarm('', this.swarm.map(axe => ({ ip: axe.IP })))
+      .pipe(catchError(() => of(null)))
+      .subscribe();
+  }
+
   public refreshList() {
     if (this.scanning) {
       return;
@@ -268,7 +286,43 @@ export class SwarmComponent implements OnInit, OnDestroy {
     const ips = this.swarm.map(axeOs => axeOs.IP);
     this.isRefreshing = true;
 
-    from(ips).pipe(
+    // with the aggregator one request covers the farm, if it fails every
+    // device is polled from the browser
+    const stats$: Observable<ISwarmStats | null> = this.swarmAggregator
+      ? this.systemService.getSwarmStats().pipe(
+        timeout(SWARM_STATS_TIMEOUT_MS),
+        catchError(() => of(null))
+      )
+      : of(null);
+
+    stats$.pipe(
+      switchMap(stats => {
+        const aggregated = new Map((stats?.devices ?? []).map(device => [device.ip, device]));
+        // devices the aggregator doesn't know yet are polled directly
+        return merge(
+          from(ips.filter(ip => aggregated.has(ip))).pipe(
+            map(ipAddr => this.mergeAggregated(ipAddr, aggregated.get(ipAddr)!))
+          ),
+          this.pollDevices(ips.filter(ip => !aggregated.has(ip)))
+        );
+      }),
+      toArray()
+    ).pipe(take(1)).subscribe({
+      next: (result) => {
+        this.swarm = result.sort(this.sortByIp.bind(this));
+        this.localStorageService.setObject(SWARM_DATA, this.swarm);
+        this.calculateTotals();
+        this.rebuildColorLegend();
+        this.isRefreshing = false;
+      },
+      complete: () => {
+        this.isRefreshing = false;
+      }
+    });
+  }
+
+  private pollDevices(ips: string[]): Observable<any> {
+    return from(ips).pipe(
       mergeMap(ipAddr =>
         forkJoin({
           info: this.httpClient.get<any>(`http://${ipAddr}/api/system/info`).pipe(timeout(5000)),
@@ -298,39 +352,48 @@ export class SwarmComponent implements OnInit, OnDestroy {
           catchError(error => {
             const errorMessage = error?.message || error?.statusText || error?.toString() || 'Unknown error';
             this.toastrService.danger('Failed to get info from ' + ipAddr, errorMessage);
-            const existingDevice = this.swarm.find(axeOs => axeOs.IP === ipAddr);
-            return of({
-              ...existingDevice,
-              IP: ipAddr,
-              hashRate: 0,
-              sharesAccepted: 0,
-              power: 0,
-              voltage: 0,
-              temp: 0,
-              bestDiff: 0,
-              version: 0,
-              uptimeSeconds: 0,
-              poolDifficulty: 0,
-              swarmColor: existingDevice?.swarmColor ?? 'blue',
-              supportsAsicApi: existingDevice?.supportsAsicApi ?? false,
-            });
+            return of(this.offlineDevice(ipAddr));
           })
         ),
         128
-      ),
-      toArray()
-    ).pipe(take(1)).subscribe({
-      next: (result) => {
-        this.swarm = result.sort(this.sortByIp.bind(this));
-        this.localStorageService.setObject(SWARM_DATA, this.swarm);
-        this.calculateTotals();
-        this.rebuildColorLegend();
-        this.isRefreshing = false;
-      },
-      complete: () => {
-        this.isRefreshing = false;
-      }
-    });
+      )
+    );
+  }
+
+  // the stats of the aggregate on top of what is known about the device,
+  // the settings and ASIC details stay from the last scan
+  private mergeAggregated(ipAddr: string, device: ISwarmDevice): any {
+    if (device.health === 'offline') {
+      return this.offlineDevice(ipAddr);
+    }
+    const { ip, health, ageS, latencyMs, self, efficiency, ...stats } = device;
+    const existingDevice = this.swarm.find(axeOs => axeOs.IP === ipAddr);
+    return {
+      ...existingDevice,
+      ...stats,
+      IP: ipAddr,
+      swarmColor: existingDevice?.swarmColor ?? 'blue',
+      supportsAsicApi: existingDevice?.supportsAsicApi ?? false,
+    };
+  }
+
+  private offlineDevice(ipAddr: string): any {
+    const existingDevice = this.swarm.find(axeOs => axeOs.IP === ipAddr);
+    return {
+      ...existingDevice,
+      IP: ipAddr,
+      hashRate: 0,
+      sharesAccepted: 0,
+      power: 0,
+      voltage: 0,
+      temp: 0,
+      bestDiff: 0,
+      version: 0,
+      uptimeSeconds: 0,
+      poolDifficulty: 0,
+      swarmColor: existingDevice?.swarmColor ?? 'blue',
+      supportsAsicApi: existingDevice?.supportsAsicApi ?? false,
+    };
   }
 
   private sortByIp(a: any, b: any): number {
@@ -9,6 +9,7 @@ import { AsicInfo } from '../models/IAsicInfo';
 
 import { environment } from '../../environments/environment';
 import { IInfluxDB } from '../models/IInfluxDB';
+import { ISwarmStats } from '../models/ISwarmStats';
 
 const defaultInfo: ISystemInfo = {
   power: 11.670000076293945,
@@ -80,6 +81,10 @@ const defaultInfo: ISystemInfo = {
   boardtemp1: 30,
   boardtemp2: 40,
   overheat_temp: 70,
+  powerCap: 0,
+  powerCapActive: 0,
+  powerCapFrequency: 0,
+  powerCapHeadroom: 0,
   history: {
     hashrate_10m: [],
     hashrate_1h: [],
@@ -175,16 +180,27 @@ export class SystemService {
     return new Observable<HttpEvent<string>>((subscriber) => {
       const reader = new FileReader();
 
-      reader.onload = (event: any) => {
-        const fileContent = event.target.result;
+      reader.onload = async (event: any) => {
+        const fileContent: ArrayBuffer = event.target.result;
+
+        // manifest the device checks the image against, crypto.subtle is
+        // only there in secure contexts
+        const headers: { [name: string]: string } = {
+          'Content-Type': 'application/octet-stream', // Set the content type
+          'X-OTA-Size': String(fileContent.byteLength),
+        };
+        if (window.crypto?.subtle) {
+          const digest = await window.crypto.subtle.digest('SHA-256', fileContent);
+          headers['X-OTA-SHA256'] = Array.from(new Uint8Array(digest))
+            .map((b) => b.toString(16).padStart(2, '0'))
+            .join('');
+        }
 
         return this.httpClient.post(url, fileContent, {
           reportProgress: true,
           observe: 'events',
           responseType: 'text', // Specify the response type
-          headers: {
-            'Content-Type': 'application/octet-stream', // Set the content type
-          },
+          headers,
         }).subscribe({
           next: (event) => {
             subscriber.next(event);
@@ -218,6 +234,12 @@ export class SystemService {
     return this.httpClient.patch(`${uri}/api/swarm`, swarmConfig);
   }
 
+  // this device and the peers it polls for the swarm, 404 if the
+  // aggregator is disabled
+  public getSwarmStats(uri: string = ''): Observable<ISwarmStats> {
+    return this.httpClient.get<ISwarmStats>(`${uri}/api/swarm/stats`);
+  }
+
 
   public getAlertInfo(uri: string = ''): Observable<IAlertSettings> {
     if (environment.production) {
@@ -225,7 +247,15 @@ export class SystemService {
     } else {
       return of({
         alertDiscordEnable: 0,
-        alertDiscordWebhook: 'https://discord.com/api/webhooks/xxx/yyy'
+        alertDiscordWebhook: 'https://discord.com/api/webhooks/xxx/yyy',
+        alertWebhookEnable: 0,
+        alertEvents: 0xffff,
+        alertCooldown: 30,
+        alertDigest: 60,
+        alertHashrateDrop: 25,
+        alertChipPercent: 50,
+        alertEventNames: ['block_found', 'pool_failover', 'overheat', 'psu_fault', 'hashrate_drop',
+          'chip_underperforming', 'watchdog_reboot']
       }).pipe(delay(1000));
     }
   }
@@ -0,0 +1,47 @@
+import { Injectable } from '@angular/core';
+import { BehaviorSubject, EMPTY, Observable, retry, share, timer } from 'rxjs';
+import { webSocket } from 'rxjs/webSocket';
+
+import { environment } from '../../environments/environment';
+import { ITelemetryFrame } from '../models/ITelemetryFrame';
+
+const RECONNECT_DELAY_MS = 5000;
+
+@Injectable({
+  providedIn: 'root'
+})
+export class TelemetryService {
+
+  // true while the socket is open, the pages poll the REST API otherwise
+  public connected$ = new BehaviorSubject<boolean>(false);
+
+  private frames$: Observable<ITelemetryFrame>;
+
+  constructor() {
+    if (!environment.production) {
+      this.frames$ = EMPTY;
+      return;
+    }
+
+    const socket$ = webSocket<any>({
+      url: `ws://${window.location.host}/api/ws/telemetry`,
+      openObserver: { next: () => this.connected$.next(true) },
+      closeObserver: { next: () => this.connected$.next(false) }
+    });
+
+    // one socket for all subscribers, it is opened on the first and closed
+    // a second after the last one left, so switching pages keeps it
+    this.frames$ = socket$.multiplex(
+      () => ({ subscribe: '*', interval: 1000 }),
+      () => ({ unsubscribe: '*' }),
+      () => true
+    ).pipe(
+      retry({ delay: () => timer(RECONNECT_DELAY_MS) }),
+      share({ resetOnRefCountZero: () => timer(1000) })
+    );
+  }
+
+  public getFrames(): Observable<ITelemetryFrame> {
+    return this.frames$;
+  }
+}
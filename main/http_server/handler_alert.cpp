@@ -7,7 +7,7 @@
 #include "nvs_config.h"
 #include "http_cors.h"
 #include "http_utils.h"
-#include "discord.h"
+#include "alert_task.h"
 
 static const char* TAG = "http_alert";
 
@@ -32,6 +32,8 @@ esp_err_t GET_alert_info(httpd_req_t *req)
     // don't send the alertDiscordWebhook on the API
     //doc["alertDiscordWebhook"]  = alertDiscordWebhook;
     doc["alertDiscordEnable"] = Config::isDiscordAlertEnabled() ? 1 : 0;
+    doc["alertWebhookEnable"] = Config::isAlertWebhookEnabled() ? 1 : 0;
+    ALERT_ENGINE.toJson(doc.as<JsonObject>());
 
     esp_err_t ret = sendJsonResponse(req, doc);
 
@@ -89,13 +91,34 @@ esp_err_t POST_update_alert(httpd_req_t *req)
     if (doc["alertDiscordEnable"].is<bool>()) {
         Config::setDiscordAlertEnabled(doc["alertDiscordEnable"].as<bool>());
     }
+    if (doc["alertWebhook"].is<const char*>()) {
+        Config::setAlertWebhook(doc["alertWebhook"].as<const char*>());
+    }
+    if (doc["alertWebhookEnable"].is<bool>()) {
+        Config::setAlertWebhookEnabled(doc["alertWebhookEnable"].as<bool>());
+    }
+    if (doc["alertEvents"].is<uint16_t>()) {
+        Config::setAlertEvents(doc["alertEvents"].as<uint16_t>());
+    }
+    if (doc["alertCooldown"].is<uint16_t>()) {
+        Config::setAlertCooldown(doc["alertCooldown"].as<uint16_t>());
+    }
+    if (doc["alertDigest"].is<uint16_t>()) {
+        Config::setAlertDigest(doc["alertDigest"].as<uint16_t>());
+    }
+    if (doc["alertHashrateDrop"].is<uint16_t>() && doc["alertHashrateDrop"].as<uint16_t>() < 100) {
+        Config::setAlertHashrateDrop(doc["alertHashrateDrop"].as<uint16_t>());
+    }
+    if (doc["alertChipPercent"].is<uint16_t>() && doc["alertChipPercent"].as<uint16_t>() <= 100) {
+        Config::setAlertChipPercent(doc["alertChipPercent"].as<uint16_t>());
+    }
 
     doc.clear();
 
     httpd_resp_send_chunk(req, NULL, 0);
 
-    // reload discord alerter config
-    discordAlerter.loadConfig();
+    // reload the alerter config and the rules
+    ALERT_ENGINE.loadConfig();
 
     return ESP_OK;
 }
@@ -107,7 +130,7 @@ esp_err_t POST_test_alert(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    bool success = discordAlerter.sendTestMessage();
+    bool success = ALERT_ENGINE.sendTest();
 
     if (success) {
         httpd_resp_sendstr(req, "ok");
@@ -0,0 +1,198 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "ArduinoJson.h"
+
+#include "eventlog.h"
+#include "http_cors.h"
+#include "http_utils.h"
+#include "psram_allocator.h"
+
+static const char *TAG = "http_events";
+
+#define EVENTS_CHUNK_SIZE 1024
+
+// space for one record, binary or as text
+#define EVENTS_MAX_LINE 256
+
+/*
+ * GET /api/events?since=<seq>&format=text
+ *
+ * Returns the records of the binary event log starting at <seq>. Without
+ * format=text the packed little endian EventRecord structs are sent, the
+ * record size is in X-Event-Record-Size.
+ */
+esp_err_t GET_events(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    uint32_t since = 0;
+    bool text = false;
+    char query[64];
+    char value[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = strtoul(value, NULL, 10);
+        }
+        if (httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK) {
+            text = !strcmp(value, "text");
+        }
+    }
+
+    httpd_resp_set_type(req, text ? "text/plain; charset=utf-8" : "application/octet-stream");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    uint32_t first = EVENT_LOG.getFirstSeq();
+    uint32_t next = EVENT_LOG.getNextSeq();
+    if (since < first) {
+        since = first;
+    }
+
+    char nextHdr[16], sizeHdr[16];
+    snprintf(nextHdr, sizeof(nextHdr), "%" PRIu32, next);
+    snprintf(sizeHdr, sizeof(sizeHdr), "%u", (unsigned) sizeof(EventRecord));
+    httpd_resp_set_hdr(req, "X-Event-Next-Seq", nextHdr);
+    httpd_resp_set_hdr(req, "X-Event-Record-Size", sizeHdr);
+
+    char *chunk = (char *) MALLOC(EVENTS_CHUNK_SIZE);
+    if (!chunk) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    size_t pos = 0;
+    esp_err_t err = ESP_OK;
+    for (uint32_t seq = since; err == ESP_OK && seq < next; seq++) {
+        EventRecord record;
+        if (!EVENT_LOG.read(seq, &record)) {
+            // overwritten or still being written
+            continue;
+        }
+
+        if (pos + EVENTS_MAX_LINE > EVENTS_CHUNK_SIZE) {
+            err = httpd_resp_send_chunk(req, chunk, pos);
+            pos = 0;
+        }
+
+        if (text) {
+            pos += EventLog::format(&record, &chunk[pos], EVENTS_MAX_LINE - 1);
+            chunk[pos++] = '\n';
+        } else {
+            memcpy(&chunk[pos], &record, sizeof(record));
+            pos += sizeof(record);
+        }
+    }
+
+    if (err == ESP_OK && pos) {
+        err = httpd_resp_send_chunk(req, chunk, pos);
+    }
+    FREE(chunk);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "error sending events");
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t GET_events_verbosity(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    for (int i = 0; i < (int) EventModule::NUM_MODULES; i++) {
+        EventModule module = (EventModule) i;
+        doc[EventLog::moduleName(module)] = EventLog::levelName(EVENT_LOG.getLevel(module));
+    }
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
+
+/*
+ * POST /api/events/verbosity {"asic": "debug", "stratum": "info"}
+ *
+ * Levels are none, error, warn, info (binary events) and debug (binary
+ * events and text lines). Not persisted, reboot restores the defaults.
+ */
+esp_err_t POST_events_verbosity(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    int total_len = req->content_len;
+    int cur_len = 0;
+    char *buf = ((rest_server_context_t *) (req->user_ctx))->scratch;
+    int received = 0;
+
+    if (total_len >= SCRATCH_BUFSIZE) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Content too long");
+        return ESP_FAIL;
+    }
+
+    while (cur_len < total_len) {
+        received = httpd_req_recv(req, buf + cur_len, total_len);
+        if (received <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive body");
+            return ESP_FAIL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    DeserializationError error = deserializeJson(doc, buf);
+    if (error || !doc.is<JsonObject>()) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    for (JsonPair kv : doc.as<JsonObject>()) {
+        EventModule module;
+        EventLevel level;
+        if (!EventLog::parseModule(kv.key().c_str(), &module) || !kv.value().is<const char *>() ||
+            !EventLog::parseLevel(kv.value().as<const char *>(), &level)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid module or level");
+            return ESP_FAIL;
+        }
+        EVENT_LOG.setLevel(module, level);
+        ESP_LOGI(TAG, "verbosity of %s set to %s", EventLog::moduleName(module), EventLog::levelName(level));
+    }
+
+    doc.clear();
+
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
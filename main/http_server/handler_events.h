@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+esp_err_t GET_events(httpd_req_t *req);
+esp_err_t GET_events_verbosity(httpd_req_t *req);
+esp_err_t POST_events_verbosity(httpd_req_t *req);
@@ -7,6 +7,7 @@
 #include "nvs_config.h"
 #include "http_cors.h"
 #include "http_utils.h"
+#include "influx_task.h"
 
 static const char* TAG="http_influx";
 
@@ -42,6 +43,23 @@ esp_err_t GET_influx_info(httpd_req_t *req)
     doc["influxPrefix"] = influxPrefix;
     doc["influxEnable"] = Config::isInfluxEnabled() ? 1 : 0;
 
+    // batch writer statistics
+    WriterStats stats;
+    if (influx_task_get_writer_stats(&stats)) {
+        JsonObject writer = doc["writer"].to<JsonObject>();
+        writer["pointsWritten"]  = stats.points_written;
+        writer["pointsDropped"]  = stats.points_dropped;
+        writer["pointsPerSec"]   = stats.points_per_sec;
+        writer["bufferedPoints"] = stats.buffered_points;
+        writer["bufferedBytes"]  = stats.buffered_bytes;
+        writer["bytesRaw"]       = stats.bytes_raw;
+        writer["bytesWire"]      = stats.bytes_wire;
+        writer["flushes"]        = stats.flushes;
+        writer["flushErrors"]    = stats.flush_errors;
+        writer["lastFlushMs"]    = stats.last_flush_ms;
+        writer["maxFlushMs"]     = stats.max_flush_ms;
+    }
+
     // Serialize the JSON document into a string (using Arduino's String type)
     esp_err_t ret = sendJsonResponse(req, doc);
 
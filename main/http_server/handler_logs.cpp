@@ -0,0 +1,116 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+#include "http_cors.h"
+#include "logbuffer.h"
+
+static const char *TAG = "http_logs";
+
+#define LOGS_CHUNK_SIZE 1024
+
+/*
+ * GET /api/logs?since=<seq>
+ *
+ * Returns the buffered log lines starting at sequence number <seq> (all of
+ * them without parameter) as text/plain. X-Log-Next-Seq is the value for
+ * the next poll, X-Log-Dropped counts lines that were already overwritten.
+ */
+esp_err_t GET_logs(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    uint64_t since = 0;
+    char query[64];
+    char value[24];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoull(value, NULL, 10);
+    }
+
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    // only send what is there now, the log keeps growing while we stream
+    uint64_t first = LOG_BUFFER.getFirstSeq();
+    uint64_t next = LOG_BUFFER.getNextSeq();
+    if (since > next) {
+        since = next;
+    }
+
+    // httpd keeps the pointers until the headers are sent with the first chunk
+    char firstHdr[24], nextHdr[24], droppedHdr[24];
+    snprintf(firstHdr, sizeof(firstHdr), "%" PRIu64, first);
+    snprintf(nextHdr, sizeof(nextHdr), "%" PRIu64, next);
+    snprintf(droppedHdr, sizeof(droppedHdr), "%" PRIu64, since < first ? first - since : 0);
+    httpd_resp_set_hdr(req, "X-Log-First-Seq", firstHdr);
+    httpd_resp_set_hdr(req, "X-Log-Next-Seq", nextHdr);
+    httpd_resp_set_hdr(req, "X-Log-Dropped", droppedHdr);
+
+    // on the heap, the httpd stack is small
+    char *line = (char *) malloc(LOG_LINE_MAX + 2);
+    char *chunk = (char *) malloc(LOGS_CHUNK_SIZE);
+    if (!line || !chunk) {
+        free(line);
+        free(chunk);
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    LogCursor cursor = LOG_BUFFER.cursorAt(since);
+    uint32_t dropped = 0;
+    size_t pos = 0;
+    esp_err_t err = ESP_OK;
+
+    while (err == ESP_OK && cursor.seq < next) {
+        int len = LOG_BUFFER.read(&cursor, line, LOG_LINE_MAX + 1, &dropped);
+        if (len < 0) {
+            break;
+        }
+        line[len++] = '\n';
+
+        if (pos + len > LOGS_CHUNK_SIZE) {
+            if (pos) {
+                err = httpd_resp_send_chunk(req, chunk, pos);
+                pos = 0;
+            }
+            // longer than a chunk, send it directly
+            if (err == ESP_OK && (size_t) len > LOGS_CHUNK_SIZE) {
+                err = httpd_resp_send_chunk(req, line, len);
+                continue;
+            }
+        }
+        memcpy(&chunk[pos], line, len);
+        pos += len;
+    }
+
+    if (err == ESP_OK && pos) {
+        err = httpd_resp_send_chunk(req, chunk, pos);
+    }
+
+    free(line);
+    free(chunk);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "error sending logs");
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+
+    if (dropped) {
+        ESP_LOGW(TAG, "%lu lines were overwritten while sending", (unsigned long) dropped);
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+esp_err_t GET_logs(httpd_req_t *req);
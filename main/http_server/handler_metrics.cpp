@@ -0,0 +1,48 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "http_cors.h"
+#include "http_utils.h"
+#include "metrics.h"
+
+static const char *TAG = "http_metrics";
+
+// small enough for the httpd stack, the response is sent in chunks
+#define METRICS_CHUNK_SIZE 1024
+
+static HistogramN<10> s_scrapeDuration("http_metrics_scrape_ms", "Time to export all metrics", METRICS_LATENCY_MS_BUCKETS);
+
+static bool send_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *) ctx, data, len) == ESP_OK;
+}
+
+esp_err_t GET_metrics(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/openmetrics-text; version=1.0.0; charset=utf-8");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    int64_t start = esp_timer_get_time();
+
+    char buf[METRICS_CHUNK_SIZE];
+    if (!Metrics::exportAll(buf, sizeof(buf), send_chunk, req)) {
+        ESP_LOGE(TAG, "error sending metrics");
+        // terminate the chunked response anyway
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_FAIL;
+    }
+
+    s_scrapeDuration.observe((float) (esp_timer_get_time() - start) / 1000.0f);
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
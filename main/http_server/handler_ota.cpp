@@ -1,69 +1,188 @@
-#include "esp_ota_ops.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 
+#include "fleet_ota_task.h"
 #include "global_state.h"
+#include "ota_writer.h"
+#include "psram_allocator.h"
 
 #include "http_cors.h"
 #include "http_utils.h"
 
 static const char *TAG = "http_ota";
 
-esp_err_t POST_WWW_update(httpd_req_t *req)
+// consecutive receive timeouts until the upload counts as interrupted
+#define OTA_RECV_MAX_TIMEOUTS 3
+
+static OtaWriter s_writer;
+
+static esp_err_t sendStatus(httpd_req_t *req, const char *status)
 {
-    if (is_network_allowed(req) != ESP_OK) {
-        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    s_writer.toJson(doc.to<JsonObject>());
+    FLEET_OTA.toJson(doc["pull"].to<JsonObject>());
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
+
+// starts a new session or checks that the request continues the open one.
+// Without Content-Range the body is the whole image, X-OTA-Size and
+// X-OTA-SHA256 are the manifest. A resumed upload sends
+// "Content-Range: bytes <offset>-<last>/<size>" with the offset from
+// GET /api/system/OTA/status.
+static esp_err_t openSession(httpd_req_t *req, OtaTarget target)
+{
+    size_t start = 0;
+    size_t total = req->content_len;
+    char value[80];
+
+    if (httpd_req_get_hdr_value_str(req, "Content-Range", value, sizeof(value)) == ESP_OK) {
+        unsigned long first, last, size;
+        if (sscanf(value, "bytes %lu-%lu/%lu", &first, &last, &size) != 3 || last < first ||
+            last - first + 1 != req->content_len) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed Content-Range");
+            return ESP_FAIL;
+        }
+        start = first;
+        total = size;
+    } else if (httpd_req_get_hdr_value_str(req, "X-OTA-Size", value, sizeof(value)) == ESP_OK) {
+        total = strtoul(value, NULL, 10);
+        if (total != req->content_len) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Size doesn't match the manifest");
+            return ESP_FAIL;
+        }
     }
 
-    int remaining = req->content_len;
+    if (start) {
+        if (s_writer.isStale()) {
+            s_writer.abort();
+        }
+        if (!s_writer.isActive() || s_writer.getTarget() != target || s_writer.getSize() != total ||
+            s_writer.getOffset() != start) {
+            sendStatus(req, "416 Range Not Satisfiable");
+            return ESP_FAIL;
+        }
+        ESP_LOGI(TAG, "resuming %s update at %u/%u bytes", OtaWriter::targetName(target), (unsigned) start, (unsigned) total);
+        return ESP_OK;
+    }
+
+    char sha[72];
+    bool hasSha = httpd_req_get_hdr_value_str(req, "X-OTA-SHA256", sha, sizeof(sha)) == ESP_OK;
+
+    esp_err_t err = s_writer.begin(target, total, hasSha ? sha : nullptr);
+    switch (err) {
+    case ESP_OK:
+        return ESP_OK;
+    case ESP_ERR_INVALID_STATE:
+        httpd_resp_set_status(req, "409 Conflict");
+        httpd_resp_sendstr(req, "Another update is in progress");
+        break;
+    case ESP_ERR_INVALID_SIZE:
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File provided is too large for device");
+        break;
+    case ESP_ERR_INVALID_ARG:
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Malformed SHA-256");
+        break;
+    case ESP_ERR_NOT_FOUND:
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Partition not found");
+        break;
+    default:
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash Error");
+        break;
+    }
+    return ESP_FAIL;
+}
 
-    const esp_partition_t *www_partition =
-        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
-    if (www_partition == NULL) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "WWW partition not found");
+// streams the body into the session. The power management keeps running,
+// the flash is only written by this task. Sets done when the image is
+// complete and verified, otherwise the response is already sent.
+static esp_err_t receiveUpdate(httpd_req_t *req, OtaTarget target, bool *done)
+{
+    *done = false;
+
+    if (openSession(req, target) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    // Don't attempt to write more than what can be stored in the partition
-    if (remaining > www_partition->size) {
-        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "File provided is too large for device");
+    // don't put it on the stack
+    uint8_t *buf = (uint8_t *) MALLOC(OTA_CHUNK_SIZE);
+    if (!buf) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation error");
         return ESP_FAIL;
     }
 
-    {
-        // lock the power management module
-        LockGuard g(POWER_MANAGEMENT_MODULE);
+    int remaining = req->content_len;
+    int timeouts = 0;
+    while (remaining > 0) {
+        int recv_len = httpd_req_recv(req, (char *) buf, min(remaining, OTA_CHUNK_SIZE));
 
-        // Erase the entire www partition before writing
-        ESP_ERROR_CHECK(esp_partition_erase_range(www_partition, 0, www_partition->size));
+        // Timeout Error: retry a few times
+        if (recv_len == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_MAX_TIMEOUTS) {
+            continue;
+        }
 
-        // don't put it on the stack
-        char *buf = (char*) malloc(2048);
+        // Connection lost: the session stays open for a resume
+        if (recv_len <= 0) {
+            ESP_LOGW(TAG, "upload interrupted at %u/%u bytes", (unsigned) s_writer.getOffset(), (unsigned) s_writer.getSize());
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Protocol Error");
+            FREE(buf);
+            return ESP_FAIL;
+        }
+        timeouts = 0;
 
-        while (remaining > 0) {
-            int recv_len = httpd_req_recv(req, buf, min(remaining, 2048));
+        if (s_writer.write(buf, recv_len) != ESP_OK) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash Error");
+            FREE(buf);
+            return ESP_FAIL;
+        }
 
-            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
-            } else if (recv_len <= 0) {
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Protocol Error");
-                free(buf);
-                return ESP_FAIL;
-            }
+        remaining -= recv_len;
 
-            if (esp_partition_write(www_partition, www_partition->size - remaining, (const void *) buf, recv_len) != ESP_OK) {
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Write Error");
-                free(buf);
-                return ESP_FAIL;
-            }
+        // give the scheduler a chance for other tasks
+        vTaskDelay(1);
+    }
 
-            remaining -= recv_len;
+    FREE(buf);
 
-            // give the scheduler a chance for other tasks
-            vTaskDelay(1);
-        }
+    // more parts to come
+    if (s_writer.getOffset() < s_writer.getSize()) {
+        sendStatus(req, "202 Accepted");
+        return ESP_OK;
+    }
+
+    esp_err_t err = s_writer.finish();
+    if (err == ESP_ERR_INVALID_CRC) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "SHA-256 doesn't match the manifest");
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Validation / Activation Error");
+        return ESP_FAIL;
+    }
+
+    *done = true;
+    return ESP_OK;
+}
 
-        free(buf);
+esp_err_t POST_WWW_update(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    bool done;
+    esp_err_t err = receiveUpdate(req, OtaTarget::WWW, &done);
+    if (!done) {
+        return err;
     }
 
     httpd_resp_sendstr(req, "WWW update complete\n");
@@ -79,60 +198,53 @@ esp_err_t POST_OTA_update(httpd_req_t *req)
         return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    esp_ota_handle_t ota_handle;
-    int remaining = req->content_len;
-
-    {
-        // lock the power management module
-        LockGuard g(POWER_MANAGEMENT_MODULE);
-
-        const esp_partition_t *ota_partition = esp_ota_get_next_update_partition(NULL);
-        ESP_ERROR_CHECK(esp_ota_begin(ota_partition, OTA_SIZE_UNKNOWN, &ota_handle));
-
-        // don't put it on the stack
-        char *buf = (char*) malloc(2048);
-
-        while (remaining > 0) {
-            int recv_len = httpd_req_recv(req, buf, min(remaining, 2048));
-
-            // Timeout Error: Just retry
-            if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-                continue;
+    bool done;
+    esp_err_t err = receiveUpdate(req, OtaTarget::FIRMWARE, &done);
+    if (!done) {
+        return err;
+    }
 
-                // Serious Error: Abort OTA
-            } else if (recv_len <= 0) {
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Protocol Error");
-                free(buf);
-                return ESP_FAIL;
-            }
+    httpd_resp_sendstr(req, "Firmware update complete, rebooting now!\n");
+    ESP_LOGI(TAG, "Restarting System because of Firmware update complete");
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    POWER_MANAGEMENT_MODULE.restart();
 
-            // Successful Upload: Flash firmware chunk
-            if (esp_ota_write(ota_handle, (const void *) buf, recv_len) != ESP_OK) {
-                esp_ota_abort(ota_handle);
-                httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Flash Error");
-                free(buf);
-                return ESP_FAIL;
-            }
+    return ESP_OK;
+}
 
-            remaining -= recv_len;
+/*
+ * GET /api/system/OTA/status
+ *
+ * Progress of the running update (offset to resume at, throughput), the
+ * result of the last one and the state of the pull from the update mirror.
+ */
+esp_err_t GET_OTA_status(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
 
-            // give the scheduler a chance for other tasks
-            vTaskDelay(1);
-        }
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
 
-        free(buf);
+    return sendStatus(req, HTTPD_200);
+}
 
-        // Validate and switch to new OTA image and reboot
-        if (esp_ota_end(ota_handle) != ESP_OK || esp_ota_set_boot_partition(ota_partition) != ESP_OK) {
-            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Validation / Activation Error");
-            return ESP_FAIL;
-        }
+/*
+ * POST /api/system/OTA/pull
+ *
+ * Checks the update mirror now and applies a new version without waiting
+ * for the stagger delay.
+ */
+esp_err_t POST_OTA_pull(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
     }
 
-    httpd_resp_sendstr(req, "Firmware update complete, rebooting now!\n");
-    ESP_LOGI(TAG, "Restarting System because of Firmware update complete");
-    vTaskDelay(pdMS_TO_TICKS(1000));
-    POWER_MANAGEMENT_MODULE.restart();
-
+    FLEET_OTA.checkNow();
+    httpd_resp_sendstr(req, "Checking the update mirror\n");
     return ESP_OK;
 }
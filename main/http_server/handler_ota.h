@@ -3,4 +3,6 @@
 #include "esp_http_server.h"
 
 esp_err_t POST_WWW_update(httpd_req_t *req);
-esp_err_t POST_OTA_update(httpd_req_t *req);
\ No newline at end of file
+esp_err_t POST_OTA_update(httpd_req_t *req);
+esp_err_t GET_OTA_status(httpd_req_t *req);
+esp_err_t POST_OTA_pull(httpd_req_t *req);
@@ -0,0 +1,38 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "ArduinoJson.h"
+
+#include "http_cors.h"
+#include "http_utils.h"
+#include "profiler.h"
+#include "psram_allocator.h"
+
+/*
+ * GET /api/system/profile
+ *
+ * CPU load per core over 1/10/60 s, CPU use, priority and free stack of
+ * every task (busiest first) and the longest loop iterations of the
+ * mining tasks.
+ */
+esp_err_t GET_system_profile(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    PROFILER.toJson(doc);
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
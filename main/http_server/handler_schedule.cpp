@@ -0,0 +1,203 @@
+#include <string.h>
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "ArduinoJson.h"
+
+#include "global_state.h"
+#include "http_cors.h"
+#include "http_utils.h"
+#include "nvs_config.h"
+#include "profile_schedule.h"
+#include "psram_allocator.h"
+#include "scheduler_task.h"
+
+static const char *TAG = "http_schedule";
+
+// reads the request body into the scratch buffer, sends the error itself
+static esp_err_t receive_body(httpd_req_t *req, char **body)
+{
+    int total_len = req->content_len;
+    int cur_len = 0;
+    char *buf = ((rest_server_context_t *) (req->user_ctx))->scratch;
+    int received = 0;
+
+    if (total_len >= SCRATCH_BUFSIZE) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Content too long");
+        return ESP_FAIL;
+    }
+
+    while (cur_len < total_len) {
+        received = httpd_req_recv(req, buf + cur_len, total_len);
+        if (received <= 0) {
+            httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to receive body");
+            return ESP_FAIL;
+        }
+        cur_len += received;
+    }
+    buf[total_len] = '\0';
+
+    *body = buf;
+    return ESP_OK;
+}
+
+/*
+ * GET /api/schedule
+ *
+ * The stored schedule ("config"), the profile in effect and the energy,
+ * hashes, shares and cost accounted per profile.
+ */
+esp_err_t GET_schedule(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    char *config = Config::getScheduleConfig();
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    PROFILE_SCHEDULER.toJson(doc.to<JsonObject>());
+    if (*config) {
+        // was validated when it was stored
+        doc["config"] = serialized(config);
+    }
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    free(config);
+    return ret;
+}
+
+/*
+ * PATCH /api/schedule
+ *
+ * Replaces the schedule, see profile_schedule.h for the format. An empty
+ * body removes it.
+ */
+esp_err_t PATCH_update_schedule(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    char *buf;
+    if (receive_body(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    schedule_config_t *config = (schedule_config_t *) malloc(sizeof(schedule_config_t));
+    if (!config) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    char err[96];
+    bool valid = schedule_parse(buf, strlen(buf), config, err, sizeof(err));
+
+    // the limits of the board apply to the profiles as well
+    Board *board = SYSTEM_MODULE.getBoard();
+    for (int i = 0; valid && i < config->numProfiles; i++) {
+        const schedule_profile_t *profile = &config->profiles[i];
+        if ((profile->frequency && !board->validateFrequency((float) profile->frequency)) ||
+            (profile->coreVoltage && !board->validateVoltage((float) profile->coreVoltage / 1000.0f))) {
+            snprintf(err, sizeof(err), "profile '%s': frequency or voltage above the limit of the board", profile->name);
+            valid = false;
+        }
+    }
+    free(config);
+
+    if (!valid) {
+        ESP_LOGE(TAG, "schedule rejected: %s", err);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err);
+        return ESP_FAIL;
+    }
+
+    // the scheduler reloads it
+    Config::setScheduleConfig(buf);
+
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+/*
+ * POST /api/schedule/activate
+ *
+ *   {"profile": "eco", "minutes": 120}
+ *
+ * Holds a profile for the minutes or, without them, until the next rule
+ * starts. "default" holds the configured settings, "auto" goes back to the
+ * schedule.
+ */
+esp_err_t POST_schedule_activate(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    char *buf;
+    if (receive_body(req, &buf) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    DeserializationError error = deserializeJson(doc, buf);
+    if (error || !doc["profile"].is<const char *>()) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    const char *profile = doc["profile"];
+    if (!strcmp(profile, "auto")) {
+        PROFILE_SCHEDULER.resume();
+    } else if (!PROFILE_SCHEDULER.activate(profile, doc["minutes"] | 0u)) {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Unknown profile");
+        return ESP_FAIL;
+    }
+
+    doc.clear();
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+
+/*
+ * POST /api/schedule/reset
+ *
+ * Starts the accounting of all profiles over.
+ */
+esp_err_t POST_schedule_reset(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PROFILE_SCHEDULER.resetAccounts();
+
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
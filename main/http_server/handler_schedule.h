@@ -0,0 +1,8 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+esp_err_t GET_schedule(httpd_req_t *req);
+esp_err_t PATCH_update_schedule(httpd_req_t *req);
+esp_err_t POST_schedule_activate(httpd_req_t *req);
+esp_err_t POST_schedule_reset(httpd_req_t *req);
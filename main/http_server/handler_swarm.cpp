@@ -1,7 +1,13 @@
 #include "esp_http_server.h"
 #include "esp_log.h"
 
+#include "esp_timer.h"
+
+#include "ArduinoJson.h"
+
 #include "nvs_config.h"
+#include "psram_allocator.h"
+#include "swarm_task.h"
 #include "http_cors.h"
 #include "http_utils.h"
 
@@ -59,4 +65,73 @@ esp_err_t GET_swarm(httpd_req_t *req)
     httpd_resp_sendstr(req, swarm_config);
     free(swarm_config);
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+// serializes one object into the chunk buffer and sends it
+static esp_err_t send_json_chunk(httpd_req_t *req, JsonDocument &doc, const char *prefix, char *buf, size_t len)
+{
+    size_t prefixLen = strlcpy(buf, prefix, len);
+    size_t jsonLen = serializeJson(doc, buf + prefixLen, len - prefixLen);
+    return httpd_resp_send_chunk(req, buf, prefixLen + jsonLen);
+}
+
+// aggregate of this device and the peers of the swarm config, one chunk per
+// device so the response doesn't need a buffer for the whole farm
+esp_err_t GET_swarm_stats(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    if (!Config::isSwarmAggregatorEnabled()) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "swarm aggregator disabled");
+    }
+
+    SWARM_AGGREGATOR.request(SWARM_HTTP_TIMEOUT_MS);
+
+    httpd_resp_set_type(req, "application/json");
+
+    char *buf = ((rest_server_context_t *) (req->user_ctx))->scratch;
+    int64_t now = esp_timer_get_time();
+    SwarmTotals totals = {};
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    SwarmPeer peer;
+    SwarmAggregator::localPeer(&peer);
+    SwarmAggregator::addToTotals(&peer, now, &totals);
+    SwarmAggregator::peerToJson(&peer, now, doc.to<JsonObject>());
+    doc["self"] = true;
+    esp_err_t err = send_json_chunk(req, doc, "{\"devices\":[", buf, SCRATCH_BUFSIZE);
+
+    for (int i = 0; err == ESP_OK && SWARM_AGGREGATOR.getPeer(i, &peer); i++) {
+        SwarmAggregator::addToTotals(&peer, now, &totals);
+        doc.clear();
+        SwarmAggregator::peerToJson(&peer, now, doc.to<JsonObject>());
+        err = send_json_chunk(req, doc, ",", buf, SCRATCH_BUFSIZE);
+    }
+
+    if (err == ESP_OK) {
+        doc.clear();
+        SwarmAggregator::totalsToJson(&totals, doc["total"].to<JsonObject>());
+        int64_t lastRoundUs = SWARM_AGGREGATOR.getLastRoundUs();
+        doc["ageS"] = lastRoundUs ? (now - lastRoundUs) / 1000000 : -1;
+        doc["roundMs"] = SWARM_AGGREGATOR.getLastRoundMs();
+        // the totals follow the devices, the opening brace becomes "],"
+        size_t len = serializeJson(doc, buf + 1, SCRATCH_BUFSIZE - 1);
+        buf[0] = ']';
+        buf[1] = ',';
+        err = httpd_resp_send_chunk(req, buf, len + 1);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
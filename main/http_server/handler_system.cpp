@@ -1,4 +1,5 @@
 #include "esp_ota_ops.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_timer.h"
@@ -8,10 +9,13 @@
 #include "psram_allocator.h"
 #include "global_state.h"
 #include "nvs_config.h"
+#include "task_topology.h"
 #include "http_cors.h"
 #include "http_utils.h"
 
 #include "ping_task.h"
+#include "swarm_task.h"
+#include "scheduler_task.h"
 
 static const char *TAG = "http_system";
 
@@ -57,14 +61,6 @@ esp_err_t GET_system_info(httpd_req_t *req)
     PSRAMAllocator allocator;
     JsonDocument doc(&allocator);
 
-    // Get configuration strings from NVS
-    char *ssid               = Config::getWifiSSID();
-    char *hostname           = Config::getHostname();
-    char *stratumURL         = Config::getStratumURL();
-    char *stratumUser        = Config::getStratumUser();
-    char *fallbackStratumURL = Config::getStratumFallbackURL();
-    char *fallbackStratumUser= Config::getStratumFallbackUser();
-
     // static
     doc["asicCount"]          = board->getAsicCount();
     doc["smallCoreCount"]     = (board->getAsics()) ? board->getAsics()->getSmallCoreCount() : 0;
@@ -91,7 +87,8 @@ esp_err_t GET_system_info(httpd_req_t *req)
     doc["hashRate_1d"]        = history->getCurrentHashrate1d();
     doc["bestDiff"]           = SYSTEM_MODULE.getBestDiffString();
     doc["bestSessionDiff"]    = SYSTEM_MODULE.getBestSessionDiffString();
-    doc["coreVoltage"]        = board->getAsicVoltageMillis();
+    doc["coreVoltage"]        = board->getConfigAsicVoltageMillis();
+    doc["coreVoltageProfile"] = board->getAsicVoltageMillis();
     doc["defaultCoreVoltage"] = board->getDefaultAsicVoltageMillis();
     doc["coreVoltageActual"]  = (int) (board->getVout() * 1000.0f);
     doc["sharesAccepted"]     = SYSTEM_MODULE.getSharesAccepted();
@@ -119,18 +116,42 @@ esp_err_t GET_system_info(httpd_req_t *req)
     doc["pidI"]               = (float) pid->i / 100.0f;
     doc["pidD"]               = (float) pid->d / 100.0f;
 
-    doc["hostname"]           = hostname;
-    doc["ssid"]               = ssid;
-    doc["stratumURL"]         = stratumURL;
+    {
+        // the config strings are copied into the document without a temporary copy
+        Config::StringRef hostname            = Config::refHostname();
+        Config::StringRef ssid                = Config::refWifiSSID();
+        Config::StringRef stratumURL          = Config::refStratumURL();
+        Config::StringRef stratumUser         = Config::refStratumUser();
+        Config::StringRef fallbackStratumURL  = Config::refStratumFallbackURL();
+        Config::StringRef fallbackStratumUser = Config::refStratumFallbackUser();
+        Config::StringRef otaMirrorURL        = Config::refOtaMirrorURL();
+
+        doc["hostname"]           = hostname.c_str();
+        doc["ssid"]               = ssid.c_str();
+        doc["stratumURL"]         = stratumURL.c_str();
+        doc["stratumUser"]        = stratumUser.c_str();
+        doc["fallbackStratumURL"] = fallbackStratumURL.c_str();
+        doc["fallbackStratumUser"] = fallbackStratumUser.c_str();
+        doc["otaMirrorURL"]       = otaMirrorURL.c_str();
+    }
     doc["stratumPort"]        = Config::getStratumPortNumber();
-    doc["stratumUser"]        = stratumUser;
-    doc["fallbackStratumURL"] = fallbackStratumURL;
     doc["fallbackStratumPort"]= Config::getStratumFallbackPortNumber();
-    doc["fallbackStratumUser"] = fallbackStratumUser;
     doc["voltage"]            = POWER_MANAGEMENT_MODULE.getVoltage();
-    doc["frequency"]          = board->getAsicFrequency();
+    // the settings form edits the configured values, a mining profile of
+    // the scheduler may be in effect instead
+    doc["frequency"]          = board->getConfigAsicFrequency();
+    doc["frequencyProfile"]   = board->getAsicFrequency();
+    doc["powerCap"]           = Config::getPowerCap();
+    doc["powerCapProfile"]    = POWER_MANAGEMENT_MODULE.getPowerCap();
+    doc["powerCapActive"]     = POWER_MANAGEMENT_MODULE.isPowerCapActive() ? 1 : 0;
+    doc["powerCapFrequency"]  = POWER_MANAGEMENT_MODULE.getPowerCapFrequency();
+    doc["powerCapHeadroom"]   = POWER_MANAGEMENT_MODULE.getPowerCapHeadroom();
     doc["defaultFrequency"]   = board->getDefaultAsicFrequency();
     doc["jobInterval"]        = board->getAsicJobIntervalMs();
+    doc["jobIntervalMinSafe"] = asicJobs.getMinSafeIntervalMs();
+    doc["miningCore"]         = board->getMiningCore();
+    doc["asicBaud"]           = board->getAsicBaud();
+    doc["asicUartCrcErrors"]  = (board->getAsics()) ? board->getAsics()->getCrcErrors() : 0;
     doc["stratumDifficulty"] = Config::getStratumDifficulty();
     doc["overheat_temp"]      = Config::getOverheatTemp();
     doc["flipscreen"]         = board->isFlipScreenEnabled() ? 1 : 0;
@@ -140,6 +161,14 @@ esp_err_t GET_system_info(httpd_req_t *req)
     doc["autofanpolarity"]  = board->isAutoFanPolarityEnabled() ? 1 : 0;
     doc["autofanspeed"]       = Config::getTempControlMode();
     doc["stratum_keep"]       = Config::isStratumKeepaliveEnabled() ? 1 : 0;
+    doc["otaPullInterval"]    = Config::getOtaPullInterval();
+    doc["swarmAggregator"]    = Config::isSwarmAggregatorEnabled() ? 1 : 0;
+    doc["miningPaused"]       = SYSTEM_MODULE.isMiningPaused() ? 1 : 0;
+    {
+        char profile[SCHEDULE_NAME_MAX];
+        PROFILE_SCHEDULER.getActiveName(profile, sizeof(profile));
+        doc["miningProfile"] = profile;
+    }
 
     // system screen
     doc["ASICModel"]          = board->getAsicModel();
@@ -160,14 +189,6 @@ esp_err_t GET_system_info(httpd_req_t *req)
     esp_err_t ret = sendJsonResponse(req, doc);
     doc.clear();
 
-    // Free temporary strings
-    free(ssid);
-    free(hostname);
-    free(stratumURL);
-    free(stratumUser);
-    free(fallbackStratumURL);
-    free(fallbackStratumUser);
-
     return ret;
 }
 
@@ -216,6 +237,9 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    // all settings are written with one commit
+    Config::beginBatch();
+
     // Update settings if each key exists in the JSON object.
     if (doc["stratumURL"].is<const char*>()) {
         Config::setStratumURL(doc["stratumURL"].as<const char*>());
@@ -250,6 +274,18 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
     if (doc["hostname"].is<const char*>()) {
         Config::setHostname(doc["hostname"].as<const char*>());
     }
+    if (doc["otaMirrorURL"].is<const char*>()) {
+        Config::setOtaMirrorURL(doc["otaMirrorURL"].as<const char*>());
+    }
+    if (doc["swarmAggregator"].is<bool>() || doc["swarmAggregator"].is<int>()) {
+        Config::setSwarmAggregator(doc["swarmAggregator"].as<int>() != 0);
+    }
+    if (doc["otaPullInterval"].is<uint16_t>()) {
+        uint16_t otaPullInterval = doc["otaPullInterval"].as<uint16_t>();
+        if (otaPullInterval > 0) {
+            Config::setOtaPullInterval(otaPullInterval);
+        }
+    }
     if (doc["coreVoltage"].is<uint16_t>()) {
         uint16_t coreVoltage = doc["coreVoltage"].as<uint16_t>();
         if (coreVoltage > 0) {
@@ -268,12 +304,23 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
             Config::setAsicJobInterval(jobInterval);
         }
     }
+    if (doc["miningCore"].is<uint16_t>()) {
+        // applied after the restart
+        uint16_t miningCore = doc["miningCore"].as<uint16_t>();
+        if (miningCore <= TASK_TOPOLOGY_UNPINNED) {
+            Config::setMiningCore(miningCore);
+        }
+    }
     if (doc["stratumDifficulty"].is<uint32_t>()) {
         Config::setStratumDifficulty(doc["stratumDifficulty"].as<uint32_t>());
     }
     if (doc["flipscreen"].is<bool>()) {
         Config::setFlipScreen(doc["flipscreen"].as<bool>());
     }
+    if (doc["powerCap"].is<uint16_t>()) {
+        // watts, 0 switches the cap off
+        Config::setPowerCap(doc["powerCap"].as<uint16_t>());
+    }
     if (doc["overheat_temp"].is<uint16_t>()) {
         Config::setOverheatTemp(doc["overheat_temp"].as<uint16_t>());
     }
@@ -313,6 +360,8 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
         Config::setPidD((uint16_t) (doc["pidD"].as<float>() * 100.0f));
     }
 
+    Config::commitBatch();
+
     doc.clear();
 
     // Signal the end of the response
@@ -325,6 +374,27 @@ esp_err_t PATCH_update_settings(httpd_req_t *req)
     return ESP_OK;
 }
 
+// the few values a swarm aggregator polls, a fraction of /api/system/info
+esp_err_t GET_system_stats(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    SwarmAggregator::localStats(doc.to<JsonObject>());
+    return sendJsonResponse(req, doc);
+}
+
 esp_err_t GET_system_asic(httpd_req_t *req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -1,6 +1,7 @@
 #pragma once
 
 esp_err_t GET_system_info(httpd_req_t *req);
+esp_err_t GET_system_stats(httpd_req_t *req);
 esp_err_t PATCH_update_settings(httpd_req_t *req);
 
 esp_err_t GET_system_asic(httpd_req_t *req);
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "ArduinoJson.h"
+
+#include "http_cors.h"
+#include "http_utils.h"
+#include "psram_allocator.h"
+#include "vr_supervisor.h"
+
+/*
+ * GET /api/system/vr
+ *
+ * Supervision of the core regulator: SMBALERT# line, telemetry interval,
+ * the last status and the last faults with the telemetry samples taken
+ * before each of them (newest first).
+ */
+esp_err_t GET_system_vr(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    VR_SUPERVISOR.toJson(doc.to<JsonObject>());
+
+    esp_err_t ret = sendJsonResponse(req, doc);
+    doc.clear();
+    return ret;
+}
@@ -3,6 +3,7 @@
 
 #include "http_cors.h"
 #include "global_state.h"
+#include "metrics.h"
 
 static const char* CORS_TAG = "http_cors";
 
@@ -66,7 +67,23 @@ static const char* extract_origin_host(char *origin)
     return (const char*) host;
 }
 
+static Counter s_requestsAllowed("http_requests", "HTTP requests by access check result", "result=\"allowed\"");
+static Counter s_requestsDenied("http_requests", "HTTP requests by access check result", "result=\"denied\"");
+
+static esp_err_t check_network_allowed(httpd_req_t * req);
+
 esp_err_t is_network_allowed(httpd_req_t * req)
+{
+    esp_err_t ret = check_network_allowed(req);
+    if (ret == ESP_OK) {
+        s_requestsAllowed.inc();
+    } else {
+        s_requestsDenied.inc();
+    }
+    return ret;
+}
+
+static esp_err_t check_network_allowed(httpd_req_t * req)
 {
     if (SYSTEM_MODULE.getAPState()) {
         ESP_LOGI(CORS_TAG, "Device in AP mode. Allowing CORS.");
@@ -130,7 +147,7 @@ esp_err_t set_cors_headers(httpd_req_t *req)
 
     return httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*") == ESP_OK &&
                    httpd_resp_set_hdr(req, "Access-Control-Allow-Methods", "GET, POST, PUT, PATCH, DELETE, OPTIONS") == ESP_OK &&
-                   httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type") == ESP_OK
+                   httpd_resp_set_hdr(req, "Access-Control-Allow-Headers", "Content-Type, Content-Range, X-OTA-Size, X-OTA-SHA256") == ESP_OK
                ? ESP_OK
                : ESP_FAIL;
 }
\ No newline at end of file
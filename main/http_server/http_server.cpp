@@ -12,6 +12,7 @@
 #include "http_cors.h"
 #include "http_utils.h"
 #include "http_websocket.h"
+#include "http_telemetry.h"
 #include "handler_influx.h"
 #include "handler_swarm.h"
 #include "handler_system.h"
@@ -19,6 +20,13 @@
 #include "handler_restart.h"
 #include "handler_file.h"
 #include "handler_alert.h"
+#include "handler_metrics.h"
+#include "handler_logs.h"
+#include "handler_events.h"
+#include "handler_profile.h"
+#include "handler_vr.h"
+#include "handler_schedule.h"
+#include "task_topology.h"
 
 #pragma GCC diagnostic error "-Wall"
 #pragma GCC diagnostic error "-Wextra"
@@ -112,10 +120,11 @@ esp_err_t start_rest_server(void * pvParameters)
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 48;
     config.lru_purge_enable = true;
     config.max_open_sockets = 10;
     config.stack_size = 12288;
+    config.core_id = TASK_TOPOLOGY.getCore(TaskGroup::SERVICE);
 
     ESP_LOGI(TAG, "Starting HTTP Server");
     if (httpd_start(&http_server, &config) != ESP_OK) {
@@ -133,6 +142,11 @@ esp_err_t start_rest_server(void * pvParameters)
         .uri = "/api/system/info", .method = HTTP_GET, .handler = GET_system_info, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &system_info_get_uri);
 
+    /* URI handler for the compact stats polled by a swarm aggregator */
+    httpd_uri_t system_stats_get_uri = {
+        .uri = "/api/system/stats", .method = HTTP_GET, .handler = GET_system_stats, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &system_stats_get_uri);
+
         /* URI handler for fetching system info */
     httpd_uri_t system_asic_get_uri = {
         .uri = "/api/system/asic", .method = HTTP_GET, .handler = GET_system_asic, .user_ctx = rest_context};
@@ -146,6 +160,10 @@ esp_err_t start_rest_server(void * pvParameters)
     httpd_uri_t swarm_get_uri = {.uri = "/api/swarm/info", .method = HTTP_GET, .handler = GET_swarm, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &swarm_get_uri);
 
+    httpd_uri_t swarm_stats_get_uri = {
+        .uri = "/api/swarm/stats", .method = HTTP_GET, .handler = GET_swarm_stats, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &swarm_stats_get_uri);
+
     httpd_uri_t update_swarm_uri = {
         .uri = "/api/swarm", .method = HTTP_PATCH, .handler = PATCH_update_swarm, .user_ctx = rest_context};
     httpd_register_uri_handler(http_server, &update_swarm_uri);
@@ -210,9 +228,73 @@ esp_err_t start_rest_server(void * pvParameters)
         .uri = "/api/system/OTAWWW", .method = HTTP_POST, .handler = POST_WWW_update, .user_ctx = NULL};
     httpd_register_uri_handler(http_server, &update_post_ota_www);
 
+    httpd_uri_t update_get_ota_status = {
+        .uri = "/api/system/OTA/status", .method = HTTP_GET, .handler = GET_OTA_status, .user_ctx = NULL};
+    httpd_register_uri_handler(http_server, &update_get_ota_status);
+
+    httpd_uri_t update_post_ota_pull = {
+        .uri = "/api/system/OTA/pull", .method = HTTP_POST, .handler = POST_OTA_pull, .user_ctx = NULL};
+    httpd_register_uri_handler(http_server, &update_post_ota_pull);
+
+    httpd_uri_t metrics_get_uri = {
+        .uri = "/metrics", .method = HTTP_GET, .handler = GET_metrics, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &metrics_get_uri);
+
+    httpd_uri_t profile_get_uri = {
+        .uri = "/api/system/profile", .method = HTTP_GET, .handler = GET_system_profile, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &profile_get_uri);
+
+    httpd_uri_t vr_get_uri = {
+        .uri = "/api/system/vr", .method = HTTP_GET, .handler = GET_system_vr, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &vr_get_uri);
+
+    httpd_uri_t schedule_get_uri = {
+        .uri = "/api/schedule", .method = HTTP_GET, .handler = GET_schedule, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &schedule_get_uri);
+
+    httpd_uri_t schedule_patch_uri = {
+        .uri = "/api/schedule", .method = HTTP_PATCH, .handler = PATCH_update_schedule, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &schedule_patch_uri);
+
+    httpd_uri_t schedule_options_uri = {
+        .uri = "/api/schedule",
+        .method = HTTP_OPTIONS,
+        .handler = handle_options_request,
+        .user_ctx = NULL,
+    };
+    httpd_register_uri_handler(http_server, &schedule_options_uri);
+
+    httpd_uri_t schedule_activate_uri = {
+        .uri = "/api/schedule/activate", .method = HTTP_POST, .handler = POST_schedule_activate, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &schedule_activate_uri);
+
+    httpd_uri_t schedule_reset_uri = {
+        .uri = "/api/schedule/reset", .method = HTTP_POST, .handler = POST_schedule_reset, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &schedule_reset_uri);
+
+    httpd_uri_t logs_get_uri = {
+        .uri = "/api/logs", .method = HTTP_GET, .handler = GET_logs, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &logs_get_uri);
+
+    httpd_uri_t events_get_uri = {
+        .uri = "/api/events", .method = HTTP_GET, .handler = GET_events, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &events_get_uri);
+
+    httpd_uri_t events_verbosity_get_uri = {
+        .uri = "/api/events/verbosity", .method = HTTP_GET, .handler = GET_events_verbosity, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &events_verbosity_get_uri);
+
+    httpd_uri_t events_verbosity_post_uri = {
+        .uri = "/api/events/verbosity", .method = HTTP_POST, .handler = POST_events_verbosity, .user_ctx = rest_context};
+    httpd_register_uri_handler(http_server, &events_verbosity_post_uri);
+
     httpd_uri_t ws = {.uri = "/api/ws", .method = HTTP_GET, .handler = echo_handler, .user_ctx = NULL, .is_websocket = true};
     httpd_register_uri_handler(http_server, &ws);
 
+    httpd_uri_t ws_telemetry = {
+        .uri = "/api/ws/telemetry", .method = HTTP_GET, .handler = telemetry_ws_handler, .user_ctx = NULL, .is_websocket = true};
+    httpd_register_uri_handler(http_server, &ws_telemetry);
+
     if (enter_recovery) {
         /* Make default route serve Recovery */
         httpd_uri_t recovery_implicit_get_uri = {
@@ -229,6 +311,7 @@ esp_err_t start_rest_server(void * pvParameters)
     httpd_register_err_handler(http_server, HTTPD_404_NOT_FOUND, http_404_error_handler);
 
     websocket_start();
+    telemetry_start();
 
     // Start the DNS server that will redirect all queries to the softAP IP
     dns_server_config_t dns_config = DNS_SERVER_CONFIG_SINGLE("*" /* all A queries */, "WIFI_AP_DEF" /* softAP netif ID */);
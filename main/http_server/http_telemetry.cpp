@@ -0,0 +1,489 @@
+#include <algorithm>
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "ArduinoJson.h"
+
+#include "global_state.h"
+#include "http_cors.h"
+#include "http_telemetry.h"
+#include "metrics.h"
+#include "ping_task.h"
+#include "psram_allocator.h"
+#include "task_topology.h"
+
+static const char *TAG = "http_telemetry";
+
+#define TELEMETRY_MAX_CLIENTS 4
+#define TELEMETRY_MAX_FIELDS 6
+#define TELEMETRY_TICK_MS 250
+
+// per client limits
+#define TELEMETRY_MIN_INTERVAL_MS 250
+#define TELEMETRY_MAX_INTERVAL_MS 60000
+#define TELEMETRY_DEFAULT_INTERVAL_MS 1000
+#define TELEMETRY_MAX_FPS 10.0f
+#define TELEMETRY_BURST 10.0f
+
+#define TELEMETRY_MAX_MESSAGE 256
+
+extern httpd_handle_t http_server;
+
+enum
+{
+    TOPIC_HASHRATE,
+    TOPIC_POWER,
+    TOPIC_TEMPS,
+    TOPIC_SHARES,
+    TOPIC_POOL,
+    NUM_TOPICS
+};
+
+typedef struct
+{
+    const char *name;
+    int numFields;
+    const char *fields[TELEMETRY_MAX_FIELDS];
+    int decimals;
+    void (*read)(double *values);
+} telemetry_topic_t;
+
+typedef struct
+{
+    int fd; // -1 if unused
+    uint32_t generation;
+    uint32_t topics; // subscribed topics bitmask
+    uint32_t fullPending;
+    uint32_t intervalMs;
+    uint32_t seq;
+    float tokens;
+    int64_t tokensTimestamp;
+    int64_t lastSent[NUM_TOPICS];
+    double sent[NUM_TOPICS][TELEMETRY_MAX_FIELDS];
+} telemetry_client_t;
+
+static Counter s_framesSent("telemetry_frames", "Telemetry frames sent to websocket clients");
+static Counter s_framesLimited("telemetry_rate_limited", "Telemetry frames delayed by the per client rate limit");
+static Counter s_bytesSent("telemetry_bytes", "Telemetry bytes sent to websocket clients");
+
+static void read_hashrate(double *v)
+{
+    History *history = SYSTEM_MODULE.getHistory();
+    if (!history) {
+        return;
+    }
+    v[0] = history->getCurrentHashrate1m();
+    v[1] = history->getCurrentHashrate10m();
+    v[2] = history->getCurrentHashrate1h();
+    v[3] = history->getCurrentHashrate1d();
+}
+
+static void read_power(double *v)
+{
+    Board *board = SYSTEM_MODULE.getBoard();
+    v[0] = POWER_MANAGEMENT_MODULE.getPower();
+    v[1] = POWER_MANAGEMENT_MODULE.getVoltage();
+    v[2] = POWER_MANAGEMENT_MODULE.getCurrent();
+    v[3] = board ? board->getAsicVoltageMillis() : 0;
+    v[4] = board ? board->getAsicFrequency() : 0;
+    v[5] = board ? board->getVout() * 1000.0f : 0;
+}
+
+static void read_temps(double *v)
+{
+    v[0] = POWER_MANAGEMENT_MODULE.getChipTempMax();
+    v[1] = POWER_MANAGEMENT_MODULE.getVRTemp();
+    v[2] = POWER_MANAGEMENT_MODULE.getFanRPM();
+    v[3] = POWER_MANAGEMENT_MODULE.getFanPerc();
+}
+
+static void read_shares(double *v)
+{
+    v[0] = SYSTEM_MODULE.getSharesAccepted();
+    v[1] = SYSTEM_MODULE.getSharesRejected();
+    v[2] = SYSTEM_MODULE.getBestSessionNonceDiff();
+    v[3] = SYSTEM_MODULE.getPoolDifficulty();
+    v[4] = SYSTEM_MODULE.isFoundBlock() ? 1 : 0;
+}
+
+static void read_pool(double *v)
+{
+    v[0] = STRATUM_MANAGER.isAnyConnected() ? 1 : 0;
+    v[1] = STRATUM_MANAGER.isUsingFallback() ? 1 : 0;
+    v[2] = SYSTEM_MODULE.getPoolErrors();
+    v[3] = STRATUM_MANAGER.getCurrentPoolPort();
+    v[4] = get_last_ping_rtt();
+}
+
+// values are rounded to the given decimals, a field is only sent if the rounded value changed
+static const telemetry_topic_t topics[NUM_TOPICS] = {
+    {"hashrate", 4, {"1m", "10m", "1h", "1d"}, 2, read_hashrate},
+    {"power", 6, {"power", "voltage", "current", "coreVoltage", "frequency", "coreVoltageActual"}, 2, read_power},
+    {"temps", 4, {"asic", "vr", "fanRpm", "fanPerc"}, 1, read_temps},
+    {"shares", 5, {"accepted", "rejected", "bestSessionDiff", "poolDifficulty", "foundBlock"}, 0, read_shares},
+    {"pool", 5, {"connected", "fallback", "errors", "port", "pingRtt"}, 0, read_pool},
+};
+
+static telemetry_client_t clients[TELEMETRY_MAX_CLIENTS];
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double round_to(double value, int decimals)
+{
+    static const double scale[] = {1.0, 10.0, 100.0, 1000.0};
+    return round(value * scale[decimals]) / scale[decimals];
+}
+
+static void add_client(int fd)
+{
+    pthread_mutex_lock(&clients_lock);
+    telemetry_client_t *free_slot = NULL;
+    for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+        if (clients[i].fd == fd) {
+            // reused socket
+            free_slot = &clients[i];
+            break;
+        }
+        if (!free_slot && clients[i].fd < 0) {
+            free_slot = &clients[i];
+        }
+    }
+
+    if (free_slot) {
+        uint32_t generation = free_slot->generation + 1;
+        memset(free_slot, 0, sizeof(telemetry_client_t));
+        free_slot->fd = fd;
+        free_slot->generation = generation;
+        free_slot->intervalMs = TELEMETRY_DEFAULT_INTERVAL_MS;
+        free_slot->tokens = TELEMETRY_BURST;
+        free_slot->tokensTimestamp = esp_timer_get_time();
+        ESP_LOGI(TAG, "telemetry client connected (fd %d)", fd);
+    } else {
+        ESP_LOGW(TAG, "too many telemetry clients, fd %d gets no data", fd);
+    }
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static int count_clients()
+{
+    int n = 0;
+    pthread_mutex_lock(&clients_lock);
+    for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+        n += (clients[i].fd >= 0) ? 1 : 0;
+    }
+    pthread_mutex_unlock(&clients_lock);
+    return n;
+}
+
+static Gauge s_clients("telemetry_clients", "Connected telemetry clients", []() { return (float) count_clients(); });
+
+static int topic_index(const char *name)
+{
+    for (int i = 0; i < NUM_TOPICS; i++) {
+        if (!strcmp(topics[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint32_t parse_topics(JsonVariant list)
+{
+    uint32_t mask = 0;
+    if (list.is<const char *>()) {
+        const char *name = list.as<const char *>();
+        if (!strcmp(name, "*")) {
+            return (1 << NUM_TOPICS) - 1;
+        }
+        int t = topic_index(name);
+        return (t >= 0) ? (1 << t) : 0;
+    }
+    for (JsonVariant item : list.as<JsonArray>()) {
+        if (item.is<const char *>()) {
+            mask |= parse_topics(item);
+        }
+    }
+    return mask;
+}
+
+static void handle_message(int fd, const char *message)
+{
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+
+    if (deserializeJson(doc, message)) {
+        ESP_LOGW(TAG, "invalid telemetry request from fd %d", fd);
+        return;
+    }
+
+    pthread_mutex_lock(&clients_lock);
+    for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+        telemetry_client_t *client = &clients[i];
+        if (client->fd != fd) {
+            continue;
+        }
+        if (!doc["subscribe"].isNull()) {
+            uint32_t added = parse_topics(doc["subscribe"]);
+            // new subscriptions start with a full frame
+            client->fullPending |= added & ~client->topics;
+            client->topics |= added;
+        }
+        if (!doc["unsubscribe"].isNull()) {
+            client->topics &= ~parse_topics(doc["unsubscribe"]);
+        }
+        if (doc["interval"].is<uint32_t>()) {
+            uint32_t interval = doc["interval"].as<uint32_t>();
+            client->intervalMs =
+                std::max((uint32_t) TELEMETRY_MIN_INTERVAL_MS, std::min(interval, (uint32_t) TELEMETRY_MAX_INTERVAL_MS));
+        }
+        ESP_LOGI(TAG, "fd %d: topics 0x%02lx, interval %lu ms", fd, client->topics, client->intervalMs);
+        break;
+    }
+    pthread_mutex_unlock(&clients_lock);
+}
+
+esp_err_t telemetry_ws_handler(httpd_req_t *req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    int fd = httpd_req_to_sockfd(req);
+
+    if (req->method == HTTP_GET) {
+        add_client(fd);
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t ws_pkt;
+    memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+    ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+
+    // get the length first
+    esp_err_t ret = httpd_ws_recv_frame(req, &ws_pkt, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (ws_pkt.type != HTTPD_WS_TYPE_TEXT || !ws_pkt.len) {
+        return ESP_OK;
+    }
+    if (ws_pkt.len >= TELEMETRY_MAX_MESSAGE) {
+        ESP_LOGW(TAG, "telemetry request too long (%d)", (int) ws_pkt.len);
+        return ESP_FAIL;
+    }
+
+    char message[TELEMETRY_MAX_MESSAGE];
+    ws_pkt.payload = (uint8_t *) message;
+    ret = httpd_ws_recv_frame(req, &ws_pkt, ws_pkt.len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    message[ws_pkt.len] = 0;
+
+    handle_message(fd, message);
+    return ESP_OK;
+}
+
+// snprintf that reports truncation as -1 and advances the write position
+static int append(char *buf, size_t len, int *pos, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+static int append(char *buf, size_t len, int *pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(&buf[*pos], len - *pos, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= len - *pos) {
+        return -1;
+    }
+    *pos += n;
+    return n;
+}
+
+// builds a frame with the changed fields, returns the length, 0 if nothing
+// changed or -1 if the frame doesn't fit
+static int build_frame(char *frame, size_t size, telemetry_client_t *client, int t, const double *current, bool full)
+{
+    const telemetry_topic_t *topic = &topics[t];
+
+    int len = 0;
+    if (append(frame, size, &len, "{\"topic\":\"%s\",\"seq\":%lu%s,\"data\":{", topic->name,
+               (unsigned long) client->seq + 1, full ? ",\"full\":true" : "") < 0) {
+        return -1;
+    }
+    int fields = 0;
+
+    for (int f = 0; f < topic->numFields; f++) {
+        double value = round_to(current[f], topic->decimals);
+        if (!full && value == client->sent[t][f]) {
+            continue;
+        }
+        if (append(frame, size, &len, "%s\"%s\":%.*f", fields ? "," : "", topic->fields[f], topic->decimals, value) < 0) {
+            return -1;
+        }
+        fields++;
+    }
+
+    if (!fields) {
+        return 0;
+    }
+
+    // the pool host and the formatted difficulties are strings, they are
+    // sent along whenever the topic changes
+    if (t == TOPIC_POOL) {
+        if (append(frame, size, &len, ",\"host\":\"%.64s\"", STRATUM_MANAGER.getCurrentPoolHost()) < 0) {
+            return -1;
+        }
+    } else if (t == TOPIC_SHARES) {
+        if (append(frame, size, &len, ",\"bestDiffString\":\"%s\",\"bestSessionDiffString\":\"%s\"",
+                   SYSTEM_MODULE.getBestDiffString(), SYSTEM_MODULE.getBestSessionDiffString()) < 0) {
+            return -1;
+        }
+    }
+
+    if (append(frame, size, &len, "}}") < 0) {
+        return -1;
+    }
+    return len;
+}
+
+static bool take_token(telemetry_client_t *client, int64_t now)
+{
+    client->tokens += (float) (now - client->tokensTimestamp) * TELEMETRY_MAX_FPS / 1000000.0f;
+    client->tokensTimestamp = now;
+    if (client->tokens > TELEMETRY_BURST) {
+        client->tokens = TELEMETRY_BURST;
+    }
+    if (client->tokens < 1.0f) {
+        return false;
+    }
+    client->tokens -= 1.0f;
+    return true;
+}
+
+static void update_client(int slot, double current[NUM_TOPICS][TELEMETRY_MAX_FIELDS])
+{
+    // work on a copy so slow clients don't block the websocket handler
+    telemetry_client_t client;
+    pthread_mutex_lock(&clients_lock);
+    client = clients[slot];
+    pthread_mutex_unlock(&clients_lock);
+
+    if (client.fd < 0) {
+        return;
+    }
+
+    bool closed = httpd_ws_get_fd_info(http_server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET;
+    int64_t now = esp_timer_get_time();
+    uint32_t sentFull = 0;
+    char frame[320];
+
+    for (int t = 0; t < NUM_TOPICS && !closed; t++) {
+        if (!(client.topics & (1 << t))) {
+            continue;
+        }
+        bool full = client.fullPending & (1 << t);
+        if (!full && (now - client.lastSent[t]) < (int64_t) client.intervalMs * 1000) {
+            continue;
+        }
+
+        int len = build_frame(frame, sizeof(frame), &client, t, current[t], full);
+        if (len <= 0) {
+            continue;
+        }
+
+        if (!take_token(&client, now)) {
+            // values are compared to the last sent frame, so nothing gets lost
+            s_framesLimited.inc();
+            continue;
+        }
+
+        httpd_ws_frame_t ws_pkt;
+        memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
+        ws_pkt.payload = (uint8_t *) frame;
+        ws_pkt.len = len;
+        ws_pkt.type = HTTPD_WS_TYPE_TEXT;
+
+        if (httpd_ws_send_frame_async(http_server, client.fd, &ws_pkt) != ESP_OK) {
+            closed = true;
+            break;
+        }
+
+        s_framesSent.inc();
+        s_bytesSent.inc(len);
+
+        client.seq++;
+        client.lastSent[t] = now;
+        sentFull |= full ? (1 << t) : 0;
+        for (int f = 0; f < topics[t].numFields; f++) {
+            client.sent[t][f] = round_to(current[t][f], topics[t].decimals);
+        }
+    }
+
+    pthread_mutex_lock(&clients_lock);
+    telemetry_client_t *target = &clients[slot];
+    // only write back if the slot wasn't reused in the meantime
+    if (target->fd == client.fd && target->generation == client.generation) {
+        if (closed) {
+            ESP_LOGI(TAG, "telemetry client disconnected (fd %d)", client.fd);
+            target->fd = -1;
+        } else {
+            // subscriptions may have changed while sending, only write back the send state
+            target->seq = client.seq;
+            target->tokens = client.tokens;
+            target->tokensTimestamp = client.tokensTimestamp;
+            target->fullPending &= ~sentFull;
+            memcpy(target->lastSent, client.lastSent, sizeof(client.lastSent));
+            memcpy(target->sent, client.sent, sizeof(client.sent));
+        }
+    }
+    pthread_mutex_unlock(&clients_lock);
+}
+
+static void telemetry_task(void *param)
+{
+    double current[NUM_TOPICS][TELEMETRY_MAX_FIELDS];
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(TELEMETRY_TICK_MS));
+
+        // which topics are needed at all?
+        uint32_t needed = 0;
+        pthread_mutex_lock(&clients_lock);
+        for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+            if (clients[i].fd >= 0) {
+                needed |= clients[i].topics;
+            }
+        }
+        pthread_mutex_unlock(&clients_lock);
+
+        if (!needed || !http_server) {
+            continue;
+        }
+
+        memset(current, 0, sizeof(current));
+        for (int t = 0; t < NUM_TOPICS; t++) {
+            if (needed & (1 << t)) {
+                topics[t].read(current[t]);
+            }
+        }
+
+        for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+            update_client(i, current);
+        }
+    }
+}
+
+void telemetry_start()
+{
+    for (int i = 0; i < TELEMETRY_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+    }
+
+    TASK_TOPOLOGY.create(telemetry_task, "telemetry", 4096, NULL, 2, NULL, TaskGroup::SERVICE);
+}
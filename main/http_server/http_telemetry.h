@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_http_server.h"
+
+// websocket with live telemetry, clients subscribe to topics and
+// only get the fields that changed since the last frame
+//
+//   -> {"subscribe": ["hashrate", "power"], "interval": 1000}
+//   <- {"topic":"power","seq":1,"full":true,"data":{"power":12.31,...}}
+//   <- {"topic":"power","seq":2,"data":{"power":12.45}}
+esp_err_t telemetry_ws_handler(httpd_req_t *req);
+
+void telemetry_start();
@@ -1,80 +1,133 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #include "http_cors.h"
-#include "http_utils.h"
 #include "http_websocket.h"
+#include "logbuffer.h"
+#include "metrics.h"
+#include "task_topology.h"
 
 static const char* TAG = "http_websocket";
 
-static int fd = -1;
-
-extern httpd_handle_t http_server;
+#define WEBSOCKET_MAX_CLIENTS 4
 
-QueueHandle_t log_queue = NULL;
+// lines replayed to a new client
+#define WEBSOCKET_BACKLOG_LINES 64
 
-static int log_to_queue(const char * format, va_list args)
-{
-    va_list args_copy;
-    va_copy(args_copy, args);
+// lines sent to one client before the next one gets its turn
+#define WEBSOCKET_LINES_PER_ROUND 32
 
-    // Calculate the required buffer size
-    int needed_size = vsnprintf(NULL, 0, format, args_copy) + 1;
-    va_end(args_copy);
+extern httpd_handle_t http_server;
 
-    // Allocate the buffer dynamically
-    char * log_buffer = (char *) CALLOC(needed_size + 2, sizeof(char));  // +2 for potential \n and \0
-    if (log_buffer == NULL) {
-        return 0;
+typedef struct
+{
+    int fd; // -1 if unused
+    uint32_t generation;
+    LogCursor cursor;
+    uint32_t dropped;
+} log_client_t;
+
+static log_client_t clients[WEBSOCKET_MAX_CLIENTS] = {
+    {.fd = -1, .generation = 0, .cursor = {}, .dropped = 0},
+    {.fd = -1, .generation = 0, .cursor = {}, .dropped = 0},
+    {.fd = -1, .generation = 0, .cursor = {}, .dropped = 0},
+    {.fd = -1, .generation = 0, .cursor = {}, .dropped = 0},
+};
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static TaskHandle_t log_task = NULL;
+
+// line plus newline, only used by the log task
+static char line[LOG_LINE_MAX + 2];
+
+static Counter s_linesSent("websocket_log_lines", "Log lines sent to websocket clients");
+static Counter s_linesDropped("websocket_log_dropped", "Log lines websocket clients missed because they were too slow");
+
+static bool add_client(int fd)
+{
+    uint64_t next = LOG_BUFFER.getNextSeq();
+    LogCursor cursor = LOG_BUFFER.cursorAt(next > WEBSOCKET_BACKLOG_LINES ? next - WEBSOCKET_BACKLOG_LINES : 0);
+
+    bool added = false;
+    pthread_mutex_lock(&clients_lock);
+    for (int i = 0; i < WEBSOCKET_MAX_CLIENTS; i++) {
+        // reconnect on the same socket
+        if (clients[i].fd == fd) {
+            clients[i].generation++;
+            clients[i].cursor = cursor;
+            clients[i].dropped = 0;
+            added = true;
+            break;
+        }
     }
-
-    // Format the string into the allocated buffer
-    va_copy(args_copy, args);
-    vsnprintf(log_buffer, needed_size, format, args_copy);
-    va_end(args_copy);
-
-    // Ensure the log message ends with a newline
-    size_t len = strlen(log_buffer);
-    if (len > 0 && log_buffer[len - 1] != '\n') {
-        log_buffer[len] = '\n';
-        log_buffer[len + 1] = '\0';
-        len++;
+    for (int i = 0; !added && i < WEBSOCKET_MAX_CLIENTS; i++) {
+        if (clients[i].fd == -1) {
+            clients[i].fd = fd;
+            clients[i].generation++;
+            clients[i].cursor = cursor;
+            clients[i].dropped = 0;
+            added = true;
+        }
     }
+    pthread_mutex_unlock(&clients_lock);
 
-    // Print to standard output
-    printf("%s", log_buffer);
-
-	if (xQueueSendToBack(log_queue, (void*)&log_buffer, (TickType_t) 0) != pdPASS) {
-		if (log_buffer != NULL) {
-			FREE(log_buffer);
-		}
-	}
-    return 0;
+    if (added && log_task) {
+        xTaskNotifyGive(log_task);
+    }
+    return added;
 }
 
-static void send_log_to_websocket(char *message)
+static bool send_text(int fd, const char *text, size_t len)
 {
-    // Prepare the WebSocket frame
     httpd_ws_frame_t ws_pkt;
     memset(&ws_pkt, 0, sizeof(httpd_ws_frame_t));
-    ws_pkt.payload = (uint8_t *)message;
-    ws_pkt.len = strlen(message);
+    ws_pkt.payload = (uint8_t *) text;
+    ws_pkt.len = len;
     ws_pkt.type = HTTPD_WS_TYPE_TEXT;
 
-    // Ensure server and fd are valid
-    if (http_server != NULL && fd >= 0) {
-        // Send the WebSocket frame asynchronously
-        if (httpd_ws_send_frame_async(http_server, fd, &ws_pkt) != ESP_OK) {
-            esp_log_set_vprintf(vprintf);
+    return httpd_ws_send_frame_async(http_server, fd, &ws_pkt) == ESP_OK;
+}
+
+// sends the next lines to a client, returns true if there is more to send
+static bool send_lines(log_client_t *client)
+{
+    for (int i = 0; i < WEBSOCKET_LINES_PER_ROUND; i++) {
+        int len = LOG_BUFFER.read(&client->cursor, line, LOG_LINE_MAX + 1, &client->dropped);
+
+        // tell the client about the gap before continuing
+        if (client->dropped) {
+            char msg[64];
+            int n = snprintf(msg, sizeof(msg), "... %lu log lines dropped ...\n", (unsigned long) client->dropped);
+            if (!send_text(client->fd, msg, n)) {
+                client->fd = -1;
+                return false;
+            }
+            s_linesDropped.inc(client->dropped);
+            client->dropped = 0;
+        }
+
+        if (len < 0) {
+            return false;
         }
-    }
 
-    // Free the allocated buffer
-    FREE(message);
+        // one frame per line, the UI expects them terminated
+        line[len++] = '\n';
+        if (!send_text(client->fd, line, len)) {
+            client->fd = -1;
+            return false;
+        }
+        s_linesSent.inc();
+    }
+    return true;
 }
 
 /*
- * This handler echos back the received ws data
- * and triggers an async send if certain message received
+ * Log websocket, any number of clients (up to WEBSOCKET_MAX_CLIENTS) follow
+ * the log buffer with their own cursor
  */
 esp_err_t echo_handler(httpd_req_t *req)
 {
@@ -83,8 +136,10 @@ esp_err_t echo_handler(httpd_req_t *req)
     }
     if (req->method == HTTP_GET) {
         ESP_LOGI(TAG, "Handshake done, the new connection was opened");
-        fd = httpd_req_to_sockfd(req);
-        esp_log_set_vprintf(log_to_queue);
+        if (!add_client(httpd_req_to_sockfd(req))) {
+            ESP_LOGW(TAG, "too many log clients");
+            return ESP_FAIL;
+        }
         return ESP_OK;
     }
     return ESP_OK;
@@ -92,30 +147,43 @@ esp_err_t echo_handler(httpd_req_t *req)
 
 void websocket_log_handler(void* param)
 {
-	while (true)
-	{
-		char *message;
-		if (xQueueReceive(log_queue, &message, (TickType_t) portMAX_DELAY) != pdPASS) {
-			if (message != NULL) {
-				FREE(message);
-			}
-			vTaskDelay(pdMS_TO_TICKS(10));
-			continue;
-		}
-
-		if (fd == -1) {
-			FREE(message);
-			vTaskDelay(pdMS_TO_TICKS(100));
-			continue;
-		}
-
-		send_log_to_websocket(message);
-	}
+    LOG_BUFFER.setNotifyTask(xTaskGetCurrentTaskHandle());
+
+    bool more = false;
+    while (true) {
+        // woken up by new lines, the timeout notices closed sockets
+        if (!more) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        }
+        more = false;
+
+        for (int i = 0; i < WEBSOCKET_MAX_CLIENTS; i++) {
+            // work on a copy, sending may block
+            pthread_mutex_lock(&clients_lock);
+            log_client_t client = clients[i];
+            pthread_mutex_unlock(&clients_lock);
+
+            if (client.fd == -1) {
+                continue;
+            }
+
+            if (!http_server || httpd_ws_get_fd_info(http_server, client.fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+                client.fd = -1;
+            } else {
+                more |= send_lines(&client);
+            }
+
+            pthread_mutex_lock(&clients_lock);
+            // don't overwrite a client add_client set up in the meantime
+            if (clients[i].generation == client.generation) {
+                clients[i] = client;
+            }
+            pthread_mutex_unlock(&clients_lock);
+        }
+    }
 }
 
 void websocket_start() {
-    log_queue = xQueueCreate(MESSAGE_QUEUE_SIZE, sizeof(char*));
-
     // Start websocket log handler thread
-    xTaskCreate(&websocket_log_handler, "websocket_log_handler", 4096, NULL, 2, NULL);
-}
\ No newline at end of file
+    TASK_TOPOLOGY.create(&websocket_log_handler, "websocket_log_handler", 4096, NULL, 2, &log_task, TaskGroup::SERVICE);
+}
@@ -0,0 +1,203 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "logbuffer.h"
+
+#pragma GCC diagnostic error "-Wall"
+#pragma GCC diagnostic error "-Wextra"
+
+// don't log from inside this file, it would recurse into the hook
+static const char *TAG = "logbuffer";
+
+#ifdef CONFIG_SPIRAM
+#define ALLOC(s) heap_caps_malloc(s, MALLOC_CAP_SPIRAM)
+#else
+#define ALLOC(s) malloc(s)
+#endif
+
+#define RECORD_HEADER sizeof(uint16_t)
+
+LogBuffer LOG_BUFFER;
+
+LogBuffer::LogBuffer()
+{
+    // NOP
+}
+
+bool LogBuffer::init(size_t size)
+{
+    m_buffer = (char *) ALLOC(size);
+    if (!m_buffer) {
+        ESP_LOGE(TAG, "error allocating log buffer");
+        return false;
+    }
+    m_size = size;
+
+    esp_log_set_vprintf(vprintfHook);
+    return true;
+}
+
+int LogBuffer::vprintfHook(const char *format, va_list args)
+{
+    LogBuffer *self = &LOG_BUFFER;
+
+    // the format buffer is shared, the ring lock is only taken for the copy
+    pthread_mutex_lock(&self->m_lineLock);
+    int len = vsnprintf(self->m_line, sizeof(self->m_line), format, args);
+    if (len < 0) {
+        pthread_mutex_unlock(&self->m_lineLock);
+        return len;
+    }
+    if (len >= (int) sizeof(self->m_line)) {
+        len = sizeof(self->m_line) - 1;
+    }
+
+    // without the newline, the readers add their own
+    size_t stored = len;
+    while (stored && (self->m_line[stored - 1] == '\n' || self->m_line[stored - 1] == '\r')) {
+        stored--;
+    }
+    pthread_mutex_lock(&self->m_lock);
+    self->writeLocked(self->m_line, stored);
+    TaskHandle_t notify = self->m_notifyTask;
+    pthread_mutex_unlock(&self->m_lock);
+
+    // print to the console as before
+    fputs(self->m_line, stdout);
+    pthread_mutex_unlock(&self->m_lineLock);
+
+    if (notify) {
+        xTaskNotifyGive(notify);
+    }
+    return len;
+}
+
+void LogBuffer::copyIn(uint64_t offset, const void *src, size_t len)
+{
+    size_t pos = offset % m_size;
+    size_t first = (len < m_size - pos) ? len : m_size - pos;
+    memcpy(&m_buffer[pos], src, first);
+    memcpy(m_buffer, (const char *) src + first, len - first);
+}
+
+void LogBuffer::copyOut(uint64_t offset, void *dst, size_t len)
+{
+    size_t pos = offset % m_size;
+    size_t first = (len < m_size - pos) ? len : m_size - pos;
+    memcpy(dst, &m_buffer[pos], first);
+    memcpy((char *) dst + first, m_buffer, len - first);
+}
+
+void LogBuffer::dropOldest()
+{
+    uint16_t len;
+    copyOut(m_head, &len, RECORD_HEADER);
+    m_head += RECORD_HEADER + len;
+    m_firstSeq++;
+}
+
+void LogBuffer::writeLocked(const char *line, size_t len)
+{
+    if (!m_buffer) {
+        return;
+    }
+
+    if (len > LOG_LINE_MAX) {
+        len = LOG_LINE_MAX;
+    }
+
+    uint16_t record_len = (uint16_t) len;
+    while (m_tail + RECORD_HEADER + record_len - m_head > m_size) {
+        dropOldest();
+    }
+
+    copyIn(m_tail, &record_len, RECORD_HEADER);
+    copyIn(m_tail + RECORD_HEADER, line, record_len);
+    m_tail += RECORD_HEADER + record_len;
+    m_nextSeq++;
+}
+
+void LogBuffer::write(const char *line, size_t len)
+{
+    pthread_mutex_lock(&m_lock);
+    writeLocked(line, len);
+    TaskHandle_t notify = m_notifyTask;
+    pthread_mutex_unlock(&m_lock);
+
+    if (notify) {
+        xTaskNotifyGive(notify);
+    }
+}
+
+int LogBuffer::read(LogCursor *cursor, char *dst, size_t maxLen, uint32_t *dropped)
+{
+    pthread_mutex_lock(&m_lock);
+
+    // the lines of the reader were overwritten, continue with the oldest one
+    if (cursor->seq < m_firstSeq) {
+        *dropped += (uint32_t) (m_firstSeq - cursor->seq);
+        cursor->seq = m_firstSeq;
+        cursor->offset = m_head;
+    }
+
+    if (cursor->seq >= m_nextSeq) {
+        pthread_mutex_unlock(&m_lock);
+        return -1;
+    }
+
+    uint16_t len;
+    copyOut(cursor->offset, &len, RECORD_HEADER);
+    size_t copy = (len < maxLen - 1) ? len : maxLen - 1;
+    copyOut(cursor->offset + RECORD_HEADER, dst, copy);
+    dst[copy] = 0;
+
+    cursor->offset += RECORD_HEADER + len;
+    cursor->seq++;
+
+    pthread_mutex_unlock(&m_lock);
+    return (int) copy;
+}
+
+LogCursor LogBuffer::cursorAt(uint64_t seq)
+{
+    pthread_mutex_lock(&m_lock);
+    LogCursor cursor = {m_firstSeq, m_head};
+
+    // walk the records, there are not that many
+    while (cursor.seq < seq && cursor.seq < m_nextSeq) {
+        uint16_t len;
+        copyOut(cursor.offset, &len, RECORD_HEADER);
+        cursor.offset += RECORD_HEADER + len;
+        cursor.seq++;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return cursor;
+}
+
+LogCursor LogBuffer::end()
+{
+    pthread_mutex_lock(&m_lock);
+    LogCursor cursor = {m_nextSeq, m_tail};
+    pthread_mutex_unlock(&m_lock);
+    return cursor;
+}
+
+uint64_t LogBuffer::getFirstSeq()
+{
+    pthread_mutex_lock(&m_lock);
+    uint64_t seq = m_firstSeq;
+    pthread_mutex_unlock(&m_lock);
+    return seq;
+}
+
+uint64_t LogBuffer::getNextSeq()
+{
+    pthread_mutex_lock(&m_lock);
+    uint64_t seq = m_nextSeq;
+    pthread_mutex_unlock(&m_lock);
+    return seq;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// size of the log ring buffer in PSRAM
+#define LOG_BUFFER_SIZE (64 * 1024)
+
+// longer lines are truncated
+#define LOG_LINE_MAX 1024
+
+// position of a reader in the log buffer
+typedef struct
+{
+    uint64_t seq;    // sequence number of the next line
+    uint64_t offset; // absolute byte offset of the next line
+} LogCursor;
+
+// Ring buffer holding the last log lines.
+//
+// Lines are stored as [u16 length][text] records in one PSRAM buffer,
+// writing a line never allocates. Every line has a sequence number, so
+// any number of readers can follow the log with their own cursor. When
+// a reader is too slow and its lines were overwritten, read() reports
+// how many lines it missed.
+class LogBuffer {
+  protected:
+    char *m_buffer = nullptr;
+    size_t m_size = 0;
+
+    uint64_t m_head = 0; // absolute offset of the oldest record
+    uint64_t m_tail = 0; // absolute offset of the next record
+    uint64_t m_firstSeq = 0;
+    uint64_t m_nextSeq = 0;
+
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    TaskHandle_t m_notifyTask = nullptr;
+
+    // format buffer used by the vprintf hook, guarded by m_lineLock so the
+    // slow console output doesn't hold m_lock
+    pthread_mutex_t m_lineLock = PTHREAD_MUTEX_INITIALIZER;
+    char m_line[LOG_LINE_MAX];
+
+    void copyOut(uint64_t offset, void *dst, size_t len);
+    void copyIn(uint64_t offset, const void *src, size_t len);
+    void dropOldest();
+    void writeLocked(const char *line, size_t len);
+
+    static int vprintfHook(const char *format, va_list args);
+
+  public:
+    LogBuffer();
+
+    // allocates the buffer and installs the log hook
+    bool init(size_t size);
+
+    void write(const char *line, size_t len);
+
+    // reads the line at the cursor into dst (zero terminated), returns the length
+    // or -1 if there is no new line. Lines that were lost are added to dropped.
+    int read(LogCursor *cursor, char *dst, size_t maxLen, uint32_t *dropped);
+
+    // cursor to the first line with a sequence number >= seq
+    LogCursor cursorAt(uint64_t seq);
+
+    // cursor behind the newest line
+    LogCursor end();
+
+    // task that is notified (xTaskNotifyGive) when a line was written
+    void setNotifyTask(TaskHandle_t task)
+    {
+        m_notifyTask = task;
+    }
+
+    uint64_t getFirstSeq();
+    uint64_t getNextSeq();
+};
+
+extern LogBuffer LOG_BUFFER;
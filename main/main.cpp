@@ -3,6 +3,7 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_sntp.h"
 #include "esp_task_wdt.h"
 #include "mbedtls/platform.h"
 #include "nvs_flash.h"
@@ -19,19 +20,26 @@
 #include "boards/nerdhaxegamma.h"
 #include "boards/nerdeko.h"
 #include "create_jobs_task.h"
+#include "fleet_ota_task.h"
+#include "swarm_task.h"
+#include "scheduler_task.h"
 #include "global_state.h"
 #include "history.h"
 #include "http_server.h"
 #include "influx_task.h"
+#include "logbuffer.h"
+#include "eventlog.h"
+#include "profiler.h"
 #include "main.h"
 #include "nvs_config.h"
 #include "serial.h"
 #include "stratum_task.h"
 #include "system.h"
+#include "task_topology.h"
 #include "apis_task.h"
 #include "ping_task.h"
 #include "wifi_health.h"
-#include "discord.h"
+#include "alert_task.h"
 
 #define STRATUM_WATCHDOG_TIMEOUT_SECONDS 3600
 
@@ -41,13 +49,20 @@ PowerManagementTask POWER_MANAGEMENT_MODULE;
 StratumManager STRATUM_MANAGER;
 APIsFetcher APIs_FETCHER;
 
-DiscordAlerter discordAlerter;
-
 AsicJobs asicJobs;
 
 static const char *TAG = "nerd*axe";
 // static const double NONCE_SPACE = 4294967296.0; //  2^32
 
+// the wall clock for the influx points and the mining profile schedule,
+// started once here so the tasks don't race to initialize it
+static void setup_sntp()
+{
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, "pool.ntp.org");
+    esp_sntp_init();
+}
+
 static void setup_wifi()
 {
     // pull the wifi credentials and hostname out of NVS
@@ -124,33 +139,25 @@ void free_psram(void *ptr) {
     heap_caps_free(ptr);
 }
 
-#if 0
-const UBaseType_t max_tasks = 30;
-TaskStatus_t task_list[max_tasks];
-
-void monitor_all_task_watermarks() {
-    UBaseType_t count = uxTaskGetSystemState(task_list, max_tasks, NULL);
-
-    for (int i = 0; i < count; ++i) {
-        ESP_LOGW("TASK_MON", "Task '%s': watermark = %lu words",
-            task_list[i].pcTaskName,
-            task_list[i].usStackHighWaterMark);
-
-    }
-}
-#endif
-
-
 extern "C" void app_main(void)
 {
     initWatchdog();
 
+    // keep the log in a ring buffer for the websocket and /api/logs
+    LOG_BUFFER.init(LOG_BUFFER_SIZE);
+
+    // binary events of the hot paths
+    EVENT_LOG.init(CONFIG_EVENTLOG_RECORDS);
+
     // use PSRAM because TLS costs a lot of internal RAM
     mbedtls_platform_set_calloc_free(psram_calloc, free_psram);
 
     ESP_LOGI(TAG, "Welcome to the Nerd*Axe - hack the planet!");
     ESP_ERROR_CHECK(nvs_flash_init());
 
+    // all settings are read from RAM from now on
+    Config::init();
+
     // shows and saves last reset reason
     esp_reset_reason_t reason = SYSTEM_MODULE.showLastResetReason();
 
@@ -202,10 +209,18 @@ extern "C" void app_main(void)
         vTaskDelay(pdMS_TO_TICKS(60 * 60 * 1000));
     }
 
-    xTaskCreate(SYSTEM_MODULE.taskWrapper, "SYSTEM_task", 4096, &SYSTEM_MODULE, 3, NULL);
-    xTaskCreate(POWER_MANAGEMENT_MODULE.taskWrapper, "power mangement", 8192, (void *) &POWER_MANAGEMENT_MODULE, 10, NULL);
+    // mining pipeline and UI/network tasks run on separate cores
+    TASK_TOPOLOGY.init(board->getMiningCore());
+
+    // task CPU usage, stack watermarks and loop latencies on /api/system/profile
+    PROFILER.start();
+
+    TASK_TOPOLOGY.create(SYSTEM_MODULE.taskWrapper, "SYSTEM_task", 4096, &SYSTEM_MODULE, 3, NULL, TaskGroup::SERVICE);
+    TASK_TOPOLOGY.create(POWER_MANAGEMENT_MODULE.taskWrapper, "power mangement", 8192, (void *) &POWER_MANAGEMENT_MODULE, 10, NULL,
+                         TaskGroup::MINING);
 
     setup_wifi();
+    setup_sntp();
 
     // set the startup_done flag
     SYSTEM_MODULE.setStartupDone();
@@ -216,12 +231,12 @@ extern "C" void app_main(void)
         // wifi is connected, switch the AP off
         wifi_softap_off();
 
-        discordAlerter.init();
-        discordAlerter.loadConfig();
+        ALERT_ENGINE.init();
+        TASK_TOPOLOGY.create(ALERT_ENGINE.taskWrapper, "alerts", 8192, (void *) &ALERT_ENGINE, 1, NULL, TaskGroup::SERVICE);
 
         // we only use alerting if we are in a normal operating mode
         if (reason == ESP_RST_TASK_WDT) {
-            discordAlerter.sendMessage("Device rebootet because there was no share for more than 1h!");
+            ALERT_ENGINE.post(AlertEvent::WATCHDOG_REBOOT, "Device rebootet because there was no share for more than 1h!");
         }
 
         // and continue with initialization
@@ -233,13 +248,18 @@ extern "C" void app_main(void)
 
         TaskHandle_t stratum_manager_handle;
 
-        xTaskCreate(STRATUM_MANAGER.taskWrapper, "stratum manager", 8192, (void *) &STRATUM_MANAGER, 5, &stratum_manager_handle);
-        xTaskCreate(create_jobs_task, "stratum miner", 8192, NULL, 10, NULL);
-        xTaskCreate(ASIC_result_task, "asic result", 8192, NULL, 15, NULL);
-        xTaskCreate(influx_task, "influx", 8192, NULL, 1, NULL);
-        xTaskCreate(APIs_FETCHER.taskWrapper, "apis ticker", 4096, (void*) &APIs_FETCHER, 5, NULL);
-        xTaskCreate(ping_task, "ping task", 4096, NULL, 1, NULL);
-        xTaskCreate(wifi_monitor_task, "wifi monitor", 4096, NULL, 1, NULL);
+        TASK_TOPOLOGY.create(STRATUM_MANAGER.taskWrapper, "stratum manager", 8192, (void *) &STRATUM_MANAGER, 5,
+                             &stratum_manager_handle, TaskGroup::MINING);
+        TASK_TOPOLOGY.create(create_jobs_task, "stratum miner", 8192, NULL, 10, NULL, TaskGroup::MINING);
+        TASK_TOPOLOGY.create(ASIC_result_task, "asic result", 8192, NULL, 15, NULL, TaskGroup::MINING);
+        TASK_TOPOLOGY.create(influx_task, "influx", 8192, NULL, 1, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(APIs_FETCHER.taskWrapper, "apis ticker", 4096, (void*) &APIs_FETCHER, 5, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(ping_task, "ping task", 4096, NULL, 1, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(wifi_monitor_task, "wifi monitor", 4096, NULL, 1, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(FLEET_OTA.taskWrapper, "fleet ota", 6144, (void *) &FLEET_OTA, 1, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(SWARM_AGGREGATOR.taskWrapper, "swarm", 4096, (void *) &SWARM_AGGREGATOR, 1, NULL, TaskGroup::SERVICE);
+        TASK_TOPOLOGY.create(PROFILE_SCHEDULER.taskWrapper, "scheduler", 6144, (void *) &PROFILE_SCHEDULER, 1, NULL,
+                             TaskGroup::SERVICE);
     }
 
     //char* taskList = (char*) malloc(8192);
@@ -250,7 +270,6 @@ extern "C" void app_main(void)
         if (free_internal_heap < 10000) {
             ESP_LOGW(TAG, "*** WARNING *** Free internal heap: %d bytes", free_internal_heap);
         }
-        //monitor_all_task_watermarks();
     }
 }
 
@@ -0,0 +1,216 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "metrics.h"
+
+#pragma GCC diagnostic error "-Wall"
+#pragma GCC diagnostic error "-Wextra"
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+
+Metric *Metrics::s_first = nullptr;
+Metric *Metrics::s_last = nullptr;
+
+const float METRICS_LATENCY_US_BUCKETS[10] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+const float METRICS_LATENCY_MS_BUCKETS[10] = {1, 5, 10, 25, 50, 100, 250, 500, 1000, 5000};
+
+static const char *typeName(MetricType type)
+{
+    switch (type) {
+    case MetricType::COUNTER:
+        return "counter";
+    case MetricType::GAUGE:
+        return "gauge";
+    case MetricType::HISTOGRAM:
+        return "histogram";
+    }
+    return "unknown";
+}
+
+// snprintf that reports truncation as -1 and advances the write position
+static int append(char *buf, size_t len, int *pos, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+static int append(char *buf, size_t len, int *pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(&buf[*pos], len - *pos, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= len - *pos) {
+        return -1;
+    }
+    *pos += n;
+    return n;
+}
+
+Metric::Metric(MetricType type, const char *name, const char *help, const char *labels)
+    : m_name(name), m_help(help), m_labels(labels), m_type(type)
+{
+    Metrics::add(this);
+}
+
+Counter::Counter(const char *name, const char *help, const char *labels) : Metric(MetricType::COUNTER, name, help, labels)
+{}
+
+Counter::Counter(const char *name, const char *help, ReadFn read, const char *labels)
+    : Metric(MetricType::COUNTER, name, help, labels), m_read(read)
+{}
+
+int Counter::format(char *buf, size_t len)
+{
+    int pos = 0;
+    if (append(buf, len, &pos, "%s_total%s%s%s %llu\n", m_name, m_labels ? "{" : "", m_labels ? m_labels : "",
+               m_labels ? "}" : "", (unsigned long long) get()) < 0) {
+        return -1;
+    }
+    return pos;
+}
+
+Gauge::Gauge(const char *name, const char *help, const char *labels) : Metric(MetricType::GAUGE, name, help, labels)
+{}
+
+Gauge::Gauge(const char *name, const char *help, ReadFn read, const char *labels)
+    : Metric(MetricType::GAUGE, name, help, labels), m_read(read)
+{}
+
+int Gauge::format(char *buf, size_t len)
+{
+    int pos = 0;
+    if (append(buf, len, &pos, "%s%s%s%s %g\n", m_name, m_labels ? "{" : "", m_labels ? m_labels : "", m_labels ? "}" : "",
+               (double) get()) < 0) {
+        return -1;
+    }
+    return pos;
+}
+
+Histogram::Histogram(const char *name, const char *help, const float *bounds, int numBounds, std::atomic<uint32_t> *buckets,
+                     const char *labels)
+    : Metric(MetricType::HISTOGRAM, name, help, labels), m_bounds(bounds), m_numBounds(numBounds), m_buckets(buckets)
+{}
+
+void Histogram::observe(float value)
+{
+    // linear search, the bucket lists are short
+    int i = 0;
+    while (i < m_numBounds && value > m_bounds[i]) {
+        i++;
+    }
+    m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+
+    portENTER_CRITICAL_SAFE(&m_mux);
+    m_count++;
+    m_sum += value;
+    portEXIT_CRITICAL_SAFE(&m_mux);
+}
+
+int Histogram::format(char *buf, size_t len)
+{
+    const char *sep = m_labels ? "," : "";
+    const char *labels = m_labels ? m_labels : "";
+
+    portENTER_CRITICAL_SAFE(&m_mux);
+    uint64_t count = m_count;
+    double sum = m_sum;
+    portEXIT_CRITICAL_SAFE(&m_mux);
+
+    int pos = 0;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < m_numBounds; i++) {
+        cumulative += m_buckets[i].load(std::memory_order_relaxed);
+        if (append(buf, len, &pos, "%s_bucket{%s%sle=\"%g\"} %llu\n", m_name, labels, sep, (double) m_bounds[i],
+                   (unsigned long long) cumulative) < 0) {
+            return -1;
+        }
+    }
+    cumulative += m_buckets[m_numBounds].load(std::memory_order_relaxed);
+
+    // buckets and count are read separately, don't let +Inf drop below a bucket
+    if (count < cumulative) {
+        count = cumulative;
+    }
+
+    if (append(buf, len, &pos, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", m_name, labels, sep, (unsigned long long) count) < 0 ||
+        append(buf, len, &pos, "%s_count%s%s%s %llu\n", m_name, m_labels ? "{" : "", labels, m_labels ? "}" : "",
+               (unsigned long long) count) < 0 ||
+        append(buf, len, &pos, "%s_sum%s%s%s %g\n", m_name, m_labels ? "{" : "", labels, m_labels ? "}" : "", sum) < 0) {
+        return -1;
+    }
+    return pos;
+}
+
+void Metrics::add(Metric *metric)
+{
+    // called from static constructors, keep registration order
+    if (!s_first) {
+        s_first = metric;
+    } else {
+        s_last->m_next = metric;
+    }
+    s_last = metric;
+}
+
+bool Metrics::exportAll(char *buf, size_t len, WriteFn write, void *ctx)
+{
+    int pos = 0;
+
+    // flushes buf when the next part doesn't fit anymore
+    auto emit = [&](Metric *m, bool header) -> bool {
+        for (int retry = 0; retry < 2; retry++) {
+            int start = pos;
+            bool ok = true;
+            if (header) {
+                ok = append(buf, len, &pos, "# TYPE %s %s\n# HELP %s %s\n", m->m_name, typeName(m->m_type), m->m_name,
+                            m->m_help) >= 0;
+            }
+            if (ok) {
+                int n = m->format(&buf[pos], len - pos);
+                ok = n >= 0;
+                pos += ok ? n : 0;
+            }
+            if (ok) {
+                return true;
+            }
+            pos = start;
+            if (!pos) {
+                // doesn't even fit into an empty buffer
+                return false;
+            }
+            if (!write(ctx, buf, pos)) {
+                return false;
+            }
+            pos = 0;
+        }
+        return false;
+    };
+
+    for (Metric *m = s_first; m; m = m->m_next) {
+        // already exported as part of an earlier family?
+        bool seen = false;
+        for (Metric *p = s_first; p != m; p = p->m_next) {
+            if (!strcmp(p->m_name, m->m_name)) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+
+        if (!emit(m, true)) {
+            return false;
+        }
+        for (Metric *f = m->m_next; f; f = f->m_next) {
+            if (!strcmp(f->m_name, m->m_name) && !emit(f, false)) {
+                return false;
+            }
+        }
+    }
+
+    if (append(buf, len, &pos, "# EOF\n") < 0) {
+        if (!write(ctx, buf, pos)) {
+            return false;
+        }
+        pos = 0;
+        append(buf, len, &pos, "# EOF\n");
+    }
+    return write(ctx, buf, pos);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Metrics registry exported in OpenMetrics text format on /metrics.
+//
+// Metrics are static objects that register themselves when they are
+// constructed, so no heap is used and updating a metric is just an
+// atomic operation. Metrics with the same name but different labels
+// are grouped under one family on export.
+//
+//   static Counter s_rx("stratum_rx_lines", "Lines received from the pool");
+//   s_rx.inc();
+
+enum class MetricType : uint8_t
+{
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+};
+
+class Metric {
+    friend class Metrics;
+
+  protected:
+    const char *m_name;
+    const char *m_help;
+    const char *m_labels; // e.g. "result=\"accepted\"" or nullptr
+    MetricType m_type;
+    Metric *m_next = nullptr;
+
+    Metric(MetricType type, const char *name, const char *help, const char *labels);
+
+    // writes the sample lines of the metric, returns the length or -1 if buf is too small
+    virtual int format(char *buf, size_t len) = 0;
+};
+
+class Counter : public Metric {
+  public:
+    typedef uint64_t (*ReadFn)();
+
+  protected:
+    std::atomic<uint64_t> m_value{0};
+    ReadFn m_read = nullptr;
+
+    int format(char *buf, size_t len) override;
+
+  public:
+    Counter(const char *name, const char *help, const char *labels = nullptr);
+
+    // counter whose value is read on export, for counts kept elsewhere (e.g. by an ISR)
+    Counter(const char *name, const char *help, ReadFn read, const char *labels = nullptr);
+
+    void inc(uint64_t n = 1)
+    {
+        m_value.fetch_add(n, std::memory_order_relaxed);
+    }
+    uint64_t get()
+    {
+        return m_read ? m_read() : m_value.load(std::memory_order_relaxed);
+    }
+};
+
+class Gauge : public Metric {
+  public:
+    typedef float (*ReadFn)();
+
+  protected:
+    std::atomic<float> m_value{0.0f};
+    ReadFn m_read = nullptr;
+
+    int format(char *buf, size_t len) override;
+
+  public:
+    Gauge(const char *name, const char *help, const char *labels = nullptr);
+
+    // gauge whose value is read on export, so nothing has to be updated on the hot path
+    Gauge(const char *name, const char *help, ReadFn read, const char *labels = nullptr);
+
+    void set(float value)
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+    float get()
+    {
+        return m_read ? m_read() : m_value.load(std::memory_order_relaxed);
+    }
+};
+
+class Histogram : public Metric {
+  protected:
+    const float *m_bounds;
+    int m_numBounds;
+    std::atomic<uint32_t> *m_buckets; // numBounds + 1 (+Inf)
+    uint64_t m_count = 0;
+    double m_sum = 0.0;
+    portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+
+    int format(char *buf, size_t len) override;
+
+  public:
+    // bounds must be sorted and stay valid, buckets must have numBounds + 1 entries
+    Histogram(const char *name, const char *help, const float *bounds, int numBounds, std::atomic<uint32_t> *buckets,
+              const char *labels = nullptr);
+
+    void observe(float value);
+};
+
+// histogram with its own bucket storage
+template <int N> class HistogramN : public Histogram {
+  protected:
+    std::atomic<uint32_t> m_storage[N + 1] = {};
+
+  public:
+    HistogramN(const char *name, const char *help, const float (&bounds)[N], const char *labels = nullptr)
+        : Histogram(name, help, bounds, N, m_storage, labels)
+    {}
+};
+
+class Metrics {
+  protected:
+    static Metric *s_first;
+    static Metric *s_last;
+
+  public:
+    typedef bool (*WriteFn)(void *ctx, const char *data, size_t len);
+
+    static void add(Metric *metric);
+
+    // streams all metrics in OpenMetrics format through write, using buf as scratch
+    static bool exportAll(char *buf, size_t len, WriteFn write, void *ctx);
+};
+
+// common bucket layouts
+extern const float METRICS_LATENCY_US_BUCKETS[10];
+extern const float METRICS_LATENCY_MS_BUCKETS[10];
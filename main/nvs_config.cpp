@@ -1,139 +1,479 @@
+#include <inttypes.h>
+#include <pthread.h>
 #include <string.h>
 
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "nvs.h"
+#include "nvs_flash.h"
+
 #include "nvs_config.h"
+#include "platform.h"
 
 #define NVS_CONFIG_NAMESPACE "main"
 
+// the cache grows in steps of this many entries
+#define CONFIG_ENTRIES_STEP 16
+#define CONFIG_MAX_LISTENERS 8
+
 namespace Config {
 
 static const char *TAG = "nvs_config";
 
-char *nvs_config_get_string(const char *key, const char *default_value)
+typedef struct
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return strdup(default_value);
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    uint64_t value; // u16 and u64
+    char *str;
+    bool dirty;   // not written to NVS yet
+    bool changed; // listeners not called yet
+} config_entry_t;
+
+typedef struct
+{
+    config_listener_t fn;
+    void *arg;
+} config_listener_entry_t;
+
+// strings replaced while StringRefs were alive, freed with the last one
+typedef struct retired_string
+{
+    struct retired_string *next;
+    char *str;
+} retired_string_t;
+
+static config_entry_t *s_entries = nullptr;
+static int s_numEntries = 0;
+static int s_maxEntries = 0;
+static bool s_loaded = false;
+
+static config_listener_entry_t s_listeners[CONFIG_MAX_LISTENERS];
+static int s_numListeners = 0;
+
+// a setter swaps in a new string, the one StringRefs may still point to is
+// retired until the last reference is released
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_noReaders = PTHREAD_COND_INITIALIZER;
+static int s_readers = 0;
+static retired_string_t *s_retired = nullptr;
+
+// only one batch at a time, writes of other tasks go straight to NVS
+static pthread_mutex_t s_batchLock = PTHREAD_MUTEX_INITIALIZER;
+static TaskHandle_t s_batchOwner = NULL;
+
+static config_entry_t *find(const char *key)
+{
+    for (int i = 0; i < s_numEntries; i++) {
+        if (!strcmp(s_entries[i].key, key)) {
+            return &s_entries[i];
+        }
     }
+    return nullptr;
+}
 
-    size_t size = 0;
-    err = nvs_get_str(handle, key, NULL, &size);
+static config_entry_t *add(const char *key, nvs_type_t type)
+{
+    if (s_numEntries >= s_maxEntries) {
+        // entries are only referenced while s_lock is held, they can move
+        int maxEntries = s_maxEntries + CONFIG_ENTRIES_STEP;
+        config_entry_t *entries = (config_entry_t *) platform_realloc(s_entries, maxEntries * sizeof(config_entry_t));
+        if (!entries) {
+            ESP_LOGE(TAG, "no memory to cache %s", key);
+            return nullptr;
+        }
+        s_entries = entries;
+        s_maxEntries = maxEntries;
+    }
+    config_entry_t *entry = &s_entries[s_numEntries++];
+    memset(entry, 0, sizeof(*entry));
+    strlcpy(entry->key, key, sizeof(entry->key));
+    entry->type = type;
+    return entry;
+}
 
-    if (err != ESP_OK) {
-        nvs_close(handle);
-        return strdup(default_value);
+static void loadEntry(nvs_handle_t handle, const char *key, nvs_type_t type)
+{
+    switch (type) {
+    case NVS_TYPE_U16: {
+        uint16_t value;
+        if (nvs_get_u16(handle, key, &value) == ESP_OK) {
+            config_entry_t *entry = add(key, type);
+            if (entry) {
+                entry->value = value;
+            }
+        }
+        break;
     }
+    case NVS_TYPE_U64: {
+        uint64_t value;
+        if (nvs_get_u64(handle, key, &value) == ESP_OK) {
+            config_entry_t *entry = add(key, type);
+            if (entry) {
+                entry->value = value;
+            }
+        }
+        break;
+    }
+    case NVS_TYPE_STR: {
+        size_t size = 0;
+        if (nvs_get_str(handle, key, NULL, &size) != ESP_OK) {
+            break;
+        }
+        char *str = (char *) platform_malloc(size);
+        if (!str) {
+            break;
+        }
+        if (nvs_get_str(handle, key, str, &size) != ESP_OK) {
+            platform_free(str);
+            break;
+        }
+        config_entry_t *entry = add(key, type);
+        if (!entry) {
+            platform_free(str);
+            break;
+        }
+        entry->str = str;
+        break;
+    }
+    default:
+        // types that aren't used by the config
+        break;
+    }
+}
 
-    char *out = (char *) malloc(size);
-    err = nvs_get_str(handle, key, out, &size);
+static void load()
+{
+    if (s_loaded) {
+        return;
+    }
+    s_loaded = true;
 
-    if (err != ESP_OK) {
-        free(out);
-        nvs_close(handle);
-        return strdup(default_value);
+    nvs_handle_t handle;
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        // nothing written yet
+        return;
     }
 
+    nvs_iterator_t it = NULL;
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_CONFIG_NAMESPACE, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        loadEntry(handle, info.key, info.type);
+        err = nvs_entry_next(&it);
+    }
+    nvs_release_iterator(it);
     nvs_close(handle);
-    return out;
+
+    ESP_LOGI(TAG, "%d config values cached", s_numEntries);
 }
 
-void nvs_config_set_string(const char *key, const char *value)
+void init()
+{
+    pthread_mutex_lock(&s_lock);
+    load();
+    pthread_mutex_unlock(&s_lock);
+}
+
+// called with s_lock held, frees the string once no StringRef can point to it
+static void retire(char *str)
 {
+    if (!str) {
+        return;
+    }
+    if (s_readers) {
+        retired_string_t *node = (retired_string_t *) platform_malloc(sizeof(retired_string_t));
+        if (node) {
+            node->str = str;
+            node->next = s_retired;
+            s_retired = node;
+            return;
+        }
+        // out of memory, wait for the readers instead
+        while (s_readers) {
+            pthread_cond_wait(&s_noReaders, &s_lock);
+        }
+    }
+    platform_free(str);
+}
 
-    nvs_handle handle;
+// called with s_lock held. A value that can't be written stays in effect
+// until the next reboot, the listeners are still called.
+static bool store(nvs_handle_t handle, config_entry_t *entry)
+{
     esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
+    switch (entry->type) {
+    case NVS_TYPE_U16:
+        err = nvs_set_u16(handle, entry->key, (uint16_t) entry->value);
+        break;
+    case NVS_TYPE_U64:
+        err = nvs_set_u64(handle, entry->key, entry->value);
+        break;
+    default:
+        err = nvs_set_str(handle, entry->key, entry->str);
+        break;
+    }
+    entry->dirty = false;
     if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
+        ESP_LOGE(TAG, "Could not write nvs key: %s (%s)", entry->key, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+// writes the dirty entries, all of them or only the given one, with a single commit
+static void flush(config_entry_t *only)
+{
+    nvs_handle_t handle;
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not open nvs, changes are kept until reboot");
+        for (int i = 0; i < s_numEntries; i++) {
+            if (!only || only == &s_entries[i]) {
+                s_entries[i].dirty = false;
+            }
+        }
         return;
     }
 
-    err = nvs_set_str(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %s", key, value);
+    for (int i = 0; i < s_numEntries; i++) {
+        config_entry_t *entry = &s_entries[i];
+        if (entry->dirty && (!only || only == entry)) {
+            store(handle, entry);
+        }
     }
 
+    if (nvs_commit(handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not commit nvs");
+    }
     nvs_close(handle);
 }
 
-uint16_t nvs_config_get_u16(const char *key, const uint16_t default_value)
+// fallback without a cache entry, the value is only read back after a reboot
+static void writeDirect(const char *key, nvs_type_t type, uint64_t value, const char *str)
 {
-    nvs_handle handle;
+    ESP_LOGE(TAG, "%s not cached, writing it to nvs only", key);
+
+    nvs_handle_t handle;
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not open nvs");
+        return;
+    }
     esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    switch (type) {
+    case NVS_TYPE_U16:
+        err = nvs_set_u16(handle, key, (uint16_t) value);
+        break;
+    case NVS_TYPE_U64:
+        err = nvs_set_u64(handle, key, value);
+        break;
+    default:
+        err = nvs_set_str(handle, key, str);
+        break;
+    }
+    if (err != ESP_OK || nvs_commit(handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Could not write nvs key: %s", key);
     }
-
-    uint16_t out;
-    err = nvs_get_u16(handle, key, &out);
     nvs_close(handle);
+}
 
-    if (err != ESP_OK) {
-        return default_value;
+// called without s_lock held, listeners may read the config
+static void notify()
+{
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    // one key at a time, the cache may grow while the listeners run
+    for (;;) {
+        bool found = false;
+
+        pthread_mutex_lock(&s_lock);
+        for (int i = 0; i < s_numEntries; i++) {
+            if (s_entries[i].changed && !s_entries[i].dirty) {
+                s_entries[i].changed = false;
+                strlcpy(key, s_entries[i].key, sizeof(key));
+                found = true;
+                break;
+            }
+        }
+        int numListeners = s_numListeners;
+        pthread_mutex_unlock(&s_lock);
+
+        if (!found) {
+            break;
+        }
+        for (int i = 0; i < numListeners; i++) {
+            s_listeners[i].fn(key, s_listeners[i].arg);
+        }
     }
-    return out;
 }
 
-void nvs_config_set_u16(const char *key, const uint16_t value)
+static bool inBatch()
 {
+    return s_batchOwner && s_batchOwner == xTaskGetCurrentTaskHandle();
+}
 
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
+// locks the cache for writing and returns the entry of the key, nullptr if
+// it can't be cached
+static config_entry_t *lockForWrite(const char *key, nvs_type_t type, bool *created)
+{
+    pthread_mutex_lock(&s_lock);
+    load();
+
+    config_entry_t *entry = find(key);
+    *created = !entry;
+    if (!entry) {
+        return add(key, type);
+    }
+    if (entry->type != type) {
+        ESP_LOGW(TAG, "type of %s changed", key);
+        retire(entry->str);
+        entry->str = nullptr;
+        entry->type = type;
+        *created = true;
     }
+    return entry;
+}
 
-    err = nvs_set_u16(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %u", key, value);
+static void unlockAfterWrite(config_entry_t *entry)
+{
+    bool write = entry && entry->dirty && !inBatch();
+    if (write) {
+        flush(entry);
     }
+    pthread_mutex_unlock(&s_lock);
 
-    nvs_close(handle);
+    if (write) {
+        notify();
+    }
 }
 
-uint64_t nvs_config_get_u64(const char *key, const uint64_t default_value)
+void beginBatch()
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
-    }
+    pthread_mutex_lock(&s_batchLock);
+    s_batchOwner = xTaskGetCurrentTaskHandle();
+}
 
-    uint64_t out;
-    err = nvs_get_u64(handle, key, &out);
+void commitBatch()
+{
+    pthread_mutex_lock(&s_lock);
+    s_batchOwner = NULL;
+    flush(nullptr);
+    pthread_mutex_unlock(&s_lock);
 
-    if (err != ESP_OK) {
-        nvs_close(handle);
-        return default_value;
+    pthread_mutex_unlock(&s_batchLock);
+
+    notify();
+}
+
+bool addListener(config_listener_t listener, void *arg)
+{
+    pthread_mutex_lock(&s_lock);
+    bool ok = s_numListeners < CONFIG_MAX_LISTENERS;
+    if (ok) {
+        s_listeners[s_numListeners].fn = listener;
+        s_listeners[s_numListeners].arg = arg;
+        s_numListeners++;
     }
+    pthread_mutex_unlock(&s_lock);
+    return ok;
+}
 
-    nvs_close(handle);
-    return out;
+StringRef::StringRef(const char *key, const char *default_value)
+{
+    pthread_mutex_lock(&s_lock);
+    load();
+    config_entry_t *entry = find(key);
+    m_value = (entry && entry->type == NVS_TYPE_STR) ? entry->str : default_value;
+    s_readers++;
+    pthread_mutex_unlock(&s_lock);
 }
 
-void nvs_config_set_u64(const char *key, const uint64_t value)
+StringRef::~StringRef()
 {
+    pthread_mutex_lock(&s_lock);
+    if (!--s_readers) {
+        while (s_retired) {
+            retired_string_t *node = s_retired;
+            s_retired = node->next;
+            platform_free(node->str);
+            platform_free(node);
+        }
+        pthread_cond_broadcast(&s_noReaders);
+    }
+    pthread_mutex_unlock(&s_lock);
+}
 
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
+char *nvs_config_get_string(const char *key, const char *default_value)
+{
+    StringRef value(key, default_value);
+    return value.c_str() ? strdup(value.c_str()) : NULL;
+}
+
+void nvs_config_set_string(const char *key, const char *value)
+{
+    bool created;
+    config_entry_t *entry = lockForWrite(key, NVS_TYPE_STR, &created);
+    if (!entry) {
+        writeDirect(key, NVS_TYPE_STR, 0, value);
+    } else if (created || strcmp(entry->str, value)) {
+        char *str = (char *) platform_malloc(strlen(value) + 1);
+        if (str) {
+            strcpy(str, value);
+            retire(entry->str);
+            entry->str = str;
+            entry->dirty = true;
+            entry->changed = true;
+        } else {
+            ESP_LOGE(TAG, "no memory for %s", key);
+        }
     }
+    unlockAfterWrite(entry);
+}
 
-    err = nvs_set_u64(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
+static uint64_t get_value(const char *key, nvs_type_t type, uint64_t default_value)
+{
+    pthread_mutex_lock(&s_lock);
+    load();
+    config_entry_t *entry = find(key);
+    uint64_t value = (entry && entry->type == type) ? entry->value : default_value;
+    pthread_mutex_unlock(&s_lock);
+    return value;
+}
+
+static void set_value(const char *key, nvs_type_t type, uint64_t value)
+{
+    bool created;
+    config_entry_t *entry = lockForWrite(key, type, &created);
+    // new entries are always written, the caller's default could differ from the value
+    if (!entry) {
+        writeDirect(key, type, value, nullptr);
+    } else if (created || entry->value != value) {
+        entry->value = value;
+        entry->dirty = true;
+        entry->changed = true;
     }
-    nvs_close(handle);
+    unlockAfterWrite(entry);
+}
+
+uint16_t nvs_config_get_u16(const char *key, const uint16_t default_value)
+{
+    return (uint16_t) get_value(key, NVS_TYPE_U16, default_value);
+}
+
+void nvs_config_set_u16(const char *key, const uint16_t value)
+{
+    set_value(key, NVS_TYPE_U16, value);
+}
+
+uint64_t nvs_config_get_u64(const char *key, const uint64_t default_value)
+{
+    return get_value(key, NVS_TYPE_U64, default_value);
+}
+
+void nvs_config_set_u64(const char *key, const uint64_t value)
+{
+    set_value(key, NVS_TYPE_U64, value);
 }
 
 void migrate_config() {
@@ -155,4 +495,3 @@ void migrate_config() {
 }
 
 }
-
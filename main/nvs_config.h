@@ -33,6 +33,7 @@
 #define NVS_CONFIG_SELF_TEST "selftest"
 #define NVS_CONFIG_AUTO_SCREEN_OFF "autoscreenoff"
 #define NVS_CONFIG_OVERHEAT_TEMP "overheat_temp"
+#define NVS_CONFIG_MINING_CORE "miningcore"
 
 #define NVS_CONFIG_INFLUX_ENABLE "influx_enable"
 #define NVS_CONFIG_INFLUX_URL "influx_url"
@@ -49,8 +50,25 @@
 
 #define NVS_CONFIG_ALERT_DISCORD_ENABLE "alrt_disc_en"
 #define NVS_CONFIG_ALERT_DISCORD_URL    "alrt_disc_url"
+#define NVS_CONFIG_ALERT_WEBHOOK_ENABLE "alrt_hook_en"
+#define NVS_CONFIG_ALERT_WEBHOOK_URL    "alrt_hook_url"
+#define NVS_CONFIG_ALERT_EVENTS         "alrt_mask"
+#define NVS_CONFIG_ALERT_COOLDOWN       "alrt_cooldown"
+#define NVS_CONFIG_ALERT_DIGEST         "alrt_digest"
+#define NVS_CONFIG_ALERT_HASHRATE_DROP  "alrt_hr_drop"
+#define NVS_CONFIG_ALERT_CHIP_PERCENT   "alrt_chip_pct"
 
 #define NVS_CONFIG_SWARM "swarmconfig"
+#define NVS_CONFIG_SWARM_AGGREGATOR "swarm_aggr"
+#define NVS_CONFIG_POWER_CAP "power_cap"
+#define NVS_CONFIG_SCHEDULE "sched_config"
+#define NVS_CONFIG_SCHEDULE_STATS "sched_stats"
+
+#define NVS_CONFIG_OTA_MIRROR_URL "ota_mirror"
+#define NVS_CONFIG_OTA_PULL_INTERVAL "ota_pull_min"
+#define NVS_CONFIG_OTA_WWW_SHA "ota_www_sha"
+#define NVS_CONFIG_OTA_FW_SHA "ota_fw_sha"
+#define NVS_CONFIG_OTA_FW_PART_SHA "ota_fw_part"
 
 #if defined(CONFIG_FAN_MODE_MANUAL)
 #define CONFIG_AUTO_FAN_SPEED_VALUE 0
@@ -68,7 +86,40 @@
 
 #include <stdint.h>
 
+// All values of the namespace are cached in RAM at boot, the getters never
+// touch the flash. Setters write through to NVS unless a batch is open, a
+// batch is written with a single commit. Listeners are called after a value
+// changed.
+
+typedef void (*config_listener_t)(const char *key, void *arg);
+
 namespace Config {
+    // loads the cache, called once after nvs_flash_init
+    void init();
+
+    // writes of the calling task are kept in RAM until commitBatch, only one
+    // batch can be open at a time
+    void beginBatch();
+    void commitBatch();
+
+    bool addListener(config_listener_t listener, void *arg);
+
+    // zero-copy access to a cached string. A setter swaps in a new string,
+    // the referenced one stays valid until the reference is released.
+    class StringRef {
+      protected:
+        const char *m_value;
+
+      public:
+        StringRef(const char *key, const char *default_value);
+        ~StringRef();
+
+        StringRef(const StringRef &) = delete;
+        StringRef &operator=(const StringRef &) = delete;
+
+        const char *c_str() const { return m_value; }
+    };
+
     char* nvs_config_get_string(const char* key, const char* default_value);
     void nvs_config_set_string(const char* key, const char* value);
     uint16_t nvs_config_get_u16(const char* key, uint16_t default_value);
@@ -92,7 +143,11 @@ namespace Config {
     inline char* getInfluxOrg() { return nvs_config_get_string(NVS_CONFIG_INFLUX_ORG, CONFIG_INFLUX_ORG); }
     inline char* getInfluxPrefix() { return nvs_config_get_string(NVS_CONFIG_INFLUX_PREFIX, CONFIG_INFLUX_PREFIX); }
     inline char* getSwarmConfig() { return nvs_config_get_string(NVS_CONFIG_SWARM, ""); }
+    inline char* getScheduleConfig() { return nvs_config_get_string(NVS_CONFIG_SCHEDULE, ""); }
+    inline char* getScheduleStats() { return nvs_config_get_string(NVS_CONFIG_SCHEDULE_STATS, ""); }
     inline char* getDiscordWebhook() { return nvs_config_get_string(NVS_CONFIG_ALERT_DISCORD_URL, CONFIG_ALERT_DISCORD_URL); }
+    inline char* getAlertWebhook() { return nvs_config_get_string(NVS_CONFIG_ALERT_WEBHOOK_URL, ""); }
+    inline char* getOtaMirrorURL() { return nvs_config_get_string(NVS_CONFIG_OTA_MIRROR_URL, ""); }
 
     // ---- String Setters ----
     inline void setWifiSSID(const char* value) { nvs_config_set_string(NVS_CONFIG_WIFI_SSID, value); }
@@ -110,15 +165,46 @@ namespace Config {
     inline void setInfluxOrg(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_ORG, value); }
     inline void setInfluxPrefix(const char* value) { nvs_config_set_string(NVS_CONFIG_INFLUX_PREFIX, value); }
     inline void setSwarmConfig(const char* value) { nvs_config_set_string(NVS_CONFIG_SWARM, value); }
+    inline void setScheduleConfig(const char* value) { nvs_config_set_string(NVS_CONFIG_SCHEDULE, value); }
+    inline void setScheduleStats(const char* value) { nvs_config_set_string(NVS_CONFIG_SCHEDULE_STATS, value); }
     inline void setDiscordWebhook(const char* value) { nvs_config_set_string(NVS_CONFIG_ALERT_DISCORD_URL, value); }
+    inline void setAlertWebhook(const char* value) { nvs_config_set_string(NVS_CONFIG_ALERT_WEBHOOK_URL, value); }
+    inline void setOtaMirrorURL(const char* value) { nvs_config_set_string(NVS_CONFIG_OTA_MIRROR_URL, value); }
+    inline void setOtaWwwSha(const char* value) { nvs_config_set_string(NVS_CONFIG_OTA_WWW_SHA, value); }
+    inline void setOtaFwSha(const char* value) { nvs_config_set_string(NVS_CONFIG_OTA_FW_SHA, value); }
+    inline void setOtaFwPartSha(const char* value) { nvs_config_set_string(NVS_CONFIG_OTA_FW_PART_SHA, value); }
+
+    // ---- Zero-copy String Getters ----
+    inline StringRef refWifiSSID() { return StringRef(NVS_CONFIG_WIFI_SSID, CONFIG_ESP_WIFI_SSID); }
+    inline StringRef refHostname() { return StringRef(NVS_CONFIG_HOSTNAME, CONFIG_LWIP_LOCAL_HOSTNAME); }
+    inline StringRef refStratumURL() { return StringRef(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL); }
+    inline StringRef refStratumUser() { return StringRef(NVS_CONFIG_STRATUM_USER, CONFIG_STRATUM_USER); }
+    inline StringRef refStratumFallbackURL() { return StringRef(NVS_CONFIG_STRATUM_FALLBACK_URL, CONFIG_STRATUM_FALLBACK_URL); }
+    inline StringRef refStratumFallbackUser() { return StringRef(NVS_CONFIG_STRATUM_FALLBACK_USER, CONFIG_STRATUM_FALLBACK_USER); }
+    inline StringRef refInfluxURL() { return StringRef(NVS_CONFIG_INFLUX_URL, CONFIG_INFLUX_URL); }
+    inline StringRef refInfluxBucket() { return StringRef(NVS_CONFIG_INFLUX_BUCKET, CONFIG_INFLUX_BUCKET); }
+    inline StringRef refInfluxOrg() { return StringRef(NVS_CONFIG_INFLUX_ORG, CONFIG_INFLUX_ORG); }
+    inline StringRef refInfluxPrefix() { return StringRef(NVS_CONFIG_INFLUX_PREFIX, CONFIG_INFLUX_PREFIX); }
+    inline StringRef refDiscordWebhook() { return StringRef(NVS_CONFIG_ALERT_DISCORD_URL, CONFIG_ALERT_DISCORD_URL); }
+    inline StringRef refOtaMirrorURL() { return StringRef(NVS_CONFIG_OTA_MIRROR_URL, ""); }
+    inline StringRef refOtaWwwSha() { return StringRef(NVS_CONFIG_OTA_WWW_SHA, ""); }
+    inline StringRef refOtaFwSha() { return StringRef(NVS_CONFIG_OTA_FW_SHA, ""); }
+    inline StringRef refOtaFwPartSha() { return StringRef(NVS_CONFIG_OTA_FW_PART_SHA, ""); }
 
     // ---- uint16_t Getters ----
     inline uint16_t getStratumPortNumber() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_PORT, CONFIG_STRATUM_PORT); }
     inline uint16_t getStratumFallbackPortNumber() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_FALLBACK_PORT, CONFIG_STRATUM_FALLBACK_PORT); }
     inline uint16_t getFanSpeed() { return nvs_config_get_u16(NVS_CONFIG_FAN_SPEED, CONFIG_FAN_SPEED); }
     inline uint16_t getOverheatTemp() { return nvs_config_get_u16(NVS_CONFIG_OVERHEAT_TEMP, CONFIG_OVERHEAT_TEMP); }
+    inline uint16_t getPowerCap() { return nvs_config_get_u16(NVS_CONFIG_POWER_CAP, 0); }
     inline uint16_t getInfluxPort() { return nvs_config_get_u16(NVS_CONFIG_INFLUX_PORT, CONFIG_INFLUX_PORT); }
     inline uint16_t getTempControlMode() { return nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, CONFIG_AUTO_FAN_SPEED_VALUE); }
+    inline uint16_t getOtaPullInterval() { return nvs_config_get_u16(NVS_CONFIG_OTA_PULL_INTERVAL, 60); }
+    inline uint16_t getAlertEvents() { return nvs_config_get_u16(NVS_CONFIG_ALERT_EVENTS, 0xffff); }
+    inline uint16_t getAlertCooldown() { return nvs_config_get_u16(NVS_CONFIG_ALERT_COOLDOWN, 30); }
+    inline uint16_t getAlertDigest() { return nvs_config_get_u16(NVS_CONFIG_ALERT_DIGEST, 60); }
+    inline uint16_t getAlertHashrateDrop() { return nvs_config_get_u16(NVS_CONFIG_ALERT_HASHRATE_DROP, 25); }
+    inline uint16_t getAlertChipPercent() { return nvs_config_get_u16(NVS_CONFIG_ALERT_CHIP_PERCENT, 50); }
 
 
     // ---- uint16_t Setters ----
@@ -129,8 +215,16 @@ namespace Config {
     inline void setStratumFallbackPortNumber(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_STRATUM_FALLBACK_PORT, value); }
     inline void setFanSpeed(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_FAN_SPEED, value); }
     inline void setOverheatTemp(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_OVERHEAT_TEMP, value); }
+    inline void setPowerCap(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_POWER_CAP, value); }
     inline void setInfluxPort(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_INFLUX_PORT, value); }
     inline void setTempControlMode(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_AUTO_FAN_SPEED, value); }
+    inline void setMiningCore(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_MINING_CORE, value); }
+    inline void setOtaPullInterval(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_OTA_PULL_INTERVAL, value); }
+    inline void setAlertEvents(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ALERT_EVENTS, value); }
+    inline void setAlertCooldown(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ALERT_COOLDOWN, value); }
+    inline void setAlertDigest(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ALERT_DIGEST, value); }
+    inline void setAlertHashrateDrop(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ALERT_HASHRATE_DROP, value); }
+    inline void setAlertChipPercent(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_ALERT_CHIP_PERCENT, value); }
 
     inline void setPidTargetTemp(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_PID_TARGET_TEMP, value); }
     inline void setPidP(uint16_t value) { nvs_config_set_u16(NVS_CONFIG_PID_P, value); }
@@ -150,7 +244,9 @@ namespace Config {
     inline bool isSelfTestEnabled() { return nvs_config_get_u16(NVS_CONFIG_SELF_TEST, 0) != 0; }
     inline bool isAutoScreenOffEnabled() { return nvs_config_get_u16(NVS_CONFIG_AUTO_SCREEN_OFF, CONFIG_AUTO_SCREEN_OFF_VALUE) != 0; }
     inline bool isInfluxEnabled() { return nvs_config_get_u16(NVS_CONFIG_INFLUX_ENABLE, CONFIG_INFLUX_ENABLE_VALUE) != 0; }
+    inline bool isAlertWebhookEnabled() { return nvs_config_get_u16(NVS_CONFIG_ALERT_WEBHOOK_ENABLE, 0) != 0; }
     inline bool isDiscordAlertEnabled() { return nvs_config_get_u16(NVS_CONFIG_ALERT_DISCORD_ENABLE, CONFIG_ALERT_DISCORD_ENABLE_VALUE) != 0; }
+    inline bool isSwarmAggregatorEnabled() { return nvs_config_get_u16(NVS_CONFIG_SWARM_AGGREGATOR, 0) != 0; }
     inline bool isStratumKeepaliveEnabled() { return nvs_config_get_u16(NVS_CONFIG_STRATUM_KEEPALIVE, CONFIG_STRATUM_KEEPALIVE_ENABLE_VALUE) != 0; }
 
 
@@ -161,14 +257,17 @@ namespace Config {
     inline void setAutoFanPolarity(bool value) { nvs_config_set_u16(NVS_CONFIG_AUTO_FAN_POLARITY, value ? 1 : 0); }
     inline void setSelfTest(bool value) { nvs_config_set_u16(NVS_CONFIG_SELF_TEST, value ? 1 : 0); }
     inline void setAutoScreenOff(bool value) { nvs_config_set_u16(NVS_CONFIG_AUTO_SCREEN_OFF, value ? 1 : 0); }
+    inline void setSwarmAggregator(bool value) { nvs_config_set_u16(NVS_CONFIG_SWARM_AGGREGATOR, value ? 1 : 0); }
     inline void setInfluxEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_INFLUX_ENABLE, value ? 1 : 0); }
     inline void setDiscordAlertEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_ALERT_DISCORD_ENABLE, value ? 1 : 0); }
+    inline void setAlertWebhookEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_ALERT_WEBHOOK_ENABLE, value ? 1 : 0); }
     inline void setStratumKeepaliveEnabled(bool value) { nvs_config_set_u16(NVS_CONFIG_STRATUM_KEEPALIVE, value ? 1 : 0); }
 
     // with board specific default values
     inline uint16_t getAsicFrequency(uint16_t d) { return nvs_config_get_u16(NVS_CONFIG_ASIC_FREQ, d); }
     inline uint16_t getAsicVoltage(uint16_t d) { return nvs_config_get_u16(NVS_CONFIG_ASIC_VOLTAGE, d); }
     inline uint16_t getAsicJobInterval(uint16_t d) { return nvs_config_get_u16(NVS_CONFIG_ASIC_JOB_INTERVAL, d); }
+    inline uint16_t getMiningCore(uint16_t d) { return nvs_config_get_u16(NVS_CONFIG_MINING_CORE, d); }
     inline bool isFlipScreenEnabled(bool d) { return nvs_config_get_u16(NVS_CONFIG_FLIP_SCREEN, d ? 1 : 0) != 0; }
     inline bool isInvertFanPolarityEnabled(bool d) { return nvs_config_get_u16(NVS_CONFIG_INVERT_FAN_POLARITY, d ? 1 : 0) != 0; }
     inline bool isAutoFanPolarityEnabled(bool d) { return nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_POLARITY, d ? 1 : 0) != 0; }
@@ -0,0 +1,331 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "spi_flash_mmap.h"
+
+#include "metrics.h"
+#include "ota_writer.h"
+
+static const char *TAG = "ota_writer";
+
+static Counter s_bytesFirmware("ota_bytes", "Update bytes written to flash", "target=\"firmware\"");
+static Counter s_bytesWww("ota_bytes", "Update bytes written to flash", "target=\"www\"");
+static Counter s_sessionsOk("ota_sessions", "Finished update sessions", "result=\"ok\"");
+static Counter s_sessionsFailed("ota_sessions", "Finished update sessions", "result=\"failed\"");
+static Counter s_sessionsAborted("ota_sessions", "Finished update sessions", "result=\"aborted\"");
+static Gauge s_lastDuration("ota_last_duration_ms", "Duration of the last successful update");
+static Gauge s_lastThroughput("ota_last_throughput_kbps", "Average throughput of the last successful update");
+
+// the writer that owns the flash, only one session at a time
+static pthread_mutex_t s_ownerLock = PTHREAD_MUTEX_INITIALIZER;
+static OtaWriter *s_owner = nullptr;
+
+static bool parseSha256(const char *hex, uint8_t *out)
+{
+    if (strlen(hex) != 64) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        uint8_t byte = 0;
+        for (int j = 0; j < 2; j++) {
+            char c = hex[i * 2 + j];
+            byte <<= 4;
+            if (c >= '0' && c <= '9') {
+                byte |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                byte |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                byte |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        out[i] = byte;
+    }
+    return true;
+}
+
+const char *OtaWriter::targetName(OtaTarget target)
+{
+    return (target == OtaTarget::WWW) ? "www" : "firmware";
+}
+
+esp_err_t OtaWriter::begin(OtaTarget target, size_t size, const char *sha256Hex)
+{
+    pthread_mutex_lock(&s_ownerLock);
+    OtaWriter *owner = s_owner;
+    pthread_mutex_unlock(&s_ownerLock);
+
+    // a session nobody wrote to for OTA_SESSION_TIMEOUT_US (a closed
+    // browser tab, a lost peer) doesn't hold the flash any longer
+    if (owner && owner != this && owner->isStale()) {
+        ESP_LOGW(TAG, "taking over from the stale %s update", targetName(owner->getTarget()));
+        owner->abort();
+    }
+
+    pthread_mutex_lock(&s_ownerLock);
+    if (s_owner && s_owner != this) {
+        pthread_mutex_unlock(&s_ownerLock);
+        ESP_LOGW(TAG, "another update is in progress");
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_owner = this;
+    pthread_mutex_unlock(&s_ownerLock);
+
+    pthread_mutex_lock(&m_lock);
+    if (m_active) {
+        ESP_LOGW(TAG, "dropping the unfinished %s update at %u/%u bytes", targetName(m_target), (unsigned) m_offset,
+                 (unsigned) m_size);
+        if (m_target == OtaTarget::FIRMWARE) {
+            esp_ota_abort(m_otaHandle);
+        }
+        mbedtls_sha256_free(&m_sha);
+        m_active = false;
+        s_sessionsAborted.inc();
+    }
+
+    m_hasSha = sha256Hex && *sha256Hex;
+    if (m_hasSha && !parseSha256(sha256Hex, m_expectedSha)) {
+        pthread_mutex_unlock(&m_lock);
+        close(nullptr);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (target == OtaTarget::WWW) {
+        m_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, "www");
+    } else {
+        m_partition = esp_ota_get_next_update_partition(NULL);
+    }
+    if (!m_partition || !size || size > m_partition->size) {
+        pthread_mutex_unlock(&m_lock);
+        close(nullptr);
+        return m_partition ? ESP_ERR_INVALID_SIZE : ESP_ERR_NOT_FOUND;
+    }
+
+    // sequential writes erase each sector when the data gets there instead
+    // of the whole partition up front
+    if (target == OtaTarget::FIRMWARE) {
+        esp_err_t err = esp_ota_begin(m_partition, OTA_WITH_SEQUENTIAL_WRITES, &m_otaHandle);
+        if (err != ESP_OK) {
+            pthread_mutex_unlock(&m_lock);
+            close(nullptr);
+            return err;
+        }
+    }
+
+    mbedtls_sha256_init(&m_sha);
+    mbedtls_sha256_starts(&m_sha, 0);
+
+    m_target = target;
+    m_size = size;
+    m_offset = 0;
+    m_erasedUntil = 0;
+    m_startUs = esp_timer_get_time();
+    m_lastWriteUs = m_startUs;
+    m_active = true;
+    pthread_mutex_unlock(&m_lock);
+
+    ESP_LOGI(TAG, "%s update of %u bytes started%s", targetName(target), (unsigned) size, m_hasSha ? ", sha256 given" : "");
+    return ESP_OK;
+}
+
+// called with m_lock held, erases the www sectors up to end
+esp_err_t OtaWriter::eraseAhead(size_t end)
+{
+    if (end <= m_erasedUntil) {
+        return ESP_OK;
+    }
+    size_t alignedEnd = (end + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1);
+    if (alignedEnd > m_partition->size) {
+        alignedEnd = m_partition->size;
+    }
+    esp_err_t err = esp_partition_erase_range(m_partition, m_erasedUntil, alignedEnd - m_erasedUntil);
+    if (err == ESP_OK) {
+        m_erasedUntil = alignedEnd;
+    }
+    return err;
+}
+
+esp_err_t OtaWriter::write(const uint8_t *data, size_t len)
+{
+    pthread_mutex_lock(&m_lock);
+    if (!m_active) {
+        pthread_mutex_unlock(&m_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (m_offset + len > m_size) {
+        pthread_mutex_unlock(&m_lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err;
+    if (m_target == OtaTarget::FIRMWARE) {
+        err = esp_ota_write(m_otaHandle, data, len);
+    } else {
+        err = eraseAhead(m_offset + len);
+        if (err == ESP_OK) {
+            err = esp_partition_write(m_partition, m_offset, data, len);
+        }
+    }
+    if (err != ESP_OK) {
+        pthread_mutex_unlock(&m_lock);
+        ESP_LOGE(TAG, "flash write at %u failed: %s", (unsigned) m_offset, esp_err_to_name(err));
+        abort();
+        return err;
+    }
+
+    mbedtls_sha256_update(&m_sha, data, len);
+    m_offset += len;
+    m_lastWriteUs = esp_timer_get_time();
+    pthread_mutex_unlock(&m_lock);
+
+    if (m_target == OtaTarget::WWW) {
+        s_bytesWww.inc(len);
+    } else {
+        s_bytesFirmware.inc(len);
+    }
+    return ESP_OK;
+}
+
+esp_err_t OtaWriter::finish()
+{
+    pthread_mutex_lock(&m_lock);
+    if (!m_active || m_offset != m_size) {
+        pthread_mutex_unlock(&m_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t sha[32];
+    mbedtls_sha256_finish(&m_sha, sha);
+    mbedtls_sha256_free(&m_sha);
+
+    esp_err_t err = ESP_OK;
+    if (m_hasSha && memcmp(sha, m_expectedSha, sizeof(sha))) {
+        ESP_LOGE(TAG, "sha256 of the %s image doesn't match the manifest", targetName(m_target));
+        err = ESP_ERR_INVALID_CRC;
+    }
+
+    if (m_target == OtaTarget::FIRMWARE) {
+        if (err != ESP_OK) {
+            esp_ota_abort(m_otaHandle);
+        } else {
+            // esp_ota_end validates the app image
+            err = esp_ota_end(m_otaHandle);
+            if (err == ESP_OK) {
+                err = esp_ota_set_boot_partition(m_partition);
+            }
+        }
+    } else if (err == ESP_OK) {
+        // the old content behind a smaller image
+        err = eraseAhead(m_partition->size);
+    }
+
+    int64_t durationUs = esp_timer_get_time() - m_startUs;
+    size_t size = m_size;
+    OtaTarget target = m_target;
+    m_active = false;
+    pthread_mutex_unlock(&m_lock);
+
+    if (err != ESP_OK) {
+        close("failed");
+        return err;
+    }
+
+    float durationMs = (float) durationUs / 1000.0f;
+    float kbps = durationUs ? (float) size * 8.0f / ((float) durationUs / 1000.0f) : 0.0f;
+    s_lastDuration.set(durationMs);
+    s_lastThroughput.set(kbps);
+    ESP_LOGI(TAG, "%s update of %u bytes done in %.1f s, %.0f kbit/s", targetName(target), (unsigned) size,
+             durationMs / 1000.0f, kbps);
+
+    pthread_mutex_lock(&m_lock);
+    m_lastDurationUs = durationUs;
+    m_lastSize = size;
+    pthread_mutex_unlock(&m_lock);
+
+    close("ok");
+    return ESP_OK;
+}
+
+void OtaWriter::abort()
+{
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    if (active) {
+        if (m_target == OtaTarget::FIRMWARE) {
+            esp_ota_abort(m_otaHandle);
+        }
+        mbedtls_sha256_free(&m_sha);
+        m_active = false;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (active) {
+        ESP_LOGW(TAG, "%s update aborted at %u/%u bytes", targetName(m_target), (unsigned) m_offset, (unsigned) m_size);
+        close("aborted");
+    }
+}
+
+// releases the flash, result is counted unless it is nullptr
+void OtaWriter::close(const char *result)
+{
+    if (result) {
+        pthread_mutex_lock(&m_lock);
+        m_lastResult = result;
+        pthread_mutex_unlock(&m_lock);
+
+        if (!strcmp(result, "ok")) {
+            s_sessionsOk.inc();
+        } else if (!strcmp(result, "failed")) {
+            s_sessionsFailed.inc();
+        } else {
+            s_sessionsAborted.inc();
+        }
+    }
+
+    pthread_mutex_lock(&s_ownerLock);
+    if (s_owner == this) {
+        s_owner = nullptr;
+    }
+    pthread_mutex_unlock(&s_ownerLock);
+}
+
+bool OtaWriter::isActive()
+{
+    pthread_mutex_lock(&m_lock);
+    bool active = m_active;
+    pthread_mutex_unlock(&m_lock);
+    return active;
+}
+
+bool OtaWriter::isStale()
+{
+    pthread_mutex_lock(&m_lock);
+    bool stale = m_active && (esp_timer_get_time() - m_lastWriteUs > OTA_SESSION_TIMEOUT_US);
+    pthread_mutex_unlock(&m_lock);
+    return stale;
+}
+
+void OtaWriter::toJson(JsonObject obj)
+{
+    pthread_mutex_lock(&m_lock);
+    int64_t now = esp_timer_get_time();
+    obj["active"] = m_active;
+    if (m_active) {
+        int64_t elapsedUs = now - m_startUs;
+        obj["target"] = targetName(m_target);
+        obj["offset"] = m_offset;
+        obj["size"] = m_size;
+        obj["elapsedMs"] = elapsedUs / 1000;
+        obj["throughputKbps"] = elapsedUs ? (int) ((float) m_offset * 8.0f / ((float) elapsedUs / 1000.0f)) : 0;
+        obj["idleMs"] = (now - m_lastWriteUs) / 1000;
+    }
+    obj["lastResult"] = m_lastResult;
+    if (m_lastDurationUs) {
+        obj["lastSize"] = m_lastSize;
+        obj["lastDurationMs"] = m_lastDurationUs / 1000;
+        obj["lastThroughputKbps"] = (int) ((float) m_lastSize * 8.0f / ((float) m_lastDurationUs / 1000.0f));
+    }
+    pthread_mutex_unlock(&m_lock);
+}
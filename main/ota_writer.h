@@ -0,0 +1,93 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "esp_err.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+
+// an interrupted session can be resumed for this long
+#ifndef OTA_SESSION_TIMEOUT_US
+#define OTA_SESSION_TIMEOUT_US (10ll * 60ll * 1000000ll)
+#endif
+
+// receive buffer, in PSRAM if there is some
+#define OTA_CHUNK_SIZE (16 * 1024)
+
+enum class OtaTarget
+{
+    FIRMWARE,
+    WWW,
+};
+
+// Writes an update image as it arrives. The flash is erased sector by
+// sector in front of the data, the image is hashed on the way and checked
+// against the manifest (size and SHA-256) before it is activated. The
+// session survives a dropped connection so the upload can be continued at
+// getOffset(). Only one session can write at a time.
+class OtaWriter {
+  protected:
+    OtaTarget m_target = OtaTarget::FIRMWARE;
+    const esp_partition_t *m_partition = nullptr;
+    esp_ota_handle_t m_otaHandle = 0;
+    mbedtls_sha256_context m_sha;
+
+    bool m_active = false;
+    bool m_hasSha = false;
+    uint8_t m_expectedSha[32];
+    size_t m_size = 0;
+    size_t m_offset = 0;
+    size_t m_erasedUntil = 0;
+
+    int64_t m_startUs = 0;
+    int64_t m_lastWriteUs = 0;
+
+    // result of the last finished session
+    const char *m_lastResult = "none";
+    int64_t m_lastDurationUs = 0;
+    size_t m_lastSize = 0;
+
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    esp_err_t eraseAhead(size_t end);
+    void close(const char *result);
+
+  public:
+    // starts a new session, size is the length of the image and sha256Hex
+    // the expected hash (or nullptr). A session of this writer that wasn't
+    // finished is dropped, a stale one of another writer is aborted.
+    esp_err_t begin(OtaTarget target, size_t size, const char *sha256Hex);
+
+    // next bytes of the image
+    esp_err_t write(const uint8_t *data, size_t len);
+
+    // checks size and hash and activates the image
+    esp_err_t finish();
+
+    void abort();
+
+    bool isActive();
+
+    // the session wasn't written to for OTA_SESSION_TIMEOUT_US
+    bool isStale();
+
+    OtaTarget getTarget()
+    {
+        return m_target;
+    }
+    size_t getOffset()
+    {
+        return m_offset;
+    }
+    size_t getSize()
+    {
+        return m_size;
+    }
+
+    void toJson(JsonObject obj);
+
+    static const char *targetName(OtaTarget target);
+};
@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <math.h>
+
+#include "power_cap.h"
+
+void PowerCap::reset(float frequency, uint16_t voltage)
+{
+    m_hasSample = false;
+    m_filtered = 0.0f;
+    m_integral = frequency;
+    m_frequency = frequency;
+    m_voltage = voltage;
+    m_overAtMinimum = 0;
+}
+
+bool PowerCap::update(float pin, float dtS, float capW, const PowerCapLimits *limits)
+{
+    if (!m_hasSample) {
+        m_filtered = pin;
+        m_hasSample = true;
+    } else {
+        float alpha = 1.0f - expf(-std::max(dtS, 0.0f) / POWER_CAP_FILTER_S);
+        m_filtered += alpha * (pin - m_filtered);
+    }
+
+    float band = std::max(capW * POWER_CAP_BAND, POWER_CAP_MIN_BAND_W);
+    float error = (capW - band) - m_filtered;
+
+    // hysteresis, the integrator holds as well
+    if (fabsf(error) < band / 2.0f) {
+        m_overAtMinimum = 0;
+        return false;
+    }
+
+    // a lowered voltage comes back before the frequency goes up
+    if (error > band && m_voltage < limits->maxVoltage) {
+        m_voltage = (uint16_t) std::min<int>(m_voltage + POWER_CAP_VOLTAGE_STEP_MV, limits->maxVoltage);
+        return true;
+    }
+
+    // power scales about linearly with the frequency
+    float wattsPerMhz = m_filtered / std::max(m_frequency, 1.0f);
+    if (wattsPerMhz <= 0.0f) {
+        return false;
+    }
+    float errorMhz = error / wattsPerMhz;
+
+    float integral = m_integral + POWER_CAP_KI * dtS * errorMhz;
+    float command = integral + POWER_CAP_KP * errorMhz;
+
+    float limited = std::min(std::max(command, m_frequency - POWER_CAP_MAX_SLEW_MHZ), m_frequency + POWER_CAP_MAX_SLEW_MHZ);
+    limited = std::min(std::max(limited, limits->minFrequency), limits->maxFrequency);
+
+    // anti-windup, the integrator follows what can be applied
+    m_integral = (limited != command) ? limited - POWER_CAP_KP * errorMhz : integral;
+
+    // on the PLL grid and never above the command, the limits themselves
+    // may be off the grid
+    float frequency;
+    if (limited >= limits->maxFrequency) {
+        frequency = limits->maxFrequency;
+    } else if (limited <= limits->minFrequency) {
+        frequency = limits->minFrequency;
+    } else {
+        // rounding down must not step over the slew limit
+        float slewFloor = ceilf((m_frequency - POWER_CAP_MAX_SLEW_MHZ) / POWER_CAP_STEP_MHZ) * POWER_CAP_STEP_MHZ;
+        frequency = floorf(limited / POWER_CAP_STEP_MHZ) * POWER_CAP_STEP_MHZ;
+        frequency = std::max(std::max(frequency, slewFloor), limits->minFrequency);
+    }
+
+    bool changed = false;
+    if (frequency != m_frequency) {
+        m_frequency = frequency;
+        changed = true;
+    }
+
+    // over the cap with nothing left on the frequency
+    if (error < 0.0f && m_frequency <= limits->minFrequency) {
+        if (++m_overAtMinimum >= POWER_CAP_VOLTAGE_SETTLE && m_voltage > limits->minVoltage) {
+            m_voltage = (uint16_t) std::max<int>(m_voltage - POWER_CAP_VOLTAGE_STEP_MV, limits->minVoltage);
+            m_overAtMinimum = 0;
+            changed = true;
+        }
+    } else {
+        m_overAtMinimum = 0;
+    }
+
+    return changed;
+}
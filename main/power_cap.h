@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+// time constant of the input power filter
+#define POWER_CAP_FILTER_S 8.0f
+
+// width of the band under the cap the power settles in, share of the cap
+#define POWER_CAP_BAND 0.02f
+#define POWER_CAP_MIN_BAND_W 0.5f
+
+#define POWER_CAP_KP 0.5f
+#define POWER_CAP_KI 0.1f // 1/s
+
+// the ASIC PLL ramps in these steps
+#define POWER_CAP_STEP_MHZ 6.25f
+
+// frequency change of one control step
+#define POWER_CAP_MAX_SLEW_MHZ 25.0f
+
+// the frequency isn't lowered below this share of the configured one
+#define POWER_CAP_MIN_FREQUENCY 0.5f
+
+// still over the cap at the minimum frequency for this many steps lowers
+// the core voltage by POWER_CAP_VOLTAGE_STEP_MV
+#define POWER_CAP_VOLTAGE_SETTLE 3
+#define POWER_CAP_VOLTAGE_STEP_MV 10
+
+typedef struct
+{
+    float minFrequency; // MHz
+    float maxFrequency; // MHz, the configured frequency
+    uint16_t minVoltage; // mV
+    uint16_t maxVoltage; // mV, the configured voltage
+} PowerCapLimits;
+
+// Keeps the filtered input power in a band just under the cap with the
+// highest ASIC frequency that fits.
+//
+// A PI controller works on the error in MHz (watts divided by the measured
+// watts per MHz). In the band [cap - 1.5 band, cap - 0.5 band] nothing
+// changes, the hysteresis keeps a frequency step from toggling back and
+// forth. The integrator is calculated back from the frequency that is
+// applied when the output hits the limits or the slew limit (anti-windup).
+// Only when the frequency is at its minimum the voltage is lowered, and it
+// is raised back first when there is headroom again.
+//
+// Plain logic without ESP-IDF so the host build can run it.
+class PowerCap {
+  protected:
+    bool m_hasSample = false;
+    float m_filtered = 0.0f;
+    float m_integral = 0.0f;
+    float m_frequency = 0.0f;
+    uint16_t m_voltage = 0;
+    int m_overAtMinimum = 0;
+
+  public:
+    // starts from the applied frequency and voltage (bumpless)
+    void reset(float frequency, uint16_t voltage);
+
+    // one input power sample, dtS seconds after the last one, true when
+    // getFrequency() or getVoltage() changed
+    bool update(float pin, float dtS, float capW, const PowerCapLimits *limits);
+
+    float getFrequency() const
+    {
+        return m_frequency;
+    }
+
+    uint16_t getVoltage() const
+    {
+        return m_voltage;
+    }
+
+    float getFilteredPower() const
+    {
+        return m_filtered;
+    }
+
+    // watts left under the cap, negative when it can't be held
+    float getHeadroom(float capW) const
+    {
+        return capW - m_filtered;
+    }
+};
@@ -0,0 +1,224 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ArduinoJson.h"
+
+#include "profile_schedule.h"
+#include "psram_allocator.h"
+
+static const char *DAY_NAMES[7] = {"sun", "mon", "tue", "wed", "thu", "fri", "sat"};
+
+static bool fail(char *err, size_t errLen, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(err, errLen, format, args);
+    va_end(args);
+    return false;
+}
+
+static int parseDay(const char *s, size_t len)
+{
+    if (len != 3) {
+        return -1;
+    }
+    for (int i = 0; i < 7; i++) {
+        if (!strncasecmp(s, DAY_NAMES[i], 3)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// "*", "mon-fri", "sat,sun", ranges may wrap ("fri-mon")
+static bool parseDays(const char *spec, uint8_t *days)
+{
+    *days = 0;
+    if (!strcmp(spec, "*")) {
+        *days = 0x7f;
+        return true;
+    }
+
+    const char *p = spec;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t) (end - p) : strlen(p);
+
+        const char *dash = (const char *) memchr(p, '-', len);
+        int first = parseDay(p, dash ? (size_t) (dash - p) : len);
+        int last = dash ? parseDay(dash + 1, len - (dash - p) - 1) : first;
+        if (first < 0 || last < 0) {
+            return false;
+        }
+        for (int d = first;; d = (d + 1) % 7) {
+            *days |= 1 << d;
+            if (d == last) {
+                break;
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return *days != 0;
+}
+
+// "HH:MM"
+static bool parseStart(const char *s, uint16_t *minute)
+{
+    int h, m;
+    char tail;
+    if (sscanf(s, "%d:%d%c", &h, &m, &tail) != 2 || h < 0 || h > 23 || m < 0 || m > 59) {
+        return false;
+    }
+    *minute = (uint16_t) (h * 60 + m);
+    return true;
+}
+
+static bool parseProfile(JsonObjectConst obj, schedule_profile_t *profile, char *err, size_t errLen)
+{
+    const char *name = obj["name"];
+    if (!name || !*name || strlen(name) >= SCHEDULE_NAME_MAX) {
+        return fail(err, errLen, "profile name missing or longer than %d", SCHEDULE_NAME_MAX - 1);
+    }
+    if (!strcmp(name, SCHEDULE_DEFAULT_PROFILE)) {
+        return fail(err, errLen, "profile name '%s' is reserved", name);
+    }
+    strlcpy(profile->name, name, sizeof(profile->name));
+
+    profile->frequency = obj["frequency"] | 0;
+    profile->coreVoltage = obj["coreVoltage"] | 0;
+    profile->fanMode = obj["autofanspeed"] | -1;
+    profile->fanSpeed = obj["fanspeed"] | -1;
+    profile->powerCap = obj["powerCap"] | -1;
+    profile->pause = obj["pause"] | false;
+    profile->price = obj["price"] | 0.0f;
+
+    if (profile->fanMode != -1 && profile->fanMode != 0 && profile->fanMode != 2) {
+        return fail(err, errLen, "profile '%s': autofanspeed must be 0 or 2", name);
+    }
+    if (profile->fanSpeed < -1 || profile->fanSpeed > 100 || profile->powerCap < -1 || profile->powerCap > 1000 ||
+        profile->price < 0.0f) {
+        return fail(err, errLen, "profile '%s': value out of range", name);
+    }
+    return true;
+}
+
+bool schedule_parse(const char *json, size_t len, schedule_config_t *config, char *err, size_t errLen)
+{
+    memset(config, 0, sizeof(*config));
+    if (errLen) {
+        err[0] = '\0';
+    }
+    if (!len) {
+        return true;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    if (deserializeJson(doc, json, len) || !doc.is<JsonObject>()) {
+        return fail(err, errLen, "invalid JSON");
+    }
+
+    config->enabled = doc["enabled"] | false;
+    strlcpy(config->timezone, doc["timezone"] | "UTC0", sizeof(config->timezone));
+
+    for (JsonObjectConst obj : doc["profiles"].as<JsonArrayConst>()) {
+        if (config->numProfiles == SCHEDULE_MAX_PROFILES) {
+            return fail(err, errLen, "more than %d profiles", SCHEDULE_MAX_PROFILES);
+        }
+        schedule_profile_t *profile = &config->profiles[config->numProfiles];
+        if (!parseProfile(obj, profile, err, errLen)) {
+            return false;
+        }
+        if (schedule_find_profile(config, profile->name) >= 0) {
+            return fail(err, errLen, "profile '%s' defined twice", profile->name);
+        }
+        config->numProfiles++;
+    }
+
+    for (JsonObjectConst obj : doc["rules"].as<JsonArrayConst>()) {
+        if (config->numRules == SCHEDULE_MAX_RULES) {
+            return fail(err, errLen, "more than %d rules", SCHEDULE_MAX_RULES);
+        }
+        schedule_rule_t *rule = &config->rules[config->numRules];
+
+        const char *days = obj["days"] | "*";
+        const char *start = obj["start"] | "";
+        const char *profile = obj["profile"] | "";
+        int index = schedule_find_profile(config, profile);
+
+        if (!parseDays(days, &rule->days)) {
+            return fail(err, errLen, "rule %d: invalid days '%s'", config->numRules, days);
+        }
+        if (!parseStart(start, &rule->minute)) {
+            return fail(err, errLen, "rule %d: invalid start '%s', expected HH:MM", config->numRules, start);
+        }
+        if (index < 0 && strcmp(profile, SCHEDULE_DEFAULT_PROFILE)) {
+            return fail(err, errLen, "rule %d: unknown profile '%s'", config->numRules, profile);
+        }
+        rule->profile = (int8_t) index;
+        config->numRules++;
+    }
+    return true;
+}
+
+int schedule_find_profile(const schedule_config_t *config, const char *name)
+{
+    for (int i = 0; i < config->numProfiles; i++) {
+        if (!strcmp(config->profiles[i].name, name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int schedule_active_rule(const schedule_config_t *config, int wday, int minute)
+{
+    int now = wday * 24 * 60 + minute;
+    int best = -1;
+    int bestAge = SCHEDULE_MINUTES_PER_WEEK;
+
+    // the start that is the least minutes ago, a week back at most
+    for (int i = 0; i < config->numRules; i++) {
+        const schedule_rule_t *rule = &config->rules[i];
+        for (int d = 0; d < 7; d++) {
+            if (!(rule->days & (1 << d))) {
+                continue;
+            }
+            int age = (now - (d * 24 * 60 + rule->minute) + SCHEDULE_MINUTES_PER_WEEK) % SCHEDULE_MINUTES_PER_WEEK;
+            if (age <= bestAge) {
+                best = i;
+                bestAge = age;
+            }
+        }
+    }
+    return best;
+}
+
+int schedule_minutes_to_next(const schedule_config_t *config, int wday, int minute)
+{
+    int now = wday * 24 * 60 + minute;
+    int next = -1;
+
+    for (int i = 0; i < config->numRules; i++) {
+        const schedule_rule_t *rule = &config->rules[i];
+        for (int d = 0; d < 7; d++) {
+            if (!(rule->days & (1 << d))) {
+                continue;
+            }
+            int in = (d * 24 * 60 + rule->minute - now + SCHEDULE_MINUTES_PER_WEEK) % SCHEDULE_MINUTES_PER_WEEK;
+            if (!in) {
+                in = SCHEDULE_MINUTES_PER_WEEK;
+            }
+            if (next < 0 || in < next) {
+                next = in;
+            }
+        }
+    }
+    return next;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Time-of-use schedule of mining profiles, stored as JSON:
+//
+//   {
+//     "enabled": true,
+//     "timezone": "CET-1CEST,M3.5.0,M10.5.0/3",   // POSIX TZ, default UTC
+//     "profiles": [
+//       {"name": "peak", "pause": true, "price": 0.42},
+//       {"name": "eco", "frequency": 400, "coreVoltage": 1150, "powerCap": 45, "price": 0.30},
+//       {"name": "night", "autofanspeed": 0, "fanspeed": 100, "price": 0.18}
+//     ],
+//     "rules": [
+//       {"days": "mon-fri", "start": "07:00", "profile": "eco"},
+//       {"days": "mon-fri", "start": "17:00", "profile": "peak"},
+//       {"days": "*", "start": "22:00", "profile": "night"}
+//     ]
+//   }
+//
+// A profile only changes the settings it names, the others stay as
+// configured. A rule is in effect from its start until the next rule
+// starts, the week wraps around. "days" is "*" or a list of days and
+// ranges like "mon-fri,sun".
+
+#define SCHEDULE_MAX_PROFILES 8
+#define SCHEDULE_MAX_RULES 32
+#define SCHEDULE_NAME_MAX 16
+#define SCHEDULE_TIMEZONE_MAX 48
+
+#define SCHEDULE_MINUTES_PER_WEEK (7 * 24 * 60)
+
+// the configured settings, reserved as a profile name
+#define SCHEDULE_DEFAULT_PROFILE "default"
+
+typedef struct
+{
+    char name[SCHEDULE_NAME_MAX];
+    uint16_t frequency;   // MHz, 0 keeps the configured one
+    uint16_t coreVoltage; // mV, 0 keeps the configured one
+    int16_t fanMode;      // autofanspeed (0 manual, 2 PID), -1 keeps it
+    int16_t fanSpeed;     // %, -1 keeps it
+    int16_t powerCap;     // W, 0 is off, -1 keeps it
+    bool pause;           // no jobs are sent, the ASICs run at the board's lowest frequency and voltage
+    float price;          // per kWh, only for the accounting
+} schedule_profile_t;
+
+typedef struct
+{
+    uint8_t days;    // bit 0 is Sunday like tm_wday
+    uint16_t minute; // of the day
+    int8_t profile;  // index into profiles, -1 for the configured settings
+} schedule_rule_t;
+
+typedef struct
+{
+    bool enabled;
+    char timezone[SCHEDULE_TIMEZONE_MAX];
+    int numProfiles;
+    schedule_profile_t profiles[SCHEDULE_MAX_PROFILES];
+    int numRules;
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+} schedule_config_t;
+
+// parses and validates a schedule, an empty string is an empty schedule;
+// on an error err says why
+bool schedule_parse(const char *json, size_t len, schedule_config_t *config, char *err, size_t errLen);
+
+// index of the profile, -1 if there is none with this name
+int schedule_find_profile(const schedule_config_t *config, const char *name);
+
+// rule in effect at the local time (tm_wday, minute of the day), -1 without
+// rules; on the same start the later rule wins
+int schedule_active_rule(const schedule_config_t *config, int wday, int minute);
+
+// minutes until the next rule starts, -1 without rules
+int schedule_minutes_to_next(const schedule_config_t *config, int wday, int minute);
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "profiler.h"
+#include "task_topology.h"
+
+#pragma GCC diagnostic error "-Wall"
+#pragma GCC diagnostic error "-Wextra"
+
+static const char *TAG = "profiler";
+
+// uxTaskGetSystemState fails if there are more tasks than entries
+#define PROFILER_STATUS_ENTRIES 48
+
+Profiler PROFILER;
+
+TaskLoop *TaskLoop::s_firstLoop = nullptr;
+
+TaskLoop::TaskLoop(const char *loop)
+    : Metric(MetricType::GAUGE, "profile_loop_max_us", "Longest iteration of a task loop", nullptr), m_loop(loop)
+{
+    m_nextLoop = s_firstLoop;
+    s_firstLoop = this;
+}
+
+int TaskLoop::format(char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "%s{loop=\"%s\",window=\"10s\"} %lu\n%s{loop=\"%s\",window=\"boot\"} %lu\n", m_name, m_loop,
+                     (unsigned long) getWindowMaxUs(), m_name, m_loop, (unsigned long) getMaxUs());
+    return (n < 0 || (size_t) n >= len) ? -1 : n;
+}
+
+// per core load over the sliding windows
+class CoreLoadMetric : public Metric {
+  protected:
+    int format(char *buf, size_t len) override
+    {
+        static const int windows[] = {1, 10, 60};
+        int pos = 0;
+        for (int core = 0; core < PROFILER_NUM_CORES; core++) {
+            for (int seconds : windows) {
+                float load = PROFILER.getCoreLoad(core, seconds);
+                if (load < 0.0f) {
+                    continue;
+                }
+                int n = snprintf(&buf[pos], len - pos, "%s{core=\"%d\",window=\"%ds\"} %.2f\n", m_name, core, seconds, load);
+                if (n < 0 || (size_t) n >= len - pos) {
+                    return -1;
+                }
+                pos += n;
+            }
+        }
+        return pos;
+    }
+
+  public:
+    CoreLoadMetric() : Metric(MetricType::GAUGE, "profile_cpu_load_percent", "CPU load per core", nullptr)
+    {}
+};
+
+// one metric per task slot, the task name becomes the label
+class TaskLoadMetric : public Metric {
+  protected:
+    static int s_count;
+    int m_slot;
+
+    int format(char *buf, size_t len) override
+    {
+        char name[configMAX_TASK_NAME_LEN];
+        int core;
+        float load;
+        if (!PROFILER.getTaskLoad(m_slot, 10, name, sizeof(name), &core, &load)) {
+            return 0;
+        }
+        char coreLabel[12];
+        if (core < 0) {
+            strcpy(coreLabel, "any");
+        } else {
+            snprintf(coreLabel, sizeof(coreLabel), "%d", core);
+        }
+        int n = snprintf(buf, len, "%s{task=\"%s\",core=\"%s\"} %.2f\n", m_name, name, coreLabel, load);
+        return (n < 0 || (size_t) n >= len) ? -1 : n;
+    }
+
+  public:
+    TaskLoadMetric()
+        : Metric(MetricType::GAUGE, "profile_task_cpu_percent", "CPU used by a task over 10 s, percent of one core", nullptr),
+          m_slot(s_count++)
+    {}
+};
+
+int TaskLoadMetric::s_count = 0;
+
+static CoreLoadMetric s_coreLoad;
+static TaskLoadMetric s_taskLoad[PROFILER_MAX_TASKS];
+
+Profiler::Profiler()
+{
+    // NOP
+}
+
+bool Profiler::start()
+{
+#if !CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    ESP_LOGW(TAG, "FreeRTOS run time stats are disabled, only task loops are profiled");
+#endif
+    return TASK_TOPOLOGY.create(taskWrapper, "profiler", 3072, this, 1, NULL, TaskGroup::SERVICE) == pdPASS;
+}
+
+void Profiler::taskWrapper(void *pvParameters)
+{
+    Profiler *profiler = (Profiler *) pvParameters;
+    profiler->task();
+}
+
+void Profiler::task()
+{
+    uint32_t ticks = 0;
+    while (1) {
+        sample();
+
+        if (++ticks % PROFILER_LOOP_WINDOW == 0) {
+            for (TaskLoop *loop = TaskLoop::first(); loop; loop = loop->next()) {
+                loop->rollWindow();
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(PROFILER_SAMPLE_MS));
+    }
+}
+
+void Profiler::sample()
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // only used from the profiler task
+    static TaskStatus_t status[PROFILER_STATUS_ENTRIES];
+
+#ifdef configRUN_TIME_COUNTER_TYPE
+    configRUN_TIME_COUNTER_TYPE total = 0;
+#else
+    uint32_t total = 0;
+#endif
+    UBaseType_t count = uxTaskGetSystemState(status, PROFILER_STATUS_ENTRIES, &total);
+    if (!count) {
+        ESP_LOGW(TAG, "more than %d tasks", PROFILER_STATUS_ENTRIES);
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+
+    // the first call only takes the reference values
+    bool first = !m_lastTotal;
+    int taskIndex = m_numSamples % PROFILER_TASK_SAMPLES;
+    int coreIndex = m_numSamples % PROFILER_CORE_SAMPLES;
+
+    for (int c = 0; c < PROFILER_NUM_CORES; c++) {
+        m_idle[c][coreIndex] = 0;
+    }
+    for (int i = 0; i < PROFILER_MAX_TASKS; i++) {
+        m_tasks[i].alive = false;
+    }
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        TaskStatus_t *s = &status[i];
+        uint32_t runTime = (uint32_t) s->ulRunTimeCounter;
+
+        profiler_task_t *task = nullptr;
+        profiler_task_t *unused = nullptr;
+        for (int j = 0; j < PROFILER_MAX_TASKS; j++) {
+            if (m_tasks[j].used && m_tasks[j].handle == s->xHandle) {
+                task = &m_tasks[j];
+                break;
+            }
+            if (!m_tasks[j].used && !unused) {
+                unused = &m_tasks[j];
+            }
+        }
+
+        uint32_t delta = 0;
+        if (task) {
+            delta = runTime - task->lastRunTime;
+        } else if (unused) {
+            // new task, starts with an empty window
+            task = unused;
+            memset(task, 0, sizeof(*task));
+            task->used = true;
+            task->handle = s->xHandle;
+            strncpy(task->name, s->pcTaskName, sizeof(task->name) - 1);
+        } else {
+            continue;
+        }
+
+        task->alive = true;
+        task->lastRunTime = runTime;
+        task->runTime[taskIndex] = delta;
+        task->priority = s->uxCurrentPriority;
+        task->stackFree = s->usStackHighWaterMark;
+#ifdef CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        task->core = (s->xCoreID >= 0 && s->xCoreID < PROFILER_NUM_CORES) ? (int) s->xCoreID : -1;
+#else
+        // the idle tasks are named IDLE0 and IDLE1
+        task->core = -1;
+        if (!strncmp(task->name, "IDLE", 4) && task->name[4] >= '0' && task->name[4] < '0' + PROFILER_NUM_CORES) {
+            task->core = task->name[4] - '0';
+        }
+#endif
+        if (!strncmp(task->name, "IDLE", 4) && task->core >= 0) {
+            m_idle[task->core][coreIndex] = delta;
+        }
+    }
+
+    // deleted tasks free their slot
+    for (int i = 0; i < PROFILER_MAX_TASKS; i++) {
+        if (!m_tasks[i].alive) {
+            m_tasks[i].used = false;
+        }
+    }
+
+    m_total[coreIndex] = (uint32_t) total - m_lastTotal;
+    m_lastTotal = (uint32_t) total;
+    if (!first) {
+        m_numSamples++;
+    }
+
+    pthread_mutex_unlock(&m_lock);
+#endif
+}
+
+bool Profiler::isAvailable()
+{
+    return m_numSamples > 0;
+}
+
+// total run time of the last samples, must hold the lock
+uint32_t Profiler::totalOver(int samples)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < samples; i++) {
+        total += m_total[(m_numSamples - 1 - i) % PROFILER_CORE_SAMPLES];
+    }
+    return total;
+}
+
+float Profiler::getCoreLoad(int core, int seconds)
+{
+    int samples = seconds * 1000 / PROFILER_SAMPLE_MS;
+    float load = -1.0f;
+
+    pthread_mutex_lock(&m_lock);
+    if (samples > (int) m_numSamples) {
+        samples = m_numSamples;
+    }
+    if (samples > PROFILER_CORE_SAMPLES) {
+        samples = PROFILER_CORE_SAMPLES;
+    }
+    uint32_t total = totalOver(samples);
+    if (core >= 0 && core < PROFILER_NUM_CORES && total) {
+        uint32_t idle = 0;
+        for (int i = 0; i < samples; i++) {
+            idle += m_idle[core][(m_numSamples - 1 - i) % PROFILER_CORE_SAMPLES];
+        }
+        load = 100.0f - 100.0f * (float) idle / (float) total;
+        load = load < 0.0f ? 0.0f : load;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return load;
+}
+
+bool Profiler::getTaskLoad(int slot, int seconds, char *name, size_t nameLen, int *core, float *load)
+{
+    int samples = seconds * 1000 / PROFILER_SAMPLE_MS;
+    bool found = false;
+
+    pthread_mutex_lock(&m_lock);
+    if (samples > (int) m_numSamples) {
+        samples = m_numSamples;
+    }
+    if (samples > PROFILER_TASK_SAMPLES) {
+        samples = PROFILER_TASK_SAMPLES;
+    }
+    uint32_t total = totalOver(samples);
+    profiler_task_t *task = (slot >= 0 && slot < PROFILER_MAX_TASKS) ? &m_tasks[slot] : nullptr;
+    if (task && task->used && total) {
+        uint32_t runTime = 0;
+        for (int i = 0; i < samples; i++) {
+            runTime += task->runTime[(m_numSamples - 1 - i) % PROFILER_TASK_SAMPLES];
+        }
+        strncpy(name, task->name, nameLen - 1);
+        name[nameLen - 1] = 0;
+        *core = task->core;
+        *load = 100.0f * (float) runTime / (float) total;
+        found = true;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return found;
+}
+
+void Profiler::toJson(JsonDocument &doc)
+{
+    doc["available"] = isAvailable();
+    doc["sampleMs"] = PROFILER_SAMPLE_MS;
+
+    JsonArray cores = doc["cores"].to<JsonArray>();
+    for (int core = 0; core < PROFILER_NUM_CORES && isAvailable(); core++) {
+        JsonObject obj = cores.add<JsonObject>();
+        obj["core"] = core;
+        obj["load1s"] = getCoreLoad(core, 1);
+        obj["load10s"] = getCoreLoad(core, 10);
+        obj["load60s"] = getCoreLoad(core, 60);
+    }
+
+    // busiest tasks first
+    typedef struct
+    {
+        char name[configMAX_TASK_NAME_LEN];
+        int core;
+        uint32_t priority;
+        uint32_t stackFree;
+        float load1s;
+        float load10s;
+    } entry_t;
+
+    static entry_t entries[PROFILER_MAX_TASKS];
+    static pthread_mutex_t entriesLock = PTHREAD_MUTEX_INITIALIZER;
+
+    pthread_mutex_lock(&entriesLock);
+    int numEntries = 0;
+    for (int slot = 0; slot < PROFILER_MAX_TASKS; slot++) {
+        entry_t e;
+        if (!getTaskLoad(slot, 10, e.name, sizeof(e.name), &e.core, &e.load10s)) {
+            continue;
+        }
+        getTaskLoad(slot, 1, e.name, sizeof(e.name), &e.core, &e.load1s);
+
+        pthread_mutex_lock(&m_lock);
+        e.priority = m_tasks[slot].priority;
+        e.stackFree = m_tasks[slot].stackFree;
+        pthread_mutex_unlock(&m_lock);
+
+        int pos = numEntries++;
+        while (pos > 0 && entries[pos - 1].load10s < e.load10s) {
+            entries[pos] = entries[pos - 1];
+            pos--;
+        }
+        entries[pos] = e;
+    }
+
+    JsonArray tasks = doc["tasks"].to<JsonArray>();
+    for (int i = 0; i < numEntries; i++) {
+        JsonObject obj = tasks.add<JsonObject>();
+        obj["name"] = entries[i].name;
+        if (entries[i].core >= 0) {
+            obj["core"] = entries[i].core;
+        } else {
+            obj["core"] = nullptr;
+        }
+        obj["priority"] = entries[i].priority;
+        obj["stackFree"] = entries[i].stackFree;
+        obj["load1s"] = entries[i].load1s;
+        obj["load10s"] = entries[i].load10s;
+    }
+    pthread_mutex_unlock(&entriesLock);
+
+    JsonArray loops = doc["loops"].to<JsonArray>();
+    for (TaskLoop *loop = TaskLoop::first(); loop; loop = loop->next()) {
+        JsonObject obj = loops.add<JsonObject>();
+        obj["name"] = loop->getName();
+        obj["count"] = loop->getCount();
+        obj["maxUs"] = loop->getMaxUs();
+        obj["windowMaxUs"] = loop->getWindowMaxUs();
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "metrics.h"
+
+#define PROFILER_MAX_TASKS 32
+#define PROFILER_NUM_CORES 2
+
+// one sample per second
+#define PROFILER_SAMPLE_MS 1000
+
+// samples kept for the sliding windows
+#define PROFILER_TASK_SAMPLES 10
+#define PROFILER_CORE_SAMPLES 60
+
+// loop maxima are reported per window of this many samples
+#define PROFILER_LOOP_WINDOW 10
+
+// Longest iteration of a task loop. The task reports how long each
+// iteration took, the profiler rolls the window every 10 s.
+//
+//   static TaskLoop s_loop("asic_result");
+//   s_loop.record(platform_time_us() - start);
+class TaskLoop : public Metric {
+  protected:
+    const char *m_loop;
+    std::atomic<uint32_t> m_count{0};
+    std::atomic<uint32_t> m_maxUs{0};
+    std::atomic<uint32_t> m_windowMaxUs{0};
+    std::atomic<uint32_t> m_lastWindowMaxUs{0};
+    TaskLoop *m_nextLoop = nullptr;
+
+    static TaskLoop *s_firstLoop;
+
+    int format(char *buf, size_t len) override;
+
+    static void storeMax(std::atomic<uint32_t> &max, uint32_t value)
+    {
+        uint32_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+
+  public:
+    TaskLoop(const char *loop);
+
+    void record(int64_t us)
+    {
+        uint32_t value = us > UINT32_MAX ? UINT32_MAX : (us < 0 ? 0 : (uint32_t) us);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        storeMax(m_maxUs, value);
+        storeMax(m_windowMaxUs, value);
+    }
+
+    // starts a new window, the finished one is reported until the next roll
+    void rollWindow()
+    {
+        m_lastWindowMaxUs.store(m_windowMaxUs.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    const char *getName()
+    {
+        return m_loop;
+    }
+    uint32_t getCount()
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+    uint32_t getMaxUs()
+    {
+        return m_maxUs.load(std::memory_order_relaxed);
+    }
+    uint32_t getWindowMaxUs()
+    {
+        return m_lastWindowMaxUs.load(std::memory_order_relaxed);
+    }
+
+    static TaskLoop *first()
+    {
+        return s_firstLoop;
+    }
+    TaskLoop *next()
+    {
+        return m_nextLoop;
+    }
+};
+
+typedef struct
+{
+    TaskHandle_t handle;
+    char name[configMAX_TASK_NAME_LEN];
+    int core; // -1 if not pinned
+    uint32_t priority;
+    uint32_t stackFree; // high water mark, bytes
+    uint32_t lastRunTime;
+    uint32_t runTime[PROFILER_TASK_SAMPLES]; // run time counter ticks per sample
+    bool used;
+    bool alive;
+} profiler_task_t;
+
+// Samples the FreeRTOS run time stats once per second and keeps per task
+// and per core utilisation over sliding windows. Needs
+// CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, otherwise only the task loops
+// are reported.
+class Profiler {
+  protected:
+    profiler_task_t m_tasks[PROFILER_MAX_TASKS] = {};
+
+    // run time of the idle tasks and total run time per sample
+    uint32_t m_idle[PROFILER_NUM_CORES][PROFILER_CORE_SAMPLES] = {};
+    uint32_t m_total[PROFILER_CORE_SAMPLES] = {};
+    uint32_t m_lastTotal = 0;
+    uint32_t m_numSamples = 0;
+
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    void sample();
+    void task();
+    static void taskWrapper(void *pvParameters);
+
+    uint32_t totalOver(int samples);
+
+  public:
+    Profiler();
+
+    // starts the sampling task
+    bool start();
+
+    bool isAvailable();
+
+    // percent of one core over the last seconds, -1 if not known
+    float getCoreLoad(int core, int seconds);
+
+    // percent of one core used by the task in the slot over the last seconds,
+    // returns false if the slot is empty
+    bool getTaskLoad(int slot, int seconds, char *name, size_t nameLen, int *core, float *load);
+
+    void toJson(JsonDocument &doc);
+};
+
+extern Profiler PROFILER;
@@ -1,19 +1,18 @@
 #pragma once
 
 #include "ArduinoJson.h"
-#include "esp_heap_caps.h"
+#include "platform.h"
 
 struct PSRAMAllocator : ArduinoJson::Allocator {
     void* allocate(size_t size) override {
-        return heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+        return platform_malloc(size);
     }
 
     void deallocate(void* pointer) override {
-        heap_caps_free(pointer);
+        platform_free(pointer);
     }
 
     void* reallocate(void* ptr, size_t new_size) override {
-        return heap_caps_realloc(ptr, new_size, MALLOC_CAP_SPIRAM);
+        return platform_realloc(ptr, new_size);
     }
 };
-
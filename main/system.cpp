@@ -68,6 +68,9 @@ void System::initSystem() {
     // Initialize psu error flag
     m_psuError = false;
 
+    // mining runs until a profile pauses it
+    m_miningPaused = false;
+
     // Initialize shown overlay flag and last error code
     m_showsOverlay = false;
     m_currentErrorCode = 0;
@@ -158,6 +161,7 @@ void System::checkForBestDiff(double diff, uint32_t nbits) {
     if (diff > networkDiff) {
         m_foundBlock = true;
         ESP_LOGI(TAG, "FOUND BLOCK!!! %f > %f", diff, networkDiff);
+        ALERT_ENGINE.post(AlertEvent::BLOCK_FOUND, "share difficulty %.0f above the network difficulty %.0f", diff, networkDiff);
     }
 
     if ((uint64_t)diff <= m_bestNonceDiff) {
@@ -325,6 +329,10 @@ void System::task() {
         }
         lastFoundBlock = m_foundBlock;
 
+        // one sample every 5s for the chart screen
+        m_history->pushChartSample(esp_timer_get_time() / 1000llu, POWER_MANAGEMENT_MODULE.getChipTempMax(),
+                                   POWER_MANAGEMENT_MODULE.getPower());
+
         m_display->updateGlobalState();
         m_display->updateCurrentSettings();
         m_display->refreshScreen();
@@ -55,6 +55,7 @@ class System {
     int m_poolErrors;  // Count of errors related to the mining pool
     bool m_overheated; // Flag to indicate if the system is overheated
     bool m_psuError;   // Flag to indicate that there is some PSU problem
+    bool m_miningPaused; // no jobs are sent, set by a mining profile
     bool m_showsOverlay;    // Flat if overlay is shown
     uint32_t m_currentErrorCode;
 
@@ -179,6 +180,26 @@ class System {
         m_psuError = status;
     }
 
+    bool isOverheated() const
+    {
+        return m_overheated;
+    }
+
+    bool isPSUError() const
+    {
+        return m_psuError;
+    }
+
+    void setMiningPaused(bool paused)
+    {
+        m_miningPaused = paused;
+    }
+
+    bool isMiningPaused() const
+    {
+        return m_miningPaused;
+    }
+
     // WiFi-related getters and setters
     const char *getWifiStatus() const
     {
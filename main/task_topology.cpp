@@ -0,0 +1,52 @@
+#include "esp_log.h"
+
+#include "task_topology.h"
+
+static const char *TAG = "topology";
+
+TaskTopology TASK_TOPOLOGY;
+
+void TaskTopology::init(int miningCore)
+{
+    if (miningCore != 0 && miningCore != 1) {
+        m_miningCore = tskNO_AFFINITY;
+        m_serviceCore = tskNO_AFFINITY;
+        ESP_LOGI(TAG, "tasks are not pinned");
+        return;
+    }
+
+    m_miningCore = miningCore;
+    m_serviceCore = 1 - miningCore;
+    ESP_LOGI(TAG, "mining tasks on core %d, service tasks on core %d", (int) m_miningCore, (int) m_serviceCore);
+
+    if (m_miningCore == 0) {
+        ESP_LOGW(TAG, "mining tasks share core 0 with the Wi-Fi driver");
+    }
+}
+
+BaseType_t TaskTopology::getCore(TaskGroup group)
+{
+    switch (group) {
+    case TaskGroup::MINING:
+        return m_miningCore;
+    case TaskGroup::DISPLAY:
+        return 1 - TASK_TOPOLOGY_NETWORK_CORE;
+    default:
+        return m_serviceCore;
+    }
+}
+
+int TaskTopology::getMiningCore()
+{
+    return m_miningCore == tskNO_AFFINITY ? -1 : (int) m_miningCore;
+}
+
+BaseType_t TaskTopology::create(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters,
+                                UBaseType_t priority, TaskHandle_t *handle, TaskGroup group)
+{
+    BaseType_t ret = xTaskCreatePinnedToCore(task, name, stackDepth, parameters, priority, handle, getCore(group));
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "failed to create task %s", name);
+    }
+    return ret;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The ESP32-S3 has two cores. The Wi-Fi driver and lwIP run on core 0, so by
+// default the mining pipeline (ASIC results, job creation, stratum and power
+// management) is pinned to core 1 and everything else that talks to the
+// network is pinned to core 0. The display renders in bursts of several ms,
+// it stays off the network core at a priority below the mining tasks.
+enum class TaskGroup
+{
+    MINING,
+    SERVICE,
+    DISPLAY,
+};
+
+// core of the Wi-Fi driver and lwIP (sdkconfig.defaults)
+#define TASK_TOPOLOGY_NETWORK_CORE 0
+
+// value of the miningcore setting that disables pinning
+#define TASK_TOPOLOGY_UNPINNED 2
+
+class TaskTopology {
+  protected:
+    BaseType_t m_miningCore = tskNO_AFFINITY;
+    BaseType_t m_serviceCore = tskNO_AFFINITY;
+
+  public:
+    // miningCore is 0, 1 or TASK_TOPOLOGY_UNPINNED, the service tasks use the other core
+    void init(int miningCore);
+
+    BaseType_t getCore(TaskGroup group);
+
+    // -1 if the tasks are not pinned
+    int getMiningCore();
+
+    BaseType_t create(TaskFunction_t task, const char *name, uint32_t stackDepth, void *parameters, UBaseType_t priority,
+                      TaskHandle_t *handle, TaskGroup group);
+};
+
+extern TaskTopology TASK_TOPOLOGY;
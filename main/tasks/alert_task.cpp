@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <stdarg.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "alert_task.h"
+#include "global_state.h"
+#include "metrics.h"
+#include "nvs_config.h"
+#include "platform.h"
+#include "scheduler_task.h"
+
+static const char *TAG = "alerts";
+
+static Counter s_queued("alert_events", "Alert events by what happened to them", "result=\"queued\"");
+static Counter s_dropped("alert_events", "Alert events by what happened to them", "result=\"dropped\"");
+static Counter s_filtered("alert_events", "Alert events by what happened to them", "result=\"filtered\"");
+static Counter s_suppressed("alert_events", "Alert events by what happened to them", "result=\"suppressed\"");
+static Counter s_sentOk("alert_messages", "Alert messages sent", "result=\"ok\"");
+static Counter s_sentFailed("alert_messages", "Alert messages sent", "result=\"error\"");
+
+AlertEngine ALERT_ENGINE;
+
+void AlertEngine::taskWrapper(void *pvParameters)
+{
+    AlertEngine *engine = (AlertEngine *) pvParameters;
+    engine->task();
+}
+
+const char *AlertEngine::eventName(AlertEvent event)
+{
+    switch (event) {
+    case AlertEvent::BLOCK_FOUND:
+        return "block_found";
+    case AlertEvent::POOL_FAILOVER:
+        return "pool_failover";
+    case AlertEvent::OVERHEAT:
+        return "overheat";
+    case AlertEvent::PSU_FAULT:
+        return "psu_fault";
+    case AlertEvent::HASHRATE_DROP:
+        return "hashrate_drop";
+    case AlertEvent::CHIP_UNDERPERFORMING:
+        return "chip_underperforming";
+    case AlertEvent::WATCHDOG_REBOOT:
+        return "watchdog_reboot";
+    default:
+        return "unknown";
+    }
+}
+
+const char *AlertEngine::eventTitle(AlertEvent event)
+{
+    switch (event) {
+    case AlertEvent::BLOCK_FOUND:
+        return "Block found";
+    case AlertEvent::POOL_FAILOVER:
+        return "Pool failover";
+    case AlertEvent::OVERHEAT:
+        return "Overheat";
+    case AlertEvent::PSU_FAULT:
+        return "PSU fault";
+    case AlertEvent::HASHRATE_DROP:
+        return "Hashrate drop";
+    case AlertEvent::CHIP_UNDERPERFORMING:
+        return "Chip underperforming";
+    case AlertEvent::WATCHDOG_REBOOT:
+        return "Watchdog reboot";
+    default:
+        return "Unknown";
+    }
+}
+
+void AlertEngine::init()
+{
+    m_queue = xQueueCreate(ALERT_QUEUE_LENGTH, sizeof(AlertMessage));
+    m_discord.init();
+    m_webhook.init();
+    loadConfig();
+}
+
+void AlertEngine::loadConfig()
+{
+    m_discord.loadConfig();
+    m_webhook.loadConfig();
+
+    pthread_mutex_lock(&m_lock);
+    m_events = Config::getAlertEvents();
+    m_cooldownMin = Config::getAlertCooldown();
+    m_digestS = Config::getAlertDigest();
+    m_hashrateDrop = Config::getAlertHashrateDrop();
+    m_chipPercent = Config::getAlertChipPercent();
+    pthread_mutex_unlock(&m_lock);
+}
+
+void AlertEngine::post(AlertEvent event, const char *format, ...)
+{
+    if (!m_queue) {
+        return;
+    }
+
+    AlertMessage msg;
+    msg.event = event;
+    msg.timestamp = esp_timer_get_time();
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(msg.text, sizeof(msg.text), format, args);
+    va_end(args);
+
+    if (xQueueSend(m_queue, &msg, 0) != pdTRUE) {
+        s_dropped.inc();
+        return;
+    }
+    s_queued.inc();
+}
+
+void AlertEngine::handle(const AlertMessage *msg)
+{
+    int index = (int) msg->event;
+    if (index >= (int) AlertEvent::NUM_EVENTS) {
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    bool wanted = m_events & (1 << index);
+    int64_t cooldownUs = (int64_t) m_cooldownMin * 60ll * 1000000ll;
+    pthread_mutex_unlock(&m_lock);
+
+    if (!wanted) {
+        s_filtered.inc();
+        return;
+    }
+
+    ESP_LOGI(TAG, "%s: %s", eventName(msg->event), msg->text);
+
+    if (m_lastSentUs[index] && msg->timestamp - m_lastSentUs[index] < cooldownUs) {
+        m_suppressed[index]++;
+        s_suppressed.inc();
+        return;
+    }
+
+    if (m_pendingCount[index] < UINT16_MAX) {
+        m_pendingCount[index]++;
+    }
+    m_pendingLastUs[index] = msg->timestamp;
+    strlcpy(m_pendingText[index], msg->text, sizeof(m_pendingText[index]));
+
+    if (!m_digestStartUs) {
+        m_digestStartUs = msg->timestamp;
+    }
+
+    // nobody wants to wait for this one
+    if (msg->event == AlertEvent::BLOCK_FOUND) {
+        flush(esp_timer_get_time());
+    }
+}
+
+void AlertEngine::flush(int64_t now)
+{
+    AlertEntry entries[(int) AlertEvent::NUM_EVENTS];
+    int numEntries = 0;
+
+    for (int i = 0; i < (int) AlertEvent::NUM_EVENTS; i++) {
+        if (!m_pendingCount[i]) {
+            continue;
+        }
+        AlertEntry *entry = &entries[numEntries++];
+        entry->type = eventName((AlertEvent) i);
+        entry->title = eventTitle((AlertEvent) i);
+        entry->count = m_pendingCount[i] + m_suppressed[i];
+        entry->lastUs = m_pendingLastUs[i];
+        entry->message = m_pendingText[i];
+    }
+
+    if (numEntries) {
+        for (Alerter *alerter : {(Alerter *) &m_discord, (Alerter *) &m_webhook}) {
+            if (!alerter->isEnabled()) {
+                continue;
+            }
+            (alerter->sendDigest(entries, numEntries) ? s_sentOk : s_sentFailed).inc();
+        }
+    }
+
+    for (int i = 0; i < (int) AlertEvent::NUM_EVENTS; i++) {
+        if (m_pendingCount[i]) {
+            m_pendingCount[i] = 0;
+            m_suppressed[i] = 0;
+            m_lastSentUs[i] = now;
+        }
+    }
+    m_digestStartUs = 0;
+}
+
+// chips are compared by their nonce counts, all of them run the same
+// frequency and difficulty
+void AlertEngine::checkChips(int64_t now, uint16_t chipPercent)
+{
+    NonceDistribution *distribution = SYSTEM_MODULE.getHistory()->getNonceDistribution();
+    int numChips = distribution->getNumAsics();
+    if (!numChips) {
+        return;
+    }
+
+    if (!m_chipShares) {
+        m_chipShares = (uint32_t *) platform_malloc(numChips * sizeof(uint32_t));
+        if (!m_chipShares) {
+            return;
+        }
+        m_numChips = numChips;
+    } else if (now - m_chipWindowStartUs < (int64_t) ALERT_CHIP_WINDOW_MS * 1000ll) {
+        return;
+    } else if (chipPercent && m_numChips > 1) {
+        uint32_t total = 0;
+        for (int i = 0; i < m_numChips; i++) {
+            total += distribution->getShares(i) - m_chipShares[i];
+        }
+        uint32_t mean = total / m_numChips;
+
+        if (mean >= ALERT_CHIP_MIN_SHARES) {
+            for (int i = 0; i < m_numChips; i++) {
+                uint32_t shares = distribution->getShares(i) - m_chipShares[i];
+                if (shares * 100 < mean * chipPercent) {
+                    post(AlertEvent::CHIP_UNDERPERFORMING, "chip %d: %lu nonces in %d min, mean %lu", i, (unsigned long) shares,
+                         ALERT_CHIP_WINDOW_MS / 60000, (unsigned long) mean);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < m_numChips; i++) {
+        m_chipShares[i] = distribution->getShares(i);
+    }
+    m_chipWindowStartUs = now;
+}
+
+void AlertEngine::evaluateRules(int64_t now)
+{
+    pthread_mutex_lock(&m_lock);
+    uint16_t hashrateDrop = m_hashrateDrop;
+    uint16_t chipPercent = m_chipPercent;
+    pthread_mutex_unlock(&m_lock);
+
+    bool fallback = STRATUM_MANAGER.isUsingFallback();
+    if (fallback != m_wasFallback) {
+        if (fallback) {
+            post(AlertEvent::POOL_FAILOVER, "primary pool lost, mining on the fallback pool");
+        }
+        m_wasFallback = fallback;
+    }
+
+    // the 1h average needs an hour of data, also after a mining profile
+    // changed the hashrate on purpose; the power cap lowers it on purpose
+    // too, so the alert is held back while it is active; the alert is
+    // rearmed when the hashrate is back above the threshold
+    History *history = SYSTEM_MODULE.getHistory();
+    int64_t since = std::max(SYSTEM_MODULE.getStartTime(), PROFILE_SCHEDULER.getSwitchUs());
+    bool warm = now - since > 3600ll * 1000000ll;
+    bool capped = POWER_MANAGEMENT_MODULE.isPowerCapActive();
+    double avg10m = history->getCurrentHashrate10m();
+    double avg1h = history->getCurrentHashrate1h();
+    if (hashrateDrop && warm && !capped && avg1h > 0.0) {
+        bool low = avg10m < avg1h * (100 - hashrateDrop) / 100.0;
+        if (low && !m_hashrateLow) {
+            post(AlertEvent::HASHRATE_DROP, "10m hashrate %.1f GH/s is %.0f%% below the 1h average %.1f GH/s", avg10m,
+                 (1.0 - avg10m / avg1h) * 100.0, avg1h);
+        }
+        m_hashrateLow = low;
+    }
+
+    checkChips(now, chipPercent);
+}
+
+bool AlertEngine::sendTest()
+{
+    bool discord = m_discord.isEnabled();
+    bool webhook = m_webhook.isEnabled();
+
+    bool ok = true;
+    if (discord || !webhook) {
+        ok = m_discord.sendTestMessage() && ok;
+    }
+    if (webhook) {
+        ok = m_webhook.sendTestMessage() && ok;
+    }
+    return ok;
+}
+
+void AlertEngine::task()
+{
+    while (1) {
+        AlertMessage msg;
+        if (xQueueReceive(m_queue, &msg, pdMS_TO_TICKS(1000)) == pdTRUE) {
+            handle(&msg);
+        }
+
+        int64_t now = esp_timer_get_time();
+
+        pthread_mutex_lock(&m_lock);
+        int64_t digestUs = (int64_t) m_digestS * 1000000ll;
+        pthread_mutex_unlock(&m_lock);
+
+        if (m_digestStartUs && now - m_digestStartUs >= digestUs) {
+            flush(now);
+        }
+
+        if (now - m_lastRuleUs >= (int64_t) ALERT_RULE_INTERVAL_MS * 1000ll) {
+            evaluateRules(now);
+            m_lastRuleUs = now;
+        }
+
+        m_discord.closeIdle();
+        m_webhook.closeIdle();
+    }
+}
+
+void AlertEngine::toJson(JsonObject obj)
+{
+    pthread_mutex_lock(&m_lock);
+    obj["alertEvents"] = m_events;
+    obj["alertCooldown"] = m_cooldownMin;
+    obj["alertDigest"] = m_digestS;
+    obj["alertHashrateDrop"] = m_hashrateDrop;
+    obj["alertChipPercent"] = m_chipPercent;
+    pthread_mutex_unlock(&m_lock);
+
+    JsonArray names = obj["alertEventNames"].to<JsonArray>();
+    for (int i = 0; i < (int) AlertEvent::NUM_EVENTS; i++) {
+        names.add(eventName((AlertEvent) i));
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "discord.h"
+
+// bits of the alrt_mask setting, only append
+enum class AlertEvent : uint8_t
+{
+    BLOCK_FOUND = 0,
+    POOL_FAILOVER,
+    OVERHEAT,
+    PSU_FAULT,
+    HASHRATE_DROP,
+    CHIP_UNDERPERFORMING,
+    WATCHDOG_REBOOT,
+    NUM_EVENTS
+};
+
+#define ALERT_QUEUE_LENGTH 16
+#define ALERT_TEXT_MAX 96
+
+// the rules on the mining state are evaluated this often
+#define ALERT_RULE_INTERVAL_MS (60 * 1000)
+
+// shares of every chip are compared over this window
+#define ALERT_CHIP_WINDOW_MS (10 * 60 * 1000)
+
+// below this many shares per chip in a window the comparison is noise
+#define ALERT_CHIP_MIN_SHARES 20
+
+typedef struct
+{
+    AlertEvent event;
+    int64_t timestamp;
+    char text[ALERT_TEXT_MAX];
+} AlertMessage;
+
+// Takes events from any task into a queue and sends them from its own low
+// priority task, the caller never waits for the network.
+//
+// Rules (settings on /api/alert):
+//   - alertEvents: event types that are sent at all
+//   - alertDigest: the first event opens a window of this many seconds,
+//     everything arriving in it goes out as one message. A found block is
+//     sent right away.
+//   - alertCooldown: minutes an event type stays quiet after it was sent,
+//     repeats are counted and reported with the next one
+//   - alertHashrateDrop: percent the 10m hashrate may fall below the 1h
+//     average before HASHRATE_DROP fires (0 = off)
+//   - alertChipPercent: a chip with less than this share of the mean nonce
+//     count over ALERT_CHIP_WINDOW_MS fires CHIP_UNDERPERFORMING (0 = off)
+//
+// Pool failover, hashrate drop and chip underperformance are evaluated on
+// the mining state, the other events are posted where they happen.
+class AlertEngine {
+  protected:
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    QueueHandle_t m_queue = NULL;
+
+    DiscordAlerter m_discord;
+    WebhookAlerter m_webhook;
+
+    // settings
+    uint16_t m_events = 0xffff;
+    uint16_t m_cooldownMin = 30;
+    uint16_t m_digestS = 60;
+    uint16_t m_hashrateDrop = 25;
+    uint16_t m_chipPercent = 50;
+
+    // digest
+    uint16_t m_pendingCount[(int) AlertEvent::NUM_EVENTS] = {};
+    int64_t m_pendingLastUs[(int) AlertEvent::NUM_EVENTS] = {};
+    char m_pendingText[(int) AlertEvent::NUM_EVENTS][ALERT_TEXT_MAX] = {};
+    uint16_t m_suppressed[(int) AlertEvent::NUM_EVENTS] = {};
+    int64_t m_lastSentUs[(int) AlertEvent::NUM_EVENTS] = {};
+    int64_t m_digestStartUs = 0;
+
+    // rules
+    int64_t m_lastRuleUs = 0;
+    bool m_wasFallback = false;
+    bool m_hashrateLow = false;
+    int64_t m_chipWindowStartUs = 0;
+    uint32_t *m_chipShares = nullptr;
+    int m_numChips = 0;
+
+    void handle(const AlertMessage *msg);
+    void flush(int64_t now);
+    void evaluateRules(int64_t now);
+    void checkChips(int64_t now, uint16_t chipPercent);
+    void task();
+
+  public:
+    static void taskWrapper(void *pvParameters);
+
+    void init();
+    void loadConfig();
+
+    // queues an event, safe from any task (not from an ISR), drops the
+    // event when the queue is full
+    void post(AlertEvent event, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+    // sends a test message on the enabled alerters (Discord if none is), blocks
+    bool sendTest();
+
+    static const char *eventName(AlertEvent event);
+    static const char *eventTitle(AlertEvent event);
+
+    void toJson(JsonObject obj);
+};
+
+extern AlertEngine ALERT_ENGINE;
@@ -0,0 +1,168 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+#include "asic_jobs.h"
+#include "platform.h"
+
+static const char *TAG = "asic_jobs";
+
+AsicJobs::AsicJobs()
+{
+    memset(m_slots, 0, sizeof(m_slots));
+}
+
+bm_job *AsicJobs::cloneBmJob(bm_job *src)
+{
+    bm_job *dst = (bm_job *) malloc(sizeof(bm_job));
+
+    // copy all
+    memcpy(dst, src, sizeof(bm_job));
+
+    // copy strings
+    dst->extranonce2 = strdup(src->extranonce2);
+    dst->jobid = strdup(src->jobid);
+
+    return dst;
+}
+
+void AsicJobs::freeSlot(asic_job_slot_t *slot)
+{
+    for (int i = 0; i < ASIC_JOB_MAX_GENERATIONS; i++) {
+        if (slot->jobs[i]) {
+            free_bm_job(slot->jobs[i]);
+        }
+    }
+    memset(slot, 0, sizeof(*slot));
+}
+
+void AsicJobs::cleanJobs()
+{
+    lock();
+    for (int i = 0; i < MAX_ASIC_JOBS; i++) {
+        freeSlot(&m_slots[i]);
+    }
+    m_numSlotsUsed = 0;
+    unlock();
+}
+
+// called with the lock held. A slot comes around again after
+// slots * interval, the jobs it held have to be kept as long as nonces
+// for them can arrive.
+void AsicJobs::updateGenerations()
+{
+    int64_t maxAgeUs = (m_maxAgeUs > m_lastMaxAgeUs) ? m_maxAgeUs : m_lastMaxAgeUs;
+    float reuseMs = m_intervalMs * m_numSlotsUsed;
+    int generations = 2;
+    if (reuseMs > 0.0f) {
+        generations = 1 + (int) ceilf((float) maxAgeUs / 1000.0f / reuseMs);
+    }
+    if (generations < 2) {
+        generations = 2;
+    }
+    if (generations > ASIC_JOB_MAX_GENERATIONS) {
+        generations = ASIC_JOB_MAX_GENERATIONS;
+    }
+    if (generations != m_numGenerations) {
+        ESP_LOGI(TAG, "keeping %d generations of jobs (%d slots, %.1fms interval, %lldms oldest nonce)", generations,
+                 m_numSlotsUsed, m_intervalMs, (long long) (maxAgeUs / 1000));
+        m_numGenerations = generations;
+    }
+}
+
+void AsicJobs::storeJob(bm_job *next_job, uint8_t asic_job_id)
+{
+    int64_t now = platform_time_us();
+
+    lock();
+    if (m_lastStoreUs) {
+        float intervalMs = (float) (now - m_lastStoreUs) / 1000.0f;
+        m_intervalMs = m_intervalMs ? m_intervalMs * 0.9f + intervalMs * 0.1f : intervalMs;
+    }
+    m_lastStoreUs = now;
+
+    asic_job_slot_t *slot = &m_slots[asic_job_id];
+    if (!slot->generation) {
+        m_numSlotsUsed++;
+    }
+    updateGenerations();
+
+    // the oldest generation drops out, the others move one back
+    for (int i = m_numGenerations - 1; i < ASIC_JOB_MAX_GENERATIONS; i++) {
+        if (slot->jobs[i]) {
+            free_bm_job(slot->jobs[i]);
+            slot->jobs[i] = NULL;
+        }
+    }
+    for (int i = m_numGenerations - 1; i > 0; i--) {
+        slot->jobs[i] = slot->jobs[i - 1];
+        slot->storedUs[i] = slot->storedUs[i - 1];
+    }
+    slot->jobs[0] = next_job;
+    slot->storedUs[0] = now;
+    slot->generation++;
+    unlock();
+}
+
+bm_job *AsicJobs::getClone(uint8_t asic_job_id, int age, int64_t *storedUs)
+{
+    if (age < 0 || age >= ASIC_JOB_MAX_GENERATIONS) {
+        return NULL;
+    }
+
+    // check if we have a job with this job id
+    lock();
+    asic_job_slot_t *slot = &m_slots[asic_job_id];
+    if (!slot->jobs[age]) {
+        unlock();
+        return NULL;
+    }
+    // create a clone
+    bm_job *job = cloneBmJob(slot->jobs[age]);
+    if (storedUs) {
+        *storedUs = slot->storedUs[age];
+    }
+    unlock();
+
+    // and return it
+    return job;
+}
+
+void AsicJobs::recordResultAge(int64_t storedUs, int64_t nowUs)
+{
+    int64_t age = nowUs - storedUs;
+
+    lock();
+    if (nowUs - m_windowStartUs > ASIC_JOB_AGE_WINDOW_US) {
+        m_lastMaxAgeUs = m_maxAgeUs;
+        m_maxAgeUs = 0;
+        m_windowStartUs = nowUs;
+    }
+    if (age > m_maxAgeUs) {
+        m_maxAgeUs = age;
+    }
+    unlock();
+}
+
+int AsicJobs::getNumGenerations()
+{
+    lock();
+    int generations = m_numGenerations;
+    unlock();
+    return generations;
+}
+
+int AsicJobs::getMinSafeIntervalMs()
+{
+    lock();
+    int64_t maxAgeUs = (m_maxAgeUs > m_lastMaxAgeUs) ? m_maxAgeUs : m_lastMaxAgeUs;
+    int slots = m_numSlotsUsed;
+    unlock();
+
+    if (!slots || !maxAgeUs) {
+        return 0;
+    }
+    // 25% margin on the oldest nonce seen
+    return (int) ceilf((float) maxAgeUs * 1.25f / 1000.0f / slots);
+}
@@ -1,82 +1,78 @@
 #pragma once
 
 #include <pthread.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "mining.h"
 
 #define MAX_ASIC_JOBS 128
 
+// generations of jobs kept per ASIC job id, the newest one and the ones it
+// replaced, so late nonces of a replaced job can still be matched
+#define ASIC_JOB_MAX_GENERATIONS 4
+
+// window over which the oldest nonce is tracked for the recommendation
+#define ASIC_JOB_AGE_WINDOW_US (300ll * 1000000ll)
+
+typedef struct
+{
+    bm_job *jobs[ASIC_JOB_MAX_GENERATIONS]; // [0] is the newest
+    int64_t storedUs[ASIC_JOB_MAX_GENERATIONS];
+    uint32_t generation; // jobs stored in this slot since the last clean
+} asic_job_slot_t;
+
+// Jobs sent to the ASICs, by the ASIC job id. The chips only report a few
+// distinct ids (16 on the BM1368/70), so with short job intervals a slot is
+// reused while the chips can still send nonces for the job it held. The
+// replaced jobs are kept for some generations, the number depends on how
+// old the nonces get compared to how fast the slots are reused.
 class AsicJobs {
-protected:
-    bm_job *m_activeJobs[MAX_ASIC_JOBS];
-    pthread_mutex_t m_validJobsLock;
+  protected:
+    asic_job_slot_t m_slots[MAX_ASIC_JOBS];
+    pthread_mutex_t m_validJobsLock = PTHREAD_MUTEX_INITIALIZER;
 
-    void lock() {
+    int m_numGenerations = 2;
+    int m_numSlotsUsed = 0;
+    int64_t m_lastStoreUs = 0;
+    float m_intervalMs = 0.0f; // moving average of the time between jobs
+
+    // oldest matched nonce of the current and of the last window
+    int64_t m_maxAgeUs = 0;
+    int64_t m_lastMaxAgeUs = 0;
+    int64_t m_windowStartUs = 0;
+
+    void lock()
+    {
         pthread_mutex_lock(&m_validJobsLock);
     }
 
-    void unlock() {
+    void unlock()
+    {
         pthread_mutex_unlock(&m_validJobsLock);
     }
 
-    bm_job *cloneBmJob(bm_job *src)
-    {
-        bm_job *dst = (bm_job *) malloc(sizeof(bm_job));
-
-        // copy all
-        memcpy(dst, src, sizeof(bm_job));
-
-        // copy strings
-        dst->extranonce2 = strdup(src->extranonce2);
-        dst->jobid = strdup(src->jobid);
+    bm_job *cloneBmJob(bm_job *src);
+    void freeSlot(asic_job_slot_t *slot);
+    void updateGenerations();
 
-        return dst;
-    }
+  public:
+    AsicJobs();
 
-public:
-    AsicJobs() {
-        m_validJobsLock = PTHREAD_MUTEX_INITIALIZER;
-        memset(m_activeJobs, 0, sizeof(m_activeJobs));
-    }
+    void cleanJobs();
+    void storeJob(bm_job *next_job, uint8_t asic_job_id);
 
-    void cleanJobs() {
-        lock();
-        for (int i = 0; i < MAX_ASIC_JOBS; i++) {
-            if (m_activeJobs[i]) {
-                free_bm_job(m_activeJobs[i]);
-                m_activeJobs[i] = 0;
-            }
-        }
-        unlock();
-    }
+    // clone of the job in the slot, age 0 is the newest job and 1 the one it
+    // replaced, ... returns NULL if there is none. storedUs is set to the
+    // time the job was sent.
+    bm_job *getClone(uint8_t asic_job_id, int age = 0, int64_t *storedUs = nullptr);
 
-    void storeJob(bm_job *next_job, uint8_t asic_job_id) {
-        lock();
-        // if a slot was used before free it
-        if (m_activeJobs[asic_job_id]) {
-            free_bm_job(m_activeJobs[asic_job_id]);
-        }
-        // save job into slot
-        m_activeJobs[asic_job_id] = next_job;
-        unlock();
-    }
+    // a nonce of a job that was sent at storedUs was matched
+    void recordResultAge(int64_t storedUs, int64_t nowUs);
 
-    bm_job *getClone(uint8_t asic_job_id) {
-        // check if we have a job with this job id
-        lock();
-        if (!m_activeJobs[asic_job_id]) {
-            unlock();
-            return NULL;
-        }
-        // create a clone
-        bm_job *job = cloneBmJob(m_activeJobs[asic_job_id]);
-        unlock();
-
-        // and return it
-        return job;
-    }
+    int getNumGenerations();
 
+    // shortest job interval at which the slots aren't reused while nonces of
+    // their jobs are still coming in, 0 if not known yet
+    int getMinSafeIntervalMs();
 };
-
-
@@ -6,11 +6,82 @@
 #include "utils.h"
 #include "global_state.h"
 #include "nvs_config.h"
+#include "platform.h"
 #include "system.h"
 #include "boards/board.h"
+#include "influx_task.h"
+#include "eventlog.h"
+#include "metrics.h"
+#include "profiler.h"
 
 static const char *TAG = "asic_result";
 
+static Counter s_nonces("asic_nonces", "Nonces received from the ASICs");
+static Counter s_regResponses("asic_register_responses", "Register responses received from the ASICs");
+static Counter s_invalidJobIds("asic_invalid_job_ids", "Nonces with unknown job id");
+static Counter s_crossGeneration("asic_cross_generation_results", "Nonces of a job that was replaced in its slot");
+static Counter s_lowDiffResults("asic_low_difficulty_results", "Nonces below the ticket difficulty of every job in the slot");
+static Counter s_asicShares("asic_shares", "Nonces above the ASIC difficulty");
+static Counter s_poolShares("asic_pool_shares", "Nonces above the pool difficulty");
+static Counter s_pausedNonces("asic_paused_nonces", "Nonces dropped while mining is paused");
+static HistogramN<10> s_processTime("asic_result_process_us", "Time to validate and handle a nonce", METRICS_LATENCY_US_BUCKETS);
+static HistogramN<10> s_submitTime("asic_share_submit_us", "Time from a nonce to the share being sent to the pool",
+                                    METRICS_LATENCY_US_BUCKETS);
+static TaskLoop s_loop("asic_result");
+
+// share of the UART line rate used since the last export, 10 bits per byte (8N1)
+static float uartUtilization(bool tx)
+{
+    static uint32_t lastBytes[2];
+    static int64_t lastUs[2];
+
+    serial_stats_t stats;
+    SERIAL_get_stats(&stats);
+    uint32_t bytes = tx ? stats.txBytes : stats.rxBytes;
+    int64_t now = platform_time_us();
+
+    uint32_t delta = bytes - lastBytes[tx];
+    int64_t elapsedUs = now - lastUs[tx];
+    lastBytes[tx] = bytes;
+    lastUs[tx] = now;
+
+    if (!stats.baud || elapsedUs <= 0) {
+        return 0.0f;
+    }
+    return (float) delta * 10.0f * 1e6f / ((float) stats.baud * elapsedUs) * 100.0f;
+}
+
+static Gauge s_jobGenerations("asic_job_generations", "Jobs kept per ASIC job id", []() {
+    return (float) asicJobs.getNumGenerations();
+});
+static Gauge s_minSafeInterval("asic_job_interval_min_safe_ms", "Shortest job interval without reusing busy job ids", []() {
+    return (float) asicJobs.getMinSafeIntervalMs();
+});
+
+// a nonce of the right job is at least at the ticket difficulty the chips
+// were configured with (see Asic::setJobDifficultyMask), half of it leaves
+// room for rounding
+static bool belongsToJob(double nonceDiff, bm_job *job)
+{
+    return nonceDiff >= (double) _largest_power_of_two(job->asic_diff) / 2.0;
+}
+
+static Gauge s_uartBaud("asic_uart_baud", "Negotiated baud of the ASIC UART", []() {
+    serial_stats_t stats;
+    SERIAL_get_stats(&stats);
+    return (float) stats.baud;
+});
+static Gauge s_uartTx("asic_uart_utilization_percent", "Use of the ASIC UART line rate", []() {
+    return uartUtilization(true);
+}, "direction=\"tx\"");
+static Gauge s_uartRx("asic_uart_utilization_percent", "Use of the ASIC UART line rate", []() {
+    return uartUtilization(false);
+}, "direction=\"rx\"");
+static Counter s_uartCrcErrors("asic_uart_crc_errors", "ASIC responses with a wrong crc", []() {
+    Asic *asics = SYSTEM_MODULE.getBoard()->getAsics();
+    return asics ? (uint64_t) asics->getCrcErrors() : (uint64_t) 0;
+});
+
 void ASIC_result_task(void *pvParameters)
 {
     Board* board = SYSTEM_MODULE.getBoard();
@@ -26,12 +97,15 @@ void ASIC_result_task(void *pvParameters)
         }
 
         if (asic_result.is_reg_resp) {
+            s_regResponses.inc();
             switch (asic_result.reg) {
                 case 0xb4: {
                     if (asic_result.data & 0x80000000) {
                         float ftemp = (float) (asic_result.data & 0x0000ffff) * 0.171342f - 299.5144f;;
-                        ESP_LOGI(TAG, "asic %d temp: %.3f", (int) asic_result.asic_nr, ftemp);
+                        EVENT_LOGI(EventModule::ASIC, EventId::ASIC_TEMP, asic_result.asic_nr, ftemp);
+                        EVENT_TEXT(EventModule::ASIC, TAG, "asic %d temp: %.3f", (int) asic_result.asic_nr, ftemp);
                         board->setChipTemp(asic_result.asic_nr, ftemp);
+                        influx_task_push_chip_temp(asic_result.asic_nr, ftemp);
                     }
                     break;
                 }
@@ -43,40 +117,100 @@ void ASIC_result_task(void *pvParameters)
             continue;
         }
 
+        s_nonces.inc();
+
+        // a pause only stops new jobs, the chips still finish the last one;
+        // its nonces are neither submitted nor booked to the paused profile
+        if (SYSTEM_MODULE.isMiningPaused()) {
+            s_pausedNonces.inc();
+            continue;
+        }
+
+        int64_t start = platform_time_us();
+
         uint8_t asic_job_id = asic_result.job_id;
 
-        bm_job *job = asicJobs.getClone(asic_job_id);
+        int64_t storedUs;
+        bm_job *job = asicJobs.getClone(asic_job_id, 0, &storedUs);
         if (!job) {
-            ESP_LOGI(TAG, "Invalid job id found, 0x%02X", asic_job_id);
+            EVENT_LOGW(EventModule::ASIC, EventId::ASIC_INVALID_JOB, asic_job_id);
+            EVENT_TEXT(EventModule::ASIC, TAG, "Invalid job id found, 0x%02X", asic_job_id);
+            s_invalidJobIds.inc();
             continue;
         }
 
-        // now we have the original job and can `or` the version
+        // check the nonce difficulty, with the original job we can `or` the version
+        double nonce_diff = test_nonce_value(job, asic_result.nonce, asic_result.rolled_version | job->version);
+
+        // a late nonce of the job the slot held before
+        if (!belongsToJob(nonce_diff, job)) {
+            bm_job *older = NULL;
+            int64_t olderStoredUs = 0;
+            double older_diff = 0.0;
+            for (int age = 1; age < asicJobs.getNumGenerations(); age++) {
+                older = asicJobs.getClone(asic_job_id, age, &olderStoredUs);
+                if (!older) {
+                    break;
+                }
+                older_diff = test_nonce_value(older, asic_result.nonce, asic_result.rolled_version | older->version);
+                if (belongsToJob(older_diff, older)) {
+                    break;
+                }
+                free_bm_job(older);
+                older = NULL;
+            }
+
+            if (older) {
+                s_crossGeneration.inc();
+                free_bm_job(job);
+                job = older;
+                nonce_diff = older_diff;
+                storedUs = olderStoredUs;
+            } else {
+                s_lowDiffResults.inc();
+            }
+        }
+
+        if (belongsToJob(nonce_diff, job)) {
+            asicJobs.recordResultAge(storedUs, start);
+        }
+
         asic_result.rolled_version |= job->version;
 
-        // check the nonce difficulty
-        double nonce_diff = test_nonce_value(job, asic_result.nonce, asic_result.rolled_version);
+        EVENT_LOGI(EventModule::ASIC, EventId::ASIC_NONCE, asic_job_id, asic_result.asic_nr, asic_result.rolled_version,
+                   asic_result.nonce, nonce_diff, job->pool_diff);
 
-        // get best known session diff
-        char bestDiffString[16];
-        System::suffixString(SYSTEM_MODULE.getBestSessionNonceDiff(), bestDiffString, sizeof(bestDiffString), 3);
+        // the formatted line is only built when the text log of the module is on
+        if (EVENT_TEXT_ENABLED(EventModule::ASIC)) {
+            // get best known session diff
+            char bestDiffString[16];
+            System::suffixString(SYSTEM_MODULE.getBestSessionNonceDiff(), bestDiffString, sizeof(bestDiffString), 3);
 
-        // log the ASIC response, including pool and best session difficulty using human-readable SI formatting
-        ESP_LOGI(TAG, "Job ID: %02X AsicNr: %d Ver: %08" PRIX32 " Nonce %08" PRIX32 "; Extranonce2 %s diff %.1f/%lu/%s",
-            asic_job_id, asic_result.asic_nr, asic_result.rolled_version, asic_result.nonce, job->extranonce2,
-            nonce_diff, job->pool_diff, bestDiffString);
+            // log the ASIC response, including pool and best session difficulty using human-readable SI formatting
+            ESP_LOGI(TAG, "Job ID: %02X AsicNr: %d Ver: %08" PRIX32 " Nonce %08" PRIX32 "; Extranonce2 %s diff %.1f/%lu/%s",
+                asic_job_id, asic_result.asic_nr, asic_result.rolled_version, asic_result.nonce, job->extranonce2,
+                nonce_diff, job->pool_diff, bestDiffString);
+        }
 
         if (nonce_diff > job->pool_diff) {
+            s_poolShares.inc();
             STRATUM_MANAGER.submitShare(job->jobid, job->extranonce2, job->ntime, asic_result.nonce,
                                     asic_result.rolled_version ^ job->version);
+            s_submitTime.observe((float) (platform_time_us() - start));
         }
 
         if (nonce_diff > job->asic_diff) {
+            s_asicShares.inc();
             SYSTEM_MODULE.notifyFoundNonce((double) job->asic_diff, asic_result.asic_nr);
+            influx_task_push_share(asic_result.asic_nr, nonce_diff, job->asic_diff, job->pool_diff);
         }
 
         SYSTEM_MODULE.checkForBestDiff(nonce_diff, job->target);
 
         free_bm_job(job);
+
+        int64_t duration = platform_time_us() - start;
+        s_processTime.observe((float) duration);
+        s_loop.record(duration);
     }
 }
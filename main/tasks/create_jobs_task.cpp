@@ -1,20 +1,46 @@
 #include <limits.h>
+#include <math.h>
 #include <pthread.h>
 #include <string.h>
 #include <sys/time.h>
 
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_timer.h"
 #include "mining.h"
+#include "platform.h"
 
 #include "global_state.h"
 
 #include "boards/board.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "system.h"
 
 static const char *TAG = "create_jobs_task";
 
+static const float JOB_INTERVAL_BUCKETS[8] = {100, 250, 500, 750, 1000, 1500, 2000, 5000};
+
+static Counter s_jobsCreated("jobs_created", "Jobs sent to the ASICs");
+static Counter s_difficultyMaskChanges("jobs_asic_difficulty_changes", "ASIC difficulty mask updates");
+static HistogramN<10> s_jobBuildTime("jobs_build_us", "Time to build a job (coinbase, merkle root, midstates)",
+                                     METRICS_LATENCY_US_BUCKETS);
+static HistogramN<10> s_jobSendTime("jobs_send_us", "Time to send a job to the ASICs", METRICS_LATENCY_US_BUCKETS);
+static HistogramN<8> s_jobInterval("jobs_interval_ms", "Time between two jobs", JOB_INTERVAL_BUCKETS);
+static TaskLoop s_loop("create_jobs");
+
+// shortest timer period, below it the UART would be busy with jobs
+#define JOB_INTERVAL_MIN_MS 20
+
+static int s_versionBits = 0;
+static int s_jobCapacityMs = 0;
+
+static Gauge s_versionBitsGauge("jobs_version_rolling_bits", "Version bits the ASICs roll per job", []() {
+    return (float) s_versionBits;
+});
+static Gauge s_jobCapacityGauge("jobs_capacity_ms", "Time until the chain has hashed through the space of a job", []() {
+    return (float) s_jobCapacityMs;
+});
+
 pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
 
@@ -32,7 +58,7 @@ static uint32_t version_mask = 0;
 #define min(a, b) ((a < b) ? (a) : (b))
 #define max(a, b) ((a > b) ? (a) : (b))
 
-static void create_job_timer(TimerHandle_t xTimer)
+static void create_job_timer(void *arg)
 {
     pthread_mutex_lock(&job_mutex);
     pthread_cond_signal(&job_cond);
@@ -107,6 +133,31 @@ void create_job_mining_notify(mining_notify *notifiy)
     trigger_job_creation();
 }
 
+// time until the chain has hashed through the nonce and rolled version space
+// of one job, the chips split it by their address
+static int job_capacity_ms(Board *board, Asic *asics, int versionBits)
+{
+    double hashrate = (double) board->getAsicFrequency() * 1e6 * asics->getSmallCoreCount() * board->getAsicCount();
+    if (hashrate <= 0.0) {
+        return INT_MAX;
+    }
+    double ms = ldexp(1.0, 32 + versionBits) / hashrate * 1000.0;
+    return (ms > INT_MAX) ? INT_MAX : (int) ms;
+}
+
+// the timer is shortened to the job capacity so the chips don't idle, but
+// not below the interval at which the few job ids come around while the
+// chips still send nonces for them. Without rolled version bits, or before
+// the nonce ages are known, the configured interval is kept.
+static int job_timer_period_ms(int configuredMs, int capacityMs, int versionBits)
+{
+    int minSafeMs = asicJobs.getMinSafeIntervalMs();
+    if (!versionBits || !minSafeMs) {
+        return configuredMs;
+    }
+    return min(configuredMs, max(capacityMs, max(minSafeMs, JOB_INTERVAL_MIN_MS)));
+}
+
 void *create_jobs_task(void *pvParameters)
 {
     Board *board = SYSTEM_MODULE.getBoard();
@@ -117,7 +168,7 @@ void *create_jobs_task(void *pvParameters)
     ESP_LOGI(TAG, "ASIC Ready!");
 
     // Create the timer
-    TimerHandle_t job_timer = xTimerCreate(TAG, pdMS_TO_TICKS(board->getAsicJobIntervalMs()), pdTRUE, NULL, create_job_timer);
+    platform_timer_t job_timer = platform_timer_create(TAG, board->getAsicJobIntervalMs(), create_job_timer, NULL);
 
     if (job_timer == NULL) {
         ESP_LOGE(TAG, "Failed to create timer");
@@ -125,7 +176,7 @@ void *create_jobs_task(void *pvParameters)
     }
 
     // Start the timer
-    if (xTimerStart(job_timer, 0) != pdPASS) {
+    if (!platform_timer_start(job_timer)) {
         ESP_LOGE(TAG, "Failed to start timer");
         return NULL;
     }
@@ -134,11 +185,15 @@ void *create_jobs_task(void *pvParameters)
     memset(&current_job, 0, sizeof(mining_notify));
 
     uint32_t last_asic_diff = 0;
+    uint32_t last_version_mask = 0;
+    bool version_mask_set = false;
     uint32_t last_ntime = 0;
     uint64_t last_submit_time = 0;
     uint32_t extranonce_2 = 0;
 
     int lastJobInterval = board->getAsicJobIntervalMs();
+    int timerPeriod = lastJobInterval;
+    bool warnedJobInterval = false;
 
     while (1) {
         pthread_mutex_lock(&job_mutex);
@@ -147,18 +202,32 @@ void *create_jobs_task(void *pvParameters)
 
         // job interval changed via UI
         if (board->getAsicJobIntervalMs() != lastJobInterval) {
-            xTimerChangePeriod(job_timer, pdMS_TO_TICKS(board->getAsicJobIntervalMs()), 0);
             lastJobInterval = board->getAsicJobIntervalMs();
+            int capacity = s_jobCapacityMs ? s_jobCapacityMs : INT_MAX;
+            timerPeriod = job_timer_period_ms(lastJobInterval, capacity, s_versionBits);
+            platform_timer_set_period(job_timer, timerPeriod);
+            warnedJobInterval = false;
             continue;
         }
 
+        // the job ids come around before the chips are done with them
+        int minSafeInterval = asicJobs.getMinSafeIntervalMs();
+        if (!warnedJobInterval && timerPeriod < minSafeInterval) {
+            ESP_LOGW(TAG, "job interval %d ms is below the recommended %d ms, late nonces are matched by older jobs",
+                     timerPeriod, minSafeInterval);
+            warnedJobInterval = true;
+        }
+
         pthread_mutex_lock(&current_stratum_job_mutex);
 
-        if (!current_job.ntime || !asics) {
+        // a paused miner keeps the pool connection but sends no work
+        if (!current_job.ntime || !asics || SYSTEM_MODULE.isMiningPaused()) {
             pthread_mutex_unlock(&current_stratum_job_mutex);
             continue;
         }
 
+        int64_t build_start = platform_time_us();
+
         if (last_ntime != current_job.ntime) {
             last_ntime = current_job.ntime;
             ESP_LOGI(TAG, "New Work Received %s", current_job.job_id);
@@ -192,21 +261,47 @@ void *create_jobs_task(void *pvParameters)
 
         pthread_mutex_unlock(&current_stratum_job_mutex);
 
+        s_jobBuildTime.observe((float) (platform_time_us() - build_start));
+
         if (next_job->asic_diff != last_asic_diff) {
             ESP_LOGI(TAG, "New ASIC difficulty %lu", next_job->asic_diff);
             last_asic_diff = next_job->asic_diff;
+            s_difficultyMaskChanges.inc();
 
             asics->setJobDifficultyMask(next_job->asic_diff);
         }
 
-        uint64_t current_time = esp_timer_get_time();
+        // the chips must only roll the bits the pool allows
+        if (!version_mask_set || next_job->version_mask != last_version_mask) {
+            last_version_mask = next_job->version_mask;
+            version_mask_set = true;
+            asics->setVersionMask(next_job->version_mask);
+            s_versionBits = __builtin_popcount(next_job->version_mask & ASIC_VERSION_ROLLING_BITS);
+        }
+
+        // with few rolled bits a job is done before the next one comes
+        s_jobCapacityMs = job_capacity_ms(board, asics, s_versionBits);
+        int period = job_timer_period_ms(lastJobInterval, s_jobCapacityMs, s_versionBits);
+        if (period != timerPeriod) {
+            ESP_LOGI(TAG, "job timer %d ms (%d version bits, a job lasts %d ms)", period, s_versionBits, s_jobCapacityMs);
+            timerPeriod = period;
+            platform_timer_set_period(job_timer, timerPeriod);
+        }
+
+        uint64_t current_time = platform_time_us();
         if (last_submit_time) {
             ESP_LOGD(TAG, "job interval %dms", (int) ((current_time - last_submit_time) / 1e3));
+            s_jobInterval.observe((float) (current_time - last_submit_time) / 1000.0f);
         }
         last_submit_time = current_time;
 
         int asic_job_id = asics->sendWork(extranonce_2, next_job);
 
+        int64_t done = platform_time_us();
+        s_jobSendTime.observe((float) (done - current_time));
+        s_loop.record(done - build_start);
+        s_jobsCreated.inc();
+
         ESP_LOGD(TAG, "Sent Job: %02X", asic_job_id);
 
         // save job
@@ -0,0 +1,473 @@
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_delta_ota.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+
+#include "fleet_ota_task.h"
+#include "global_state.h"
+#include "metrics.h"
+#include "nvs_config.h"
+#include "platform.h"
+
+static const char *TAG = "fleet_ota";
+
+static Counter s_checksOk("fleet_ota_checks", "Manifest checks of the update mirror", "result=\"ok\"");
+static Counter s_checksFailed("fleet_ota_checks", "Manifest checks of the update mirror", "result=\"error\"");
+static Counter s_updatesOk("fleet_ota_updates", "Images pulled from the update mirror", "result=\"ok\"");
+static Counter s_updatesFailed("fleet_ota_updates", "Images pulled from the update mirror", "result=\"error\"");
+
+FleetOta FLEET_OTA;
+
+// base of the delta being applied, esp_delta_ota reads it without a context
+static const esp_partition_t *s_deltaBase = nullptr;
+
+// sha256 of an app partition like the bootloader computes it
+static bool partitionSha(const esp_partition_t *partition, char *hex)
+{
+    uint8_t sha[32];
+    if (!partition || esp_partition_get_sha256(partition, sha) != ESP_OK) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        snprintf(&hex[i * 2], 3, "%02x", sha[i]);
+    }
+    return true;
+}
+
+// keeps the start of the Content-Range of a response, SIZE_MAX if there is
+// none or it can't be parsed
+static esp_err_t httpEvent(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && !strcasecmp(evt->header_key, "Content-Range")) {
+        size_t *rangeStart = (size_t *) evt->user_data;
+        if (!fleet_ota_parse_content_range(evt->header_value, rangeStart)) {
+            *rangeStart = SIZE_MAX;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t deltaRead(uint8_t *buf, size_t size, int offset)
+{
+    return esp_partition_read(s_deltaBase, offset, buf, size);
+}
+
+static esp_err_t deltaWrite(const uint8_t *buf, size_t size, void *userData)
+{
+    return ((OtaWriter *) userData)->write(buf, size);
+}
+
+void FleetOta::taskWrapper(void *pvParameters)
+{
+    FleetOta *fleetOta = (FleetOta *) pvParameters;
+    fleetOta->task();
+}
+
+void FleetOta::setState(const char *state, const char *error)
+{
+    pthread_mutex_lock(&m_lock);
+    m_state = state;
+    if (error) {
+        strlcpy(m_lastError, error, sizeof(m_lastError));
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+// sha256 of the image that was pulled last if it is the one that runs, ""
+// if the firmware was never pulled or was updated some other way since
+void FleetOta::getFirmwareSha(char *sha, size_t len)
+{
+    sha[0] = '\0';
+    if (!*m_runningPartSha) {
+        return;
+    }
+    Config::StringRef partSha = Config::refOtaFwPartSha();
+    if (strcasecmp(partSha.c_str(), m_runningPartSha)) {
+        return;
+    }
+    Config::StringRef fwSha = Config::refOtaFwSha();
+    strlcpy(sha, fwSha.c_str(), len);
+}
+
+// remembers the pulled image together with the partition it went to
+void FleetOta::firmwarePulled(const fleet_ota_image_t *image)
+{
+    char partSha[FLEET_OTA_SHA256_HEX];
+    if (!partitionSha(esp_ota_get_boot_partition(), partSha)) {
+        ESP_LOGW(TAG, "can't hash the new app partition");
+        return;
+    }
+    Config::beginBatch();
+    Config::setOtaFwSha(image->sha256);
+    Config::setOtaFwPartSha(partSha);
+    Config::commitBatch();
+}
+
+bool FleetOta::fetchManifest(const char *mirrorUrl, const char *firmwareSha, fleet_ota_manifest_t *manifest)
+{
+    char url[FLEET_OTA_URL_MAX];
+    snprintf(url, sizeof(url), "%s%smanifest.json", mirrorUrl, mirrorUrl[strlen(mirrorUrl) - 1] == '/' ? "" : "/");
+
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.timeout_ms = 10000;
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return false;
+    }
+
+    char *buf = (char *) platform_malloc(FLEET_OTA_MANIFEST_MAX);
+    int len = 0;
+    bool ok = false;
+    if (buf && esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0 &&
+        esp_http_client_get_status_code(client) == 200) {
+        int n;
+        while (len < FLEET_OTA_MANIFEST_MAX && (n = esp_http_client_read(client, buf + len, FLEET_OTA_MANIFEST_MAX - len)) > 0) {
+            len += n;
+        }
+        ok = fleet_ota_parse_manifest(buf, len, mirrorUrl, SYSTEM_MODULE.getBoard()->getDeviceModel(), firmwareSha, manifest);
+    }
+    if (!ok) {
+        ESP_LOGW(TAG, "no valid manifest at %s", url);
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    platform_free(buf);
+    return ok;
+}
+
+// streams the image into the writer, a broken connection is continued with
+// a Range request
+bool FleetOta::download(const fleet_ota_image_t *image, OtaTarget target)
+{
+    esp_err_t err = m_writer.begin(target, image->size, image->sha256);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "can't start the %s update: %s", OtaWriter::targetName(target), esp_err_to_name(err));
+        return false;
+    }
+
+    uint8_t *buf = (uint8_t *) platform_malloc(OTA_CHUNK_SIZE);
+    if (!buf) {
+        m_writer.abort();
+        return false;
+    }
+
+    for (int attempt = 0; attempt < FLEET_OTA_DOWNLOAD_ATTEMPTS && m_writer.getOffset() < image->size; attempt++) {
+        if (attempt) {
+            vTaskDelay(pdMS_TO_TICKS(FLEET_OTA_RETRY_DELAY_MS * attempt));
+        }
+
+        size_t rangeStart = SIZE_MAX;
+
+        esp_http_client_config_t config = {};
+        config.url = image->url;
+        config.timeout_ms = 10000;
+        config.event_handler = httpEvent;
+        config.user_data = &rangeStart;
+
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+        if (!client) {
+            continue;
+        }
+
+        size_t offset = m_writer.getOffset();
+        if (offset) {
+            char range[32];
+            snprintf(range, sizeof(range), "bytes=%u-", (unsigned) offset);
+            esp_http_client_set_header(client, "Range", range);
+        }
+
+        if (esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+            int status = esp_http_client_get_status_code(client);
+            if (offset && status == 200) {
+                ESP_LOGW(TAG, "mirror doesn't support ranges, starting over");
+                m_writer.begin(target, image->size, image->sha256);
+                offset = 0;
+            }
+            if (status == 206 && rangeStart != offset) {
+                // the next attempt gets the whole image
+                ESP_LOGW(TAG, "mirror sent a range other than bytes=%u-, starting over", (unsigned) offset);
+                m_writer.begin(target, image->size, image->sha256);
+            } else if (status == 200 || (offset && status == 206)) {
+                int len;
+                while ((len = esp_http_client_read(client, (char *) buf, OTA_CHUNK_SIZE)) > 0) {
+                    if (m_writer.write(buf, len) != ESP_OK) {
+                        break;
+                    }
+                    // the miner keeps going, this task has a low priority anyway
+                    vTaskDelay(1);
+                }
+            } else {
+                ESP_LOGW(TAG, "%s: HTTP %d", image->url, status);
+            }
+        }
+
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+
+        // flash error
+        if (!m_writer.isActive()) {
+            break;
+        }
+    }
+
+    platform_free(buf);
+
+    if (!m_writer.isActive()) {
+        return false;
+    }
+    if (m_writer.getOffset() != image->size) {
+        m_writer.abort();
+        return false;
+    }
+    return m_writer.finish() == ESP_OK;
+}
+
+// a patch can't be continued where the connection broke, it is fetched once
+// and the caller falls back to the full image
+bool FleetOta::downloadDelta(const fleet_ota_image_t *delta, const fleet_ota_image_t *image)
+{
+    // the result is checked against the full image
+    esp_err_t err = m_writer.begin(OtaTarget::FIRMWARE, image->size, image->sha256);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "can't start the firmware update: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    s_deltaBase = esp_ota_get_running_partition();
+
+    esp_delta_ota_cfg_t deltaConfig = {};
+    deltaConfig.user_data = &m_writer;
+    deltaConfig.read_cb = deltaRead;
+    deltaConfig.write_cb = deltaWrite;
+    esp_delta_ota_handle_t handle = esp_delta_ota_init(&deltaConfig);
+
+    esp_http_client_config_t config = {};
+    config.url = delta->url;
+    config.timeout_ms = 10000;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+
+    uint8_t *buf = (uint8_t *) platform_malloc(OTA_CHUNK_SIZE);
+    bool ok = false;
+    if (handle && client && buf && esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+        int status = esp_http_client_get_status_code(client);
+        if (status == 200) {
+            size_t received = 0;
+            int len;
+            ok = true;
+            while ((len = esp_http_client_read(client, (char *) buf, OTA_CHUNK_SIZE)) > 0) {
+                received += len;
+                if (esp_delta_ota_feed_patch(handle, buf, len) != ESP_OK) {
+                    ok = false;
+                    break;
+                }
+                vTaskDelay(1);
+            }
+            ok = ok && received == delta->size && esp_delta_ota_finalize(handle) == ESP_OK;
+        } else {
+            ESP_LOGW(TAG, "%s: HTTP %d", delta->url, status);
+        }
+    }
+
+    if (client) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+    if (handle) {
+        esp_delta_ota_deinit(handle);
+    }
+    platform_free(buf);
+
+    if (!ok || m_writer.getOffset() != image->size) {
+        m_writer.abort();
+        return false;
+    }
+    return m_writer.finish() == ESP_OK;
+}
+
+void FleetOta::check(bool force)
+{
+    char *mirrorUrl = Config::getOtaMirrorURL();
+    if (!mirrorUrl || !*mirrorUrl) {
+        free(mirrorUrl);
+        setState("disabled");
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    int64_t intervalUs = (int64_t) Config::getOtaPullInterval() * 60ll * 1000000ll;
+    bool pendingDue = m_pendingUpdates && now >= m_pendingSinceUs + (int64_t) m_delayS * 1000000ll;
+    if (!force && m_lastCheckUs && now - m_lastCheckUs < intervalUs && !pendingDue) {
+        free(mirrorUrl);
+        return;
+    }
+    m_lastCheckUs = now;
+
+    char firmwareSha[FLEET_OTA_SHA256_HEX];
+    getFirmwareSha(firmwareSha, sizeof(firmwareSha));
+
+    fleet_ota_manifest_t manifest;
+    bool ok = fetchManifest(mirrorUrl, firmwareSha, &manifest);
+    free(mirrorUrl);
+    if (!ok) {
+        s_checksFailed.inc();
+        setState("error", "no valid manifest");
+        return;
+    }
+    s_checksOk.inc();
+
+    pthread_mutex_lock(&m_lock);
+    strlcpy(m_mirrorVersion, manifest.version, sizeof(m_mirrorVersion));
+    pthread_mutex_unlock(&m_lock);
+
+    const char *runningVersion = esp_app_get_description()->version;
+    char wwwSha[65];
+    {
+        Config::StringRef ref = Config::refOtaWwwSha();
+        strlcpy(wwwSha, ref.c_str(), sizeof(wwwSha));
+    }
+
+    int updates = fleet_ota_plan(&manifest, runningVersion, firmwareSha, wwwSha);
+    bool inRollout = force || fleet_ota_in_rollout(m_slot, manifest.rolloutPercent);
+    if (!updates || !inRollout) {
+        // the www image of the running release is the one on the mirror
+        if (!*wwwSha && manifest.www.present && !strcmp(manifest.version, runningVersion)) {
+            Config::setOtaWwwSha(manifest.www.sha256);
+        }
+        pthread_mutex_lock(&m_lock);
+        m_pendingVersion[0] = 0;
+        m_pendingUpdates = 0;
+        pthread_mutex_unlock(&m_lock);
+        setState(updates ? "not in rollout" : "up to date");
+        return;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    if (strcmp(m_pendingVersion, manifest.version) || m_pendingUpdates != updates) {
+        strlcpy(m_pendingVersion, manifest.version, sizeof(m_pendingVersion));
+        m_pendingUpdates = updates;
+        m_pendingSinceUs = now;
+        m_delayS = fleet_ota_stagger_delay_s(m_slot, manifest.staggerMinutes);
+        ESP_LOGI(TAG, "%s available (%s%s), starting in %d s", manifest.version, (updates & FLEET_OTA_WWW) ? "www " : "",
+                 (updates & FLEET_OTA_FIRMWARE) ? "firmware" : "", m_delayS);
+    }
+    bool waiting = !force && now < m_pendingSinceUs + (int64_t) m_delayS * 1000000ll;
+    pthread_mutex_unlock(&m_lock);
+
+    if (waiting) {
+        setState("waiting");
+        return;
+    }
+
+    if (updates & FLEET_OTA_WWW) {
+        setState("downloading www");
+        if (!download(&manifest.www, OtaTarget::WWW)) {
+            s_updatesFailed.inc();
+            setState("error", "www download failed");
+            return;
+        }
+        s_updatesOk.inc();
+        Config::setOtaWwwSha(manifest.www.sha256);
+    }
+
+    if (updates & FLEET_OTA_FIRMWARE) {
+        bool pulled = false;
+        if (manifest.delta.present) {
+            setState("downloading firmware delta");
+            pulled = downloadDelta(&manifest.delta, &manifest.firmware);
+            if (!pulled) {
+                ESP_LOGW(TAG, "delta update failed, pulling the full image");
+            }
+        }
+        if (!pulled) {
+            setState("downloading firmware");
+            pulled = download(&manifest.firmware, OtaTarget::FIRMWARE);
+        }
+        if (!pulled) {
+            s_updatesFailed.inc();
+            setState("error", "firmware download failed");
+            return;
+        }
+        s_updatesOk.inc();
+        firmwarePulled(&manifest.firmware);
+        setState("restarting");
+        ESP_LOGI(TAG, "Restarting System because of Firmware update %s", manifest.version);
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        POWER_MANAGEMENT_MODULE.restart();
+    }
+
+    pthread_mutex_lock(&m_lock);
+    m_pendingVersion[0] = 0;
+    m_pendingUpdates = 0;
+    pthread_mutex_unlock(&m_lock);
+    setState("up to date");
+}
+
+void FleetOta::checkNow()
+{
+    pthread_mutex_lock(&m_lock);
+    m_force = true;
+    pthread_mutex_unlock(&m_lock);
+
+    if (m_handle) {
+        xTaskNotifyGive(m_handle);
+    }
+}
+
+void FleetOta::init()
+{
+    uint8_t mac[6];
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    m_slot = fleet_ota_device_slot(mac);
+
+    // reads the whole app once, it doesn't change until the next boot
+    if (!partitionSha(esp_ota_get_running_partition(), m_runningPartSha)) {
+        ESP_LOGW(TAG, "can't hash the running app partition");
+    }
+}
+
+void FleetOta::task()
+{
+    m_handle = xTaskGetCurrentTaskHandle();
+    init();
+
+    while (1) {
+        pthread_mutex_lock(&m_lock);
+        bool force = m_force;
+        m_force = false;
+        pthread_mutex_unlock(&m_lock);
+
+        check(force);
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FLEET_OTA_TICK_MS));
+    }
+}
+
+void FleetOta::toJson(JsonObject obj)
+{
+    int64_t now = esp_timer_get_time();
+
+    pthread_mutex_lock(&m_lock);
+    obj["state"] = m_state;
+    obj["lastError"] = m_lastError;
+    obj["mirrorVersion"] = m_mirrorVersion;
+    obj["lastCheckAgoS"] = m_lastCheckUs ? (now - m_lastCheckUs) / 1000000 : -1;
+    if (m_pendingUpdates) {
+        int64_t startsInUs = m_pendingSinceUs + (int64_t) m_delayS * 1000000ll - now;
+        obj["pendingVersion"] = m_pendingVersion;
+        obj["pendingWww"] = (m_pendingUpdates & FLEET_OTA_WWW) != 0;
+        obj["pendingFirmware"] = (m_pendingUpdates & FLEET_OTA_FIRMWARE) != 0;
+        obj["startsInS"] = startsInUs > 0 ? startsInUs / 1000000 : 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    m_writer.toJson(obj["download"].to<JsonObject>());
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "fleet_ota_manifest.h"
+#include "ota_writer.h"
+
+// the task looks at the schedule once a minute
+#define FLEET_OTA_TICK_MS (60 * 1000)
+
+// downloads are continued with a Range request this often
+#define FLEET_OTA_DOWNLOAD_ATTEMPTS 5
+
+// wait before the next attempt, times the attempts so far
+#ifndef FLEET_OTA_RETRY_DELAY_MS
+#define FLEET_OTA_RETRY_DELAY_MS 2000
+#endif
+
+#define FLEET_OTA_MANIFEST_MAX (8 * 1024)
+
+// Pulls updates from a local mirror. The manifest is checked every
+// otaPullInterval minutes. A new version is applied after a delay that
+// depends on the MAC, so a fleet on the same mirror doesn't update at once,
+// and only by the rolloutPercent share of the devices. Images are streamed
+// through the OtaWriter while the miner keeps mining, www first, then the
+// firmware followed by a restart. The firmware comes as a delta to the
+// running image if the mirror has one, the full image is the fallback.
+class FleetOta {
+  protected:
+    TaskHandle_t m_handle = NULL;
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    OtaWriter m_writer;
+    uint32_t m_slot = 0;
+    bool m_force = false;
+
+    // sha256 of the running app partition, to tell if the last pulled
+    // firmware is the one that runs
+    char m_runningPartSha[FLEET_OTA_SHA256_HEX] = "";
+
+    // status
+    const char *m_state = "disabled";
+    char m_lastError[64] = "";
+    char m_mirrorVersion[FLEET_OTA_VERSION_MAX] = "";
+    char m_pendingVersion[FLEET_OTA_VERSION_MAX] = "";
+    int m_pendingUpdates = 0;
+    int64_t m_pendingSinceUs = 0;
+    int m_delayS = 0;
+    int64_t m_lastCheckUs = 0;
+
+    void init();
+    void setState(const char *state, const char *error = nullptr);
+    void getFirmwareSha(char *sha, size_t len);
+    bool fetchManifest(const char *mirrorUrl, const char *firmwareSha, fleet_ota_manifest_t *manifest);
+    bool download(const fleet_ota_image_t *image, OtaTarget target);
+    bool downloadDelta(const fleet_ota_image_t *delta, const fleet_ota_image_t *image);
+    void firmwarePulled(const fleet_ota_image_t *image);
+    void check(bool force);
+    void task();
+
+  public:
+    static void taskWrapper(void *pvParameters);
+
+    // checks the mirror now and applies an update without the stagger delay
+    void checkNow();
+
+    void toJson(JsonObject obj);
+};
+
+extern FleetOta FLEET_OTA;
@@ -1,8 +1,12 @@
 #include <pthread.h>
+#include <sys/time.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
+#include "freertos/timers.h"
 
 #include "global_state.h"
 #include "nvs_config.h"
@@ -11,7 +15,34 @@
 
 static const char *TAG = "influx_task";
 
+// flush earlier if this many bytes are waiting
+#define INFLUX_BATCH_BYTES 16384
+
+// retry delays when the server isn't reachable
+#define INFLUX_BACKOFF_MIN_MS 1000
+#define INFLUX_BACKOFF_MAX_MS 60000
+
+#define INFLUX_EVENT_QUEUE_SIZE 64
+
+typedef enum
+{
+    INFLUX_EVENT_SHARE,
+    INFLUX_EVENT_CHIP_TEMP,
+} influx_event_type_t;
+
+// points from other tasks, formatted in the influx task so the callers stay cheap
+typedef struct
+{
+    uint8_t type;
+    uint8_t asic_nr;
+    int64_t timestamp_ms;
+    double value;
+    uint32_t asic_diff;
+    uint32_t pool_diff;
+} influx_event_t;
+
 static Influx *influxdb = 0;
+static QueueHandle_t influx_events = 0;
 
 bool last_block_found = false;
 
@@ -51,6 +82,92 @@ void influx_task_set_pwr(float vin, float iin, float pin, float vout, float iout
     pthread_mutex_unlock(&influxdb->m_lock);
 }
 
+// unix time in ms, 0 if the clock wasn't synced yet
+static int64_t influx_timestamp_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    // anything before 2023 means we never got the time
+    if (tv.tv_sec < 1672531200) {
+        return 0;
+    }
+    return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+void influx_task_push_share(int asic_nr, double diff, uint32_t asic_diff, uint32_t pool_diff)
+{
+    if (!influx_events) {
+        return;
+    }
+    influx_event_t event = {
+        .type = INFLUX_EVENT_SHARE,
+        .asic_nr = (uint8_t) asic_nr,
+        .timestamp_ms = influx_timestamp_ms(),
+        .value = diff,
+        .asic_diff = asic_diff,
+        .pool_diff = pool_diff,
+    };
+    // never block the caller
+    xQueueSend(influx_events, &event, 0);
+}
+
+void influx_task_push_chip_temp(int asic_nr, float temp)
+{
+    if (!influx_events) {
+        return;
+    }
+    influx_event_t event = {
+        .type = INFLUX_EVENT_CHIP_TEMP,
+        .asic_nr = (uint8_t) asic_nr,
+        .timestamp_ms = influx_timestamp_ms(),
+        .value = temp,
+        .asic_diff = 0,
+        .pool_diff = 0,
+    };
+    xQueueSend(influx_events, &event, 0);
+}
+
+bool influx_task_get_writer_stats(WriterStats *stats)
+{
+    if (!influxdb) {
+        return false;
+    }
+    influxdb->getWriterStats(stats);
+    return true;
+}
+
+static void influx_task_handle_event(influx_event_t *event)
+{
+    switch (event->type) {
+    case INFLUX_EVENT_SHARE:
+        influxdb->enqueueShare(event->timestamp_ms, event->asic_nr, event->value, event->asic_diff, event->pool_diff);
+        break;
+    case INFLUX_EVENT_CHIP_TEMP:
+        influxdb->enqueueChipTemp(event->timestamp_ms, event->asic_nr, (float) event->value);
+        break;
+    default:
+        break;
+    }
+}
+
+// waits for the given time while moving queued points into the batch
+static void influx_task_wait(uint32_t ms)
+{
+    TickType_t end = xTaskGetTickCount() + pdMS_TO_TICKS(ms);
+    influx_event_t event;
+
+    while (1) {
+        TickType_t remaining = end - xTaskGetTickCount();
+        if ((int32_t) remaining <= 0) {
+            break;
+        }
+        if (xQueueReceive(influx_events, &event, remaining) == pdTRUE) {
+            influx_task_handle_event(&event);
+        }
+    }
+}
+
 static void influx_task_fetch_from_system_module(System *module)
 {
     // fetch best difficulty
@@ -121,7 +238,13 @@ void influx_task(void *pvParameters)
              influxPrefix);
 
     influxdb = new Influx();
-    influxdb->init(influxURL, influxPort, influxToken, influxBucket, influxOrg, influxPrefix);
+    if (!influxdb->init(influxURL, influxPort, influxToken, influxBucket, influxOrg, influxPrefix)) {
+        ESP_LOGE(TAG, "initializing InfluxDB failed");
+        forever();
+    }
+
+    // points generated while we connect are buffered and sent later
+    influx_events = xQueueCreate(INFLUX_EVENT_QUEUE_SIZE, sizeof(influx_event_t));
 
     bool ping_ok = false;
     bool bucket_ok = false;
@@ -154,7 +277,7 @@ void influx_task(void *pvParameters)
         if (loaded_values_ok) {
             break;
         }
-        vTaskDelay(pdMS_TO_TICKS(15000));
+        influx_task_wait(15000);
     }
 
     ESP_LOGI(TAG, "last values: total_uptime: %d, total_best_difficulty: %.3f, total_blocks_found: %d",
@@ -169,11 +292,47 @@ void influx_task(void *pvParameters)
         forever();
     }
 
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    int64_t next_sample = now_ms;
+    int64_t next_flush = now_ms + CONFIG_INFLUX_FLUSH_INTERVAL_MS;
+    uint32_t backoff_ms = 0;
+
     while (1) {
-        pthread_mutex_lock(&influxdb->m_lock);
-        influx_task_fetch_from_system_module(module);
-        influxdb->write();
-        pthread_mutex_unlock(&influxdb->m_lock);
-        vTaskDelay(pdMS_TO_TICKS(15000));
+        now_ms = esp_timer_get_time() / 1000;
+
+        if (now_ms >= next_sample) {
+            pthread_mutex_lock(&influxdb->m_lock);
+            influx_task_fetch_from_system_module(module);
+            influxdb->enqueueStats(influx_timestamp_ms());
+            pthread_mutex_unlock(&influxdb->m_lock);
+            next_sample += CONFIG_INFLUX_SAMPLE_INTERVAL_MS;
+            if (next_sample <= now_ms) {
+                next_sample = now_ms + CONFIG_INFLUX_SAMPLE_INTERVAL_MS;
+            }
+        }
+
+        // flush when the oldest point is due or a batch is full, but respect the backoff
+        bool batch_full = !backoff_ms && influxdb->pending() >= INFLUX_BATCH_BYTES;
+        if (now_ms >= next_flush || batch_full) {
+            if (influxdb->flush()) {
+                backoff_ms = 0;
+                // keep going without delay while backfilling
+                next_flush = (influxdb->pending() >= INFLUX_BATCH_BYTES) ? now_ms : now_ms + CONFIG_INFLUX_FLUSH_INTERVAL_MS;
+            } else {
+                backoff_ms = backoff_ms ? backoff_ms * 2 : INFLUX_BACKOFF_MIN_MS;
+                if (backoff_ms > INFLUX_BACKOFF_MAX_MS) {
+                    backoff_ms = INFLUX_BACKOFF_MAX_MS;
+                }
+                ESP_LOGW(TAG, "flush failed, %u bytes buffered, retry in %lu ms", (unsigned) influxdb->pending(),
+                         (unsigned long) backoff_ms);
+                next_flush = now_ms + backoff_ms;
+            }
+        }
+
+        now_ms = esp_timer_get_time() / 1000;
+        int64_t next = (next_sample < next_flush) ? next_sample : next_flush;
+        if (next > now_ms) {
+            influx_task_wait((uint32_t) (next - now_ms));
+        }
     }
 }
@@ -5,4 +5,10 @@
 void influx_task_set_temperature(float temp, float temp2);
 void influx_task_set_pwr(float vin, float iin, float pin, float vout, float iout, float pout);
 
+// high rate points, safe to call from any task (non blocking)
+void influx_task_push_share(int asic_nr, double diff, uint32_t asic_diff, uint32_t pool_diff);
+void influx_task_push_chip_temp(int asic_nr, float temp);
+
+bool influx_task_get_writer_stats(WriterStats *stats);
+
 void influx_task(void *pvParameters);
\ No newline at end of file
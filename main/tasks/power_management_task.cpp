@@ -14,11 +14,36 @@
 #include "nvs_config.h"
 #include "influx_task.h"
 #include "boards/board.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "vr_supervisor.h"
 
 #define POLL_RATE 2000
 
 static const char *TAG = "power_management";
 
+static Gauge s_power("power_input_watts", "Input power", []() { return POWER_MANAGEMENT_MODULE.getPower(); });
+static Gauge s_voltage("power_input_millivolts", "Input voltage", []() { return POWER_MANAGEMENT_MODULE.getVoltage(); });
+static Gauge s_current("power_input_milliamps", "Input current", []() { return POWER_MANAGEMENT_MODULE.getCurrent(); });
+static Gauge s_chipTemp("power_asic_temp_celsius", "Highest ASIC temperature", []() {
+    return POWER_MANAGEMENT_MODULE.getChipTempMax();
+});
+static Gauge s_vrTemp("power_vr_temp_celsius", "Voltage regulator temperature", []() {
+    return POWER_MANAGEMENT_MODULE.getVRTemp();
+});
+static Gauge s_fanRpm("power_fan_rpm", "Fan speed", []() { return (float) POWER_MANAGEMENT_MODULE.getFanRPM(); });
+static Gauge s_fanPerc("power_fan_percent", "Fan duty cycle", []() { return (float) POWER_MANAGEMENT_MODULE.getFanPerc(); });
+static Gauge s_capHeadroom("power_cap_headroom_watts", "Filtered input power left under the power cap", []() {
+    return POWER_MANAGEMENT_MODULE.getPowerCapHeadroom();
+});
+static Gauge s_capFrequency("power_cap_frequency_mhz", "ASIC frequency allowed by the power cap", []() {
+    return POWER_MANAGEMENT_MODULE.getPowerCapFrequency();
+});
+static Counter s_psuFaults("power_psu_faults", "PSU faults detected");
+static Counter s_overheats("power_overheats", "Overheat shutdowns");
+static HistogramN<10> s_loopTime("power_loop_ms", "Duration of one power management iteration", METRICS_LATENCY_MS_BUCKETS);
+static TaskLoop s_loop("power_management");
+
 PowerManagementTask::PowerManagementTask() {
     m_mutex = PTHREAD_MUTEX_INITIALIZER;
 }
@@ -64,6 +89,12 @@ void PowerManagementTask::checkCoreVoltageChanged() {
 
     Board* board = SYSTEM_MODULE.getBoard();
 
+    // the buck stays off after an overheat or a PSU fault, also when a
+    // mining profile changes the voltage
+    if (SYSTEM_MODULE.isPSUError() || SYSTEM_MODULE.isOverheated()) {
+        return;
+    }
+
     uint16_t core_voltage = board->getAsicVoltageMillis();
 
     if (core_voltage != last_core_voltage) {
@@ -109,10 +140,200 @@ void PowerManagementTask::checkPidSettingsChanged() {
     }
 }
 
+void PowerManagementTask::handlePSUFault(const char *cause)
+{
+    Board* board = SYSTEM_MODULE.getBoard();
+
+    // when this happens, there is some PSU error
+    // on the nerdqaxes the buck restarted and defaulted to 1.00V
+    // this can happen when the PSU can't deliver enough current
+    // we display the error message and switch the buck off
+    if (!SYSTEM_MODULE.isPSUError()) {
+        ALERT_ENGINE.post(AlertEvent::PSU_FAULT, "%s, buck switched off, input %.2f V / %.2f A", cause, m_voltage / 1000.0f,
+                          m_current / 1000.0f);
+    }
+    SYSTEM_MODULE.setPSUError(true);
+    board->setVoltage(0.0);
+    s_psuFaults.inc();
+}
+
+void PowerManagementTask::checkVRStatus(bool alert)
+{
+    Board* board = SYSTEM_MODULE.getBoard();
+
+    // the output is off, nothing to protect
+    if (!board->isInitialized() || SYSTEM_MODULE.isPSUError() || SYSTEM_MODULE.isOverheated()) {
+        return;
+    }
+
+    VRStatus status;
+    if (!board->readVRStatus(&status)) {
+        return;
+    }
+
+    if (!m_vrArmed) {
+        board->clearVRFaults();
+        m_vrArmed = true;
+        return;
+    }
+
+    // a single STATUS_WORD read when nothing is latched
+    if (!status.word && !alert) {
+        return;
+    }
+
+    // releases SMBALERT#, a condition that is still there latches again
+    if (status.word) {
+        board->clearVRFaults();
+    }
+
+    if (VR_SUPERVISOR.checkStatus(&status, alert, false)) {
+        handlePSUFault(alert ? "regulator fault (SMBALERT)" : "regulator fault");
+    }
+}
+
+void PowerManagementTask::readTelemetry(uint16_t asicOverheatTemp, float vrMaxTemp)
+{
+    Board* board = SYSTEM_MODULE.getBoard();
+
+    float vin = board->getVin();
+    float iin = board->getIin();
+    float pin = board->getPin();
+    float pout = board->getPout();
+    float vout = board->getVout();
+    float iout = board->getIout();
+
+    m_vrTemp = board->getVRTemp();
+
+    ESP_LOGI(TAG, "vin: %.2f, iin: %.2f, pin: %.2f, vout: %.2f, iout: %.2f, pout: %.2f, vr-temp: %.2f",
+        vin, iin, pin, vout, iout, pout, m_vrTemp);
+
+    influx_task_set_pwr(vin, iin, pin, vout, iout, pout);
+
+    m_voltage = vin * 1000.0;
+    m_current = iin * 1000.0;
+    m_power = pin;
+
+    // with a cap the power sits near it on purpose, the fast telemetry
+    // gives the controller its samples
+    float maxPin = board->getMaxPin();
+    uint16_t cap = m_powerCap;
+    if (cap && (!maxPin || cap < maxPin)) {
+        maxPin = cap;
+    }
+
+    VRSample sample = {esp_timer_get_time(), vin, iin, pin, vout, iout, m_vrTemp};
+    bool nearLimit = (maxPin > 0.0f && pin > maxPin * VR_NEAR_LIMIT) ||
+                     m_chipTempMax > asicOverheatTemp * VR_NEAR_LIMIT || m_vrTemp > vrMaxTemp * VR_NEAR_LIMIT;
+    VR_SUPERVISOR.addSample(&sample, nearLimit);
+
+    applyPowerCap(pin);
+}
+
+void PowerManagementTask::applyPowerCap(float pin)
+{
+    Board* board = SYSTEM_MODULE.getBoard();
+
+    uint16_t cap = m_powerCap;
+    bool outputOff = !board->isInitialized() || SYSTEM_MODULE.isPSUError() || SYSTEM_MODULE.isOverheated();
+
+    if (!cap || outputOff) {
+        if (m_powerCapActive) {
+            m_powerCapActive = false;
+            m_powerCapHeadroom = 0.0f;
+            m_powerCapFrequency = 0.0f;
+
+            // back to the configured settings, unless the buck has to stay off
+            if (!outputOff) {
+                ESP_LOGI(TAG, "power cap off, back to %dMHz / %dmV", board->getAsicFrequency(), board->getAsicVoltageMillis());
+                board->setVoltage((float) board->getAsicVoltageMillis() / 1000.0f);
+                board->setAsicFrequency((float) board->getAsicFrequency());
+            }
+        }
+        return;
+    }
+
+    PowerCapLimits limits;
+    limits.maxFrequency = (float) board->getAsicFrequency();
+    limits.minFrequency = limits.maxFrequency * POWER_CAP_MIN_FREQUENCY;
+    limits.maxVoltage = (uint16_t) board->getAsicVoltageMillis();
+    limits.minVoltage = limits.maxVoltage;
+    if (!board->getVoltageOptions().empty()) {
+        limits.minVoltage = std::min(limits.maxVoltage, (uint16_t) board->getVoltageOptions().front());
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (!m_powerCapActive) {
+        ESP_LOGI(TAG, "power cap on: %uW", cap);
+        m_powerCapCtl.reset(limits.maxFrequency, limits.maxVoltage);
+        m_powerCapActive = true;
+        m_powerCapLastUs = now;
+    } else if (limits.maxFrequency != m_powerCapLimits.maxFrequency || limits.maxVoltage != m_powerCapLimits.maxVoltage) {
+        // a mining profile changed the settings, checkAsicFrequencyChanged
+        // and checkCoreVoltageChanged apply them as they are
+        ESP_LOGI(TAG, "power cap: settings changed to %.0fMHz / %umV", limits.maxFrequency, limits.maxVoltage);
+        m_powerCapCtl.reset(limits.maxFrequency, limits.maxVoltage);
+    }
+    m_powerCapLimits = limits;
+
+    float dt = (float) (now - m_powerCapLastUs) / 1000000.0f;
+    m_powerCapLastUs = now;
+
+    uint16_t oldVoltage = m_powerCapCtl.getVoltage();
+    float oldFrequency = m_powerCapCtl.getFrequency();
+
+    if (m_powerCapCtl.update(pin, dt, (float) cap, &limits)) {
+        ESP_LOGI(TAG, "power cap %uW: %.1fW filtered, %.2fMHz, %umV", cap, m_powerCapCtl.getFilteredPower(),
+                 m_powerCapCtl.getFrequency(), m_powerCapCtl.getVoltage());
+
+        if (m_powerCapCtl.getVoltage() != oldVoltage) {
+            board->setVoltage((float) m_powerCapCtl.getVoltage() / 1000.0f);
+        }
+        // ramps in 6.25MHz steps
+        if (m_powerCapCtl.getFrequency() != oldFrequency && !board->setAsicFrequency(m_powerCapCtl.getFrequency())) {
+            ESP_LOGE(TAG, "power cap: setting %.2fMHz failed", m_powerCapCtl.getFrequency());
+        }
+    }
+
+    m_powerCapHeadroom = m_powerCapCtl.getHeadroom((float) cap);
+    m_powerCapFrequency = m_powerCapCtl.getFrequency();
+}
+
+void PowerManagementTask::loadConfig()
+{
+    int16_t fanMode = m_profileFanMode;
+    int16_t fanSpeed = m_profileFanSpeed;
+    int16_t powerCap = m_profilePowerCap;
+
+    m_overheatTemp = Config::getOverheatTemp();
+    m_tempControlMode = (fanMode >= 0) ? (uint16_t) fanMode : Config::getTempControlMode();
+    m_manualFanSpeed = (fanSpeed >= 0) ? (uint16_t) fanSpeed : Config::getFanSpeed();
+    m_powerCap = (powerCap >= 0) ? (uint16_t) powerCap : Config::getPowerCap();
+}
+
+void PowerManagementTask::setProfileSettings(int fanMode, int fanSpeed, int powerCap)
+{
+    m_profileFanMode = (int16_t) fanMode;
+    m_profileFanSpeed = (int16_t) fanSpeed;
+    m_profilePowerCap = (int16_t) powerCap;
+    loadConfig();
+}
+
+void PowerManagementTask::configChanged(const char *key, void *arg)
+{
+    if (!strcmp(key, NVS_CONFIG_OVERHEAT_TEMP) || !strcmp(key, NVS_CONFIG_AUTO_FAN_SPEED) || !strcmp(key, NVS_CONFIG_FAN_SPEED) ||
+        !strcmp(key, NVS_CONFIG_POWER_CAP)) {
+        static_cast<PowerManagementTask *>(arg)->loadConfig();
+    }
+}
+
 void PowerManagementTask::task()
 {
     Board* board = SYSTEM_MODULE.getBoard();
 
+    loadConfig();
+    Config::addListener(configChanged, this);
+
     // use manual invert polarity setting
     bool invert = board->isInvertFanPolarityEnabled();
 
@@ -153,13 +374,24 @@ void PowerManagementTask::task()
     m_pid->SetControllerDirection(REVERSE);
     m_pid->Initialize();
 
+    // SMBALERT# wakes this task, without it the status is polled
+    VR_SUPERVISOR.init(board->getVRAlertPin());
+
     vTaskDelay(pdMS_TO_TICKS(3000));
 
+    int64_t next_control = 0;
+    int64_t next_telemetry = 0;
+    uint32_t wait_ms = 0;
+
     while (1) {
+        bool alert = VR_SUPERVISOR.wait(wait_ms);
+
         lock();
 
-        uint16_t asic_overheat_temp = Config::getOverheatTemp();
-        uint16_t temp_control_mode = Config::getTempControlMode();
+        int64_t loop_start = esp_timer_get_time();
+
+        uint16_t asic_overheat_temp = m_overheatTemp;
+        uint16_t temp_control_mode = m_tempControlMode;
 
         // overwrite previously allowed 0 value to disable
         // over-temp shutdown
@@ -167,108 +399,125 @@ void PowerManagementTask::task()
             asic_overheat_temp = 70;
         }
 
-        // check if asic voltage changed
-        checkCoreVoltageChanged();
+        float vr_maxTemp = asic_overheat_temp;
+        if(board->getVrMaxTemp()) {
+            vr_maxTemp = board->getVrMaxTemp();
+        }
+
+        // regulator faults are handled on every wake up
+        if (alert || !VR_SUPERVISOR.hasAlertPin() || !m_vrArmed) {
+            checkVRStatus(alert);
+        }
 
-        // check if asic frequency changed
-        checkAsicFrequencyChanged();
+        bool telemetryRead = loop_start >= next_telemetry;
+        if (telemetryRead) {
+            readTelemetry(asic_overheat_temp, vr_maxTemp);
+            next_telemetry = loop_start + (int64_t) VR_SUPERVISOR.getIntervalMs() * 1000;
+        }
 
-        // check if pid settings changed
-        checkPidSettingsChanged();
+        if (loop_start >= next_control) {
+            next_control = loop_start + POLL_RATE * 1000;
 
-        // request chip temps
-        requestChipTemps();
+            // currently only implemented for boards with TPS536x7
+            // catches a buck that restarted without a latched status,
+            // runs here because the telemetry may be slowed down
+            if (!SYSTEM_MODULE.isPSUError() && board->getPSUFault()) {
+                VRStatus status = {};
+                VR_SUPERVISOR.checkStatus(&status, false, true);
+                handlePSUFault("PSU fault");
+            }
 
-        float vin = board->getVin();
-        float iin = board->getIin();
-        float pin = board->getPin();
-        float pout = board->getPout();
-        float vout = board->getVout();
-        float iout = board->getIout();
+            // check if asic voltage changed
+            checkCoreVoltageChanged();
 
-        m_vrTemp = board->getVRTemp();
+            // check if asic frequency changed
+            checkAsicFrequencyChanged();
 
-        ESP_LOGI(TAG, "vin: %.2f, iin: %.2f, pin: %.2f, vout: %.2f, iout: %.2f, pout: %.2f, vr-temp: %.2f",
-            vin, iin, pin, vout, iout, pout, m_vrTemp);
+            // check if pid settings changed
+            checkPidSettingsChanged();
 
-        influx_task_set_pwr(vin, iin, pin, vout, iout, pout);
+            // request chip temps
+            requestChipTemps();
 
-        // currently only implemented for boards with TPS536x7
-        bool psuError = board->getPSUFault();
-        if (psuError) {
-            // when this happens, there is some PSU error
-            // on the nerdqaxes the buck restarted and defaulted to 1.00V
-            // this can happen when the PSU can't deliver enough current
-            // we display the error message and switch the buck off
-            SYSTEM_MODULE.setPSUError(true);
-            board->setVoltage(0.0);
-        }
+            board->getFanSpeed(&m_fanRPM);
 
-        m_voltage = vin * 1000.0;
-        m_current = iin * 1000.0;
-        m_power = pin;
-        board->getFanSpeed(&m_fanRPM);
-
-        // collect temperatures
-        // get the max of all asic measuring temp sensors
-        float tmp1075Max = 0.0f;
-        for (int i=0; i < board->getNumTempSensors(); i++) {
-            float tmp = board->getTemperature(i);
-            if (tmp) {
-                ESP_LOGI(TAG, "Temperature %d: %.2f C", i, tmp);
+            // collect temperatures
+            // get the max of all asic measuring temp sensors
+            float tmp1075Max = 0.0f;
+            for (int i=0; i < board->getNumTempSensors(); i++) {
+                float tmp = board->getTemperature(i);
+                if (tmp) {
+                    ESP_LOGI(TAG, "Temperature %d: %.2f C", i, tmp);
+                }
+                tmp1075Max = std::max(tmp1075Max, tmp);
             }
-            tmp1075Max = std::max(tmp1075Max, tmp);
-        }
 
-        //Get the readed MaxChipTemp of all chained chips after
-        //calling requestChipTemp()
-        //IMPORTANT: this value only makes sense with BM1368 ASIC, with other Asics will remain at 0
-        float intChipTempMax = board->getMaxChipTemp();
+            //Get the readed MaxChipTemp of all chained chips after
+            //calling requestChipTemp()
+            //IMPORTANT: this value only makes sense with BM1368 ASIC, with other Asics will remain at 0
+            float intChipTempMax = board->getMaxChipTemp();
 
-        // Uses the worst case between board temp sensor or Asic temp read command
-        m_chipTempMax = std::max(tmp1075Max, intChipTempMax);
+            // Uses the worst case between board temp sensor or Asic temp read command
+            m_chipTempMax = std::max(tmp1075Max, intChipTempMax);
 
-        influx_task_set_temperature(m_chipTempMax, m_vrTemp);
+            // the telemetry may be slowed down to VR_POLL_SLOW_MS, the
+            // overheat check needs a fresh VR temperature every time
+            if (!telemetryRead) {
+                m_vrTemp = board->getVRTemp();
+            }
 
-        float vr_maxTemp = asic_overheat_temp;
-        if(board->getVrMaxTemp()) {
-            vr_maxTemp = board->getVrMaxTemp();
-        }
+            influx_task_set_temperature(m_chipTempMax, m_vrTemp);
+
+            if (asic_overheat_temp &&
+                (m_chipTempMax > asic_overheat_temp || m_vrTemp > vr_maxTemp)) {
+                // over temperature
+                if (!SYSTEM_MODULE.isOverheated()) {
+                    ALERT_ENGINE.post(AlertEvent::OVERHEAT, "ASIC %.1f °C, VR %.1f °C, ASIC voltage switched off", m_chipTempMax,
+                                      m_vrTemp);
+                }
+                SYSTEM_MODULE.setOverheated(true);
+                // disables the buck
+                board->setVoltage(0.0);
+                ESP_LOGE(TAG, "System overheated - Shutting down asic voltage");
+                s_overheats.inc();
+            }
 
-        if (asic_overheat_temp &&
-            (m_chipTempMax > asic_overheat_temp || m_vrTemp > vr_maxTemp)) {
-            // over temperature
-            SYSTEM_MODULE.setOverheated(true);
-            // disables the buck
-            board->setVoltage(0.0);
-            ESP_LOGE(TAG, "System overheated - Shutting down asic voltage");
+            // we let the PID always calculate for "bumpless transfer"
+            // when switching modes
+            pid_input = std::max(m_chipTempMax, m_vrTemp);
+            m_pid->Compute();
+
+            switch (temp_control_mode) {
+                case 0:
+                    // manual
+                    m_fanPerc = m_manualFanSpeed;
+                    board->setFanSpeed((float) m_fanPerc / 100.0f);
+                    break;
+                case 2:
+                    // pid
+                    m_fanPerc = (uint16_t) roundf(pid_output);
+                    board->setFanSpeed((float) m_fanPerc / 100.0f);
+                    //ESP_LOGI(TAG, "PID: Temp: %.1f°C, SetPoint: %.1f°C, Output: %.1f%%", pid_input, pid_target, pid_output);
+                    //ESP_LOGI(TAG, "p:%.2f i:%.2f d:%.2f", m_pid->GetKp(), m_pid->GetKi(), m_pid->GetKd());
+                    break;
+                default:
+                    ESP_LOGE(TAG, "invalid temp control mode: %d. Defaulting to manual mode 100%%.", temp_control_mode);
+                    m_fanPerc = 100;
+                    board->setFanSpeed((float) m_fanPerc / 100.0f);
+            }
         }
 
-        // we let the PID always calculate for "bumpless transfer"
-        // when switching modes
-        pid_input = std::max(m_chipTempMax, m_vrTemp);
-        m_pid->Compute();
-
-        switch (temp_control_mode) {
-            case 0:
-                // manual
-                m_fanPerc = Config::getFanSpeed();
-                board->setFanSpeed((float) m_fanPerc / 100.0f);
-                break;
-            case 2:
-                // pid
-                m_fanPerc = (uint16_t) roundf(pid_output);
-                board->setFanSpeed((float) m_fanPerc / 100.0f);
-                //ESP_LOGI(TAG, "PID: Temp: %.1f°C, SetPoint: %.1f°C, Output: %.1f%%", pid_input, pid_target, pid_output);
-                //ESP_LOGI(TAG, "p:%.2f i:%.2f d:%.2f", m_pid->GetKp(), m_pid->GetKi(), m_pid->GetKd());
-                break;
-            default:
-                ESP_LOGE(TAG, "invalid temp control mode: %d. Defaulting to manual mode 100%%.", temp_control_mode);
-                m_fanPerc = 100;
-                board->setFanSpeed((float) m_fanPerc / 100.0f);
-        }
+        int64_t now = esp_timer_get_time();
+        int64_t duration = now - loop_start;
+        s_loopTime.observe((float) duration / 1000.0f);
+        s_loop.record(duration);
         unlock();
 
-        vTaskDelay(pdMS_TO_TICKS(POLL_RATE));
+        // sleep until the next deadline, an alert ends it early
+        int64_t next = std::min(next_control, next_telemetry);
+        if (!VR_SUPERVISOR.hasAlertPin()) {
+            next = std::min(next, now + VR_STATUS_POLL_MS * 1000ll);
+        }
+        wait_ms = (uint32_t) (std::max(next - now, (int64_t) 0) / 1000);
     }
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <pthread.h>
 #include "boards/board.h"
 #include "pid/PID_v1_bc.h"
+#include "power_cap.h"
 
 template <class T>
 class LockGuard {
@@ -25,10 +27,40 @@ class PowerManagementTask {
     float m_current;
     PID *m_pid;
 
+    // the first status read after the buck came up only clears the bits
+    // latched while it was powered up
+    bool m_vrArmed = false;
+
+    // power cap, the controller runs on every telemetry sample
+    PowerCap m_powerCapCtl;
+    bool m_powerCapActive = false;
+    PowerCapLimits m_powerCapLimits = {};
+    int64_t m_powerCapLastUs = 0;
+    float m_powerCapHeadroom = 0.0f;
+    float m_powerCapFrequency = 0.0f;
+
+    // settings, updated when the config changes
+    std::atomic<uint16_t> m_overheatTemp{0};
+    std::atomic<uint16_t> m_tempControlMode{0};
+    std::atomic<uint16_t> m_manualFanSpeed{0};
+    std::atomic<uint16_t> m_powerCap{0};
+
+    // mining profile of the scheduler, -1 keeps the configured value
+    std::atomic<int16_t> m_profileFanMode{-1};
+    std::atomic<int16_t> m_profileFanSpeed{-1};
+    std::atomic<int16_t> m_profilePowerCap{-1};
+
+    void loadConfig();
+    static void configChanged(const char *key, void *arg);
+
     void requestChipTemps();
     void checkCoreVoltageChanged();
     void checkAsicFrequencyChanged();
     void checkPidSettingsChanged();
+    void checkVRStatus(bool alert);
+    void readTelemetry(uint16_t asicOverheatTemp, float vrMaxTemp);
+    void handlePSUFault(const char *cause);
+    void applyPowerCap(float pin);
     void task();
 
   public:
@@ -39,6 +71,10 @@ class PowerManagementTask {
 
     static void taskWrapper(void *pvParameters);
 
+    // fan mode, fan speed and power cap of a mining profile, -1 goes back
+    // to the configured value
+    void setProfileSettings(int fanMode, int fanSpeed, int powerCap);
+
     float getPower()
     {
         return m_power;
@@ -67,6 +103,25 @@ class PowerManagementTask {
     {
         return m_fanPerc;
     };
+    // in effect, a mining profile may override the configured one
+    uint16_t getPowerCap()
+    {
+        return m_powerCap;
+    };
+    bool isPowerCapActive()
+    {
+        return m_powerCapActive;
+    };
+    // watts under the cap of the filtered input power, 0 without a cap
+    float getPowerCapHeadroom()
+    {
+        return m_powerCapHeadroom;
+    };
+    // frequency the cap currently allows, 0 without a cap
+    float getPowerCapFrequency()
+    {
+        return m_powerCapFrequency;
+    };
 
     void lock() {
         pthread_mutex_lock(&m_mutex);
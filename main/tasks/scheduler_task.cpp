@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "global_state.h"
+#include "metrics.h"
+#include "nvs_config.h"
+#include "psram_allocator.h"
+#include "scheduler_task.h"
+
+static const char *TAG = "scheduler";
+
+static Counter s_switches("schedule_switches", "Mining profile changes");
+static Gauge s_profile("schedule_profile", "Index of the active mining profile, -1 for the configured settings");
+
+ProfileScheduler PROFILE_SCHEDULER;
+
+void ProfileScheduler::taskWrapper(void *pvParameters)
+{
+    ProfileScheduler *scheduler = (ProfileScheduler *) pvParameters;
+    scheduler->task();
+}
+
+void ProfileScheduler::configChanged(const char *key, void *arg)
+{
+    if (strcmp(key, NVS_CONFIG_SCHEDULE)) {
+        return;
+    }
+    ProfileScheduler *scheduler = static_cast<ProfileScheduler *>(arg);
+    pthread_mutex_lock(&scheduler->m_lock);
+    scheduler->m_reload = true;
+    pthread_mutex_unlock(&scheduler->m_lock);
+    xTaskNotifyGive(scheduler->m_task);
+}
+
+void ProfileScheduler::loadConfig()
+{
+    char *json = Config::getScheduleConfig();
+    char err[96];
+    if (!schedule_parse(json, strlen(json), &m_config, err, sizeof(err))) {
+        // was validated when it was stored
+        ESP_LOGE(TAG, "invalid schedule: %s", err);
+    }
+    free(json);
+
+    // the rules are in local time
+    setenv("TZ", m_config.timezone[0] ? m_config.timezone : "UTC0", 1);
+    tzset();
+
+    ESP_LOGI(TAG, "schedule %s, %d profiles, %d rules, TZ %s", m_config.enabled ? "enabled" : "disabled", m_config.numProfiles,
+             m_config.numRules, getenv("TZ"));
+}
+
+static void accountToJson(const ProfileAccount *account, JsonObject obj)
+{
+    obj["name"] = account->name;
+    obj["seconds"] = account->seconds;
+    obj["energyWh"] = account->energyWh;
+    obj["terahashes"] = account->terahashes;
+    obj["cost"] = account->cost;
+    obj["shares"] = account->shares;
+}
+
+void ProfileScheduler::loadAccounts()
+{
+    char *json = Config::getScheduleStats();
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    DeserializationError err = deserializeJson(doc, json);
+    free(json);
+
+    pthread_mutex_lock(&m_lock);
+    for (JsonObjectConst obj : err ? JsonArrayConst() : doc.as<JsonArrayConst>()) {
+        const char *name = obj["name"] | "";
+        ProfileAccount *account = *name ? getAccount(name) : nullptr;
+        if (!account) {
+            continue;
+        }
+        account->seconds = obj["seconds"] | 0.0;
+        account->energyWh = obj["energyWh"] | 0.0;
+        account->terahashes = obj["terahashes"] | 0.0;
+        account->cost = obj["cost"] | 0.0;
+        account->shares = obj["shares"] | (uint64_t) 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+void ProfileScheduler::saveAccounts()
+{
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    JsonArray arr = doc.to<JsonArray>();
+
+    pthread_mutex_lock(&m_lock);
+    for (int i = 0; i < m_numAccounts; i++) {
+        accountToJson(&m_accounts[i], arr.add<JsonObject>());
+    }
+    m_savedUs = esp_timer_get_time();
+    pthread_mutex_unlock(&m_lock);
+
+    size_t len = measureJson(doc) + 1;
+    char *json = (char *) malloc(len);
+    if (!json) {
+        return;
+    }
+    serializeJson(doc, json, len);
+    Config::setScheduleStats(json);
+    free(json);
+}
+
+// called with the lock held
+ProfileAccount *ProfileScheduler::getAccount(const char *name)
+{
+    for (int i = 0; i < m_numAccounts; i++) {
+        if (!strcmp(m_accounts[i].name, name)) {
+            return &m_accounts[i];
+        }
+    }
+    if (m_numAccounts == SCHEDULE_MAX_ACCOUNTS) {
+        return nullptr;
+    }
+    ProfileAccount *account = &m_accounts[m_numAccounts++];
+    memset(account, 0, sizeof(*account));
+    strlcpy(account->name, name, sizeof(account->name));
+    return account;
+}
+
+// books the time since the last call on the active profile, called with the
+// lock held
+void ProfileScheduler::account(int64_t now)
+{
+    uint64_t shares = SYSTEM_MODULE.getSharesAccepted();
+
+    if (m_accountUs) {
+        const schedule_profile_t *profile = (m_active >= 0) ? &m_config.profiles[m_active] : nullptr;
+        ProfileAccount *account = getAccount(profile ? profile->name : SCHEDULE_DEFAULT_PROFILE);
+
+        if (account) {
+            double dt = (double) (now - m_accountUs) / 1000000.0;
+            double energyWh = (double) POWER_MANAGEMENT_MODULE.getPower() * dt / 3600.0;
+
+            account->seconds += dt;
+            account->energyWh += energyWh;
+            account->terahashes += SYSTEM_MODULE.getHistory()->getCurrentHashrate1m() * dt / 1000.0;
+            account->cost += energyWh / 1000.0 * (profile ? profile->price : 0.0f);
+            account->shares += shares - m_accountShares;
+        }
+    }
+    m_accountUs = now;
+    m_accountShares = shares;
+}
+
+// called with the lock held
+void ProfileScheduler::apply(int index, int64_t now)
+{
+    const schedule_profile_t *profile = (index >= 0) ? &m_config.profiles[index] : nullptr;
+
+    if (index != m_active) {
+        ESP_LOGI(TAG, "mining profile %s (%s)", profile ? profile->name : SCHEDULE_DEFAULT_PROFILE, m_source);
+        m_switchUs = now;
+        s_switches.inc();
+    }
+    m_active = index;
+    s_profile.set(index);
+
+    Board *board = SYSTEM_MODULE.getBoard();
+    int frequency = profile ? profile->frequency : 0;
+    int voltageMillis = profile ? profile->coreVoltage : 0;
+
+    // idle chips still draw power, while paused they run at the lowest
+    // frequency and voltage the board offers
+    if (profile && profile->pause) {
+        const std::vector<uint32_t> &frequencies = board->getFrequencyOptions();
+        const std::vector<uint32_t> &voltages = board->getVoltageOptions();
+        if (!frequencies.empty()) {
+            frequency = *std::min_element(frequencies.begin(), frequencies.end());
+        }
+        if (!voltages.empty()) {
+            voltageMillis = *std::min_element(voltages.begin(), voltages.end());
+        }
+    }
+
+    // the power management task ramps to the new frequency and voltage
+    board->setProfileSettings(frequency, voltageMillis);
+    POWER_MANAGEMENT_MODULE.setProfileSettings(profile ? profile->fanMode : -1, profile ? profile->fanSpeed : -1,
+                                               profile ? profile->powerCap : -1);
+    SYSTEM_MODULE.setMiningPaused(profile && profile->pause);
+}
+
+void ProfileScheduler::tick()
+{
+    int64_t now = esp_timer_get_time();
+
+    pthread_mutex_lock(&m_lock);
+
+    // the time so far belongs to the profile of the old config
+    account(now);
+
+    bool reapply = m_reload;
+    if (m_reload) {
+        m_reload = false;
+        loadConfig();
+    }
+
+    time_t t = time(NULL);
+    m_clockSynced = t > SCHEDULE_MIN_EPOCH;
+
+    int rule = -1;
+    m_minutesToNext = -1;
+    if (m_clockSynced && m_config.enabled) {
+        struct tm local;
+        localtime_r(&t, &local);
+        int minute = local.tm_hour * 60 + local.tm_min;
+        rule = schedule_active_rule(&m_config, local.tm_wday, minute);
+        m_minutesToNext = schedule_minutes_to_next(&m_config, local.tm_wday, minute);
+    }
+    m_activeRule = rule;
+
+    // a manual profile holds until it expires or the next rule starts
+    if (m_override[0]) {
+        bool known = !strcmp(m_override, SCHEDULE_DEFAULT_PROFILE) || schedule_find_profile(&m_config, m_override) >= 0;
+        bool expired = m_overrideUntilUs ? now >= m_overrideUntilUs : rule != m_overrideRule;
+        if (!known || expired) {
+            ESP_LOGI(TAG, "manual profile %s ended", m_override);
+            m_override[0] = '\0';
+        }
+    }
+
+    int profile = -1;
+    if (m_override[0]) {
+        profile = schedule_find_profile(&m_config, m_override);
+        m_source = "manual";
+    } else if (rule >= 0) {
+        profile = m_config.rules[rule].profile;
+        m_source = "schedule";
+    } else {
+        m_source = "default";
+    }
+
+    // a changed config may have changed the profile itself
+    if (profile != m_active || reapply) {
+        apply(profile, now);
+    }
+
+    bool save = now - m_savedUs >= SCHEDULE_SAVE_INTERVAL_MS * 1000ll;
+    pthread_mutex_unlock(&m_lock);
+
+    if (save) {
+        saveAccounts();
+    }
+}
+
+void ProfileScheduler::task()
+{
+    m_task = xTaskGetCurrentTaskHandle();
+    m_savedUs = esp_timer_get_time();
+
+    loadAccounts();
+    Config::addListener(configChanged, this);
+
+    while (1) {
+        tick();
+
+        // a changed config or a manual profile wakes the task early
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SCHEDULE_TICK_MS));
+    }
+}
+
+bool ProfileScheduler::activate(const char *name, uint32_t minutes)
+{
+    pthread_mutex_lock(&m_lock);
+    bool known = !strcmp(name, SCHEDULE_DEFAULT_PROFILE) || schedule_find_profile(&m_config, name) >= 0;
+    if (known) {
+        strlcpy(m_override, name, sizeof(m_override));
+        m_overrideUntilUs = minutes ? esp_timer_get_time() + (int64_t) minutes * 60 * 1000000 : 0;
+        m_overrideRule = m_activeRule;
+        if (minutes) {
+            ESP_LOGI(TAG, "manual profile %s for %lu minutes", name, (unsigned long) minutes);
+        } else {
+            ESP_LOGI(TAG, "manual profile %s until the next rule", name);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (known && m_task) {
+        xTaskNotifyGive(m_task);
+    }
+    return known;
+}
+
+void ProfileScheduler::resume()
+{
+    pthread_mutex_lock(&m_lock);
+    m_override[0] = '\0';
+    pthread_mutex_unlock(&m_lock);
+
+    if (m_task) {
+        xTaskNotifyGive(m_task);
+    }
+}
+
+void ProfileScheduler::resetAccounts()
+{
+    pthread_mutex_lock(&m_lock);
+    m_numAccounts = 0;
+    m_accountUs = esp_timer_get_time();
+    m_accountShares = SYSTEM_MODULE.getSharesAccepted();
+    pthread_mutex_unlock(&m_lock);
+
+    saveAccounts();
+}
+
+int64_t ProfileScheduler::getSwitchUs()
+{
+    pthread_mutex_lock(&m_lock);
+    int64_t switchUs = m_switchUs;
+    pthread_mutex_unlock(&m_lock);
+    return switchUs;
+}
+
+void ProfileScheduler::getActiveName(char *name, size_t len)
+{
+    pthread_mutex_lock(&m_lock);
+    strlcpy(name, (m_active >= 0) ? m_config.profiles[m_active].name : "", len);
+    pthread_mutex_unlock(&m_lock);
+}
+
+void ProfileScheduler::toJson(JsonObject obj)
+{
+    int64_t now = esp_timer_get_time();
+
+    pthread_mutex_lock(&m_lock);
+    obj["enabled"] = m_config.enabled;
+    obj["clockSynced"] = m_clockSynced;
+    obj["profile"] = (m_active >= 0) ? m_config.profiles[m_active].name : SCHEDULE_DEFAULT_PROFILE;
+    obj["source"] = m_source;
+    obj["paused"] = SYSTEM_MODULE.isMiningPaused();
+    obj["minutesToNext"] = m_minutesToNext;
+    obj["switchAgeS"] = m_switchUs ? (now - m_switchUs) / 1000000 : -1;
+    if (m_override[0]) {
+        obj["override"] = m_override;
+        // -1 until the next rule
+        obj["overrideRemainingS"] = m_overrideUntilUs ? std::max((m_overrideUntilUs - now) / 1000000, (int64_t) 0) : -1;
+    }
+
+    // derived values so the profiles compare at a glance
+    JsonArray accounts = obj["accounts"].to<JsonArray>();
+    for (int i = 0; i < m_numAccounts; i++) {
+        const ProfileAccount *account = &m_accounts[i];
+        JsonObject a = accounts.add<JsonObject>();
+        accountToJson(account, a);
+        a["avgPower"] = account->seconds > 0.0 ? account->energyWh * 3600.0 / account->seconds : 0.0;
+        a["avgHashrate"] = account->seconds > 0.0 ? account->terahashes * 1000.0 / account->seconds : 0.0; // GH/s
+        a["joulesPerTH"] = account->terahashes > 0.0 ? account->energyWh * 3600.0 / account->terahashes : 0.0;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
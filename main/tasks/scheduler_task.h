@@ -0,0 +1,108 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "profile_schedule.h"
+
+// the schedule is checked and the accounting updated this often
+#define SCHEDULE_TICK_MS 10000
+
+// the accounting is written to NVS this often
+#define SCHEDULE_SAVE_INTERVAL_MS (60 * 60 * 1000)
+
+// before this the wall clock isn't synced (2024-01-01)
+#define SCHEDULE_MIN_EPOCH 1704067200
+
+// profiles that are accounted, including ones that were removed from the
+// schedule and the configured settings
+#define SCHEDULE_MAX_ACCOUNTS 16
+
+typedef struct
+{
+    char name[SCHEDULE_NAME_MAX]; // SCHEDULE_DEFAULT_PROFILE for the configured settings
+    double seconds;
+    double energyWh;
+    double terahashes;
+    double cost; // energy times the price of the profile
+    uint64_t shares;
+} ProfileAccount;
+
+// Switches the mining profiles of the time-of-use schedule.
+//
+// The rule in effect is taken from the local time once SNTP has synced the
+// clock. A profile activated on /api/schedule/activate holds until it
+// expires or the next rule starts. The frequency and the voltage of a
+// profile go to the board, where the power management task picks them up
+// like a changed setting, the fan and the power cap go to the power
+// management task directly. A paused profile sends no jobs and ramps the
+// chips down to the lowest frequency and voltage of the board, nonces of
+// the last job are dropped by the result task.
+//
+// Energy, hashes, shares and cost are accounted per profile, so the
+// profiles can be compared.
+class ProfileScheduler {
+  protected:
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    TaskHandle_t m_task = NULL;
+
+    schedule_config_t m_config = {};
+    bool m_reload = true;
+
+    // -1 is the configured settings
+    int m_active = -1;
+    int m_activeRule = -1;
+    const char *m_source = "default";
+    int64_t m_switchUs = 0;
+    bool m_clockSynced = false;
+    int m_minutesToNext = -1;
+
+    // manual activation, by name so it survives a config change
+    char m_override[SCHEDULE_NAME_MAX] = {};
+    int64_t m_overrideUntilUs = 0; // 0 holds until the next rule
+    int m_overrideRule = -1;
+
+    ProfileAccount m_accounts[SCHEDULE_MAX_ACCOUNTS] = {};
+    int m_numAccounts = 0;
+    int64_t m_accountUs = 0;
+    uint64_t m_accountShares = 0;
+    int64_t m_savedUs = 0;
+
+    static void configChanged(const char *key, void *arg);
+
+    void loadConfig();
+    void loadAccounts();
+    void saveAccounts();
+    ProfileAccount *getAccount(const char *name);
+    void account(int64_t now);
+    void apply(int profile, int64_t now);
+    void tick();
+    void task();
+
+  public:
+    static void taskWrapper(void *pvParameters);
+
+    // holds the profile for minutes or, with 0, until the next rule starts;
+    // SCHEDULE_DEFAULT_PROFILE holds the configured settings. false if there
+    // is no such profile.
+    bool activate(const char *name, uint32_t minutes);
+
+    // back to the schedule
+    void resume();
+
+    void resetAccounts();
+
+    // esp_timer time of the last profile change, 0 if there was none
+    int64_t getSwitchUs();
+
+    // "" while the configured settings are in effect
+    void getActiveName(char *name, size_t len);
+
+    void toJson(JsonObject obj);
+};
+
+extern ProfileScheduler PROFILE_SCHEDULER;
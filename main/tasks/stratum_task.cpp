@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <time.h>
@@ -5,7 +6,6 @@
 #include "esp_log.h"
 #include "esp_sntp.h"
 #include "esp_task_wdt.h"
-#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "global_state.h"
 #include "lwip/dns.h"
@@ -14,17 +14,16 @@
 #include "boards/board.h"
 #include "connect.h"
 #include "create_jobs_task.h"
+#include "eventlog.h"
 #include "global_state.h"
+#include "metrics.h"
 #include "nvs_config.h"
+#include "platform.h"
+#include "profiler.h"
 #include "psram_allocator.h"
 #include "stratum_task.h"
 #include "system.h"
-
-#ifdef CONFIG_SPIRAM
-#define ALLOC(s) heap_caps_malloc(s, MALLOC_CAP_SPIRAM)
-#else
-#define ALLOC(s) malloc(s)
-#endif
+#include "task_topology.h"
 
 // fallback can nicely be tested with netcat
 // mkfifo /tmp/ncpipe
@@ -36,6 +35,29 @@ enum Selected
     SECONDARY = 1
 };
 
+static Counter s_rxLines("stratum_rx_lines", "JSON-RPC lines received from the pool");
+static Counter s_rxBytes("stratum_rx_bytes", "Bytes received from the pool");
+static Counter s_parseErrors("stratum_parse_errors", "Lines that couldn't be parsed");
+static Counter s_connects("stratum_connects", "Successful pool connections");
+static Counter s_disconnects("stratum_disconnects", "Pool connections that were closed");
+static Counter s_notifies("stratum_notifies", "mining.notify messages received");
+static Counter s_cleanJobs("stratum_clean_jobs", "mining.notify messages with clean jobs flag");
+static Counter s_difficultyChanges("stratum_difficulty_changes", "mining.set_difficulty messages received");
+static Counter s_submits("stratum_submits", "Shares submitted to the pool");
+static Counter s_sharesAccepted("stratum_shares", "Share results by pool response", "result=\"accepted\"");
+static Counter s_sharesRejected("stratum_shares", "Share results by pool response", "result=\"rejected\"");
+static HistogramN<10> s_submitLatency("stratum_submit_latency_ms", "Time between share submit and pool response",
+                                      METRICS_LATENCY_MS_BUCKETS);
+static HistogramN<10> s_dispatchTime("stratum_dispatch_us", "Time to parse and dispatch a pool message",
+                                     METRICS_LATENCY_US_BUCKETS);
+static TaskLoop s_loop("stratum_dispatch");
+static Gauge s_connected("stratum_connected", "1 if connected to a pool", []() {
+    return STRATUM_MANAGER.isAnyConnected() ? 1.0f : 0.0f;
+});
+static Gauge s_fallback("stratum_using_fallback", "1 if the fallback pool is used", []() {
+    return STRATUM_MANAGER.isUsingFallback() ? 1.0f : 0.0f;
+});
+
 static void safe_free(char *&ptr)
 {
     if (ptr) {         // Check if pointer is not null
@@ -255,6 +277,7 @@ void StratumTask::task()
         // track pool errors
         // TODO: move this into the manager and mutex it
         SYSTEM_MODULE.incPoolErrors();
+        s_disconnects.inc();
 
         // shutdown and reconnect
         ESP_LOGE(m_tag, "Shutdown socket ...");
@@ -278,6 +301,7 @@ void StratumTask::stratumLoop()
 
     m_stratumAPI.resetUid();
     m_stratumAPI.clearBuffer();
+    clearPendingSubmits();
 
     ///// Start Stratum Action
     // mining.subscribe - ID: 1
@@ -318,7 +342,14 @@ void StratumTask::stratumLoop()
             break;
         }
 
-        ESP_LOGI(m_tag, "rx: %s", line); // debug incoming stratum messages
+        size_t rxLen = strlen(line);
+        s_rxLines.inc();
+        s_rxBytes.inc(rxLen);
+
+        EVENT_LOGI(EventModule::STRATUM, EventId::STRATUM_RX, rxLen, s_rxLines.get());
+        EVENT_TEXT(EventModule::STRATUM, m_tag, "rx: %s", line); // debug incoming stratum messages
+
+        int64_t rxTime = platform_time_us();
 
         PSRAMAllocator allocator;
         JsonDocument doc(&allocator);
@@ -328,6 +359,7 @@ void StratumTask::stratumLoop()
         DeserializationError error = deserializeJson(doc, line);
         if (error) {
             ESP_LOGE(m_tag, "Unable to parse JSON: %s", error.c_str());
+            s_parseErrors.inc();
             break;
         }
 
@@ -336,6 +368,7 @@ void StratumTask::stratumLoop()
         if (!m_isConnected) {
             m_manager->connectedCallback(m_index);
             m_isConnected = true;
+            s_connects.inc();
         }
 
         // if stop is requested, don't dispatch anything
@@ -347,6 +380,10 @@ void StratumTask::stratumLoop()
         // parse the line
         m_manager->dispatch(m_index, doc);
 
+        int64_t duration = platform_time_us() - rxTime;
+        s_dispatchTime.observe((float) duration);
+        s_loop.record(duration);
+
         // sets line to nullptr too
         safe_free(line);
     }
@@ -358,6 +395,37 @@ void StratumTask::submitShare(const char *jobid, const char *extranonce_2, const
                               const uint32_t version)
 {
     m_stratumAPI.submitShare(m_sock, m_config->user, jobid, extranonce_2, ntime, nonce, version);
+
+    pthread_mutex_lock(&m_pendingLock);
+    // oldest entry is overwritten when more submits are in flight than slots
+    m_pendingSubmits[m_pendingNext] = {m_stratumAPI.getLastUid(), platform_time_us()};
+    m_pendingNext = (m_pendingNext + 1) % STRATUM_PENDING_SUBMITS;
+    pthread_mutex_unlock(&m_pendingLock);
+
+    s_submits.inc();
+}
+
+int64_t StratumTask::takePendingSubmit(int64_t id)
+{
+    int64_t sentUs = 0;
+    pthread_mutex_lock(&m_pendingLock);
+    for (int i = 0; i < STRATUM_PENDING_SUBMITS; i++) {
+        if (m_pendingSubmits[i].id == id) {
+            sentUs = m_pendingSubmits[i].sentUs;
+            m_pendingSubmits[i] = {};
+            break;
+        }
+    }
+    pthread_mutex_unlock(&m_pendingLock);
+    return sentUs;
+}
+
+void StratumTask::clearPendingSubmits()
+{
+    pthread_mutex_lock(&m_pendingLock);
+    memset(m_pendingSubmits, 0, sizeof(m_pendingSubmits));
+    m_pendingNext = 0;
+    pthread_mutex_unlock(&m_pendingLock);
 }
 
 void StratumTask::connect()
@@ -372,7 +440,7 @@ void StratumTask::disconnect()
 
 StratumManager::StratumManager()
 {
-    m_stratum_api_v1_message = (StratumApiV1Message *) ALLOC(sizeof(StratumApiV1Message));
+    m_stratum_api_v1_message = (StratumApiV1Message *) platform_malloc(sizeof(StratumApiV1Message));
 }
 
 bool StratumManager::isUsingFallback()
@@ -406,14 +474,14 @@ const char* StratumManager::getResolvedIpForSelected() const {
     return m_stratumTasks[m_selected]->getResolvedIp();
 }
 
-void StratumManager::reconnectTimerCallbackWrapper(TimerHandle_t xTimer)
+void StratumManager::reconnectTimerCallbackWrapper(void *arg)
 {
-    StratumManager *self = static_cast<StratumManager *>(pvTimerGetTimerID(xTimer));
-    self->reconnectTimerCallback(xTimer);
+    StratumManager *self = static_cast<StratumManager *>(arg);
+    self->reconnectTimerCallback();
 }
 
 // Reconnect Timer Callback
-void StratumManager::reconnectTimerCallback(TimerHandle_t xTimer)
+void StratumManager::reconnectTimerCallback()
 {
     pthread_mutex_lock(&m_mutex);
     // Check if primary is still disconnected
@@ -428,12 +496,12 @@ void StratumManager::reconnectTimerCallback(TimerHandle_t xTimer)
 void StratumManager::startReconnectTimer()
 {
     if (m_reconnectTimer == NULL) {
-        m_reconnectTimer = xTimerCreate("Reconnect Timer", pdMS_TO_TICKS(30000), pdTRUE, this, reconnectTimerCallbackWrapper);
+        m_reconnectTimer = platform_timer_create("Reconnect Timer", 30000, reconnectTimerCallbackWrapper, this);
     }
 
     // only start the timer when it is not running
-    if (xTimerIsTimerActive(m_reconnectTimer) == pdFALSE) {
-        xTimerStart(m_reconnectTimer, 0);
+    if (!platform_timer_is_active(m_reconnectTimer)) {
+        platform_timer_start(m_reconnectTimer);
     }
 }
 
@@ -441,7 +509,7 @@ void StratumManager::startReconnectTimer()
 void StratumManager::stopReconnectTimer()
 {
     if (m_reconnectTimer != NULL) {
-        xTimerStop(m_reconnectTimer, 0);
+        platform_timer_stop(m_reconnectTimer);
     }
 }
 
@@ -485,8 +553,8 @@ void StratumManager::task()
     // Create the Stratum tasks for both pools
     for (int i = 0; i < 2; i++) {
         m_stratumTasks[i] = new StratumTask(this, i, system->getStratumConfig(i));
-        xTaskCreate(m_stratumTasks[i]->taskWrapper, (i == 0 ? "stratum task (primary)" : "stratum task (secondary)"), 8192,
-                    (void *) m_stratumTasks[i], 5, NULL);
+        TASK_TOPOLOGY.create(m_stratumTasks[i]->taskWrapper, (i == 0 ? "stratum task (primary)" : "stratum task (secondary)"),
+                             8192, (void *) m_stratumTasks[i], 5, NULL, TaskGroup::MINING);
     }
 
     // Always start by connecting to the primary pool
@@ -495,12 +563,20 @@ void StratumManager::task()
     // Start the reconnect timer
     startReconnectTimer();
 
+    // a paused miner submits nothing, the hour starts again when it resumes
+    uint64_t lastPausedTimestamp = 0;
+
     // Watchdog Task Loop (optional, if needed)
     while (1) {
         vTaskDelay(pdMS_TO_TICKS(30000));
 
+        if (system->isMiningPaused()) {
+            lastPausedTimestamp = platform_time_us();
+        }
+
         // Reset watchdog if there was a submit response within the last hour
-        if (m_lastSubmitResponseTimestamp && ((esp_timer_get_time() - m_lastSubmitResponseTimestamp) / 1000000) < 3600) {
+        uint64_t lastActivity = std::max(m_lastSubmitResponseTimestamp, lastPausedTimestamp);
+        if (lastActivity && ((platform_time_us() - lastActivity) / 1000000) < 3600) {
             esp_task_wdt_reset();
         }
     }
@@ -548,6 +624,10 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
 
     switch (m_stratum_api_v1_message->method) {
     case MINING_NOTIFY: {
+        s_notifies.inc();
+        if (m_stratum_api_v1_message->should_abandon_work) {
+            s_cleanJobs.inc();
+        }
         SYSTEM_MODULE.notifyNewNtime(m_stratum_api_v1_message->mining_notification->ntime);
 
         // abandon work clears the asic job list
@@ -567,6 +647,7 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
     }
 
     case MINING_SET_DIFFICULTY: {
+        s_difficultyChanges.inc();
         SYSTEM_MODULE.setPoolDifficulty(m_stratum_api_v1_message->new_difficulty);
         if (create_job_set_difficulty(m_stratum_api_v1_message->new_difficulty)) {
             ESP_LOGI(tag, "Set stratum difficulty: %ld", m_stratum_api_v1_message->new_difficulty);
@@ -597,11 +678,19 @@ void StratumManager::dispatch(int pool, JsonDocument &doc)
         if (m_stratum_api_v1_message->response_success) {
             ESP_LOGI(tag, "message result accepted");
             SYSTEM_MODULE.notifyAcceptedShare();
+            s_sharesAccepted.inc();
         } else {
             ESP_LOGW(tag, "message result rejected");
             SYSTEM_MODULE.notifyRejectedShare();
+            s_sharesRejected.inc();
+        }
+        m_lastSubmitResponseTimestamp = platform_time_us();
+        if (m_stratum_api_v1_message->message_id > 0) {
+            int64_t sentUs = selected->takePendingSubmit(m_stratum_api_v1_message->message_id);
+            if (sentUs) {
+                s_submitLatency.observe((float) ((int64_t) m_lastSubmitResponseTimestamp - sentUs) / 1000.0f);
+            }
         }
-        m_lastSubmitResponseTimestamp = esp_timer_get_time();
         break;
     }
 
@@ -1,10 +1,13 @@
 #pragma once
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
 #include "lwip/inet.h"
+#include "platform.h"
 #include <pthread.h>
 
+// number of in-flight submits tracked for the latency histogram
+#define STRATUM_PENDING_SUBMITS 16
+
 class StratumManager;
 
 /**
@@ -38,6 +41,17 @@ class StratumTask {
     bool m_stopFlag = true;     ///< Stop flag for the task
     bool m_firstJob;
 
+    // send times of in-flight submits, matched against the response id
+    typedef struct
+    {
+        int64_t id;     ///< Message ID of the submit (0 = free slot)
+        int64_t sentUs; ///< Time the submit was sent
+    } PendingSubmit;
+
+    PendingSubmit m_pendingSubmits[STRATUM_PENDING_SUBMITS] = {}; ///< Ring of in-flight submits
+    int m_pendingNext = 0;                                        ///< Next ring slot to write
+    pthread_mutex_t m_pendingLock = PTHREAD_MUTEX_INITIALIZER;    ///< Guards the submit ring
+
     // Connection and network-related methods
     bool isWifiConnected();                                                      ///< Check if Wi-Fi is connected
     bool resolveHostname(const char *hostname, char *ip_str, size_t ip_str_len); ///< Resolve hostname to IP
@@ -53,6 +67,8 @@ class StratumTask {
     // Submit mining shares to the pool
     void submitShare(const char *jobid, const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
                      const uint32_t version);
+    int64_t takePendingSubmit(int64_t id); ///< Returns and clears the send time of a submit, 0 if unknown
+    void clearPendingSubmits();            ///< Forgets all in-flight submits (message IDs restart)
 
     // Stratum task function
     void task();
@@ -118,9 +134,9 @@ class StratumManager {
     void cleanQueue();
 
     // Reconnection management
-    TimerHandle_t m_reconnectTimer;                                  ///< FreeRTOS timer for automatic reconnection
-    static void reconnectTimerCallbackWrapper(TimerHandle_t xTimer); ///< Static wrapper for FreeRTOS timer callback
-    void reconnectTimerCallback(TimerHandle_t xTimer);               ///< Handles reconnection logic
+    platform_timer_t m_reconnectTimer;                               ///< Timer for automatic reconnection
+    static void reconnectTimerCallbackWrapper(void *arg);            ///< Static wrapper for the timer callback
+    void reconnectTimerCallback();                                   ///< Handles reconnection logic
     void startReconnectTimer();                                      ///< Starts the reconnect timer
     void stopReconnectTimer();                                       ///< Stops the reconnect timer
 
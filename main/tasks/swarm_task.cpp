@@ -0,0 +1,435 @@
+#include <string.h>
+
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "global_state.h"
+#include "metrics.h"
+#include "nvs_config.h"
+#include "platform.h"
+#include "psram_allocator.h"
+#include "swarm_task.h"
+#include "task_topology.h"
+
+static const char *TAG = "swarm";
+
+static Counter s_pollsOk("swarm_polls", "Requests to swarm peers", "result=\"ok\"");
+static Counter s_pollsFailed("swarm_polls", "Requests to swarm peers", "result=\"error\"");
+static HistogramN<10> s_pollLatency("swarm_poll_latency_ms", "Duration of one request to a swarm peer",
+                                    METRICS_LATENCY_MS_BUCKETS);
+static Gauge s_roundDuration("swarm_round_ms", "Duration of the last polling round over all peers");
+static Gauge s_peers("swarm_peers", "Peers in the swarm config");
+
+SwarmAggregator SWARM_AGGREGATOR;
+
+void SwarmAggregator::taskWrapper(void *pvParameters)
+{
+    SwarmAggregator *swarm = (SwarmAggregator *) pvParameters;
+    swarm->task();
+}
+
+void SwarmAggregator::workerWrapper(void *pvParameters)
+{
+    SwarmAggregator *swarm = (SwarmAggregator *) pvParameters;
+    swarm->worker();
+}
+
+// the swarm config is the list the dashboard keeps, entries are ip strings
+// or objects with an "ip" (or "IP") member
+void SwarmAggregator::loadPeers()
+{
+    char *config = Config::getSwarmConfig();
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    DeserializationError err = deserializeJson(doc, config);
+    free(config);
+
+    SwarmPeer *peers = (SwarmPeer *) platform_malloc(sizeof(SwarmPeer) * SWARM_MAX_PEERS);
+    if (!peers) {
+        return;
+    }
+
+    const char *selfIp = SYSTEM_MODULE.getIPAddress();
+    int numPeers = 0;
+
+    pthread_mutex_lock(&m_lock);
+    for (JsonVariantConst entry : err ? JsonArrayConst() : doc.as<JsonArrayConst>()) {
+        const char *ip = entry.is<const char *>() ? entry.as<const char *>() : entry["ip"].as<const char *>();
+        if (!ip) {
+            ip = entry["IP"].as<const char *>();
+        }
+        if (!ip || !*ip || strlen(ip) >= sizeof(peers[0].ip) || !strcmp(ip, selfIp) || numPeers == SWARM_MAX_PEERS) {
+            continue;
+        }
+
+        // keep what is cached for the peer
+        SwarmPeer *peer = &peers[numPeers++];
+        memset(peer, 0, sizeof(*peer));
+        for (int i = 0; i < m_numPeers; i++) {
+            if (!strcmp(m_peers[i].ip, ip)) {
+                *peer = m_peers[i];
+                break;
+            }
+        }
+        strlcpy(peer->ip, ip, sizeof(peer->ip));
+    }
+
+    platform_free(m_peers);
+    m_peers = peers;
+    m_numPeers = numPeers;
+    pthread_mutex_unlock(&m_lock);
+
+    s_peers.set(numPeers);
+}
+
+void SwarmAggregator::pollPeer(int index, char *buf)
+{
+    char ip[sizeof(((SwarmPeer *) 0)->ip)];
+    bool legacy;
+    pthread_mutex_lock(&m_lock);
+    strlcpy(ip, m_peers[index].ip, sizeof(ip));
+    legacy = m_peers[index].legacy;
+    pthread_mutex_unlock(&m_lock);
+
+    int64_t start = esp_timer_get_time();
+    int len = -1;
+    int status = 0;
+
+    // peers with older firmware answer the compact endpoint with 404
+    for (int attempt = 0; attempt < 2 && len < 0; attempt++) {
+        char url[64];
+        snprintf(url, sizeof(url), "http://%s%s", ip, legacy ? "/api/system/info" : SWARM_STATS_PATH);
+
+        esp_http_client_config_t config = {};
+        config.url = url;
+        config.timeout_ms = SWARM_HTTP_TIMEOUT_MS;
+
+        esp_http_client_handle_t client = esp_http_client_init(&config);
+        if (!client) {
+            break;
+        }
+        if (esp_http_client_open(client, 0) == ESP_OK && esp_http_client_fetch_headers(client) >= 0) {
+            status = esp_http_client_get_status_code(client);
+            if (status == 200) {
+                int n;
+                len = 0;
+                while (len < SWARM_RESPONSE_MAX && (n = esp_http_client_read(client, buf + len, SWARM_RESPONSE_MAX - len)) > 0) {
+                    len += n;
+                }
+            }
+        }
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+
+        if (status != 404 || legacy) {
+            break;
+        }
+        legacy = true;
+    }
+
+    // only the fields of the compact endpoint, whatever else /info has
+    JsonDocument filter;
+    for (const char *key : {"hostname", "deviceModel", "ASICModel", "version", "hashRate", "hashRate_1m", "power", "temp", "vrTemp",
+                            "overheat_temp", "sharesAccepted", "sharesRejected", "isStratumConnected", "uptimeSeconds",
+                            "bestDiff", "bestSessionDiff", "poolDifficulty"}) {
+        filter[key] = true;
+    }
+
+    PSRAMAllocator allocator;
+    JsonDocument doc(&allocator);
+    bool ok = len > 0 && !deserializeJson(doc, buf, len, DeserializationOption::Filter(filter)) && doc["hashRate"].is<float>();
+
+    int64_t now = esp_timer_get_time();
+    uint16_t latencyMs = (now - start) / 1000;
+    s_pollLatency.observe(latencyMs);
+    (ok ? s_pollsOk : s_pollsFailed).inc();
+
+    pthread_mutex_lock(&m_lock);
+    // the peer list may have been reloaded, the index is only valid for
+    // the same ip
+    SwarmPeer *peer = index < m_numPeers && !strcmp(m_peers[index].ip, ip) ? &m_peers[index] : nullptr;
+    if (peer) {
+        peer->lastPollUs = now;
+        peer->latencyMs = latencyMs;
+        peer->legacy = legacy;
+        if (ok) {
+            strlcpy(peer->hostname, doc["hostname"] | "", sizeof(peer->hostname));
+            strlcpy(peer->deviceModel, doc["deviceModel"] | "", sizeof(peer->deviceModel));
+            strlcpy(peer->asicModel, doc["ASICModel"] | "", sizeof(peer->asicModel));
+            strlcpy(peer->version, doc["version"] | "", sizeof(peer->version));
+            peer->hashRate = doc["hashRate"] | 0.0f;
+            peer->hashRate1m = doc["hashRate_1m"] | peer->hashRate;
+            peer->power = doc["power"] | 0.0f;
+            peer->temp = doc["temp"] | 0.0f;
+            peer->vrTemp = doc["vrTemp"] | 0.0f;
+            peer->overheatTemp = doc["overheat_temp"] | 0;
+            peer->sharesAccepted = doc["sharesAccepted"] | (uint64_t) 0;
+            peer->sharesRejected = doc["sharesRejected"] | (uint64_t) 0;
+            peer->uptimeSeconds = doc["uptimeSeconds"] | 0;
+            peer->stratumConnected = doc["isStratumConnected"] | false;
+            strlcpy(peer->bestDiff, doc["bestDiff"] | "", sizeof(peer->bestDiff));
+            strlcpy(peer->bestSessionDiff, doc["bestSessionDiff"] | "", sizeof(peer->bestSessionDiff));
+            peer->poolDifficulty = doc["poolDifficulty"] | 0;
+            peer->lastOkUs = now;
+            peer->failures = 0;
+        } else if (peer->failures < UINT8_MAX) {
+            peer->failures++;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (!ok) {
+        ESP_LOGD(TAG, "%s: no stats (HTTP %d)", ip, status);
+    }
+}
+
+void SwarmAggregator::worker()
+{
+    char *buf = (char *) platform_malloc(SWARM_RESPONSE_MAX);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        int index;
+        while (buf && (index = m_next.fetch_add(1)) < m_numPeers) {
+            pollPeer(index, buf);
+        }
+        xSemaphoreGive(m_workersDone);
+    }
+}
+
+void SwarmAggregator::round()
+{
+    int64_t start = esp_timer_get_time();
+
+    loadPeers();
+
+    if (!m_workersStarted) {
+        m_workersDone = xSemaphoreCreateCounting(SWARM_WORKERS, 0);
+        for (int i = 0; i < SWARM_WORKERS; i++) {
+            TASK_TOPOLOGY.create(workerWrapper, "swarm poll", 6144, (void *) this, 1, &m_workers[i], TaskGroup::SERVICE);
+        }
+        m_workersStarted = true;
+    }
+
+    m_next = 0;
+    for (int i = 0; i < SWARM_WORKERS; i++) {
+        xTaskNotifyGive(m_workers[i]);
+    }
+    for (int i = 0; i < SWARM_WORKERS; i++) {
+        xSemaphoreTake(m_workersDone, portMAX_DELAY);
+    }
+
+    int64_t now = esp_timer_get_time();
+    pthread_mutex_lock(&m_lock);
+    m_lastRoundUs = now;
+    m_lastRoundMs = (now - start) / 1000;
+    m_rounds++;
+    pthread_mutex_unlock(&m_lock);
+
+    s_roundDuration.set(m_lastRoundMs);
+    ESP_LOGD(TAG, "polled %d peers in %lu ms", m_numPeers, (unsigned long) m_lastRoundMs);
+}
+
+void SwarmAggregator::task()
+{
+    m_handle = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SWARM_POLL_INTERVAL_MS));
+
+        pthread_mutex_lock(&m_lock);
+        int64_t now = esp_timer_get_time();
+        bool wanted = m_lastRequestUs && now - m_lastRequestUs < (int64_t) SWARM_IDLE_MS * 1000ll;
+        bool due = !m_lastRoundUs || now - m_lastRoundUs >= (int64_t) SWARM_POLL_INTERVAL_MS * 1000ll;
+        pthread_mutex_unlock(&m_lock);
+
+        if (wanted && due && Config::isSwarmAggregatorEnabled()) {
+            round();
+        }
+    }
+}
+
+void SwarmAggregator::request(uint32_t waitMs)
+{
+    pthread_mutex_lock(&m_lock);
+    int64_t now = esp_timer_get_time();
+    m_lastRequestUs = now;
+    bool due = !m_lastRoundUs || now - m_lastRoundUs >= (int64_t) SWARM_POLL_INTERVAL_MS * 1000ll;
+    uint32_t rounds = m_rounds;
+    pthread_mutex_unlock(&m_lock);
+
+    if (!due || !m_handle) {
+        return;
+    }
+    xTaskNotifyGive(m_handle);
+
+    // the first request waits for the first round, later ones get the cache
+    for (uint32_t waited = 0; !rounds && waited < waitMs && !getRounds(); waited += 50) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+bool SwarmAggregator::getPeer(int index, SwarmPeer *peer)
+{
+    pthread_mutex_lock(&m_lock);
+    bool ok = index < m_numPeers;
+    if (ok) {
+        *peer = m_peers[index];
+    }
+    pthread_mutex_unlock(&m_lock);
+    return ok;
+}
+
+uint32_t SwarmAggregator::getRounds()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t rounds = m_rounds;
+    pthread_mutex_unlock(&m_lock);
+    return rounds;
+}
+
+uint32_t SwarmAggregator::getLastRoundMs()
+{
+    return m_lastRoundMs;
+}
+
+int64_t SwarmAggregator::getLastRoundUs()
+{
+    pthread_mutex_lock(&m_lock);
+    int64_t lastRoundUs = m_lastRoundUs;
+    pthread_mutex_unlock(&m_lock);
+    return lastRoundUs;
+}
+
+const char *SwarmAggregator::health(const SwarmPeer *peer, int64_t now)
+{
+    int64_t pollIntervalUs = (int64_t) SWARM_POLL_INTERVAL_MS * 1000ll;
+    if (!peer->lastOkUs || (peer->failures >= 3 && now - peer->lastOkUs > 3 * pollIntervalUs)) {
+        return "offline";
+    }
+    if (peer->failures) {
+        return "stale";
+    }
+    if (peer->overheatTemp && peer->temp >= peer->overheatTemp - 5) {
+        return "hot";
+    }
+    if (!peer->stratumConnected) {
+        return "no pool";
+    }
+    if (peer->hashRate1m <= 0.0f) {
+        return "no hashrate";
+    }
+    return "ok";
+}
+
+void SwarmAggregator::addToTotals(const SwarmPeer *peer, int64_t now, SwarmTotals *totals)
+{
+    totals->devices++;
+    if (strcmp(health(peer, now), "offline")) {
+        totals->online++;
+        totals->hashRate += peer->hashRate;
+        totals->power += peer->power;
+        totals->maxTemp = peer->temp > totals->maxTemp ? peer->temp : totals->maxTemp;
+        totals->sharesAccepted += peer->sharesAccepted;
+        totals->sharesRejected += peer->sharesRejected;
+    }
+}
+
+void SwarmAggregator::peerToJson(const SwarmPeer *peer, int64_t now, JsonObject obj)
+{
+    obj["ip"] = peer->ip;
+    obj["health"] = health(peer, now);
+    obj["ageS"] = peer->lastOkUs ? (now - peer->lastOkUs) / 1000000 : -1;
+    obj["latencyMs"] = peer->latencyMs;
+    if (!peer->lastOkUs) {
+        return;
+    }
+    obj["hostname"] = peer->hostname;
+    obj["deviceModel"] = peer->deviceModel;
+    obj["ASICModel"] = peer->asicModel;
+    obj["version"] = peer->version;
+    obj["hashRate"] = peer->hashRate;
+    obj["hashRate_1m"] = peer->hashRate1m;
+    obj["power"] = peer->power;
+    obj["efficiency"] = peer->hashRate > 0.0f ? peer->power / (peer->hashRate / 1000.0f) : 0.0f;
+    obj["temp"] = peer->temp;
+    obj["vrTemp"] = peer->vrTemp;
+    obj["sharesAccepted"] = peer->sharesAccepted;
+    obj["sharesRejected"] = peer->sharesRejected;
+    obj["uptimeSeconds"] = peer->uptimeSeconds;
+    obj["isStratumConnected"] = peer->stratumConnected;
+    obj["bestDiff"] = peer->bestDiff;
+    obj["bestSessionDiff"] = peer->bestSessionDiff;
+    obj["poolDifficulty"] = peer->poolDifficulty;
+}
+
+void SwarmAggregator::totalsToJson(const SwarmTotals *totals, JsonObject obj)
+{
+    obj["devices"] = totals->devices;
+    obj["online"] = totals->online;
+    obj["hashRate"] = totals->hashRate;
+    obj["power"] = totals->power;
+    // J/TH
+    obj["efficiency"] = totals->hashRate > 0.0 ? totals->power / (totals->hashRate / 1000.0) : 0.0;
+    obj["maxTemp"] = totals->maxTemp;
+    obj["sharesAccepted"] = totals->sharesAccepted;
+    obj["sharesRejected"] = totals->sharesRejected;
+}
+
+void SwarmAggregator::localPeer(SwarmPeer *peer)
+{
+    Board *board = SYSTEM_MODULE.getBoard();
+    History *history = SYSTEM_MODULE.getHistory();
+    int64_t now = esp_timer_get_time();
+
+    memset(peer, 0, sizeof(*peer));
+    strlcpy(peer->ip, SYSTEM_MODULE.getIPAddress(), sizeof(peer->ip));
+    strlcpy(peer->hostname, SYSTEM_MODULE.getHostname(), sizeof(peer->hostname));
+    strlcpy(peer->deviceModel, board->getDeviceModel(), sizeof(peer->deviceModel));
+    strlcpy(peer->asicModel, board->getAsicModel(), sizeof(peer->asicModel));
+    strlcpy(peer->version, esp_app_get_description()->version, sizeof(peer->version));
+    peer->hashRate = history->getCurrentHashrate10m();
+    peer->hashRate1m = history->getCurrentHashrate1m();
+    peer->power = POWER_MANAGEMENT_MODULE.getPower();
+    peer->temp = POWER_MANAGEMENT_MODULE.getChipTempMax();
+    peer->vrTemp = POWER_MANAGEMENT_MODULE.getVRTemp();
+    peer->overheatTemp = Config::getOverheatTemp();
+    peer->sharesAccepted = SYSTEM_MODULE.getSharesAccepted();
+    peer->sharesRejected = SYSTEM_MODULE.getSharesRejected();
+    peer->uptimeSeconds = (now - SYSTEM_MODULE.getStartTime()) / 1000000;
+    peer->stratumConnected = STRATUM_MANAGER.isAnyConnected();
+    strlcpy(peer->bestDiff, SYSTEM_MODULE.getBestDiffString(), sizeof(peer->bestDiff));
+    strlcpy(peer->bestSessionDiff, SYSTEM_MODULE.getBestSessionDiffString(), sizeof(peer->bestSessionDiff));
+    peer->poolDifficulty = SYSTEM_MODULE.getPoolDifficulty();
+    peer->lastOkUs = now;
+    peer->lastPollUs = now;
+}
+
+void SwarmAggregator::localStats(JsonObject obj)
+{
+    SwarmPeer self;
+    localPeer(&self);
+
+    // same names as in /api/system/info, both are parsed with one filter
+    obj["hostname"] = self.hostname;
+    obj["deviceModel"] = self.deviceModel;
+    obj["ASICModel"] = self.asicModel;
+    obj["version"] = self.version;
+    obj["hashRate"] = self.hashRate;
+    obj["hashRate_1m"] = self.hashRate1m;
+    obj["power"] = self.power;
+    obj["temp"] = self.temp;
+    obj["vrTemp"] = self.vrTemp;
+    obj["overheat_temp"] = self.overheatTemp;
+    obj["sharesAccepted"] = self.sharesAccepted;
+    obj["sharesRejected"] = self.sharesRejected;
+    obj["isStratumConnected"] = self.stratumConnected;
+    obj["uptimeSeconds"] = self.uptimeSeconds;
+    obj["bestDiff"] = self.bestDiff;
+    obj["bestSessionDiff"] = self.bestSessionDiff;
+    obj["poolDifficulty"] = self.poolDifficulty;
+}
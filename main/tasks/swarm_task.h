@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+// peers of the swarm config that are polled
+#define SWARM_MAX_PEERS 64
+
+// concurrent requests to the peers, each worker holds one socket
+#define SWARM_WORKERS 4
+
+// a round is only started when the cache is older than this
+#define SWARM_POLL_INTERVAL_MS 10000
+
+// polling stops when nobody asked for the aggregate for this long
+#define SWARM_IDLE_MS (2 * 60 * 1000)
+
+#define SWARM_HTTP_TIMEOUT_MS 3000
+
+// /api/system/info of older firmware is a few KB
+#define SWARM_RESPONSE_MAX (8 * 1024)
+
+// the compact stats endpoint every device serves
+#define SWARM_STATS_PATH "/api/system/stats"
+
+typedef struct
+{
+    char ip[16];
+
+    // last good response
+    char hostname[32];
+    char deviceModel[24];
+    char asicModel[12];
+    char version[24];
+    float hashRate;   // GH/s, 10m
+    float hashRate1m; // GH/s
+    float power;
+    float temp;
+    float vrTemp;
+    uint16_t overheatTemp;
+    uint64_t sharesAccepted;
+    uint64_t sharesRejected;
+    uint32_t uptimeSeconds;
+    bool stratumConnected;
+    char bestDiff[12];
+    char bestSessionDiff[12];
+    uint32_t poolDifficulty;
+
+    bool legacy; // no compact endpoint, polled with /api/system/info
+    int64_t lastOkUs;
+    int64_t lastPollUs;
+    uint16_t latencyMs;
+    uint8_t failures; // consecutive
+} SwarmPeer;
+
+typedef struct
+{
+    int devices;
+    int online;
+    double hashRate; // GH/s
+    double power;
+    float maxTemp;
+    uint64_t sharesAccepted;
+    uint64_t sharesRejected;
+} SwarmTotals;
+
+// Polls the peers of the swarm config from this miner so the farm dashboard
+// needs one request instead of one per device. Polling is demand driven:
+// a request for the aggregate starts a round when the cache is older than
+// SWARM_POLL_INTERVAL_MS and the rounds stop SWARM_IDLE_MS after the last
+// request. A round hands the peers to SWARM_WORKERS tasks, so a farm of 60
+// devices with a few offline ones still finishes in a few timeouts.
+class SwarmAggregator {
+  protected:
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+    TaskHandle_t m_handle = NULL;
+    TaskHandle_t m_workers[SWARM_WORKERS] = {};
+    SemaphoreHandle_t m_workersDone = NULL;
+    bool m_workersStarted = false;
+
+    SwarmPeer *m_peers = nullptr; // PSRAM
+    int m_numPeers = 0;
+    std::atomic<int> m_next{0};
+
+    int64_t m_lastRequestUs = 0;
+    int64_t m_lastRoundUs = 0;
+    uint32_t m_rounds = 0;
+    uint32_t m_lastRoundMs = 0;
+
+    void loadPeers();
+    void pollPeer(int index, char *buf);
+    void round();
+    void task();
+    void worker();
+
+    static void workerWrapper(void *pvParameters);
+
+  public:
+    static void taskWrapper(void *pvParameters);
+
+    // marks the aggregate as wanted and starts a round if the cache is old,
+    // waits up to waitMs for the first round
+    void request(uint32_t waitMs);
+
+    // copy of the cached peer, false past the end
+    bool getPeer(int index, SwarmPeer *peer);
+
+    uint32_t getRounds();
+    uint32_t getLastRoundMs();
+    int64_t getLastRoundUs();
+
+    // "ok", "offline", "stale", "hot", "no pool" or "no hashrate"
+    static const char *health(const SwarmPeer *peer, int64_t now);
+
+    static void addToTotals(const SwarmPeer *peer, int64_t now, SwarmTotals *totals);
+    static void peerToJson(const SwarmPeer *peer, int64_t now, JsonObject obj);
+    static void totalsToJson(const SwarmTotals *totals, JsonObject obj);
+
+    // this device in the format of the compact endpoint
+    static void localStats(JsonObject obj);
+    static void localPeer(SwarmPeer *peer);
+};
+
+extern SwarmAggregator SWARM_AGGREGATOR;
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "metrics.h"
+#include "vr_supervisor.h"
+
+static const char *TAG = "vr_supervisor";
+
+VRSupervisor VR_SUPERVISOR;
+
+static Gauge s_interval("power_vr_poll_interval_ms", "Telemetry interval of the core regulator", []() {
+    return (float) VR_SUPERVISOR.getIntervalMs();
+});
+static Counter s_alerts("power_vr_alerts", "SMBALERT interrupts of the core regulator", []() {
+    return (uint64_t) VR_SUPERVISOR.getAlerts();
+});
+static Counter s_faults("power_vr_faults", "Faults of the core regulator");
+
+static const char *faultName(const VRStatus *status, bool psuFault)
+{
+    if ((status->word & PMBUS_SW_IOUT_OC) || (status->iout & (PMBUS_IOUT_OC_FAULT | PMBUS_IOUT_OC_LV_FAULT))) {
+        return "output over-current";
+    }
+    if ((status->word & PMBUS_SW_VIN_UV) || (status->input & PMBUS_INPUT_VIN_UV_FAULT)) {
+        return "input under-voltage";
+    }
+    if (status->input & PMBUS_INPUT_VIN_OV_FAULT) {
+        return "input over-voltage";
+    }
+    if (status->input & PMBUS_INPUT_IIN_OC_FAULT) {
+        return "input over-current";
+    }
+    if ((status->word & PMBUS_SW_VOUT_OV) || (status->vout & PMBUS_VOUT_OV_FAULT)) {
+        return "output over-voltage";
+    }
+    if (status->vout & PMBUS_VOUT_UV_FAULT) {
+        return "output under-voltage";
+    }
+    if (status->temperature & PMBUS_TEMP_OT_FAULT) {
+        return "over-temperature";
+    }
+    return psuFault ? "regulator reset" : "fault";
+}
+
+void VRSupervisor::alertIsr(void *arg)
+{
+    VRSupervisor *vr = (VRSupervisor *) arg;
+    BaseType_t woken = pdFALSE;
+
+    // unmasked again by wait() after VR_ALERT_HOLDOFF_MS
+    gpio_intr_disable(vr->m_alertPin);
+    vr->m_alertMasked = true;
+
+    vTaskNotifyGiveFromISR(vr->m_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+void VRSupervisor::init(gpio_num_t alertPin)
+{
+    m_task = xTaskGetCurrentTaskHandle();
+    m_alertPin = alertPin;
+
+    if (!hasAlertPin()) {
+        ESP_LOGI(TAG, "no SMBALERT# line, polling the status every %d ms", VR_STATUS_POLL_MS);
+        return;
+    }
+
+    // open drain, active low
+    gpio_set_direction(m_alertPin, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(m_alertPin, GPIO_PULLUP_ONLY);
+    gpio_set_intr_type(m_alertPin, GPIO_INTR_NEGEDGE);
+
+    // the display installs the service as well, whoever comes first wins
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "installing the GPIO ISR service failed: %d, polling the status", err);
+        m_alertPin = GPIO_NUM_NC;
+        return;
+    }
+    gpio_isr_handler_add(m_alertPin, alertIsr, (void *) this);
+
+    ESP_LOGI(TAG, "SMBALERT# on GPIO %d", (int) m_alertPin);
+}
+
+bool VRSupervisor::wait(uint32_t timeoutMs)
+{
+    if (hasAlertPin() && m_alertMasked) {
+        int64_t now = esp_timer_get_time();
+        int64_t rearmUs = m_alertUs + (int64_t) VR_ALERT_HOLDOFF_MS * 1000;
+
+        if (now < rearmUs) {
+            timeoutMs = std::min(timeoutMs, (uint32_t) ((rearmUs - now) / 1000) + 1);
+        } else {
+            m_alertMasked = false;
+            gpio_intr_enable(m_alertPin);
+
+            // still low, no edge will come for it
+            if (!gpio_get_level(m_alertPin)) {
+                gpio_intr_disable(m_alertPin);
+                m_alertMasked = true;
+                ulTaskNotifyTake(pdTRUE, 0);
+                m_alertUs = now;
+                m_alerts++;
+                return true;
+            }
+        }
+    }
+
+    if (!ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs))) {
+        return false;
+    }
+
+    m_alertUs = esp_timer_get_time();
+    m_alerts++;
+    return true;
+}
+
+bool VRSupervisor::checkStatus(const VRStatus *status, bool alert, bool psuFault)
+{
+    bool fault = psuFault || pmbus_is_fault(status);
+
+    pthread_mutex_lock(&m_lock);
+    m_lastStatus = *status;
+
+    if (fault || pmbus_is_warning(status)) {
+        m_intervalMs = VR_POLL_FAST_MS;
+        m_steadySamples = 0;
+    }
+
+    if (fault) {
+        VRFault *entry = &m_faults[m_nextFault];
+        entry->timestamp = esp_timer_get_time();
+        entry->status = *status;
+        entry->alert = alert;
+        entry->psuFault = psuFault;
+        entry->numSamples = (uint8_t) m_numSamples;
+        for (int i = 0; i < m_numSamples; i++) {
+            entry->samples[i] = m_samples[(m_nextSample - m_numSamples + i + VR_TIMELINE_SAMPLES) % VR_TIMELINE_SAMPLES];
+        }
+
+        m_nextFault = (m_nextFault + 1) % VR_MAX_FAULTS;
+        m_numFaults = std::min(m_numFaults + 1, VR_MAX_FAULTS);
+        m_totalFaults++;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (fault) {
+        ESP_LOGE(TAG, "%s (%s): word %04x, vout %02x, iout %02x, input %02x, temp %02x, mfr %02x", faultName(status, psuFault),
+                 alert ? "SMBALERT" : "poll", status->word, status->vout, status->iout, status->input, status->temperature,
+                 status->mfr);
+        s_faults.inc();
+    }
+    return fault;
+}
+
+void VRSupervisor::addSample(const VRSample *sample, bool nearLimit)
+{
+    pthread_mutex_lock(&m_lock);
+
+    // a step in the input means something is going on
+    bool jump = false;
+    if (m_numSamples) {
+        const VRSample *prev = &m_samples[(m_nextSample + VR_TIMELINE_SAMPLES - 1) % VR_TIMELINE_SAMPLES];
+        jump = fabsf(sample->pin - prev->pin) > 0.1f * std::max(prev->pin, 1.0f) ||
+               fabsf(sample->vin - prev->vin) > 0.05f * std::max(prev->vin, 1.0f);
+    }
+
+    m_samples[m_nextSample] = *sample;
+    m_nextSample = (m_nextSample + 1) % VR_TIMELINE_SAMPLES;
+    m_numSamples = std::min(m_numSamples + 1, VR_TIMELINE_SAMPLES);
+
+    if (nearLimit || jump) {
+        m_intervalMs = VR_POLL_FAST_MS;
+        m_steadySamples = 0;
+    } else if (++m_steadySamples >= VR_STEADY_SAMPLES) {
+        m_intervalMs = (m_intervalMs < VR_POLL_NORMAL_MS) ? VR_POLL_NORMAL_MS : VR_POLL_SLOW_MS;
+        m_steadySamples = 0;
+    }
+    pthread_mutex_unlock(&m_lock);
+}
+
+uint32_t VRSupervisor::getIntervalMs()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t intervalMs = m_intervalMs;
+    pthread_mutex_unlock(&m_lock);
+    return intervalMs;
+}
+
+uint32_t VRSupervisor::getAlerts()
+{
+    return m_alerts.load();
+}
+
+uint32_t VRSupervisor::getTotalFaults()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t totalFaults = m_totalFaults;
+    pthread_mutex_unlock(&m_lock);
+    return totalFaults;
+}
+
+static void statusToJson(const VRStatus *status, JsonObject obj)
+{
+    obj["word"] = status->word;
+    obj["vout"] = status->vout;
+    obj["iout"] = status->iout;
+    obj["input"] = status->input;
+    obj["temperature"] = status->temperature;
+    obj["mfr"] = status->mfr;
+}
+
+void VRSupervisor::toJson(JsonObject obj)
+{
+    int64_t now = esp_timer_get_time();
+
+    pthread_mutex_lock(&m_lock);
+    obj["alertPin"] = hasAlertPin() ? (int) m_alertPin : -1;
+    obj["alerts"] = m_alerts.load();
+    obj["intervalMs"] = m_intervalMs;
+    obj["totalFaults"] = m_totalFaults;
+    statusToJson(&m_lastStatus, obj["status"].to<JsonObject>());
+
+    // newest first, sample times are relative to the fault
+    JsonArray faults = obj["faults"].to<JsonArray>();
+    for (int i = 0; i < m_numFaults; i++) {
+        const VRFault *entry = &m_faults[(m_nextFault - 1 - i + VR_MAX_FAULTS) % VR_MAX_FAULTS];
+
+        JsonObject fault = faults.add<JsonObject>();
+        fault["ageS"] = (uint32_t) ((now - entry->timestamp) / 1000000);
+        fault["cause"] = faultName(&entry->status, entry->psuFault);
+        fault["source"] = entry->alert ? "alert" : "poll";
+        statusToJson(&entry->status, fault["status"].to<JsonObject>());
+
+        JsonArray samples = fault["samples"].to<JsonArray>();
+        for (int j = 0; j < entry->numSamples; j++) {
+            const VRSample *sample = &entry->samples[j];
+            JsonObject s = samples.add<JsonObject>();
+            s["ms"] = (int32_t) ((sample->timestamp - entry->timestamp) / 1000);
+            s["vin"] = sample->vin;
+            s["iin"] = sample->iin;
+            s["pin"] = sample->pin;
+            s["vout"] = sample->vout;
+            s["iout"] = sample->iout;
+            s["vrTemp"] = sample->vrTemp;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ArduinoJson.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "boards/drivers/pmbus_status.h"
+
+// telemetry interval of the core regulator
+#define VR_POLL_FAST_MS 1000
+#define VR_POLL_NORMAL_MS 2000
+#define VR_POLL_SLOW_MS 6000
+
+// quiet samples in a row before the interval is raised one step
+#define VR_STEADY_SAMPLES 10
+
+// without SMBALERT# the status is polled this often
+#define VR_STATUS_POLL_MS 500
+
+// SMBALERT# stays masked this long after it fired, a warning that is
+// latched again right after CLEAR_FAULTS can't keep the task busy
+#define VR_ALERT_HOLDOFF_MS 200
+
+// samples before a fault that are kept with it
+#define VR_TIMELINE_SAMPLES 8
+
+// faults kept for /api/system/vr
+#define VR_MAX_FAULTS 8
+
+// a value within this share of its limit counts as near the limit
+#define VR_NEAR_LIMIT 0.9f
+
+typedef struct
+{
+    int64_t timestamp; // us since boot
+    float vin;
+    float iin;
+    float pin;
+    float vout;
+    float iout;
+    float vrTemp;
+} VRSample;
+
+typedef struct
+{
+    int64_t timestamp;
+    VRStatus status;
+    bool alert; // SMBALERT# fired, else found by polling
+    bool psuFault;
+    uint8_t numSamples;
+    VRSample samples[VR_TIMELINE_SAMPLES]; // oldest first
+} VRFault;
+
+// Supervises the core regulator for the power management task.
+//
+// The status is read when SMBALERT# fires or, on boards without the line,
+// every VR_STATUS_POLL_MS, which is one STATUS_WORD read as long as
+// nothing is latched. A fault is stored with the telemetry samples taken
+// before it.
+//
+// The telemetry interval follows the state of the regulator: a warning
+// bit, a value near its limit or a jump between two samples selects
+// VR_POLL_FAST_MS, VR_STEADY_SAMPLES quiet samples in a row raise it one
+// step up to VR_POLL_SLOW_MS.
+class VRSupervisor {
+  protected:
+    pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    TaskHandle_t m_task = NULL;
+    gpio_num_t m_alertPin = GPIO_NUM_NC;
+    std::atomic<bool> m_alertMasked{false};
+    int64_t m_alertUs = 0;
+    std::atomic<uint32_t> m_alerts{0};
+
+    // ring of the last samples
+    VRSample m_samples[VR_TIMELINE_SAMPLES] = {};
+    int m_numSamples = 0;
+    int m_nextSample = 0;
+
+    // ring of the last faults
+    VRFault m_faults[VR_MAX_FAULTS] = {};
+    int m_numFaults = 0;
+    int m_nextFault = 0;
+    uint32_t m_totalFaults = 0;
+
+    VRStatus m_lastStatus = {};
+    uint32_t m_intervalMs = VR_POLL_NORMAL_MS;
+    int m_steadySamples = 0;
+
+    static void alertIsr(void *arg);
+
+  public:
+    // installs the SMBALERT# interrupt for the calling task, alertPin may
+    // be GPIO_NUM_NC
+    void init(gpio_num_t alertPin);
+
+    bool hasAlertPin()
+    {
+        return m_alertPin != GPIO_NUM_NC;
+    }
+
+    // waits up to timeoutMs for SMBALERT#, true when it fired
+    bool wait(uint32_t timeoutMs);
+
+    // status read in this wake up, records and returns true on a fault
+    bool checkStatus(const VRStatus *status, bool alert, bool psuFault);
+
+    // stores a telemetry sample, nearLimit when a limit outside of the
+    // regulator is close (ASIC temperature, input power)
+    void addSample(const VRSample *sample, bool nearLimit);
+
+    uint32_t getIntervalMs();
+    uint32_t getAlerts();
+    uint32_t getTotalFaults();
+
+    void toJson(JsonObject obj);
+};
+
+extern VRSupervisor VR_SUPERVISOR;
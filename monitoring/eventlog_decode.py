@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""
+Fetches and decodes the binary event log of a miner.
+
+    ./eventlog_decode.py 192.168.1.50 [--since 0] [--follow]
+
+The record layout and the event table mirror main/eventlog.h and
+main/eventlog.cpp, new events have to be added in both places.
+"""
+
+import argparse
+import struct
+import time
+import urllib.request
+
+RECORD = struct.Struct("<IHBBq6I")
+
+MODULES = ["asic", "history", "stratum"]
+
+# id: (name, argument types, argument names)
+EVENTS = {
+    1: ("asic_nonce", "xuxxfu", ["job", "asic", "ver", "nonce", "diff", "pool_diff"]),
+    2: ("asic_temp", "uf", ["asic", "temp"]),
+    3: ("asic_invalid_job", "x", ["job"]),
+    4: ("history_share", "uffffx", ["asic", "1m", "10m", "1h", "1d", "preliminary"]),
+    5: ("stratum_rx", "uu", ["len", "line"]),
+}
+
+
+def decode(raw):
+    seq, eid, module, nargs, ts, *args = RECORD.unpack(raw)
+    name, types, names = EVENTS.get(eid, ("unknown", "", []))
+    out = "%d %d.%03d %s %s" % (seq, ts // 1000000, (ts // 1000) % 1000,
+                                MODULES[module] if module < len(MODULES) else "?", name)
+    for i in range(min(nargs, 6)):
+        t = types[i] if i < len(types) else "x"
+        n = names[i] if i < len(names) else "arg"
+        v = args[i]
+        if t == "f":
+            v = "%.3f" % struct.unpack("<f", struct.pack("<I", v))[0]
+        elif t == "i":
+            v = str(struct.unpack("<i", struct.pack("<I", v))[0])
+        elif t == "x":
+            v = "0x%08x" % v
+        out += " %s=%s" % (n, v)
+    return seq, out
+
+
+def fetch(host, since):
+    with urllib.request.urlopen("http://%s/api/events?since=%d" % (host, since), timeout=10) as r:
+        size = int(r.headers.get("X-Event-Record-Size", RECORD.size))
+        next_seq = int(r.headers.get("X-Event-Next-Seq", since))
+        data = r.read()
+    if size != RECORD.size:
+        raise SystemExit("record size %d doesn't match the decoder (%d)" % (size, RECORD.size))
+    for off in range(0, len(data) - size + 1, size):
+        yield decode(data[off:off + size])
+    return next_seq
+
+
+def main():
+    p = argparse.ArgumentParser()
+    p.add_argument("host")
+    p.add_argument("--since", type=int, default=0)
+    p.add_argument("--follow", action="store_true")
+    p.add_argument("--interval", type=float, default=2.0)
+    a = p.parse_args()
+
+    since = a.since
+    while True:
+        for seq, line in fetch(a.host, since):
+            print(line)
+            since = seq + 1
+        if not a.follow:
+            break
+        time.sleep(a.interval)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""
+Minimal InfluxDB v2 stand-in for testing the miner's batch writer.
+
+Implements the endpoints the firmware uses (/ping, /api/v2/orgs,
+/api/v2/buckets, /api/v2/query, /api/v2/write), decodes gzip batches
+and prints per-batch and running statistics. HTTP/1.1 keep-alive is
+supported, so connection reuse can be verified as well.
+
+    ./influx_standin.py --port 8086 [--fail-every 5] [--dump points.lp]
+
+--fail-every N answers every Nth write with 503 to exercise the
+retry/backfill path on the device.
+"""
+
+import argparse
+import gzip
+import json
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+stats = {
+    "batches": 0,
+    "points": 0,
+    "bytes_wire": 0,
+    "bytes_raw": 0,
+    "connections": set(),
+    "started": time.time(),
+}
+args = None
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *a):
+        pass
+
+    def reply(self, code, body=b"", ctype="application/json"):
+        self.send_response(code)
+        self.send_header("Content-Type", ctype)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if body:
+            self.wfile.write(body)
+
+    def read_body(self):
+        length = int(self.headers.get("Content-Length", 0))
+        return self.rfile.read(length) if length else b""
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        if url.path == "/ping":
+            self.reply(204)
+        elif url.path == "/api/v2/orgs":
+            self.reply(200, json.dumps({"orgs": [{"id": "0000000000000001", "name": "standin"}]}).encode())
+        elif url.path == "/api/v2/buckets":
+            name = parse_qs(url.query).get("name", ["bucket"])[0]
+            self.reply(200, json.dumps({"buckets": [{"id": "0000000000000002", "name": name}]}).encode())
+        else:
+            self.reply(404)
+
+    def do_POST(self):
+        url = urlparse(self.path)
+        body = self.read_body()
+        if url.path == "/api/v2/buckets":
+            self.reply(201, b"{}")
+        elif url.path == "/api/v2/query":
+            # header only, no previous values
+            self.reply(200, b"result,table,_start,_stop,_time,_value,_field,_measurement\r\n", "text/csv")
+        elif url.path == "/api/v2/write":
+            self.handle_write(url, body)
+        else:
+            self.reply(404)
+
+    def handle_write(self, url, body):
+        stats["batches"] += 1
+        if args.fail_every and stats["batches"] % args.fail_every == 0:
+            print(f"batch {stats['batches']}: answering 503")
+            self.reply(503)
+            return
+
+        wire = len(body)
+        if self.headers.get("Content-Encoding") == "gzip":
+            try:
+                body = gzip.decompress(body)
+            except Exception as e:
+                self.reply(400, json.dumps({"code": "invalid", "message": str(e)}).encode())
+                return
+
+        lines = [l for l in body.decode().split("\n") if l]
+        stats["points"] += len(lines)
+        stats["bytes_wire"] += wire
+        stats["bytes_raw"] += len(body)
+        stats["connections"].add(self.client_address)
+
+        if args.dump:
+            with open(args.dump, "a") as f:
+                f.write("\n".join(lines) + "\n")
+
+        elapsed = time.time() - stats["started"]
+        precision = parse_qs(url.query).get("precision", ["ns"])[0]
+        print(
+            f"batch {stats['batches']}: {len(lines)} points, {len(body)} bytes, {wire} on the wire "
+            f"({self.headers.get('Content-Encoding', 'identity')}, precision={precision}) | "
+            f"total {stats['points']} points, {stats['points'] / elapsed:.2f} points/s, "
+            f"ratio {stats['bytes_wire'] / max(stats['bytes_raw'], 1):.2f}, "
+            f"{len(stats['connections'])} connection(s)"
+        )
+        self.reply(204)
+
+
+def main():
+    global args
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8086)
+    parser.add_argument("--fail-every", type=int, default=0, help="answer every Nth write with 503")
+    parser.add_argument("--dump", help="append received points to this file")
+    args = parser.parse_args()
+
+    print(f"InfluxDB stand-in listening on :{args.port}")
+    ThreadingHTTPServer(("", args.port), Handler).serve_forever()
+
+
+if __name__ == "__main__":
+    main()